@@ -3,6 +3,7 @@
 
 #include "assert.h"
 #include "../utils/utils.h"
+#include "../utils/color_kernels.h"
 #include "nrf_log.h"
 
 #include "animation_simple.h"
@@ -16,8 +17,12 @@
 #include "animation_normals.h"
 #include "animation_sequence.h"
 #include "animation_worm.h"
+#include "animation_baked.h"
 #include "config/settings.h"
 #include "config/dice_variants.h"
+#include "modules/anim_controller.h"
+#include "animation_pools.h"
+#include <new>
 
 
 // Define new and delete
@@ -34,6 +39,14 @@ using namespace Config;
 
 namespace Animations
 {
+    static SmallInstancePool smallInstancePool;
+    static LargeInstancePool largeInstancePool;
+
+    // Face colors of the animation being rendered, used for blended LEDs. Animations are only ever rendered
+    // one at a time from the anim controller update, so this scratch buffer doesn't need to live on the stack.
+    static uint32_t faceColors[MAX_LED_COUNT];
+
+    /// <summary>
     /// Dims the passed in color by the passed in intensity (normalized 0 - 255)
     /// </summary>
     uint32_t scaleColor(uint32_t refColor, uint8_t intensity)
@@ -63,29 +76,29 @@ namespace Animations
         remapFace = _remapFace;
         forceFadeTime = -1;
         loopCount = _loopCount;
+        durationDivider.setDivisor(animationPreset->duration);
+        fadeDivider.setDivisor(0);
     }
 
     int AnimationInstance::setColor(uint32_t color, uint32_t faceMask, int retIndices[], uint32_t retColors[]) {
-        int c = SettingsManager::getLayout()->faceCount;
+        uint32_t mask = faceMask & ((1 << SettingsManager::getLayout()->faceCount) - 1);
         int retCount = 0;
-        for (int i = 0; i < c; ++i) {
-            if ((faceMask & (1 << i)) != 0) {
-                retIndices[retCount] = i;
-                retColors[retCount] = color;
-                retCount++;
-            }
+        while (mask != 0) {
+            retIndices[retCount] = __builtin_ctz(mask);
+            retColors[retCount] = color;
+            retCount++;
+            mask &= mask - 1;
         }
         return retCount;
     }
 
     int AnimationInstance::setIndices(uint32_t faceMask, int retIndices[]) {
-        int c = SettingsManager::getLayout()->faceCount;
+        uint32_t mask = faceMask & ((1 << SettingsManager::getLayout()->faceCount) - 1);
         int retCount = 0;
-        for (int i = 0; i < c; ++i) {
-            if ((faceMask & (1 << i)) != 0) {
-                retIndices[retCount] = i;
-                retCount++;
-            }
+        while (mask != 0) {
+            retIndices[retCount] = __builtin_ctz(mask);
+            retCount++;
+            mask &= mask - 1;
         }
         return retCount;
     }
@@ -106,130 +119,250 @@ namespace Animations
     }
 
     /*virtual*/ 
-    void AnimationInstance::updateFaces(int ms, uint32_t* outFaces) {
-
-        auto layout = SettingsManager::getLayout();
-
-        // Update the (derived) animation instance
+    void AnimationInstance::updateFaces(int ms, AnimationFaces& outFaces) {
         int animIndices[MAX_LED_COUNT];
         uint32_t animColors[MAX_LED_COUNT];
         int animColorCount = update(ms, animIndices, animColors);
-
-        // Flatten the colors
-        memset(outFaces, 0, sizeof(uint32_t) * MAX_LED_COUNT);
         for (int i = 0; i < animColorCount; ++i) {
             int face = animIndices[i];
-            if (face < layout->faceCount) {
-                // Remap the faces as necessary
-                int remappedFace = layout->remapFaceIndexBasedOnUpFace(remapFace, face);
-                outFaces[remappedFace] = animColors[i];
+            if (face < MAX_LED_COUNT) {
+                outFaces.faceMask |= 1 << face;
+                outFaces.colors[face] = animColors[i];
             }
         }
     }
 
     /*virtual*/ 
-    void AnimationInstance::updateLEDs(int ms, uint32_t* outLEDs) {
+    void AnimationInstance::render(int ms, uint32_t fadeTimes1000, uint32_t* daisyChainFrame) {
 
-        uint32_t faceColors[MAX_LED_COUNT];
-        memset(faceColors, 0, sizeof(uint32_t) * MAX_LED_COUNT);
-        updateFaces(ms, faceColors);
-
-        // Do a bunch of remapping / blending based on the animation flags and layout
         auto layout = SettingsManager::getLayout();
+        auto tables = layout->getTables();
+
+        // Update the (derived) animation instance
+        AnimationFaces animFaces;
+        animFaces.faceMask = 0;
+        updateFaces(ms, animFaces);
+        uint32_t faceMask = animFaces.faceMask & ((1 << layout->faceCount) - 1);
+        if (faceMask == 0) {
+            // Nothing lit, and blending black doesn't change the frame
+            return;
+        }
+
+        // Convert the fade once for the whole frame
+        uint32_t fadeMultiplier = ColorKernels::getFadeMultiplier(fadeTimes1000);
+
+        // Face colors are only needed to average the colors of blended LEDs
+        bool hasBlendedLEDs = tables->blendedLEDCount > 0;
+        if (hasBlendedLEDs) {
+            memset(faceColors, 0, sizeof(uint32_t) * layout->faceCount);
+        }
+
+        // Faces map to different remapped faces, so they can be processed in any order
+        uint32_t doneFaces = 0;
+        while (faceMask != 0) {
+            int face = __builtin_ctz(faceMask);
+            faceMask &= faceMask - 1;
+
+            // Remap the faces as necessary
+            int remappedFace = layout->remapFaceIndexBasedOnUpFace(remapFace, face);
+            doneFaces |= 1 << remappedFace;
+            uint32_t color = animFaces.colors[face];
+            if (hasBlendedLEDs) {
+                faceColors[remappedFace] = color;
+            }
+            if (color != 0) {
+                // Blend the color into all the LEDs of that face
+                uint32_t daisyChainMask = tables->daisyChainMaskFromFace[remappedFace];
+                while (daisyChainMask != 0) {
+                    blendColor(daisyChainFrame, __builtin_ctz(daisyChainMask), color, fadeMultiplier);
+                    daisyChainMask &= daisyChainMask - 1;
+                }
+            }
+        }
 
-        // Now figure out what color each LED needs
-        // Remap "electrical" index (daisy chain index) to "logical" led index
-        for (int l = 0; l < layout->ledCount; ++l) {
-
-            // Animation specifies face indices, meaning if there are more than one led on a face,
-            // they will all get the same color from the animation.
-            int faces[MAX_BLENDED_COLORS];
-            int faceCount = layout->faceIndicesFromLEDIndex(l, faces);
-
-            // Blend the colors together
-            if (faceCount == 0) {
-                // No face, no color
-                outLEDs[l] = 0;
-            } else if (faceCount == 1) {
-                // One face, copy the color
-                outLEDs[l] = faceColors[faces[0]];
-            } else {
-                // Multiple faces, average the colors
+        // LEDs showing several faces get the average of their colors
+        for (int l = 0; l < tables->blendedLEDCount; ++l) {
+            auto& blendedLED = tables->blendedLEDs[l];
+            if ((blendedLED.faceMask & doneFaces) != 0) {
                 uint32_t r = 0;
                 uint32_t g = 0;
                 uint32_t b = 0;
-                for (int i = 0; i < faceCount; ++i) {
-                    uint32_t faceColor = faceColors[faces[i]];
-                    r += getRed(faceColor);
-                    g += getGreen(faceColor);
-                    b += getBlue(faceColor);
+                uint32_t faceMask = blendedLED.faceMask;
+                for (int f = 0; faceMask != 0; ++f, faceMask >>= 1) {
+                    if ((faceMask & 1) != 0) {
+                        uint32_t faceColor = faceColors[f];
+                        r += getRed(faceColor);
+                        g += getGreen(faceColor);
+                        b += getBlue(faceColor);
+                    }
+                }
+                uint32_t color = toColor(r / blendedLED.faceCount, g / blendedLED.faceCount, b / blendedLED.faceCount);
+                if (color != 0) {
+                    blendColor(daisyChainFrame, blendedLED.daisyChainIndex, color, fadeMultiplier);
                 }
-                r /= faceCount;
-                g /= faceCount;
-                b /= faceCount;
-
-                // Set the led color
-                outLEDs[l] = toColor(r, g, b);
             }
         }
     }
 
-    /*virtual*/ 
-    void AnimationInstance::updateDaisyChainLEDs(int ms, uint32_t* outDaisyChainColors) {
+    int AnimationInstance::nextChangeTime(int ms) const {
+        return ms + 1;
+    }
+
+    int AnimationInstance::getPhase(int ms, int scale) const {
+        // The product overflows 32 bits with large scales (i.e. a count times 1000) late in long animations
+        int64_t scaledTime = (int64_t)(ms - startTime) * scale;
+        uint64_t magnitude = scaledTime < 0 ? -scaledTime : scaledTime;
+        uint32_t phase;
+        if (magnitude < 0x80000000) {
+            phase = durationDivider.divide((uint32_t)magnitude);
+        } else {
+            // Out of range of the divider, fall back to a (slower) 64 bits division
+            phase = durationDivider.divisor != 0 ? (uint32_t)(magnitude / durationDivider.divisor) : 0;
+        }
+        return scaledTime < 0 ? -(int)phase : (int)phase;
+    }
+
+    int AnimationInstance::getTrackTime(int ms) const {
+        return getPhase(ms, 1000);
+    }
+
+    void AnimationInstance::setFadeTime(int fadeTime) {
+        fadeDivider.setDivisor(fadeTime);
+    }
+
+    uint8_t AnimationInstance::getFadeIntensity(int ms, uint8_t intensity) const {
+        int time = ms - startTime;
+        int fadeTime = fadeDivider.divisor;
+        int rampTime;
+        if (time <= fadeTime) {
+            // Ramp up
+            rampTime = time;
+        } else if (time >= animationPreset->duration - fadeTime) {
+            // Ramp down
+            rampTime = animationPreset->duration - time;
+        } else {
+            return intensity;
+        }
+        return rampTime > 0 ? (uint8_t)fadeDivider.divide(rampTime * intensity) : 0;
+    }
+
+    int AnimationInstance::trackTimeToNextChangeTime(int trackTime) const {
+        if (trackTime >= 1000) {
+            return ANIM_TIME_NEVER;
+        }
+        // The track is evaluated at (ms - startTime) * 1000 / duration, find the first ms where that goes past trackTime
+        return startTime + ((trackTime + 1) * animationPreset->duration + 999) / 1000;
+    }
+
+    bool AnimationInstance::getCoverage(int ms, uint32_t fadeTimes1000, AnimationCoverage& outCoverage) const {
+        return false;
+    }
 
+    bool AnimationInstance::getLoop(int ms, AnimationLoop& outLoop) const {
+        return false;
+    }
 
-        // Do a bunch of remapping / blending based on the animation flags and layout
+    void AnimationInstance::getUniformColorCoverage(uint32_t color, uint32_t faceMask, uint32_t fadeTimes1000, AnimationCoverage& outCoverage) const {
         auto layout = SettingsManager::getLayout();
+        auto tables = layout->getTables();
+
+        if (fadeTimes1000 != 1000) {
+            color = ColorKernels::scale(color, fadeTimes1000);
+        }
+        outCoverage.ledMask = 0;
+        outCoverage.opaqueMask = 0;
+        outCoverage.minColor = color;
+        outCoverage.maxColor = color;
+        if (color == 0) {
+            // Nothing lit
+            return;
+        }
 
-        uint32_t ledColors[MAX_LED_COUNT];
-        memset(ledColors, 0, sizeof(uint32_t) * MAX_LED_COUNT);
-        updateLEDs(ms, ledColors);
+        // Same faces as render() would go through
+        uint32_t remappedFaceMask = 0;
+        for (int face = 0; face < layout->faceCount; ++face) {
+            if ((faceMask & (1 << face)) != 0) {
+                int remappedFace = layout->remapFaceIndexBasedOnUpFace(remapFace, face);
+                remappedFaceMask |= 1 << remappedFace;
+                outCoverage.opaqueMask |= tables->daisyChainMaskFromFace[remappedFace];
+            }
+        }
 
-        // Remap "electrical" index (daisy chain index) to "logical" led index
-        for (int l = 0; l < layout->ledCount; ++l) {
+        // Blended LEDs get the color if all their faces have it, and something darker if only some do
+        outCoverage.ledMask = outCoverage.opaqueMask;
+        for (int l = 0; l < tables->blendedLEDCount; ++l) {
+            auto& blendedLED = tables->blendedLEDs[l];
+            uint32_t blendedLEDBit = 1 << blendedLED.daisyChainIndex;
+            if ((blendedLED.faceMask & remappedFaceMask) == blendedLED.faceMask) {
+                outCoverage.opaqueMask |= blendedLEDBit;
+                outCoverage.ledMask |= blendedLEDBit;
+            } else if ((blendedLED.faceMask & remappedFaceMask) != 0) {
+                outCoverage.ledMask |= blendedLEDBit;
+            }
+        }
+    }
 
-            int ll = layout->LEDIndexFromDaisyChainIndex(l);
-            outDaisyChainColors[l] = ledColors[ll];
+    void AnimationInstance::blendColor(uint32_t* daisyChainFrame, int daisyChainIndex, uint32_t color, uint32_t fadeMultiplier) {
+        if (fadeMultiplier != COLOR_FADE_MULTIPLIER_NONE) {
+            color = ColorKernels::fade(color, fadeMultiplier);
         }
+        daisyChainFrame[daisyChainIndex] = ColorKernels::blendMax(daisyChainFrame[daisyChainIndex], color);
     }
 
 
+    /// <summary>
+    /// Constructs an instance of the given type in a slot from the pool, returns nullptr if the pool is full
+    /// </summary>
+    template <typename InstanceType, typename PresetType>
+    AnimationInstance* createInstance(const Animation* preset, const AnimationBits* bits) {
+        void* slot = sizeof(InstanceType) <= SmallInstancePool::slotSize()
+            ? smallInstancePool.alloc(sizeof(InstanceType))
+            : largeInstancePool.alloc(sizeof(InstanceType));
+        if (slot == nullptr) {
+            NRF_LOG_ERROR("Animation instance pool is full");
+            return nullptr;
+        }
+        return new (slot) InstanceType(static_cast<const PresetType*>(preset), bits);
+    }
+
     AnimationInstance* createAnimationInstance(const Animation* preset, const AnimationBits* bits) {
         AnimationInstance* ret = nullptr;
         switch (preset->type) {
             case Animation_Simple:
-                // Maybe we'll pass an allocator at some point, this is the only place I've ever used a new in the firmware...
-                ret = new AnimationInstanceSimple(static_cast<const AnimationSimple*>(preset), bits);
+                ret = createInstance<AnimationInstanceSimple, AnimationSimple>(preset, bits);
                 break;
             case Animation_Gradient:
-                ret = new AnimationInstanceGradient(static_cast<const AnimationGradient*>(preset), bits);
+                ret = createInstance<AnimationInstanceGradient, AnimationGradient>(preset, bits);
                 break;
             case Animation_Rainbow:
-                ret = new AnimationInstanceRainbow(static_cast<const AnimationRainbow*>(preset), bits);
+                ret = createInstance<AnimationInstanceRainbow, AnimationRainbow>(preset, bits);
                 break;
             case Animation_Keyframed:
-                ret = new AnimationInstanceKeyframed(static_cast<const AnimationKeyframed*>(preset), bits);
+                ret = createInstance<AnimationInstanceKeyframed, AnimationKeyframed>(preset, bits);
                 break;
             case Animation_GradientPattern:
-                ret = new AnimationInstanceGradientPattern(static_cast<const AnimationGradientPattern*>(preset), bits);
+                ret = createInstance<AnimationInstanceGradientPattern, AnimationGradientPattern>(preset, bits);
                 break;
             case Animation_Noise:
-                ret = new AnimationInstanceNoise(static_cast<const AnimationNoise*>(preset), bits);
+                ret = createInstance<AnimationInstanceNoise, AnimationNoise>(preset, bits);
                 break;
             case Animation_Cycle:
-                ret = new AnimationInstanceCycle(static_cast<const AnimationCycle *>(preset), bits);
+                ret = createInstance<AnimationInstanceCycle, AnimationCycle>(preset, bits);
                 break;
             case Animation_BlinkId:
-                ret = new AnimationInstanceBlinkId(static_cast<const AnimationBlinkId*>(preset), bits);
+                ret = createInstance<AnimationInstanceBlinkId, AnimationBlinkId>(preset, bits);
                 break;
             case Animation_Normals:
-                ret = new AnimationInstanceNormals(static_cast<const AnimationNormals*>(preset), bits);
+                ret = createInstance<AnimationInstanceNormals, AnimationNormals>(preset, bits);
                 break;
             case Animation_Sequence:
-                ret = new AnimationInstanceSequence(static_cast<const AnimationSequence*>(preset), bits);
+                ret = createInstance<AnimationInstanceSequence, AnimationSequence>(preset, bits);
                 break;
             case Animation_Worm:
-                ret = new AnimationInstanceWorm(static_cast<const AnimationWorm*>(preset), bits);
+                ret = createInstance<AnimationInstanceWorm, AnimationWorm>(preset, bits);
+                break;
+            case Animation_Baked:
+                ret = createInstance<AnimationInstanceBaked, AnimationBaked>(preset, bits);
                 break;
             default:
                 NRF_LOG_ERROR("Unknown animation preset type");
@@ -239,9 +372,31 @@ namespace Animations
     }
 
     void destroyAnimationInstance(AnimationInstance* animationInstance) {
-        // Eventually we might use an allocator
-        delete animationInstance;
+        if (animationInstance == nullptr) {
+            return;
+        }
+
+        // Instances are constructed in place, so call the destructor explicitly before returning the slot
+        animationInstance->~AnimationInstance();
+        if (!smallInstancePool.release(animationInstance) && !largeInstancePool.release(animationInstance)) {
+            NRF_LOG_ERROR("Animation instance not allocated from the pool");
+        }
     }
 
-}
+    template <typename Pool>
+    void getPoolStats(const Pool& pool, InstancePoolStats& outStats) {
+        auto& stats = pool.getStats();
+        outStats.allocCount = stats.allocCount;
+        outStats.failureCount = stats.failureCount;
+        outStats.inUseCount = stats.inUseCount;
+        outStats.peakInUseCount = stats.peakInUseCount;
+        outStats.slotSize = (uint16_t)Pool::slotSize();
+        outStats.slotCount = (uint8_t)Pool::slotCount();
+    }
+
+    void getInstancePoolStats(InstancePoolStats& outSmallStats, InstancePoolStats& outLargeStats) {
+        getPoolStats(smallInstancePool, outSmallStats);
+        getPoolStats(largeInstancePool, outLargeStats);
+    }
 
+}
@@ -2,6 +2,7 @@
 
 #include <stdint.h>
 #include "animation_tag.h"
+#include "config/settings.h"
 
 #pragma pack(push, 1)
 
@@ -13,6 +14,9 @@ namespace DataSet
 #define ANIM_FACEMASK_ALL_LEDS 0xFFFFFFFF
 #define MAX_BLENDED_COLORS (8)
 
+// Returned by nextChangeTime() when the output won't change until the animation ends
+#define ANIM_TIME_NEVER 0x7FFFFFFF
+
 namespace Animations
 {
     /// <summary>
@@ -32,6 +36,9 @@ namespace Animations
         Animation_Normals,
         Animation_Sequence,
         Animation_Worm,
+        Animation_Baked,
+
+        Animation_Count,
     };
 
     /// <summary>
@@ -53,6 +60,82 @@ namespace Animations
         uint8_t animFlags; // Combination of AnimationFlags
         uint16_t duration; // in ms
     };
+}
+
+#pragma pack(pop)
+
+// Runtime types, left with their natural alignment so that the instance data isn't accessed unaligned
+namespace Animations
+{
+    /// <summary>
+    /// What an animation lights up on a given frame, in daisy chain LEDs and after fading.
+    /// Since animations are max-blended, an animation whose maxColor is below the minColor of other
+    /// animations over all of its ledMask can't change the frame, and the anim controller skips it.
+    /// </summary>
+    struct AnimationCoverage
+    {
+        uint32_t ledMask;       // LEDs the animation may light
+        uint32_t opaqueMask;    // LEDs the animation sets to at least minColor
+        uint32_t minColor;      // Per channel lower bound of the colors over opaqueMask
+        uint32_t maxColor;      // Per channel upper bound of the colors over ledMask
+    };
+
+    /// <summary>
+    /// The faces an animation lights on a given frame, in 'canonical orientation' (i.e. ignoring the
+    /// current up face): a bit mask of the faces and a color per face, only valid for the faces in the mask.
+    /// </summary>
+    struct AnimationFaces
+    {
+        uint32_t faceMask;
+        uint32_t colors[MAX_LED_COUNT];
+
+        // Sets all the faces of the mask to the same color
+        void fill(uint32_t mask, uint32_t color) {
+            mask &= (1 << MAX_LED_COUNT) - 1;
+            faceMask |= mask;
+            while (mask != 0) {
+                colors[__builtin_ctz(mask)] = color;
+                mask &= mask - 1;
+            }
+        }
+    };
+
+    /// <summary>
+    /// Divides by a number fixed when an animation starts (i.e. its duration or fade time) with a multiply
+    /// and a shift rather than a division, the Q32 reciprocal of the divisor being computed once.
+    /// Results are the same as the integer division, dividing by 0 returning 0 like the Cortex-M4 does.
+    /// </summary>
+    struct TimeDivider
+    {
+        uint32_t reciprocal;    // (2^32 - 1) / divisor, rounded down, 0 when dividing by 0
+        uint16_t divisor;
+
+        void setDivisor(uint16_t _divisor) {
+            divisor = _divisor;
+            reciprocal = _divisor != 0 ? 0xFFFFFFFF / _divisor : 0;
+        }
+
+        // Returns value / divisor, value must be less than 2^31
+        uint32_t divide(uint32_t value) const {
+            uint32_t quotient = (uint32_t)(((uint64_t)value * reciprocal) >> 32);
+            // The reciprocal is rounded down, so the quotient may be one short
+            if (divisor != 0 && value - quotient * divisor >= divisor) {
+                quotient++;
+            }
+            return quotient;
+        }
+    };
+
+    /// <summary>
+    /// An animation output that alternates between two frames for a number of periods,
+    /// which the LEDs can play on their own while the CPU sleeps.
+    /// </summary>
+    struct AnimationLoop
+    {
+        int frameTimes[2];      // Animation times (in ms) at which to render each of the two frames
+        int frameDurations[2];  // How long each frame is shown, in ms
+        int count;              // Number of periods, i.e. number of times both frames are shown
+    };
 
     /// <summary>
     /// Animation instance data, refers to an animation preset but stores the instance data and
@@ -71,6 +154,11 @@ namespace Animations
         uint8_t paddingLoopCount;
 
     protected:
+        // Timebase of the animation, set up by start() so that the phase and fade intensity
+        // computed on every frame don't need any division, see getPhase() and getFadeIntensity()
+        TimeDivider durationDivider;
+        TimeDivider fadeDivider;    // Divides by the fade in/out time, see setFadeTime()
+
         AnimationInstance(const Animation* preset, const DataSet::AnimationBits* bits);
 
     public:
@@ -91,26 +179,80 @@ namespace Animations
         // retIndices is one to one with retColors and keeps track of which face to turn on as well as its corresponding color
         // return value of the method is the number of faces to turn on.
         // It returns a list of faces and colors, in 'canonical orientation', i.e. ignoring the current up face.
-        // This is the 'legacy' way of doing things, and is used by animations like GradientPattern, etc...
+        // This is the 'legacy' way of doing things, and is used by animations like Cycle, Worm, etc...
         virtual int update(int ms, int retIndices[], uint32_t retColors[]);
 
-        // This method is used to return the list of all colors for all FACES of the die, taking into account the current orientation of the die.
-        // The base implementation calls update() and then flattens and remaps the faces to the current orientation.
-        virtual void updateFaces(int ms, uint32_t* outFaces);
+        // Sets the faces to turn on and their colors in outFaces, whose face mask starts out empty.
+        // Faces are in 'canonical orientation', same as update(), but animations lighting several faces
+        // with one color can fill them all at once instead of listing them.
+        // The base implementation converts the output of update(), later faces in the list winning.
+        virtual void updateFaces(int ms, AnimationFaces& outFaces);
+
+        // This method renders the animation straight into the daisy chain frame of the animation controller,
+        // blending each lit LED with the color already there, scaled by fadeTimes1000 (1000 = no fade).
+        // The base implementation calls updateFaces(), remaps the faces to the current orientation and then
+        // to LEDs and daisy chain indices in a single pass.
+        // Animation classes like noise, normals or rainbow override this method to directly set the led colors.
+        virtual void render(int ms, uint32_t fadeTimes1000, uint32_t* daisyChainFrame);
+
+        // Returns the earliest time (in ms) at which the output of the animation may change, given that it
+        // was just rendered at time ms, or ANIM_TIME_NEVER. The anim controller uses it to skip frames during holds.
+        // The base implementation assumes the output changes continuously.
+        virtual int nextChangeTime(int ms) const;
+
+        // Fills the coverage of the frame render() would draw at time ms, and returns true if skipping
+        // that render has no other effect than not drawing it (i.e. no random numbers or triggered animations).
+        // The base implementation returns false, so the animation is always rendered.
+        virtual bool getCoverage(int ms, uint32_t fadeTimes1000, AnimationCoverage& outCoverage) const;
+
+        // Fills the two frames the output alternates between from time ms on, and returns true if the output
+        // is only made of those frames until the end of the current loop of the animation.
+        // The base implementation returns false, so the animation is always updated frame by frame.
+        virtual bool getLoop(int ms, AnimationLoop& outLoop) const;
+
+    protected:
+        // Blends one color into the daisy chain frame, see render(). fadeMultiplier is the render
+        // fade converted once per frame with Utils::ColorKernels::getFadeMultiplier().
+        static void blendColor(uint32_t* daisyChainFrame, int daisyChainIndex, uint32_t color, uint32_t fadeMultiplier);
+
+        // Returns (ms - startTime) * scale / duration, i.e. the phase of the animation at time ms
+        // in units of scale per duration, rounded toward 0 like the integer division.
+        // The product is computed on 64 bits, so any scale works at any time.
+        int getPhase(int ms, int scale) const;
+
+        // Returns the track time (0 - 1000 over the animation duration) at time ms, same as getPhase(ms, 1000)
+        int getTrackTime(int ms) const;
+
+        // Sets the duration (in ms) of the fade in at the start of the animation and of the fade out at its end
+        void setFadeTime(int fadeTime);
+
+        // Returns intensity ramped up from 0 during the fade in and back down to 0 during the fade out
+        uint8_t getFadeIntensity(int ms, uint8_t intensity) const;
+
+        // Converts a track time (0 - 1000 over the animation duration) back to the first animation time
+        // after it, used to turn RGBTrack::getHoldEndTime() into a nextChangeTime()
+        int trackTimeToNextChangeTime(int trackTime) const;
 
-        // This method is use to return the list of all colors for all LEDS of the die, taking into account the current orientation of the die.
-        // The base implementation calls updateFaces() and then extracts the led colors from the face colors.
-        // Animation classes like noise or normals will override this method to directly set the led colors.
-        virtual void updateLEDs(int ms, uint32_t* outLEDs);
+        // Coverage of an animation setting all the faces in faceMask to the same color, see setColor()
+        void getUniformColorCoverage(uint32_t color, uint32_t faceMask, uint32_t fadeTimes1000, AnimationCoverage& outCoverage) const;
+    };
 
-        // This method remaps the colors of the LEDs in 'logical' order to the colors of the leds in the daisy chain to pass back to the animation controller.
-        // Animation classes like Rainbow override this method to directly set the daisy chain colors.
-        virtual void updateDaisyChainLEDs(int ms, uint32_t* outDaisyChainColors);
+    /// <summary>
+    /// Usage statistics of one of the fixed pools animation instances are allocated from
+    /// </summary>
+    struct InstancePoolStats
+    {
+        uint32_t allocCount;    // Successful allocations since boot
+        uint32_t failureCount;  // Allocations that failed because the pool was full
+        uint16_t slotSize;      // Size of a slot in bytes (= largest instance class)
+        uint8_t slotCount;      // Number of slots (= max number of running animations)
+        uint8_t inUseCount;
+        uint8_t peakInUseCount;
     };
 
+    // Instances are allocated from fixed pools, returns nullptr when the matching pool is full
     Animations::AnimationInstance* createAnimationInstance(const Animations::Animation* preset, const DataSet::AnimationBits* bits);
     void destroyAnimationInstance(Animations::AnimationInstance* animationInstance);
+    void getInstancePoolStats(InstancePoolStats& outSmallStats, InstancePoolStats& outLargeStats);
 
 }
-
-#pragma pack(pop)
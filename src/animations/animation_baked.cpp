@@ -0,0 +1,172 @@
+#include "animation_baked.h"
+#include "utils/Utils.h"
+#include "config/dice_variants.h"
+#include "data_set/data_animation_bits.h"
+#include "string.h" // for memset
+
+using namespace Config;
+
+namespace Animations
+{
+    /// <summary>
+    /// constructor for baked animations
+    /// Needs to have an associated preset passed in
+    /// </summary>
+    AnimationInstanceBaked::AnimationInstanceBaked(const AnimationBaked* preset, const DataSet::AnimationBits* bits)
+        : AnimationInstance(preset, bits)
+        , frames(bits->getAnimationData(preset->framesOffset, preset->framesSize)) {
+        rewind();
+    }
+
+    /// <summary>
+    /// destructor
+    /// </summary>
+    AnimationInstanceBaked::~AnimationInstanceBaked() {
+    }
+
+    /// <summary>
+    /// Small helper to return the expected size of the preset data
+    /// </summary>
+    int AnimationInstanceBaked::animationSize() const {
+        return sizeof(AnimationBaked);
+    }
+
+    /// <summary>
+    /// (re)Initializes the instance to animate leds. This can be called on a reused instance.
+    /// </summary>
+    void AnimationInstanceBaked::start(int _startTime, uint8_t _remapFace, uint8_t _loopCount) {
+        AnimationInstance::start(_startTime, _remapFace, _loopCount);
+        rewind();
+    }
+
+    /// <summary>
+    /// Applies the frames up to the given time and returns the faces that are lit.
+    /// Only the faces that changed are decoded, usually none or a single frame per call.
+    /// </summary>
+    /// <param name="ms">The animation time (in milliseconds)</param>
+    /// <param name="retIndices">the return list of LED indices to fill, max size should be at least 21, the max number of leds</param>
+    /// <param name="retColors">the return list of LED color to fill, max size should be at least 21, the max number of leds</param>
+    /// <returns>The number of leds/intensities added to the return array</returns>
+    int AnimationInstanceBaked::update(int ms, int retIndices[], uint32_t retColors[]) {
+        int frameIndex = getFrameIndex(ms);
+        if (frameIndex < decodedFrameIndex) {
+            // Looping, deltas only go forward
+            rewind();
+        }
+        while (decodedFrameIndex < frameIndex && decodeFrame()) {
+        }
+
+        int faceCount = SettingsManager::getLayout()->faceCount;
+        int retCount = 0;
+        for (int i = 0; i < faceCount; ++i) {
+            if (faceColors[i] != 0) {
+                retIndices[retCount] = i;
+                retColors[retCount] = faceColors[i];
+                retCount++;
+            }
+        }
+        return retCount;
+    }
+
+    /// <summary>
+    /// Clear all LEDs controlled by this animation, for instance when the anim gets interrupted.
+    /// </summary>
+    int AnimationInstanceBaked::stop(int retIndices[]) {
+        return setIndices(ANIM_FACEMASK_ALL_LEDS, retIndices);
+    }
+
+    /// <summary>
+    /// The LEDs only change on the next frame
+    /// </summary>
+    int AnimationInstanceBaked::nextChangeTime(int ms) const {
+        auto preset = getPreset();
+        uint32_t nextFrameIndex = getFrameIndex(ms) + 1;
+        if (nextFrameIndex >= preset->frameCount) {
+            return ANIM_TIME_NEVER;
+        }
+        // First ms at which getFrameIndex() returns the next frame
+        return startTime + (nextFrameIndex * preset->duration + preset->frameCount - 1) / preset->frameCount;
+    }
+
+    /// <summary>
+    /// Returns the frame to display at the given time
+    /// </summary>
+    int AnimationInstanceBaked::getFrameIndex(int ms) const {
+        auto preset = getPreset();
+        int time = ms - startTime;
+        if (time <= 0 || preset->duration == 0) {
+            return 0;
+        }
+        // Both are 16 bits, so the product can't overflow
+        uint32_t clampedTime = time < preset->duration ? time : preset->duration - 1;
+        return clampedTime * preset->frameCount / preset->duration;
+    }
+
+    /// <summary>
+    /// Goes back to before the first frame, with all the faces off
+    /// </summary>
+    void AnimationInstanceBaked::rewind() {
+        streamOffset = 0;
+        decodedFrameIndex = -1;
+        memset(faceColors, 0, sizeof(faceColors));
+    }
+
+    /// <summary>
+    /// Applies the changes of the next frame to faceColors
+    /// </summary>
+    /// <returns>False if there is no valid frame left in the stream</returns>
+    bool AnimationInstanceBaked::decodeFrame() {
+        auto preset = getPreset();
+        int faceCount = SettingsManager::getLayout()->faceCount;
+        int maskSize = (faceCount + 7) / 8;
+        int colorSize = preset->format == BakedFormat_RGB565 ? 2 : 1;
+        if (frames == nullptr || decodedFrameIndex + 1 >= preset->frameCount || streamOffset + maskSize > preset->framesSize) {
+            return false;
+        }
+
+        const uint8_t* data = frames + streamOffset;
+        uint32_t changedFaces = 0;
+        for (int i = 0; i < maskSize; ++i) {
+            changedFaces |= (uint32_t)data[i] << (i * 8);
+        }
+        int frameSize = maskSize + __builtin_popcount(changedFaces) * colorSize;
+        if (streamOffset + frameSize > preset->framesSize) {
+            return false;
+        }
+
+        const uint8_t* colors = data + maskSize;
+        while (changedFaces != 0) {
+            int face = __builtin_ctz(changedFaces);
+            changedFaces &= changedFaces - 1;
+
+            uint32_t color;
+            if (preset->format == BakedFormat_RGB565) {
+                uint32_t rgb565 = colors[0] | ((uint32_t)colors[1] << 8);
+                uint32_t red = (rgb565 >> 11) & 0x1F;
+                uint32_t green = (rgb565 >> 5) & 0x3F;
+                uint32_t blue = rgb565 & 0x1F;
+                color = Utils::toColor((red << 3) | (red >> 2), (green << 2) | (green >> 4), (blue << 3) | (blue >> 2));
+            } else if (colors[0] < animationBits->getPaletteSize() / 3 &&
+                       colors[0] != PALETTE_COLOR_FROM_FACE && colors[0] != PALETTE_COLOR_FROM_RANDOM) {
+                color = animationBits->getPaletteColor(colors[0]);
+            } else {
+                // BAKED_PALETTE_INDEX_OFF, or not a color of the palette (which would come out white)
+                color = 0;
+            }
+            colors += colorSize;
+
+            // The mask is rounded up to whole bytes, ignore faces the die doesn't have
+            if (face < faceCount) {
+                faceColors[face] = color;
+            }
+        }
+
+        streamOffset += frameSize;
+        decodedFrameIndex++;
+        return true;
+    }
+
+    const AnimationBaked* AnimationInstanceBaked::getPreset() const {
+        return static_cast<const AnimationBaked*>(animationPreset);
+    }
+}
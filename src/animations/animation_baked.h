@@ -0,0 +1,74 @@
+#pragma once
+
+#include "animations/Animation.h"
+#include "config/settings.h"
+
+#pragma pack(push, 1)
+
+// Palette index of faces that are turned off in a palette encoded frame stream
+#define BAKED_PALETTE_INDEX_OFF 0xFF
+
+namespace Animations
+{
+    /// <summary>
+    /// How the colors of the changed faces are stored in a baked frame stream
+    /// </summary>
+    enum BakedFormat : uint8_t
+    {
+        BakedFormat_Palette = 0,    // 1 byte per color, index in the palette, any other index (i.e. BAKED_PALETTE_INDEX_OFF) is off
+        BakedFormat_RGB565,         // 2 bytes per color, little endian 5-6-5 bits RGB
+    };
+
+    /// <summary>
+    /// Animation playing back frames computed ahead of time (i.e. by the app).
+    /// The frames are stored in the animations buffer of the data set as a stream of deltas,
+    /// each frame being the mask of the faces that changed since the previous frame
+    /// (one bit per face, rounded up to whole bytes, least significant byte first)
+    /// followed by the new color of each of those faces, in face order.
+    /// The first frame is a delta from all faces off.
+    /// Faces are in canonical orientation, they are remapped to the current up face when played.
+    /// size: 12 bytes (+ the frame stream)
+    /// </summary>
+    struct AnimationBaked
+        : public Animation
+    {
+        uint16_t frameCount;    // Frames are evenly spread over the animation duration
+        uint16_t framesOffset;  // Offset of the frame stream in the animations buffer, in bytes
+        uint16_t framesSize;    // Size of the frame stream, in bytes
+        BakedFormat format;
+        uint8_t padding;
+    };
+}
+
+#pragma pack(pop)
+
+namespace Animations
+{
+    /// <summary>
+    /// Baked animation instance data
+    /// </summary>
+    class AnimationInstanceBaked
+        : public AnimationInstance
+    {
+    public:
+        AnimationInstanceBaked(const AnimationBaked* preset, const DataSet::AnimationBits* bits);
+        virtual ~AnimationInstanceBaked();
+        virtual int animationSize() const;
+
+        virtual void start(int _startTime, uint8_t _remapFace, uint8_t _loopCount);
+        virtual int update(int ms, int retIndices[], uint32_t retColors[]);
+        virtual int stop(int retIndices[]);
+        virtual int nextChangeTime(int ms) const;
+
+    private:
+        const AnimationBaked* getPreset() const;
+        int getFrameIndex(int ms) const;
+        void rewind();
+        bool decodeFrame();
+
+        const uint8_t* frames;          // The frame stream, nullptr if it isn't within the data set
+        uint16_t streamOffset;          // Where the next frame starts in the stream
+        int16_t decodedFrameIndex;      // Last frame applied to faceColors, -1 when none
+        uint32_t faceColors[MAX_LED_COUNT]; // Face colors of the last decoded frame
+    };
+}
@@ -78,14 +78,20 @@ namespace Animations
     /// Computes the list of LEDs that need to be on, and what their intensities should be.
     /// </summary>
     /// <param name="ms">The animation time (in milliseconds)</param>
-    /// <param name="retIndices">the return list of LED indices to fill, max size should be at least 21, the max number of leds</param>
-    /// <param name="retColors">the return list of LED color to fill, max size should be at least 21, the max number of leds</param>
-    /// <returns>The number of leds/intensities added to the return array</returns>
-    int AnimationInstanceBlinkId::update(int ms, int retIndices[], uint32_t retColors[])
+    /// <param name="outFaces">the faces to turn on and their colors</param>
+    void AnimationInstanceBlinkId::updateFaces(int ms, AnimationFaces& outFaces)
+    {
+        // All the faces get the same color
+        outFaces.fill(ANIM_FACEMASK_ALL_LEDS, getColor(ms));
+    }
+
+    /// <summary>
+    /// Computes the color of all the LEDs at the given time
+    /// </summary>
+    uint32_t AnimationInstanceBlinkId::getColor(int ms) const
     {
         auto preset = getPreset();
 
-        // Compute color
         uint32_t color = 0;
         const uint32_t brightness = (uint32_t)preset->brightness;
         const uint32_t frameCounter = (ms - startTime) / ANIM_FRAME_DURATION_MS;
@@ -119,9 +125,7 @@ namespace Animations
             // colorIndex = 0 => red, 1 => green, 2 => blue
             color = brightness << (16 - 8 * colorIndex);
         }
-
-        // Fill the indices and colors for the anim controller to know how to update leds
-        return setColor(color, ANIM_FACEMASK_ALL_LEDS, retIndices, retColors);
+        return color;
     }
 
     /// <summary>
@@ -132,6 +136,36 @@ namespace Animations
         return setIndices(ANIM_FACEMASK_ALL_LEDS, retIndices);
     }
 
+    /// <summary>
+    /// The color only changes at the start of each blink, and not at all during the white preamble
+    /// </summary>
+    int AnimationInstanceBlinkId::nextChangeTime(int ms) const
+    {
+        auto preset = getPreset();
+        const int blinkDuration = preset->framesPerBlink * ANIM_FRAME_DURATION_MS;
+        const int tick = (ms - startTime) / blinkDuration;
+        const int preambleNumTicks = preset->duration / blinkDuration - (int)(DEVICE_BITS_COUNT + HEADER_BITS_COUNT + CRC_BITS_COUNT);
+        if (preambleNumTicks < 0)
+        {
+            // Too short for the message, getColor() shows white all along
+            return ANIM_TIME_NEVER;
+        }
+        else if (tick < preambleNumTicks)
+        {
+            return startTime + preambleNumTicks * blinkDuration;
+        }
+        return startTime + (tick + 1) * blinkDuration;
+    }
+
+    /// <summary>
+    /// All the LEDs get the same color
+    /// </summary>
+    bool AnimationInstanceBlinkId::getCoverage(int ms, uint32_t fadeTimes1000, AnimationCoverage& outCoverage) const
+    {
+        getUniformColorCoverage(getColor(ms), ANIM_FACEMASK_ALL_LEDS, fadeTimes1000, outCoverage);
+        return true;
+    }
+
     const AnimationBlinkId* AnimationInstanceBlinkId::getPreset() const
     {
         return static_cast<const AnimationBlinkId*>(animationPreset);
@@ -21,7 +21,12 @@ namespace Animations
 
         void setDuration(uint16_t preambleDuration);
     };
+}
+
+#pragma pack(pop)
 
+namespace Animations
+{
     /// <summary>
     /// Procedural on off animation instance data
     /// </summary>
@@ -34,14 +39,15 @@ namespace Animations
         virtual int animationSize() const;
 
         virtual void start(int _startTime, uint8_t _remapFace, uint8_t _loopCount);
-        virtual int update(int ms, int retIndices[], uint32_t retColors[]);
+        virtual void updateFaces(int ms, AnimationFaces& outFaces);
         virtual int stop(int retIndices[]);
+        virtual int nextChangeTime(int ms) const;
+        virtual bool getCoverage(int ms, uint32_t fadeTimes1000, AnimationCoverage& outCoverage) const;
 
     private:
         const AnimationBlinkId* getPreset() const;
+        uint32_t getColor(int ms) const;
         static uint64_t getMessage();
         const uint64_t message;
     };
 }
-
-#pragma pack(pop)
\ No newline at end of file
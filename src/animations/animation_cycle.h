@@ -1,6 +1,7 @@
 #pragma once
 
 #include "animations/Animation.h"
+#include "animations/gradient_lut.h"
 
 #pragma pack(push, 1)
 
@@ -19,7 +20,12 @@ namespace Animations
         uint8_t cyclesTimes10;
         uint16_t gradientTrackOffset;
     };
+}
+
+#pragma pack(pop)
 
+namespace Animations
+{
     /// <summary>
     /// Procedural rainbow animation instance data
     /// </summary>
@@ -37,7 +43,6 @@ namespace Animations
 
     private:
         const AnimationCycle *getPreset() const;
+        const GradientLUT* gradientLUT;     // Baked gradient, nullptr when the track must be evaluated directly
     };
 }
-
-#pragma pack(pop)
\ No newline at end of file
@@ -29,27 +29,25 @@ namespace Animations
     /// </summary>
     void AnimationInstanceGradient::start(int _startTime, uint8_t _remapFace, uint8_t _loopCount) {
         AnimationInstance::start(_startTime, _remapFace, _loopCount);
+        gradientCursor.reset();
     }
 
     /// <summary>
     /// Computes the list of LEDs that need to be on, and what their intensities should be.
     /// </summary>
     /// <param name="ms">The animation time (in milliseconds)</param>
-    /// <param name="retIndices">the return list of LED indices to fill, max size should be at least 21, the max number of leds</param>
-    /// <param name="retColors">the return list of LED color to fill, max size should be at least 21, the max number of leds</param>
-    /// <returns>The number of leds/intensities added to the return array</returns>
-    int AnimationInstanceGradient::update(int ms, int retIndices[], uint32_t retColors[]) {
-        int time = ms - startTime;
+    /// <param name="outFaces">the faces to turn on and their colors</param>
+    void AnimationInstanceGradient::updateFaces(int ms, AnimationFaces& outFaces) {
         auto preset = getPreset();
 
         // Figure out the color from the gradient
         auto& gradient = animationBits->getRGBTrack(preset->gradientTrackOffset);
 
-        int gradientTime = time * 1000 / preset->duration;
-        uint32_t color = gradient.evaluateColor(animationBits, gradientTime);
+        int gradientTime = getTrackTime(ms);
+        uint32_t color = gradient.evaluateColor(animationBits, gradientTime, gradientCursor);
 
-        // Fill the indices and colors for the anim controller to know how to update leds
-        return setColor(color, preset->faceMask, retIndices, retColors);
+        // All the faces get the same color
+        outFaces.fill(preset->faceMask, color);
     }
 
     /// <summary>
@@ -60,6 +58,32 @@ namespace Animations
         return setIndices(preset->faceMask, retIndices);
     }
 
+    /// <summary>
+    /// The color only changes when the gradient isn't holding a color
+    /// </summary>
+    int AnimationInstanceGradient::nextChangeTime(int ms) const {
+        auto preset = getPreset();
+        auto& gradient = animationBits->getRGBTrack(preset->gradientTrackOffset);
+        int gradientTime = getTrackTime(ms);
+        return trackTimeToNextChangeTime(gradient.getHoldEndTime(animationBits, gradientTime));
+    }
+
+    /// <summary>
+    /// All the LEDs of the face mask get the same color, unless the gradient picks random colors
+    /// </summary>
+    bool AnimationInstanceGradient::getCoverage(int ms, uint32_t fadeTimes1000, AnimationCoverage& outCoverage) const {
+        auto preset = getPreset();
+        auto& gradient = animationBits->getRGBTrack(preset->gradientTrackOffset);
+        if (gradient.hasRandomColors(animationBits)) {
+            // Evaluating the color here would change the one rendered
+            return false;
+        }
+
+        int gradientTime = getTrackTime(ms);
+        getUniformColorCoverage(gradient.evaluateColor(animationBits, gradientTime), preset->faceMask, fadeTimes1000, outCoverage);
+        return true;
+    }
+
     const AnimationGradient* AnimationInstanceGradient::getPreset() const {
         return static_cast<const AnimationGradient*>(animationPreset);
     }
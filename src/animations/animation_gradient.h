@@ -1,6 +1,7 @@
 #pragma once
 
 #include "animations/Animation.h"
+#include "animations/keyframes.h"
 
 #pragma pack(push, 1)
 
@@ -16,7 +17,12 @@ namespace Animations
         uint16_t gradientTrackOffset;
         uint16_t gradientPadding;
     };
+}
+
+#pragma pack(pop)
 
+namespace Animations
+{
     /// <summary>
     /// Procedural rainbow animation instance data
     /// </summary>
@@ -29,12 +35,13 @@ namespace Animations
         virtual int animationSize() const;
 
         virtual void start(int _startTime, uint8_t _remapFace, uint8_t _loopCount);
-        virtual int update(int ms, int retIndices[], uint32_t retColors[]);
+        virtual void updateFaces(int ms, AnimationFaces& outFaces);
         virtual int stop(int retIndices[]);
+        virtual int nextChangeTime(int ms) const;
+        virtual bool getCoverage(int ms, uint32_t fadeTimes1000, AnimationCoverage& outCoverage) const;
 
     private:
         const AnimationGradient* getPreset() const;
+        KeyframeCursor gradientCursor;
     };
 }
-
-#pragma pack(pop)
\ No newline at end of file
@@ -38,6 +38,10 @@ namespace Animations
     /// </summary>
     void AnimationInstanceGradientPattern::start(int _startTime, uint8_t _remapFace, uint8_t _loopCount) {
         AnimationInstance::start(_startTime, _remapFace, _loopCount);
+        gradientCursor.reset();
+        for (int i = 0; i < MAX_LED_COUNT; ++i) {
+            trackCursors[i].reset();
+        }
         auto preset = getPreset();
         if (preset->overrideWithFace) {
             // Compute color based on face is 127
@@ -50,15 +54,12 @@ namespace Animations
     /// based on the different tracks of this animation.
     /// </summary>
     /// <param name="ms">The animation time (in milliseconds)</param>
-    /// <param name="retIndices">the return list of LED indices to fill, max size should be at least 21, the max number of leds</param>
-    /// <param name="retColors">the return list of LED color to fill, max size should be at least 21, the max number of leds</param>
-    /// <returns>The number of leds/intensities added to the return array</returns>
-    int AnimationInstanceGradientPattern::update(int ms, int retIndices[], uint32_t retColors[])
+    /// <param name="outFaces">the faces to turn on and their colors</param>
+    void AnimationInstanceGradientPattern::updateFaces(int ms, AnimationFaces& outFaces)
     {
-        int time = ms - startTime;
         auto preset = getPreset();
 
-        const int trackTime = time * 1000 / preset->duration;
+        const int trackTime = getTrackTime(ms);
 
         // Figure out the color from the gradient
         auto& gradient = animationBits->getRGBTrack(preset->gradientTrackOffset);
@@ -67,28 +68,20 @@ namespace Animations
         if (preset->overrideWithFace) {
             gradientColor = rgb;
         } else {
-            gradientColor = gradient.evaluateColor(animationBits, trackTime);
+            gradientColor = gradient.evaluateColor(animationBits, trackTime, gradientCursor);
         }
 
-        // Each track will append its led indices and colors into the return array
-        // The assumption is that led indices don't overlap between tracks of a single animation,
-        // so there will always be enough room in the return arrays.
-        int totalCount = 0;
-        int indices[MAX_LED_COUNT];
-        uint32_t colors[MAX_LED_COUNT];
+        // Each track sets the color of its LEDs, should tracks overlap the last one wins
         for (int i = 0; i < preset->trackCount; ++i)
         {
             auto track = animationBits->getTrack((uint16_t)(preset->tracksOffset + i)); 
-            int count = track.evaluate(animationBits, gradientColor, trackTime, indices, colors);
-            for (int j = 0; j < count; ++j)
-            {
-                retIndices[totalCount+j] = indices[j];
-                retColors[totalCount+j] = colors[j];
+            if (i < MAX_LED_COUNT) {
+                track.evaluate(animationBits, gradientColor, trackTime, trackCursors[i], outFaces);
+            } else {
+                KeyframeCursor cursor = { 0 };
+                track.evaluate(animationBits, gradientColor, trackTime, cursor, outFaces);
             }
-            totalCount += count;
         }
-
-        return totalCount;
     }
 
     /// <summary>
@@ -1,13 +1,14 @@
 #pragma once
 
 #include "animations/Animation.h"
+#include "animations/keyframes.h"
+#include "config/settings.h"
 
 #pragma pack(push, 1)
 
 namespace Animations
 {
     struct Keyframe;
-    struct Track;
 
     /// <summary>
     /// A keyframe-based animation with a gradient applied over
@@ -22,7 +23,12 @@ namespace Animations
         uint8_t overrideWithFace;
         uint8_t overridePadding;
     };
+}
+
+#pragma pack(pop)
 
+namespace Animations
+{
     /// <summary>
     /// Keyframe-based animation instance data
     /// </summary>
@@ -40,14 +46,16 @@ namespace Animations
         virtual int animationSize() const;
 
         virtual void start(int _startTime, uint8_t _remapFace, uint8_t _loopCount);
-        virtual int update(int ms, int retIndices[], uint32_t retColors[]);
+        virtual void updateFaces(int ms, AnimationFaces& outFaces);
         virtual int stop(int retIndices[]);
 
     private:
         const AnimationGradientPattern* getPreset() const;
         const Track& GetTrack(int index) const;
+
+        KeyframeCursor gradientCursor;
+        // Tracks don't overlap, so there shouldn't be more tracks than LEDs
+        KeyframeCursor trackCursors[MAX_LED_COUNT];
     };
 
 }
-
-#pragma pack(pop)
\ No newline at end of file
@@ -36,6 +36,9 @@ namespace Animations
     /// </summary>
     void AnimationInstanceKeyframed::start(int _startTime, uint8_t _remapFace, uint8_t _loopCount) {
         AnimationInstance::start(_startTime, _remapFace, _loopCount);
+        for (int i = 0; i < MAX_LED_COUNT; ++i) {
+            trackCursors[i].reset();
+        }
     }
 
     /// <summary>
@@ -43,32 +46,25 @@ namespace Animations
     /// based on the different tracks of this animation.
     /// </summary>
     /// <param name="ms">The animation time (in milliseconds)</param>
-    /// <param name="retIndices">the return list of LED indices to fill, max size should be at least 21, the max number of leds</param>
-    /// <param name="retColors">the return list of LED color to fill, max size should be at least 21, the max number of leds</param>
-    /// <returns>The number of leds/intensities added to the return array</returns>
-    int AnimationInstanceKeyframed::update(int ms, int retIndices[], uint32_t retColors[])
+    /// <param name="outFaces">the faces to turn on and their colors</param>
+    void AnimationInstanceKeyframed::updateFaces(int ms, AnimationFaces& outFaces)
     {
-        int time = ms - startTime;
         auto preset = getPreset();
 
-        const int trackTime = time * 1000 / preset->duration;
+        const int trackTime = getTrackTime(ms);
         const RGBTrack * tracks = animationBits->getRGBTracks(preset->tracksOffset);
 
-        // Each track will append its led indices and colors into the return array
-        // The assumption is that led indices don't overlap between tracks of a single animation,
-        // so there will always be enough room in the return arrays.
-        int* indices = retIndices;
-        uint32_t* colors = retColors;
-        int totalCount = 0;
+        // Each track sets the color of its LEDs, should tracks overlap the last one wins
         for (int i = 0; i < preset->trackCount; ++i)
         {
             auto& track = tracks[i]; 
-            auto count = track.evaluate(animationBits, trackTime, indices, colors);
-            indices += count;
-            colors += count;
-            totalCount += count;
+            if (i < MAX_LED_COUNT) {
+                track.evaluate(animationBits, trackTime, trackCursors[i], outFaces);
+            } else {
+                KeyframeCursor cursor = { 0 };
+                track.evaluate(animationBits, trackTime, cursor, outFaces);
+            }
         }
-        return totalCount;
     }
 
     /// <summary>
@@ -92,6 +88,21 @@ namespace Animations
         return totalCount;
     }
 
+    /// <summary>
+    /// The LEDs only change once one of the tracks stops holding its color
+    /// </summary>
+    int AnimationInstanceKeyframed::nextChangeTime(int ms) const {
+        auto preset = getPreset();
+        const int trackTime = getTrackTime(ms);
+        const RGBTrack * tracks = animationBits->getRGBTracks(preset->tracksOffset);
+
+        int holdEndTime = 0xFFFF;
+        for (int i = 0; i < preset->trackCount && holdEndTime > trackTime; ++i) {
+            holdEndTime = std::min(holdEndTime, tracks[i].getHoldEndTime(animationBits, trackTime));
+        }
+        return trackTimeToNextChangeTime(holdEndTime);
+    }
+
     /// <summary>
     /// Small helper to get the correct type preset data pointer stored in the instance
     /// </summary
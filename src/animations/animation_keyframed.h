@@ -1,13 +1,14 @@
 #pragma once
 
 #include "animations/Animation.h"
+#include "animations/keyframes.h"
+#include "config/settings.h"
 
 #pragma pack(push, 1)
 
 namespace Animations
 {
     struct RGBKeyframe;
-    struct RGBTrack;
 
     /// <summary>
     /// A keyframe-based animation
@@ -19,7 +20,12 @@ namespace Animations
         uint16_t tracksOffset; // offset into a global buffer of tracks
         uint16_t trackCount;
     };
+}
+
+#pragma pack(pop)
 
+namespace Animations
+{
     /// <summary>
     /// Keyframe-based animation instance data
     /// </summary>
@@ -34,14 +40,16 @@ namespace Animations
         virtual int animationSize() const;
 
         virtual void start(int _startTime, uint8_t _remapFace, uint8_t _loopCount);
-        virtual int update(int ms, int retIndices[], uint32_t retColors[]);
+        virtual void updateFaces(int ms, AnimationFaces& outFaces);
         virtual int stop(int retIndices[]);
+        virtual int nextChangeTime(int ms) const;
 
     private:
         const AnimationKeyframed* getPreset() const;
         const RGBTrack& GetTrack(int index) const;
+
+        // Tracks don't overlap, so there shouldn't be more tracks than LEDs
+        KeyframeCursor trackCursors[MAX_LED_COUNT];
     };
 
 }
-
-#pragma pack(pop)
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "animation_noise.h"
 #include "data_set/data_animation_bits.h"
 #include "utils/Utils.h"
+#include "utils/color_kernels.h"
 #include "config/settings.h"
 #include "config/dice_variants.h"
 #include "nrf_log.h"
@@ -10,8 +11,8 @@
 
 using namespace DriversNRF;
 using namespace Config;
+using namespace Utils;
 
-#define MAX_RETRIES 5
 namespace Animations
 {
     int computeBaseParam(int upFace, NoiseColorOverrideType type) {
@@ -32,13 +33,17 @@ namespace Animations
     /// Needs to have an associated preset passed in
     /// </summary>
     AnimationInstanceNoise::AnimationInstanceNoise(const AnimationNoise* preset, const DataSet::AnimationBits* bits)
-        : AnimationInstance(preset, bits) {
+        : AnimationInstance(preset, bits)
+        , overallGradientLUT(nullptr)
+        , individualGradientLUT(nullptr) {
     }
 
     /// <summary>
     /// destructor
     /// </summary>
     AnimationInstanceNoise::~AnimationInstanceNoise() {
+        GradientLUTs::release(overallGradientLUT);
+        GradientLUTs::release(individualGradientLUT);
     }
 
     /// <summary>
@@ -54,6 +59,7 @@ namespace Animations
     void AnimationInstanceNoise::start(int _startTime, uint8_t _remapFace, uint8_t _loopCount) {
         AnimationInstance::start(_startTime, _remapFace, _loopCount);
         auto preset = getPreset();
+        setFadeTime(preset->duration * preset->fade / (255 * 2));
         ledCount = SettingsManager::getLayout()->ledCount;
         blinkInterValMinMs = 1000000 / (preset->blinkFrequencyTimes1000 + preset->blinkFrequencyVarTimes1000);
         int blinkInterValMaxMs = 1000000 / (preset->blinkFrequencyTimes1000 - preset->blinkFrequencyVarTimes1000);
@@ -63,9 +69,23 @@ namespace Animations
         for(int i = 0; i < MAX_LED_COUNT; i++){
             blinkStartTimes[i] = 0;
             blinkDurations[i] = 0;
+            blinkCursors[i].reset();
         }
+        blinkingLEDs = 0;
+        overallGradientCursor.reset();
+
+        // Bake the gradients, every blink of every LED evaluates them
+        GradientLUTs::release(overallGradientLUT);
+        GradientLUTs::release(individualGradientLUT);
+        overallGradientLUT = nullptr;
+        if (preset->overallGradientColorType != NoiseColorOverrideType_FaceToRainbowWheel) {
+            overallGradientLUT = GradientLUTs::acquire(animationBits, preset->overallGradientTrackOffset);
+        }
+        individualGradientLUT = GradientLUTs::acquire(animationBits, preset->individualGradientTrackOffset);
 
-        nextBlinkTime = _startTime + blinkInterValMinMs + (RNG::randomUInt32() % blinkInterValDeltaMs);
+        // Draw the blinks from a fast stream, only seeding it from the (slow) hardware RNG
+        random.seed(RNG::getStreamSeed());
+        nextBlinkTime = _startTime + blinkInterValMinMs + random.nextBelow(blinkInterValDeltaMs);
         baseColorParam = computeBaseParam(_remapFace, preset->overallGradientColorType);
     }
 
@@ -73,64 +93,71 @@ namespace Animations
     /// Computes the list of LEDs that need to be on, and what their intensities should be.
     /// </summary>
     /// <param name="ms">The animation time (in milliseconds)</param>
-    /// <param name="retIndices">the return list of LED indices to fill, max size should be at least 21, the max number of leds</param>
-    /// <param name="retColors">the return list of LED color to fill, max size should be at least 21, the max number of leds</param>
-    /// <returns>The number of leds/intensities added to the return array</returns>
-    void AnimationInstanceNoise::updateLEDs(int ms, uint32_t* outLEDs) {
+    /// <param name="fadeTimes1000">The fade out factor to apply to the colors, 1000 for no fade</param>
+    /// <param name="daisyChainFrame">the frame (in daisy chain order) to blend the LED colors into</param>
+    void AnimationInstanceNoise::render(int ms, uint32_t fadeTimes1000, uint32_t* daisyChainFrame) {
         
         auto preset = getPreset();
-        int time = ms - startTime;
-        int fadeTime = preset->duration * preset->fade / (255 * 2);
+        uint32_t fadeMultiplier = Utils::ColorKernels::getFadeMultiplier(fadeTimes1000);
 
         // LEDs will pick an initial color from the overall gradient (generally black to white)
         auto& gradientOverall = animationBits->getRGBTrack(preset->overallGradientTrackOffset); 			
         // they will then fade according to the individual gradient
         auto& gradientIndividual = animationBits->getRGBTrack(preset->individualGradientTrackOffset);	
 
-        uint8_t intensity = 255;
-        if (time <= fadeTime) {
-            // Ramp up
-            intensity = (uint8_t)(time * 255 / fadeTime);
-        } else if (time >= (preset->duration - fadeTime)) {
-            // Ramp down
-            intensity = (uint8_t)((preset->duration - time) * 255 / fadeTime);
-        }
+        uint8_t intensity = getFadeIntensity(ms, 255);
+
+        auto layout = SettingsManager::getLayout();
 
         // Should we start a new blink instance?
         if (ms >= nextBlinkTime) {
-            // Yes, pick an led!
-            int newLed = RNG::randomUInt32() % ledCount;
-            for (int retries = 0; blinkDurations[newLed] != 0 && retries < MAX_RETRIES; ++retries) {
-                newLed = RNG::randomUInt32() % ledCount;
+            // Yes, pick an led! Preferably one that isn't blinking already
+            uint32_t freeLEDs = ((1 << ledCount) - 1) & ~blinkingLEDs;
+            int newLed;
+            if (freeLEDs != 0) {
+                // Skip to a random one of the free LEDs
+                for (int skip = random.nextBelow(__builtin_popcount(freeLEDs)); skip > 0; --skip) {
+                    freeLEDs &= freeLEDs - 1;
+                }
+                newLed = __builtin_ctz(freeLEDs);
+            } else {
+                newLed = random.nextBelow(ledCount);
             }
 
             // Setup next blink
             blinkDurations[newLed] = preset->blinkDurationMs;
+            if (blinkDurations[newLed] != 0) {
+                blinkingLEDs |= 1 << newLed;
+            }
             blinkStartTimes[newLed] = ms;
+            blinkCursors[newLed].reset();
 
             uint32_t gradientColor = 0;
             switch (preset->overallGradientColorType) {
                 case NoiseColorOverrideType_RandomFromGradient:
                     // Ignore instance gradient parameter, each blink gets a random value
-                    gradientColor = gradientOverall.evaluateColor(animationBits, RNG::randomUInt32() % 1000);
+                    {
+                        int param = random.nextBelow(1000);
+                        gradientColor = overallGradientLUT != nullptr ? overallGradientLUT->evaluateColor(param) : gradientOverall.evaluateColor(animationBits, param);
+                    }
                     break;
                 case NoiseColorOverrideType_FaceToGradient:
                     {
                         // use the current face (set at start()) + variance
-                        int var = (int)(RNG::randomUInt32() % MAX(1, (2 * preset->overallGradientColorVar))) - preset->overallGradientColorVar;
+                        int var = (int)random.nextBelow(2 * preset->overallGradientColorVar) - preset->overallGradientColorVar;
                         int param = baseColorParam + var;
                         if (param < 0) {
                             param = 0;
                         } else if (param > 1000) {
                             param = 1000;
                         }
-                        gradientColor = gradientOverall.evaluateColor(animationBits, param);
+                        gradientColor = overallGradientLUT != nullptr ? overallGradientLUT->evaluateColor(param) : gradientOverall.evaluateColor(animationBits, param);
                     }
                     break;
                 case NoiseColorOverrideType_FaceToRainbowWheel:
                     {
                         // use the current face (set at start()) + variance
-                        int var = (int)(RNG::randomUInt32() % MAX(1, (2 * preset->overallGradientColorVar))) - preset->overallGradientColorVar;
+                        int var = (int)random.nextBelow(2 * preset->overallGradientColorVar) - preset->overallGradientColorVar;
                         int param = baseColorParam + var * 255 / 1000;
                         gradientColor = Rainbow::wheel(param);
                     }
@@ -138,35 +165,38 @@ namespace Animations
                 case NoiseColorOverrideType_None:
                 default:
                     {
-                    int gradientTime = time * 1000 / preset->duration;
-                    gradientColor = gradientOverall.evaluateColor(animationBits, gradientTime);
+                    int gradientTime = getTrackTime(ms);
+                    gradientColor = overallGradientLUT != nullptr ? overallGradientLUT->evaluateColor(gradientTime) : gradientOverall.evaluateColor(animationBits, gradientTime, overallGradientCursor);
                     }
                     break;
             }
 
             blinkColors[newLed] = gradientColor;
-            nextBlinkTime = ms + blinkInterValMinMs + (RNG::randomUInt32() % blinkInterValDeltaMs);
+            nextBlinkTime = ms + blinkInterValMinMs + random.nextBelow(blinkInterValDeltaMs);
         }
 
-        for (int i = 0; i < ledCount; ++i) {
-            if (blinkDurations[i] > 0) {
-                // Update this blink
-                int blinkTime = ms - blinkStartTimes[i];
-                if (blinkTime > blinkDurations[i]) {
-                    // This blink is over, return black this one time
-                    outLEDs[i] = 0;
-
-                    // and clear the array entry
-                    blinkDurations[i] = 0;
-                    blinkStartTimes[i] = 0;
-                } else {
-                    // Process this blink
-                    int blinkGradientTime = blinkTime * 1000 / blinkDurations[i];
-                    uint32_t blinkColor = gradientIndividual.evaluateColor(animationBits, blinkGradientTime);
-                    outLEDs[i] = Utils::modulateColor(Utils::mulColors(blinkColors[i], blinkColor), intensity);
-                }
+        // Only visit the LEDs that are blinking
+        uint32_t leds = blinkingLEDs;
+        while (leds != 0) {
+            int i = __builtin_ctz(leds);
+            leds &= leds - 1;
+
+            // Update this blink
+            int blinkTime = ms - blinkStartTimes[i];
+            if (blinkTime > blinkDurations[i]) {
+                // This blink is over (black this one time, so nothing to blend), clear the array entry
+                blinkDurations[i] = 0;
+                blinkStartTimes[i] = 0;
+                blinkingLEDs &= ~(1 << i);
+            } else {
+                // Process this blink
+                int blinkGradientTime = blinkTime * 1000 / blinkDurations[i];
+                uint32_t blinkColor = individualGradientLUT != nullptr ?
+                    individualGradientLUT->evaluateColor(blinkGradientTime) :
+                    gradientIndividual.evaluateColor(animationBits, blinkGradientTime, blinkCursors[i]);
+                uint32_t ledColor = ColorKernels::modulate(ColorKernels::multiply(blinkColors[i], blinkColor), intensity);
+                blendColor(daisyChainFrame, layout->daisyChainIndexFromLEDIndex(i), ledColor, fadeMultiplier);
             }
-            // Else skip
         }
     }
 
@@ -1,7 +1,9 @@
 #pragma once
 
 #include "animations/Animation.h"
+#include "animations/gradient_lut.h"
 #include "data_set/data_animation_bits.h"
+#include "drivers_nrf/rng.h"
 #include "settings.h"
 
 #pragma pack(push, 1)
@@ -31,7 +33,12 @@ namespace Animations
         NoiseColorOverrideType overallGradientColorType; // boolean
         uint16_t overallGradientColorVar; // 0 - 1000
     };
+}
+
+#pragma pack(pop)
 
+namespace Animations
+{
     /// <summary>
     /// Procedural noise animation instance data
     /// </summary>
@@ -45,20 +52,27 @@ namespace Animations
 
         virtual void start(int _startTime, uint8_t _remapFace, uint8_t _loopCount);
         virtual int stop(int retIndices[]);
-        virtual void updateLEDs(int ms, uint32_t* outLEDs);
+        virtual void render(int ms, uint32_t fadeTimes1000, uint32_t* daisyChainFrame);
 
     private:
         
         const AnimationNoise* getPreset() const;
+
+        // First so that it is word aligned, instances are packed but the stream methods
+        // may access their state with (multiple) word loads, which fault when unaligned
+        DriversNRF::RNG::RandomStream random;
         int nextBlinkTime;
         int blinkStartTimes[MAX_LED_COUNT];		// state that keeps track of the start of every individual blink so as to know how to fade it based on the time
         int blinkDurations[MAX_LED_COUNT];	// keeps track of the duration of each individual blink, so as to add a bit of variation 
         uint32_t blinkColors[MAX_LED_COUNT];
+        KeyframeCursor blinkCursors[MAX_LED_COUNT];  // Cursors into the individual gradient, one per blink
+        KeyframeCursor overallGradientCursor;
+        const GradientLUT* overallGradientLUT;      // Baked gradients, nullptr when the tracks must be evaluated directly
+        const GradientLUT* individualGradientLUT;
         int ledCount; 					// int that keeps track of how many led's the circuit board has
         int blinkInterValMinMs;
         int blinkInterValDeltaMs;
         int baseColorParam;
+        uint32_t blinkingLEDs;          // One bit per LED index, set while the LED is blinking
     };
 }
-
-#pragma pack(pop)
\ No newline at end of file
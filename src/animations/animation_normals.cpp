@@ -4,25 +4,33 @@
 #include "config/dice_variants.h"
 #include "config/settings.h"
 #include "utils/Utils.h"
+#include "utils/color_kernels.h"
 #include "nrf_log.h"
 #include "utils/Rainbow.h"
 #include "drivers_nrf/rng.h"
 
 using namespace DriversNRF;
 using namespace Config;
+using namespace Utils;
 
 namespace Animations
 {
     /// <summary>
     /// </summary>
     AnimationInstanceNormals::AnimationInstanceNormals(const AnimationNormals* preset, const DataSet::AnimationBits* bits)
-        : AnimationInstance(preset, bits) {
+        : AnimationInstance(preset, bits)
+        , gradientLUT(nullptr)
+        , axisGradientLUT(nullptr)
+        , angleGradientLUT(nullptr) {
     }
 
     /// <summary>
     /// destructor
     /// </summary>
     AnimationInstanceNormals::~AnimationInstanceNormals() {
+        GradientLUTs::release(gradientLUT);
+        GradientLUTs::release(axisGradientLUT);
+        GradientLUTs::release(angleGradientLUT);
     }
 
     /// <summary>
@@ -37,28 +45,79 @@ namespace Animations
     /// </summary>
     void AnimationInstanceNormals::start(int _startTime, uint8_t _remapFace, uint8_t _loopCount) {
         AnimationInstance::start(_startTime, _remapFace, _loopCount);
+        auto preset = getPreset();
+        setFadeTime(preset->duration * preset->fade / (255 * 2));
 
         // Grab the die normals
         auto layout = SettingsManager::getLayout();
         const Core::int3* normals = layout->faceNormals;
 
         // Grab the orientation normal, based on the current face
-        faceNormal = &normals[_remapFace];
+        const Core::int3& faceNormal = normals[_remapFace];
         int backFaceOffset = 1;
         Core::int3 backVectorNormal = normals[(_remapFace + backFaceOffset) % layout->faceCount];
-        while (abs(Core::int3::dotTimes1000(*faceNormal, backVectorNormal)) > 800 && backFaceOffset < layout->faceCount) {
+        while (abs(Core::int3::dotTimes1000(faceNormal, backVectorNormal)) > 800 && backFaceOffset < layout->faceCount) {
             backFaceOffset += 1;
             backVectorNormal = normals[(_remapFace + backFaceOffset) % layout->faceCount];
         }
         
         // Compute our base vectors, up is aligned with current face, and
         // a back is at 90 degrees from that.
-        auto cross = Core::int3::cross(*faceNormal, backVectorNormal);
+        auto cross = Core::int3::cross(faceNormal, backVectorNormal);
         cross.normalize();
-        backVector = Core::int3::cross(cross, *faceNormal);
+        Core::int3 backVector = Core::int3::cross(cross, faceNormal);
+
+        // The angles of the LEDs relative to the up face and back vector don't change
+        // while the animation plays, so compute them once here rather than every frame
+        for (int i = 0; i < layout->ledCount; ++i) {
+            auto normal = layout->ledNormals[i];
+            // Compute the up/down angle (angle to axis)
+            // We'll extract the angle from the dot product of the face's normal and the LED's normal
+            int dotAxisTimes1000 = Core::int3::dotTimes1000(faceNormal, normal);
+
+            // remap the [-1000, 1000] range to an 8 bit value usable by acos8
+            uint8_t dotAxis8 = (dotAxisTimes1000 * 1275 + 1275000) / 10000;
+
+            // Use lookup acos table
+            axisAngles8[i] = Utils::acos8(dotAxis8);
+
+            // Compute the angle around the axis, we'll use the dot product to the back vector
+
+            // Start by getting a properly normalized in-plane direction vector
+            Core::int3 inPlaneNormal = normal - faceNormal * dotAxisTimes1000;
+            inPlaneNormal.normalize();
+
+            // Compute dot product and extract angle
+            int dotBackTimes1000 = Core::int3::dotTimes1000(backVector, inPlaneNormal);
+            int dotBack8 = (dotBackTimes1000 * 1275 + 1275000) / 10000;
+            int angleToBack8 = Utils::acos8(dotBack8);
+
+            // Oops, we need full range so check cross product with axis to swap the sign as needed
+            if (Core::int3::dotTimes1000(Core::int3::cross(backVector, normal), faceNormal) < 0) {
+                // Negate the angle
+                angleToBack8 = 255 - angleToBack8;
+            }
+            backAngles8[i] = (uint8_t)angleToBack8;
+        }
+
+        gradientCursor.reset();
+        for (int i = 0; i < MAX_LED_COUNT; ++i) {
+            axisGradientCursors[i].reset();
+            angleGradientCursors[i].reset();
+        }
+
+        // Bake the gradients, they are evaluated for every LED on every frame
+        GradientLUTs::release(gradientLUT);
+        GradientLUTs::release(axisGradientLUT);
+        GradientLUTs::release(angleGradientLUT);
+        gradientLUT = nullptr;
+        if (preset->mainGradientColorType != NormalsColorOverrideType_FaceToRainbowWheel) {
+            gradientLUT = GradientLUTs::acquire(animationBits, preset->gradientOverTime);
+        }
+        axisGradientLUT = GradientLUTs::acquire(animationBits, preset->gradientAlongAxis);
+        angleGradientLUT = GradientLUTs::acquire(animationBits, preset->gradientAlongAngle);
 
         // For color override, precompute parameter
-        auto preset = getPreset();
         switch (preset->mainGradientColorType) {
             case NormalsColorOverrideType_FaceToGradient:
                 baseColorParam = (_remapFace * 1000) / layout->faceCount;
@@ -76,46 +135,33 @@ namespace Animations
     /// Computes the list of LEDs that need to be on, and what their intensities should be.
     /// </summary>
     /// <param name="ms">The animation time (in milliseconds)</param>
-    /// <param name="retIndices">the return list of LED indices to fill, max size should be at least 21, the max number of leds</param>
-    /// <param name="retColors">the return list of LED color to fill, max size should be at least 21, the max number of leds</param>
-    /// <returns>The number of leds/intensities added to the return array</returns>
-    void AnimationInstanceNormals::updateLEDs(int ms, uint32_t* outLEDs) {
-        int time = ms - startTime;
+    /// <param name="fadeTimes1000">The fade out factor to apply to the colors, 1000 for no fade</param>
+    /// <param name="daisyChainFrame">the frame (in daisy chain order) to blend the LED colors into</param>
+    void AnimationInstanceNormals::render(int ms, uint32_t fadeTimes1000, uint32_t* daisyChainFrame) {
         auto preset = getPreset();
-        int fadeTime = preset->duration * preset->fade / (255 * 2);
-
-        uint8_t intensity = 255;
-        if (time <= fadeTime) {
-            // Ramp up
-            intensity = (uint8_t)(time * 255 / fadeTime);
-        } else if (time >= (preset->duration - fadeTime)) {
-            // Ramp down
-            intensity = (uint8_t)((preset->duration - time) * 255 / fadeTime);
-        }
+        uint32_t fadeMultiplier = Utils::ColorKernels::getFadeMultiplier(fadeTimes1000);
+
+        uint8_t intensity = getFadeIntensity(ms, 255);
 
-        int axisScrollTime = time * preset->axisScrollSpeedTimes1000 / preset->duration;
-        int angleScrollTime = time * preset->angleScrollSpeedTimes1000 / preset->duration;
-        int gradientTime = time * 1000 / preset->duration;
+        int axisScrollTime = getPhase(ms, preset->axisScrollSpeedTimes1000);
+        int angleScrollTime = getPhase(ms, preset->angleScrollSpeedTimes1000);
+        int gradientTime = getTrackTime(ms);
 
         // Figure out the color from the gradient
         auto& gradient = animationBits->getRGBTrack(preset->gradientOverTime);
         auto& axisGradient = animationBits->getRGBTrack(preset->gradientAlongAxis);
         auto& angleGradient = animationBits->getRGBTrack(preset->gradientAlongAngle);
+        // Without color override, all LEDs use the same color from the gradient over time
+        uint32_t timeGradientColor = 0;
+        if (preset->mainGradientColorType != NormalsColorOverrideType_FaceToGradient &&
+            preset->mainGradientColorType != NormalsColorOverrideType_FaceToRainbowWheel) {
+            timeGradientColor = gradientLUT != nullptr ? gradientLUT->evaluateColor(gradientTime) : gradient.evaluateColor(animationBits, gradientTime, gradientCursor);
+        }
+
         auto layout = Config::SettingsManager::getLayout();
         for (int i = 0; i < layout->ledCount; ++i) {
-            auto normal = layout->ledNormals[i];
-            // Compute color relative to up/down angle (based on the angle to axis)
-            // We'll extract the angle from the dot product of the face's normal and the axis
-            int dotAxisTimes1000 = Core::int3::dotTimes1000(*faceNormal, normal);
-
-            // remap the [-1000, 1000] range to an 8 bit value usable by acos8
-            uint8_t dotAxis8 = (dotAxisTimes1000 * 1275 + 1275000) / 10000;
-
-            // Use lookup acos table
-            int angleToAxis8 = Utils::acos8(dotAxis8);
-
-            // remap 8 bit value to [-1000, 1000] range
-            int angleToAxisNormalized = (angleToAxis8 - 128) * 1000 / 128;
+            // remap 8 bit angle to [-1000, 1000] range
+            int angleToAxisNormalized = (axisAngles8[i] - 128) * 1000 / 128;
 
             // Scale / Offset the value so we can use a smaller subset of the gradient
             int axisGradientBaseTime = angleToAxisNormalized * 1000 / preset->axisScaleTimes1000 + preset->axisOffsetTimes1000;
@@ -124,34 +170,21 @@ namespace Animations
             int axisGradientTime = axisGradientBaseTime + axisScrollTime;
 
             // Compute color along axis
-            uint32_t axisColor = axisGradient.evaluateColor(animationBits, axisGradientTime);
-
-            // Compute color relative to up/down angle (angle to axis), we'll use the dot product to the back vector
-
-            // Start by getting a properly normalized in-plane direction vector
-            Core::int3 inPlaneNormal = normal - *faceNormal * dotAxisTimes1000;
-            inPlaneNormal.normalize();
-
-            // Compute dot product and extract angle
-            int dotBackTimes1000 = Core::int3::dotTimes1000(backVector, inPlaneNormal);
-            int dotBack8 = (dotBackTimes1000 * 1275 + 1275000) / 10000;
-            int angleToBack8 = Utils::acos8(dotBack8);
-
-            // Oops, we need full range so check cross product with axis to swap the sign as needed
-            if (Core::int3::dotTimes1000(Core::int3::cross(backVector, normal), *faceNormal) < 0) {
-                // Negate the angle
-                angleToBack8 = 255 - angleToBack8;
-            }
+            uint32_t axisColor = axisGradientLUT != nullptr ?
+                axisGradientLUT->evaluateColor(axisGradientTime) :
+                axisGradient.evaluateColor(animationBits, axisGradientTime, axisGradientCursors[i]);
 
-            // Remap to proper range
-            int angleToBackTimes1000 = (angleToBack8 - 128) * 1000 / 128;
+            // Remap angle around the axis to proper range
+            int angleToBackTimes1000 = (backAngles8[i] - 128) * 1000 / 128;
             int angleGradientNormalized = (angleToBackTimes1000 + 1000) / 2;
 
             // Angle is animated and wrapped around
             int angleGradientTime = (angleGradientNormalized + angleScrollTime) % 1000;
 
             // Compute color along angle
-            uint32_t angleColor = angleGradient.evaluateColor(animationBits, angleGradientTime);
+            uint32_t angleColor = angleGradientLUT != nullptr ?
+                angleGradientLUT->evaluateColor(angleGradientTime) :
+                angleGradient.evaluateColor(animationBits, angleGradientTime, angleGradientCursors[i]);
 
             // Compute color over time
             uint32_t gradientColor = 0;
@@ -160,7 +193,7 @@ namespace Animations
                     {
                         // use the current face (set at start()) + variance
                         int gradientParam = baseColorParam + angleToAxisNormalized * preset->mainGradientColorVar / 1000;
-                        gradientColor = gradient.evaluateColor(animationBits, gradientParam);
+                        gradientColor = gradientLUT != nullptr ? gradientLUT->evaluateColor(gradientParam) : gradient.evaluateColor(animationBits, gradientParam);
                     }
                     break;
                 case NormalsColorOverrideType_FaceToRainbowWheel:
@@ -172,11 +205,12 @@ namespace Animations
                     break;
                 case NormalsColorOverrideType_None:
                 default:
-                    gradientColor = gradient.evaluateColor(animationBits, gradientTime);
+                    gradientColor = timeGradientColor;
                     break;
             }
 
-            outLEDs[i] = Utils::modulateColor(Utils::mulColors(gradientColor, Utils::mulColors(axisColor, angleColor)), intensity);
+            uint32_t ledColor = ColorKernels::modulate(ColorKernels::multiply(gradientColor, ColorKernels::multiply(axisColor, angleColor)), intensity);
+            blendColor(daisyChainFrame, layout->daisyChainIndexFromLEDIndex(i), ledColor, fadeMultiplier);
         }
     }
 
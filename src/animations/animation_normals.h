@@ -1,6 +1,9 @@
 #pragma once
 
 #include "animations/Animation.h"
+#include "animations/keyframes.h"
+#include "animations/gradient_lut.h"
+#include "config/settings.h"
 #include "core/int3.h"
 
 #pragma pack(push, 1)
@@ -31,7 +34,12 @@ namespace Animations
         NormalsColorOverrideType mainGradientColorType;
         uint16_t mainGradientColorVar; // 0 - 1000, only applies for random and face-based color
     };
+}
+
+#pragma pack(pop)
 
+namespace Animations
+{
     /// <summary>
     /// Procedural rainbow animation instance data
     /// </summary>
@@ -45,14 +53,18 @@ namespace Animations
 
         virtual void start(int _startTime, uint8_t _remapFace, uint8_t _loopCount);
         virtual int stop(int retIndices[]);
-        virtual void updateLEDs(int ms, uint32_t* outLEDs);
+        virtual void render(int ms, uint32_t fadeTimes1000, uint32_t* daisyChainFrame);
 
     private:
         const AnimationNormals* getPreset() const;
-        const Core::int3* faceNormal;
-        Core::int3 backVector;
         int baseColorParam;
+        uint8_t axisAngles8[MAX_LED_COUNT];     // Angle between each LED and the up face, 0 - 255
+        uint8_t backAngles8[MAX_LED_COUNT];     // Angle around the up face between each LED and the back vector, 0 - 255
+        KeyframeCursor gradientCursor;
+        KeyframeCursor axisGradientCursors[MAX_LED_COUNT];
+        KeyframeCursor angleGradientCursors[MAX_LED_COUNT];
+        const GradientLUT* gradientLUT;         // Baked gradients, nullptr when the tracks must be evaluated directly
+        const GradientLUT* axisGradientLUT;
+        const GradientLUT* angleGradientLUT;
     };
 }
-
-#pragma pack(pop)
\ No newline at end of file
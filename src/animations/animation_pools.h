@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include "animation_simple.h"
+#include "animation_gradient.h"
+#include "animation_keyframed.h"
+#include "animation_rainbow.h"
+#include "animation_gradientpattern.h"
+#include "animation_noise.h"
+#include "animation_cycle.h"
+#include "animation_blinkid.h"
+#include "animation_normals.h"
+#include "animation_sequence.h"
+#include "animation_worm.h"
+#include "animation_baked.h"
+#include "modules/anim_controller.h"
+#include "core/slab_pool.h"
+
+// RAM set aside for the animation instance pools, in bytes, out of the ~16 KB of the firmware (see Firmware.ld)
+// The firmware Makefile sets it next to the heap and stack sizes
+#ifndef ANIM_INSTANCE_POOLS_MAX_SIZE
+#define ANIM_INSTANCE_POOLS_MAX_SIZE 3072
+#endif
+
+namespace Animations
+{
+    // Animation instances are allocated from fixed pools rather than the heap, so that playing
+    // many animations over hours doesn't fragment the (small) heap.
+    // Most instances are small, so every running animation gets a small slot. Only the few types that keep
+    // per-LED state (i.e. noise, normals, baked) need a large slot, and only a few of those play at once.
+    typedef Core::SlabPool<
+        Core::maxSizeOf<
+            AnimationInstanceSimple,
+            AnimationInstanceGradient,
+            AnimationInstanceRainbow,
+            AnimationInstanceKeyframed,
+            AnimationInstanceGradientPattern,
+            AnimationInstanceCycle,
+            AnimationInstanceBlinkId,
+            AnimationInstanceSequence,
+            AnimationInstanceWorm>(),
+        MAX_ANIMS> SmallInstancePool;
+
+    typedef Core::SlabPool<
+        Core::maxSizeOf<
+            AnimationInstanceNoise,
+            AnimationInstanceNormals,
+            AnimationInstanceBaked>(),
+        MAX_LARGE_ANIMS> LargeInstancePool;
+
+#if UINTPTR_MAX == 0xFFFFFFFF
+    // Instances are larger with 64 bits pointers, so this is only checked for 32 bits targets,
+    // i.e. when building the firmware (Animation.cpp) and by the host check_pool_sizes target
+    static_assert(sizeof(SmallInstancePool) + sizeof(LargeInstancePool) <= ANIM_INSTANCE_POOLS_MAX_SIZE,
+        "The animation instance pools take more RAM than ANIM_INSTANCE_POOLS_MAX_SIZE");
+#endif
+}
@@ -1,5 +1,6 @@
 #include "animation_rainbow.h"
 #include "utils/rainbow.h"
+#include "utils/color_kernels.h"
 #include "config/dice_variants.h"
 #include "config/settings.h"
 
@@ -33,72 +34,72 @@ namespace Animations
     /// </summary>
     void AnimationInstanceRainbow::start(int _startTime, uint8_t _remapFace, uint8_t _loopCount) {
         AnimationInstance::start(_startTime, _remapFace, _loopCount);
+
+        auto preset = getPreset();
+        setFadeTime(preset->duration * preset->fade / (255 * 2));
+
+        // The offsets only depend on the preset, compute them once rather than every frame
+        int c = SettingsManager::getLayout()->ledCount;
+        for (int i = 0; i < c; ++i) {
+            ledPhases[i] = (uint8_t)(i * 256 * preset->cyclesTimes10 / (c * 10));
+        }
     }
 
     /// <summary>
     /// Computes the list of LEDs that need to be on, and what their intensities should be.
     /// </summary>
     /// <param name="ms">The animation time (in milliseconds)</param>
-    /// <param name="retIndices">the return list of LED indices to fill, max size should be at least 21, the max number of leds</param>
-    /// <param name="retColors">the return list of LED color to fill, max size should be at least 21, the max number of leds</param>
-    /// <returns>The number of leds/intensities added to the return array</returns>
-    void AnimationInstanceRainbow::updateDaisyChainLEDs(int ms, uint32_t* outDaisyChainColors) {
-        auto l = SettingsManager::getLayout();
-        int c = l->ledCount;
+    /// <param name="fadeTimes1000">The fade out factor to apply to the colors, 1000 for no fade</param>
+    /// <param name="daisyChainFrame">the frame (in daisy chain order) to blend the LED colors into</param>
+    void AnimationInstanceRainbow::render(int ms, uint32_t fadeTimes1000, uint32_t* daisyChainFrame) {
+        uint32_t fadeMultiplier = Utils::ColorKernels::getFadeMultiplier(fadeTimes1000);
 
         auto preset = getPreset();
 
         // Compute color
         uint32_t color = 0;
-        int fadeTime = preset->duration * preset->fade / (255 * 2);
-        int time = (ms - startTime);
-
-        int wheelPos = (time * preset->count * 255 / preset->duration) % 256;
-
-        uint8_t intensity = preset->intensity;
-        if (time <= fadeTime) {
-            // Ramp up
-            intensity = (uint8_t)(time * preset->intensity / fadeTime);
-        } else if (time >= (preset->duration - fadeTime)) {
-            // Ramp down
-            intensity = (uint8_t)((preset->duration - time) * preset->intensity / fadeTime);
-        }
+        int wheelPos = getPhase(ms, preset->count * 255) % 256;
+        uint8_t intensity = getFadeIntensity(ms, preset->intensity);
 
         auto layout = SettingsManager::getLayout();
-        int reverseMapping[MAX_LED_COUNT];
-        // TODO We should do this expensive reverse mapping only once
+        auto tables = layout->getTables();
+
+        // Remap the animation face mask to the current orientation
+        uint32_t faceMask = 0;
+        for (int f = 0; f < layout->faceCount; ++f) {
+            if ((preset->faceMask & (1 << f)) != 0) {
+                faceMask |= 1 << layout->remapFaceIndexBasedOnUpFace(remapFace, f);
+            }
+        }
+
+        // And gather the daisy chain LEDs showing any of those faces
+        uint32_t daisyChainMask = 0;
         for (int f = 0; f < layout->faceCount; ++f) {
-            for (int ff = 0; ff < layout->faceCount; ++ff) {
-                if (f == layout->remapFaceIndexBasedOnUpFace(remapFace, ff)) {
-                    reverseMapping[f] = ff;
-                    break;
-                }
+            if ((faceMask & (1 << f)) != 0) {
+                daisyChainMask |= tables->daisyChainMaskFromFace[f];
+            }
+        }
+        for (int l = 0; l < tables->blendedLEDCount; ++l) {
+            if ((tables->blendedLEDs[l].faceMask & faceMask) != 0) {
+                daisyChainMask |= 1 << tables->blendedLEDs[l].daisyChainIndex;
             }
         }
 
-        // Fill the indices and colors for the anim controller to know how to update leds
+        // Fill the colors for the anim controller to know how to update leds
         bool traveling = (preset->animFlags & AnimationFlags_Traveling) != 0;
         if (!traveling) {
             // All leds same color
             color = Rainbow::wheel((uint8_t)wheelPos, intensity);
         }
-        for (int l = 0; l < layout->ledCount; ++l) {
-            // Get the corresponding faces
-            int faces[MAX_BLENDED_COLORS];
-            int faceCount = layout->faceIndicesFromLEDIndex(l, faces);
-            for (int f = 0; f < faceCount; ++f) {
-                // Inverse remap face based on face up
-                int face = faces[f];
-                // Check if the face is included in the face mask
-                if ((preset->faceMask & (1 << reverseMapping[face])) != 0) {
-                    // And compute color using the daisy chain index
-                    int i = layout->daisyChainIndexFromLEDIndex(l);
-                    outDaisyChainColors[i] = traveling
-                        ? Rainbow::wheel((uint8_t)((wheelPos + i * 256 * preset->cyclesTimes10 / (c * 10)) % 256), intensity)
-                        : color;
-                    break;
-                }
-            }
+
+        while (daisyChainMask != 0) {
+            // Compute color using the daisy chain index
+            int i = __builtin_ctz(daisyChainMask);
+            daisyChainMask &= daisyChainMask - 1;
+            uint32_t ledColor = traveling
+                ? Rainbow::wheel((uint8_t)(wheelPos + ledPhases[i]), intensity)
+                : color;
+            blendColor(daisyChainFrame, i, ledColor, fadeMultiplier);
         }
     }
 
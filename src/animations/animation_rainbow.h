@@ -1,6 +1,7 @@
 #pragma once
 
 #include "animations/Animation.h"
+#include "config/settings.h"
 
 #pragma pack(push, 1)
 
@@ -18,7 +19,12 @@ namespace Animations
         uint8_t intensity;
         uint8_t cyclesTimes10;
     };
+}
+
+#pragma pack(pop)
 
+namespace Animations
+{
     /// <summary>
     /// Procedural rainbow animation instance data
     /// </summary>
@@ -32,11 +38,11 @@ namespace Animations
 
         virtual void start(int _startTime, uint8_t _remapFace, uint8_t _loopCount);
         virtual int stop(int retIndices[]);
-        virtual void updateDaisyChainLEDs(int ms, uint32_t* outDaisyChainColors);
+        virtual void render(int ms, uint32_t fadeTimes1000, uint32_t* daisyChainFrame);
 
     private:
         const AnimationRainbow* getPreset() const;
+
+        uint8_t ledPhases[MAX_LED_COUNT]; // Wheel offset of each daisy chain LED when traveling
     };
 }
-
-#pragma pack(pop)
@@ -18,7 +18,9 @@ namespace Animations
     /// Needs to have an associated preset passed in
     /// </summary>
     AnimationInstanceSequence::AnimationInstanceSequence(const AnimationSequence* preset, const DataSet::AnimationBits* bits)
-        : AnimationInstance(preset, bits) {
+        : AnimationInstance(preset, bits)
+        , items((const AnimationSequenceItem*)bits->getAnimationData(preset->animationsOffset, preset->animationCount * sizeof(AnimationSequenceItem)))
+        , itemCount(items != nullptr ? preset->animationCount : 0) {
     }
 
     /// <summary>
@@ -39,7 +41,15 @@ namespace Animations
     /// </summary>
     void AnimationInstanceSequence::start(int _startTime, uint8_t _remapFace, uint8_t _loopCount) {
         AnimationInstance::start(_startTime, _remapFace, _loopCount);
-        lastMillis = -1;
+
+        // Lists are usually in delay order, in which case the next item is just the following one
+        inDelayOrder = true;
+        for (int i = 1; i < itemCount && inDelayOrder; ++i) {
+            inDelayOrder = items[i - 1].animationDelay <= items[i].animationDelay;
+        }
+        firstItem = (uint8_t)getFollowingItem(-1);
+        nextItem = firstItem;
+        lastTime = -1;
         processAnimations(_startTime);
     }
 
@@ -62,42 +72,103 @@ namespace Animations
         return 0;
     }
 
+    /// <summary>
+    /// Nothing is rendered, the sequence only needs to be updated when the next animation is due,
+    /// or on the next frame if this one can't trigger all the animations that are due
+    /// </summary>
+    int AnimationInstanceSequence::nextChangeTime(int ms) const {
+        // Skip the items this frame triggers, as many as processAnimations() may launch,
+        // starting over if the sequence looped
+        int time = ms - startTime;
+        int item = time < lastTime ? firstItem : nextItem;
+        int launchCount = getLaunchCount();
+        while (item < itemCount && items[item].animationDelay <= time) {
+            if (launchCount == 0) {
+                return ms + 1;
+            }
+            launchCount--;
+            item = getFollowingItem(item);
+        }
+        return item < itemCount ? startTime + items[item].animationDelay : ANIM_TIME_NEVER;
+    }
+
     const AnimationSequence* AnimationInstanceSequence::getPreset() const {
         return static_cast<const AnimationSequence*>(animationPreset);
     }
 
+    /// <summary>
+    /// Returns the index of the item triggered after the given one (-1 for the first item), or itemCount.
+    /// Items are triggered in delay order, and in list order for equal delays. Lists that aren't sorted
+    /// by delay are scanned for the next item, so that instances don't need any RAM per item.
+    /// </summary>
+    int AnimationInstanceSequence::getFollowingItem(int item) const {
+        if (inDelayOrder) {
+            return item + 1;
+        }
+        int following = itemCount;
+        for (int i = 0; i < itemCount; ++i) {
+            if (item >= 0) {
+                int delay = items[i].animationDelay;
+                int itemDelay = items[item].animationDelay;
+                if (delay < itemDelay || (delay == itemDelay && i <= item)) {
+                    // Triggered before
+                    continue;
+                }
+            }
+            if (following == itemCount || items[i].animationDelay < items[following].animationDelay) {
+                following = i;
+            }
+        }
+        return following;
+    }
+
+    /// <summary>
+    /// Returns how many animations may be triggered now, keeping SEQUENCE_QUEUE_HEADROOM entries
+    /// of the scheduler queue free
+    /// </summary>
+    int AnimationInstanceSequence::getLaunchCount() {
+        int space = Scheduler::getQueueSpace();
+        return space > SEQUENCE_QUEUE_HEADROOM ? space - SEQUENCE_QUEUE_HEADROOM : 0;
+    }
+
     void AnimationInstanceSequence::processAnimations(int ms) {
-        auto preset = getPreset();
-        int lastMs = lastMillis - startTime;
-        int thisMs = ms - startTime;
-        lastMillis = ms;
-        const int animCount = MIN(preset->animationCount, MAX_SEQ_ANIMATIONS);
-        for (int i = 0; i < animCount; i++) {
-            int delay = preset->animations[i].animationDelay;
-            if (delay > lastMs && delay <= thisMs) {
-
-                NRF_LOG_DEBUG("Starting animation %d", preset->animations[i].animationIndex);
-
-                struct TriggeredAnimation
-                {
-                    const DataSet::AnimationBits* bits;
-                    uint16_t animIndex;
-                    uint8_t remapFace;
-                };
-
-                TriggeredAnimation triggeredAnimation = 
-                {
-                    animationBits,
-                    preset->animations[i].animationIndex,
-                    remapFace
-                };
-                Scheduler::push(&triggeredAnimation, sizeof(TriggeredAnimation), [](void *p_event_data, uint16_t event_size) {
-                    auto ta = (TriggeredAnimation*)p_event_data;
-                    // Start the animation
-                    auto anim = ta->bits->getAnimation(ta->animIndex);
-                    AnimController::play(anim, ta->bits, ta->remapFace, 1);
-                });
+        int time = ms - startTime;
+        if (time < lastTime) {
+            // Looping, trigger the items again
+            nextItem = firstItem;
+        }
+        lastTime = time;
+
+        // Stop at the first item that isn't due yet, or when the scheduler queue is down to its headroom,
+        // in which case the remaining items are triggered on the next update (see nextChangeTime())
+        while (nextItem < itemCount && items[nextItem].animationDelay <= time && getLaunchCount() > 0) {
+            auto& item = items[nextItem];
+
+            NRF_LOG_DEBUG("Starting animation %d", item.animationIndex);
+
+            struct TriggeredAnimation
+            {
+                const DataSet::AnimationBits* bits;
+                uint16_t animIndex;
+                uint8_t remapFace;
+            };
+
+            TriggeredAnimation triggeredAnimation = 
+            {
+                animationBits,
+                item.animationIndex,
+                remapFace
+            };
+            bool pushed = Scheduler::push(&triggeredAnimation, sizeof(TriggeredAnimation), [](void *p_event_data, uint16_t event_size) {
+                auto ta = (TriggeredAnimation*)p_event_data;
+                // Start the animation
+                auto anim = ta->bits->getAnimation(ta->animIndex);
+                AnimController::play(anim, ta->bits, ta->remapFace, 1);
+            });
+            if (!pushed) {
+                break;
             }
+            nextItem = (uint8_t)getFollowingItem(nextItem);
         }
     }
 }
@@ -4,7 +4,12 @@
 
 #pragma pack(push, 1)
 
-#define MAX_SEQ_ANIMATIONS 4
+// The number of items of a sequence is stored on 8 bits
+#define SEQUENCE_MAX_ITEMS 255
+
+// Number of scheduler queue entries sequences leave free for the other modules (messages, accelerometer, etc.),
+// items that are due while the queue is that full are triggered on a later frame
+#define SEQUENCE_QUEUE_HEADROOM 4
 
 namespace Animations
 {
@@ -15,23 +20,31 @@ namespace Animations
     };
 
     /// <summary>
-    /// Animation that triggers other animations
+    /// Animation that triggers other animations.
+    /// The list of items is stored in the animations buffer of the data set (usually right after
+    /// the preset), so a sequence may have up to SEQUENCE_MAX_ITEMS of them, in any order.
+    /// Items are triggered in delay order, and in list order for equal delays.
+    /// size: 8 bytes (+ 4 bytes per item)
     /// </summary>
     struct AnimationSequence
         : public Animation
     {
-        AnimationSequenceItem animations[MAX_SEQ_ANIMATIONS];
+        uint16_t animationsOffset;  // Offset of the AnimationSequenceItem list in the animations buffer, in bytes
         uint8_t animationCount;
+        uint8_t padding;
     };
+}
 
+#pragma pack(pop)
+
+namespace Animations
+{
     /// <summary>
     /// Procedural on off animation instance data
     /// </summary>
     class AnimationInstanceSequence
         : public AnimationInstance
     {
-    private:
-        int lastMillis; // The last millis() value
     public:
         AnimationInstanceSequence(const AnimationSequence* preset, const DataSet::AnimationBits* bits);
         virtual ~AnimationInstanceSequence();
@@ -40,11 +53,19 @@ namespace Animations
         virtual void start(int _startTime, uint8_t _remapFace, uint8_t _loopCount);
         virtual int update(int ms, int retIndices[], uint32_t retColors[]);
         virtual int stop(int retIndices[]);
+        virtual int nextChangeTime(int ms) const;
 
     private:
         const AnimationSequence* getPreset() const;
+        int getFollowingItem(int item) const;
         void processAnimations(int ms);
+        static int getLaunchCount();
+
+        const AnimationSequenceItem* items;  // nullptr if the list isn't within the data set
+        int lastTime;               // Animation time of the last update, -1 before the first one
+        uint8_t itemCount;
+        uint8_t firstItem;          // Index of the first item to trigger
+        uint8_t nextItem;           // Index of the next item to trigger, itemCount once they all have been
+        bool inDelayOrder;          // Whether the list is sorted by delay, checked by start()
     };
 }
-
-#pragma pack(pop)
\ No newline at end of file
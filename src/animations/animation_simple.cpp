@@ -1,8 +1,13 @@
 #include "animation_simple.h"
 #include "utils/utils.h"
+#include "utils/color_kernels.h"
 #include "config/board_config.h"
 #include "data_set/data_animation_bits.h"
 
+// How late the anim controller may come at the start of a period and still hand the blinks over to the LEDs,
+// in ms. The rest of the animation is shifted by as much.
+#define SIMPLE_LOOP_START_MARGIN_MS 3
+
 namespace Animations
 {
     /// <summary>
@@ -33,41 +38,47 @@ namespace Animations
         AnimationInstance::start(_startTime, _remapFace, _loopCount);
         auto preset = getPreset();
         rgb = animationBits->getPaletteColor(preset->colorIndex);
+
+        // The animation repeats count times, each period fading in and out
+        int period = preset->duration / preset->count;
+        periodDivider.setDivisor(period);
+        setFadeTime(period * preset->fade / (255 * 2));
     }
 
     /// <summary>
     /// Computes the list of LEDs that need to be on, and what their intensities should be.
     /// </summary>
     /// <param name="ms">The animation time (in milliseconds)</param>
-    /// <param name="retIndices">the return list of LED indices to fill, max size should be at least 21, the max number of LEDs</param>
-    /// <param name="retColors">the return list of LED color to fill, max size should be at least 21, the max number of LEDs</param>
-    /// <returns>The number of LEDs/intensities added to the return array</returns>
-    int AnimationInstanceSimple::update(int ms, int retIndices[], uint32_t retColors[]) {
-        
-        auto preset = getPreset();
+    /// <param name="outFaces">the faces to turn on and their colors</param>
+    void AnimationInstanceSimple::updateFaces(int ms, AnimationFaces& outFaces) {
+        // All the faces get the same color
+        outFaces.fill(getPreset()->faceMask, getColor(ms));
+    }
 
-        // Compute color
+    /// <summary>
+    /// Computes the color of the LEDs at the given time
+    /// </summary>
+    uint32_t AnimationInstanceSimple::getColor(int ms) const {
         uint32_t black = 0;
         uint32_t color = 0;
-        int period = preset->duration / preset->count;
-        int fadeTime = period * preset->fade / (255 * 2);
-        int onOffTime = (period - fadeTime * 2) / 2;
-        int time = (ms - startTime) % period;
+        int fadeTime = fadeDivider.divisor;
+        int onOffTime = (periodDivider.divisor - fadeTime * 2) / 2;
+        int time = getPeriodTime(ms);
 
-        if (time <= fadeTime) {
+        // Fade times are at most half a period (< 32768 ms), so times shifted into
+        // interpolation weights (0 - 65536) can't overflow
+        if (time < fadeTime) {
             // Ramp up
-            color = Utils::interpolateColors(black, 0, rgb, fadeTime, time);
+            color = Utils::ColorKernels::lerp(black, rgb, fadeDivider.divide(time << 16));
         } else if (time <= fadeTime + onOffTime) {
             color = rgb;
         } else if (time <= fadeTime * 2 + onOffTime) {
             // Ramp down
-            color = Utils::interpolateColors(rgb, fadeTime + onOffTime, black, fadeTime * 2 + onOffTime, time);
+            color = Utils::ColorKernels::lerp(rgb, black, fadeDivider.divide((time - fadeTime - onOffTime) << 16));
         } else {
             color = black;
         }
-
-        // Fill the indices and colors for the anim controller to know how to update LEDs
-        return setColor(color, preset->faceMask, retIndices, retColors);
+        return color;
     }
 
     /// <summary>
@@ -78,6 +89,71 @@ namespace Animations
         return setIndices(preset->faceMask, retIndices);
     }
 
+    /// <summary>
+    /// The color only changes while fading in or out, skip the holds
+    /// </summary>
+    int AnimationInstanceSimple::nextChangeTime(int ms) const {
+        int period = periodDivider.divisor;
+        int fadeTime = fadeDivider.divisor;
+        int onOffTime = (period - fadeTime * 2) / 2;
+        int time = getPeriodTime(ms);
+
+        if (time < fadeTime) {
+            // Ramping up
+            return ms + 1;
+        } else if (time <= fadeTime + onOffTime) {
+            // On until the ramp down starts
+            return ms + fadeTime + onOffTime + 1 - time;
+        } else if (time <= fadeTime * 2 + onOffTime) {
+            // Ramping down
+            return ms + 1;
+        } else {
+            // Off until the next period
+            return ms + period - time;
+        }
+    }
+
+    /// <summary>
+    /// All the LEDs of the face mask get the same color
+    /// </summary>
+    bool AnimationInstanceSimple::getCoverage(int ms, uint32_t fadeTimes1000, AnimationCoverage& outCoverage) const {
+        getUniformColorCoverage(getColor(ms), getPreset()->faceMask, fadeTimes1000, outCoverage);
+        return true;
+    }
+
+    /// <summary>
+    /// Without fades, the LEDs blink between the color and black. From the start of a period
+    /// (nextChangeTime() wakes the anim controller up then), that's two frames repeated
+    /// until the end of the animation.
+    /// </summary>
+    bool AnimationInstanceSimple::getLoop(int ms, AnimationLoop& outLoop) const {
+        auto preset = getPreset();
+        int period = periodDivider.divisor;
+        int fadeTime = fadeDivider.divisor;
+        int onOffTime = (period - fadeTime * 2) / 2;
+        int periodStart = ms - getPeriodTime(ms);
+        if (fadeTime != 0 || onOffTime == 0 || onOffTime + 1 >= period || ms - periodStart > SIMPLE_LOOP_START_MARGIN_MS) {
+            return false;
+        }
+
+        // Same boundaries as getColor(), the color is on up to onOffTime included, then off until the next period
+        int offStart = periodStart + onOffTime + 1;
+        outLoop.frameTimes[0] = periodStart;
+        outLoop.frameTimes[1] = offStart;
+        outLoop.frameDurations[0] = offStart - periodStart;
+        outLoop.frameDurations[1] = periodStart + period - offStart;
+        outLoop.count = preset->count - periodDivider.divide(periodStart - startTime);
+        return true;
+    }
+
+    /// <summary>
+    /// Returns the time (in ms) since the start of the current period
+    /// </summary>
+    int AnimationInstanceSimple::getPeriodTime(int ms) const {
+        int time = ms - startTime;
+        return time - periodDivider.divide(time) * periodDivider.divisor;
+    }
+
     const AnimationSimple* AnimationInstanceSimple::getPreset() const {
         return static_cast<const AnimationSimple*>(animationPreset);
     }
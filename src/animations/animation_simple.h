@@ -17,7 +17,12 @@ namespace Animations
         uint8_t count;
         uint8_t fade;
     };
+}
+
+#pragma pack(pop)
 
+namespace Animations
+{
     /// <summary>
     /// Procedural on off animation instance data
     /// </summary>
@@ -26,18 +31,22 @@ namespace Animations
     {
     private:
         uint32_t rgb; // The color is determined at the beginning of the animation
+        TimeDivider periodDivider; // Divides by the period of the blinks, the fade time being that of one blink
     public:
         AnimationInstanceSimple(const AnimationSimple* preset, const DataSet::AnimationBits* bits);
         virtual ~AnimationInstanceSimple();
         virtual int animationSize() const;
 
         virtual void start(int _startTime, uint8_t _remapFace, uint8_t _loopCount);
-        virtual int update(int ms, int retIndices[], uint32_t retColors[]);
+        virtual void updateFaces(int ms, AnimationFaces& outFaces);
         virtual int stop(int retIndices[]);
+        virtual int nextChangeTime(int ms) const;
+        virtual bool getCoverage(int ms, uint32_t fadeTimes1000, AnimationCoverage& outCoverage) const;
+        virtual bool getLoop(int ms, AnimationLoop& outLoop) const;
 
     private:
         const AnimationSimple* getPreset() const;
+        uint32_t getColor(int ms) const;
+        int getPeriodTime(int ms) const;
     };
 }
-
-#pragma pack(pop)
\ No newline at end of file
@@ -1,10 +1,12 @@
 #include "animation_worm.h"
 #include "utils/utils.h"
+#include "utils/color_kernels.h"
 #include "utils/rainbow.h"
 #include "config/dice_variants.h"
 #include "data_set/data_animation_bits.h"
 
 using namespace Config;
+using namespace Utils;
 
 namespace Animations
 {
@@ -13,13 +15,15 @@ namespace Animations
     /// Needs to have an associated preset passed in
     /// </summary>
     AnimationInstanceWorm::AnimationInstanceWorm(const AnimationWorm* preset, const DataSet::AnimationBits* bits)
-        : AnimationInstance(preset, bits) {
+        : AnimationInstance(preset, bits)
+        , gradientLUT(nullptr) {
     }
 
     /// <summary>
     /// destructor
     /// </summary>
     AnimationInstanceWorm::~AnimationInstanceWorm() {
+        GradientLUTs::release(gradientLUT);
     }
 
     /// <summary>
@@ -34,6 +38,12 @@ namespace Animations
     /// </summary>
     void AnimationInstanceWorm::start(int _startTime, uint8_t _remapFace, uint8_t _loopCount) {
         AnimationInstance::start(_startTime, _remapFace, _loopCount);
+        auto preset = getPreset();
+        setFadeTime(preset->duration * preset->fade / (255 * 2));
+
+        // Bake the gradient, it is evaluated for every face on every frame
+        GradientLUTs::release(gradientLUT);
+        gradientLUT = GradientLUTs::acquire(animationBits, preset->gradientTrackOffset);
     }
 
     /// <summary>
@@ -50,21 +60,15 @@ namespace Animations
         auto preset = getPreset();
 
         // Compute color 
-        int fadeTime = preset->duration * preset->fade / (255 * 2);
-        int time = (ms - startTime);
-
-        uint8_t intensity = preset->intensity;
-        if (time <= fadeTime) {
-            // Ramp up
-            intensity = (uint8_t)(time * preset->intensity / fadeTime);
-        } else if (time >= (preset->duration - fadeTime)) {
-            // Ramp down
-            intensity = (uint8_t)((preset->duration - time) * preset->intensity / fadeTime);
-        }
+        uint8_t intensity = getFadeIntensity(ms, preset->intensity);
 
         // Figure out the color from the gradient
         auto& gradient = animationBits->getRGBTrack(preset->gradientTrackOffset);
-        int gradientTime = time * preset->count * 1000 / preset->duration;
+        int gradientTime = getPhase(ms, preset->count * 1000);
+
+        // Face times increase with the face index (until they wrap around), so when the gradient
+        // isn't baked, one cursor lets each evaluation pick up where the previous face left off
+        KeyframeCursor cursor = { 0 };
 
         // Fill the indices and colors for the anim controller to know how to update leds
         int retCount = 0;
@@ -72,7 +76,8 @@ namespace Animations
             if ((preset->faceMask & (1 << i)) != 0) {
                 retIndices[retCount] = i;
                 int faceTime = (gradientTime + i * 1000 * preset->cyclesTimes10 / (c * 10)) % 1000;
-                retColors[retCount] = Utils::modulateColor(gradient.evaluateColor(animationBits, faceTime), intensity);
+                uint32_t color = gradientLUT != nullptr ? gradientLUT->evaluateColor(faceTime) : gradient.evaluateColor(animationBits, faceTime, cursor);
+                retColors[retCount] = ColorKernels::modulate(color, intensity);
                 retCount++;
             }
         }
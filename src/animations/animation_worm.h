@@ -1,6 +1,7 @@
 #pragma once
 
 #include "animations/Animation.h"
+#include "animations/gradient_lut.h"
 #include "config/settings.h"
 
 #pragma pack(push, 1)
@@ -20,7 +21,12 @@ namespace Animations
         uint8_t cyclesTimes10;
         uint16_t gradientTrackOffset;
     };
+}
+
+#pragma pack(pop)
 
+namespace Animations
+{
     /// <summary>
     /// Procedural rainbow animation instance data
     /// </summary>
@@ -38,8 +44,6 @@ namespace Animations
 
     private:
         const AnimationWorm *getPreset() const;
-        uint8_t indices[MAX_LED_COUNT];
+        const GradientLUT* gradientLUT;     // Baked gradient, nullptr when the track must be evaluated directly
     };
 }
-
-#pragma pack(pop)
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include "gradient_lut.h"
+#include "keyframes.h"
+#include "data_set/data_animation_bits.h"
+#include "utils/utils.h"
+
+using namespace Utils;
+
+namespace Animations
+{
+    /// <summary>
+    /// Evaluates the baked gradient for a given time, in milliseconds.
+    /// Values outside the track's range are clamped, same as RGBTrack::evaluateColor().
+    /// </summary>
+    uint32_t GradientLUT::evaluateColor(int time) const {
+        if (time <= times[0]) {
+            return colors[0];
+        } else if (time > times[keyframeCount - 1]) {
+            return colors[keyframeCount - 1];
+        }
+
+        // Find the first keyframe at or after time, same as RGBTrack::findNextKeyframe(),
+        // starting from the first one of the time's bucket
+        int nextIndex = bucketKeyframes[time >> GRADIENT_LUT_BUCKET_SHIFT];
+        while (times[nextIndex] < time) {
+            nextIndex++;
+        }
+        return Utils::interpolateColors(colors[nextIndex - 1], times[nextIndex - 1], colors[nextIndex], times[nextIndex], time);
+    }
+
+namespace GradientLUTs
+{
+#if GRADIENT_LUT_ENABLED
+    static GradientLUT luts[MAX_BAKED_GRADIENTS];
+
+    /// <summary>
+    /// Checks that the track evaluates to the same colors no matter when or where it is evaluated,
+    /// and that its keyframes fit in a table
+    /// </summary>
+    static bool canBake(const DataSet::AnimationBits* bits, const RGBTrack& track) {
+        if (track.keyFrameCount == 0 || track.keyFrameCount > GRADIENT_LUT_MAX_KEYFRAMES) {
+            return false;
+        }
+        for (int i = 0; i < track.keyFrameCount; ++i) {
+            uint16_t colorIndex = track.getRGBKeyframe(bits, i).colorIndex();
+            if (colorIndex == PALETTE_COLOR_FROM_FACE || colorIndex == PALETTE_COLOR_FROM_RANDOM) {
+                return false;
+            }
+        }
+        return true;
+    }
+#endif
+
+    /// <summary>
+    /// Returns the baked version of a gradient track, sharing it with other instances
+    /// using the same track, or baking it in a free cache entry.
+    /// </summary>
+    const GradientLUT* acquire(const DataSet::AnimationBits* bits, uint16_t trackOffset) {
+#if GRADIENT_LUT_ENABLED
+        GradientLUT* freeLUT = nullptr;
+        for (int i = 0; i < MAX_BAKED_GRADIENTS; ++i) {
+            GradientLUT& lut = luts[i];
+            if (lut.refCount == 0) {
+                if (freeLUT == nullptr) {
+                    freeLUT = &lut;
+                }
+            } else if (lut.bits == bits && lut.trackOffset == trackOffset) {
+                lut.refCount++;
+                return &lut;
+            }
+        }
+
+        if (freeLUT == nullptr || trackOffset >= bits->getRGBTrackCount()) {
+            return nullptr;
+        }
+
+        auto& track = bits->getRGBTrack(trackOffset);
+        if (!canBake(bits, track)) {
+            return nullptr;
+        }
+
+        freeLUT->keyframeCount = track.keyFrameCount;
+        for (int i = 0; i < track.keyFrameCount; ++i) {
+            auto keyframe = track.getRGBKeyframe(bits, i);
+            freeLUT->times[i] = keyframe.time();
+            freeLUT->colors[i] = keyframe.color(bits);
+        }
+
+        // Keyframe times only increase, so this is a single pass over them
+        int keyframeIndex = 0;
+        for (int i = 0; i < GRADIENT_LUT_BUCKET_COUNT; ++i) {
+            int bucketTime = i << GRADIENT_LUT_BUCKET_SHIFT;
+            while (keyframeIndex < track.keyFrameCount - 1 && freeLUT->times[keyframeIndex] < bucketTime) {
+                keyframeIndex++;
+            }
+            freeLUT->bucketKeyframes[i] = (uint8_t)keyframeIndex;
+        }
+        freeLUT->bits = bits;
+        freeLUT->trackOffset = trackOffset;
+        freeLUT->refCount = 1;
+        return freeLUT;
+#else
+        return nullptr;
+#endif
+    }
+
+    /// <summary>
+    /// Gives back a gradient returned by acquire(), the entry is freed when no instance uses it anymore
+    /// </summary>
+    void release(const GradientLUT* lut) {
+        if (lut != nullptr) {
+            GradientLUT* entry = const_cast<GradientLUT*>(lut);
+            if (entry->refCount > 0) {
+                entry->refCount--;
+            }
+        }
+    }
+}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+
+// Set to 0 to always evaluate gradients from their keyframes
+#ifndef GRADIENT_LUT_ENABLED
+#define GRADIENT_LUT_ENABLED 1
+#endif
+
+// Maximum number of keyframes of a baked gradient, tracks with more keyframes are evaluated directly
+#define GRADIENT_LUT_MAX_KEYFRAMES 16
+
+// Keyframes are indexed by 64ms buckets over the 0 - 1024ms track range
+#define GRADIENT_LUT_BUCKET_SHIFT 6
+#define GRADIENT_LUT_BUCKET_COUNT (1024 >> GRADIENT_LUT_BUCKET_SHIFT)
+
+// Maximum number of different gradients baked at the same time, each one uses 120 bytes
+#define MAX_BAKED_GRADIENTS 4
+
+namespace DataSet
+{
+    struct AnimationBits;
+}
+
+namespace Animations
+{
+    struct RGBTrack;
+
+    /// <summary>
+    /// A gradient track with its keyframe colors resolved, and an index of which keyframe to start
+    /// from at any time, so that it can be evaluated without going through the palette or searching
+    /// the keyframes from the first one. Segments are interpolated exactly like the track does, so
+    /// colors are the same as the track's own.
+    /// </summary>
+    struct GradientLUT
+    {
+        const DataSet::AnimationBits* bits;
+        uint16_t trackOffset;
+        uint8_t refCount;       // Number of animation instances using this table, 0 when the entry is free
+        uint8_t keyframeCount;
+        uint16_t times[GRADIENT_LUT_MAX_KEYFRAMES];
+        uint32_t colors[GRADIENT_LUT_MAX_KEYFRAMES];
+        uint8_t bucketKeyframes[GRADIENT_LUT_BUCKET_COUNT]; // Index of the first keyframe at or after the start of each bucket
+
+        uint32_t evaluateColor(int time) const;
+    };
+
+    /// <summary>
+    /// Shared cache of baked gradients, animation instances acquire the gradients they need
+    /// when they start, and release them when they are destroyed.
+    /// </summary>
+    namespace GradientLUTs
+    {
+        // Returns nullptr if the track can't be baked or the cache is full, callers should then evaluate the track directly
+        const GradientLUT* acquire(const DataSet::AnimationBits* bits, uint16_t trackOffset);
+        void release(const GradientLUT* lut);
+    }
+}
@@ -15,10 +15,13 @@ namespace Animations
         return (timeAndColor >> 7) * 2;
     }
     
-    uint32_t RGBKeyframe::color(const DataSet::AnimationBits* bits) const {
+    uint16_t RGBKeyframe::colorIndex() const {
         // Take the lower 7 bits for the index
-        uint16_t index = timeAndColor & 0b1111111;
-        return bits->getPaletteColor(index);
+        return timeAndColor & 0b1111111;
+    }
+
+    uint32_t RGBKeyframe::color(const DataSet::AnimationBits* bits) const {
+        return bits->getPaletteColor(colorIndex());
     }
 
     void RGBKeyframe::setTimeAndColorIndex(uint16_t timeMs, uint16_t colorIndex) {
@@ -46,35 +49,58 @@ namespace Animations
     /// Values outside the track's range are clamped to first or last keyframe value.
     /// </summary>
     int RGBTrack::evaluate(const DataSet::AnimationBits* bits, int time, int retIndices[], uint32_t retColors[]) const {
+        KeyframeCursor cursor = { 0 };
+        return evaluate(bits, time, cursor, retIndices, retColors);
+    }
+
+    /// <summary>
+    /// Same as above, but starts looking for the keyframes where the previous evaluation with this cursor stopped
+    /// </summary>
+    int RGBTrack::evaluate(const DataSet::AnimationBits* bits, int time, KeyframeCursor& cursor, int retIndices[], uint32_t retColors[]) const {
         if (keyFrameCount == 0)
             return 0;
 
-        uint32_t color = evaluateColor(bits, time);
+        uint32_t color = evaluateColor(bits, time, cursor);
 
         // Fill the return arrays
         int currentCount = 0;
-        int ledCount = SettingsManager::getLayout()->ledCount;
-        for (int i = 0; i < ledCount; ++i) {
-            if (ledMask & (1 << i)) {
-                retIndices[currentCount] = i;
-                retColors[currentCount] = color;
-                currentCount++;
-            }
+        uint32_t mask = ledMask & ((1 << SettingsManager::getLayout()->ledCount) - 1);
+        while (mask != 0) {
+            retIndices[currentCount] = __builtin_ctz(mask);
+            retColors[currentCount] = color;
+            currentCount++;
+            mask &= mask - 1;
         }
         return currentCount;
     }
 
+    /// <summary>
+    /// Same as above, but sets the color of the track's LEDs in outFaces, all at once
+    /// </summary>
+    void RGBTrack::evaluate(const DataSet::AnimationBits* bits, int time, KeyframeCursor& cursor, AnimationFaces& outFaces) const {
+        if (keyFrameCount == 0)
+            return;
+
+        outFaces.fill(ledMask & ((1 << SettingsManager::getLayout()->ledCount) - 1), evaluateColor(bits, time, cursor));
+    }
+
     /// <summary>
     /// Evaluate an animation track's for a given time, in milliseconds
     /// Values outside the track's range are clamped to first or last keyframe value.
     /// </summary>
     uint32_t RGBTrack::evaluateColor(const DataSet::AnimationBits* bits, int time) const
+    {
+        KeyframeCursor cursor = { 0 };
+        return evaluateColor(bits, time, cursor);
+    }
+
+    /// <summary>
+    /// Same as above, but starts looking for the keyframes where the previous evaluation with this cursor stopped
+    /// </summary>
+    uint32_t RGBTrack::evaluateColor(const DataSet::AnimationBits* bits, int time, KeyframeCursor& cursor) const
     {
         // Find the first keyframe
-        int nextIndex = 0;
-        while (nextIndex < keyFrameCount && getRGBKeyframe(bits, nextIndex).time() < time) {
-            nextIndex++;
-        }
+        int nextIndex = findNextKeyframe(bits, time, cursor);
 
         uint32_t color = 0;
         if (nextIndex == 0) {
@@ -100,18 +126,94 @@ namespace Animations
         return color;
     }
 
+    /// <summary>
+    /// Returns the last time up to which the track keeps the color it has at the given time,
+    /// i.e. the given time if the color is changing, or 0xFFFF if it never changes again.
+    /// </summary>
+    int RGBTrack::getHoldEndTime(const DataSet::AnimationBits* bits, int time) const {
+        if (keyFrameCount == 0) {
+            return 0xFFFF;
+        }
+        KeyframeCursor cursor = { 0 };
+        int holdIndex = findNextKeyframe(bits, time, cursor);
+        if (holdIndex == keyFrameCount) {
+            // Past the last keyframe, the track keeps its last color
+            return hasConstantColor(getRGBKeyframe(bits, holdIndex - 1)) ? 0xFFFF : time;
+        }
+
+        // Between keyframes, the color only holds if both keyframes have the same color
+        if (holdIndex > 0 && !isSameColor(getRGBKeyframe(bits, holdIndex - 1), getRGBKeyframe(bits, holdIndex))) {
+            return time;
+        }
+        if (!hasConstantColor(getRGBKeyframe(bits, holdIndex))) {
+            return time;
+        }
+
+        // Keep holding for as long as the following keyframes have the same color
+        while (holdIndex + 1 < keyFrameCount && isSameColor(getRGBKeyframe(bits, holdIndex), getRGBKeyframe(bits, holdIndex + 1))) {
+            holdIndex++;
+        }
+        if (holdIndex + 1 == keyFrameCount) {
+            return 0xFFFF;
+        }
+        return getRGBKeyframe(bits, holdIndex).time();
+    }
+
+    /// <summary>
+    /// Whether any keyframe picks a random color, in which case each evaluation may return a different color
+    /// </summary>
+    bool RGBTrack::hasRandomColors(const DataSet::AnimationBits* bits) const {
+        for (int i = 0; i < keyFrameCount; ++i) {
+            if (getRGBKeyframe(bits, i).colorIndex() == PALETTE_COLOR_FROM_RANDOM) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// <summary>
+    /// Whether the keyframe color only depends on the palette, as opposed to the current face or a random value
+    /// </summary>
+    bool RGBTrack::hasConstantColor(const RGBKeyframe& keyframe) {
+        uint16_t colorIndex = keyframe.colorIndex();
+        return colorIndex != PALETTE_COLOR_FROM_FACE && colorIndex != PALETTE_COLOR_FROM_RANDOM;
+    }
+
+    /// <summary>
+    /// Whether two keyframes are known to evaluate to the same color
+    /// </summary>
+    bool RGBTrack::isSameColor(const RGBKeyframe& keyframe1, const RGBKeyframe& keyframe2) {
+        return hasConstantColor(keyframe1) && keyframe1.colorIndex() == keyframe2.colorIndex();
+    }
+
+    /// <summary>
+    /// Returns the index of the first keyframe at or after the given time, starting from the cursor
+    /// when time moved forward, and from the first keyframe otherwise. Updates the cursor.
+    /// </summary>
+    int RGBTrack::findNextKeyframe(const DataSet::AnimationBits* bits, int time, KeyframeCursor& cursor) const {
+        int nextIndex = cursor.nextIndex;
+        if (nextIndex > keyFrameCount || (nextIndex > 0 && getRGBKeyframe(bits, nextIndex - 1).time() >= time)) {
+            // Time went backward, start over
+            nextIndex = 0;
+        }
+        while (nextIndex < keyFrameCount && getRGBKeyframe(bits, nextIndex).time() < time) {
+            nextIndex++;
+        }
+        cursor.nextIndex = (uint8_t)nextIndex;
+        return nextIndex;
+    }
+
     /// <summary>
     /// Extracts the LED indices from the led bit mask
     /// </summary>
     int RGBTrack::extractLEDIndices(int retIndices[]) const {
         // Fill the return arrays
         int currentCount = 0;
-        int ledCount = SettingsManager::getLayout()->ledCount;
-        for (int i = 0; i < ledCount; ++i) {
-            if (ledMask & (1 << i)) {
-                retIndices[currentCount] = i;
-                currentCount++;
-            }
+        uint32_t mask = ledMask & ((1 << SettingsManager::getLayout()->ledCount) - 1);
+        while (mask != 0) {
+            retIndices[currentCount] = __builtin_ctz(mask);
+            currentCount++;
+            mask &= mask - 1;
         }
         return currentCount;
     }
@@ -154,35 +256,58 @@ namespace Animations
     /// Values outside the track's range are clamped to first or last keyframe value.
     /// </summary>
     int Track::evaluate(const DataSet::AnimationBits* bits, uint32_t color, int time, int retIndices[], uint32_t retColors[]) const {
+        KeyframeCursor cursor = { 0 };
+        return evaluate(bits, color, time, cursor, retIndices, retColors);
+    }
+
+    /// <summary>
+    /// Same as above, but starts looking for the keyframes where the previous evaluation with this cursor stopped
+    /// </summary>
+    int Track::evaluate(const DataSet::AnimationBits* bits, uint32_t color, int time, KeyframeCursor& cursor, int retIndices[], uint32_t retColors[]) const {
         if (keyFrameCount == 0)
             return 0;
 
-        uint32_t mcolor = modulateColor(bits, color, time);
+        uint32_t mcolor = modulateColor(bits, color, time, cursor);
 
         // Fill the return arrays
         int currentCount = 0;
-        int ledCount = SettingsManager::getLayout()->ledCount;
-        for (int i = 0; i < ledCount; ++i) {
-            if (ledMask & (1 << i)) {
-                retIndices[currentCount] = i;
-                retColors[currentCount] = mcolor;
-                currentCount++;
-            }
+        uint32_t mask = ledMask & ((1 << SettingsManager::getLayout()->ledCount) - 1);
+        while (mask != 0) {
+            retIndices[currentCount] = __builtin_ctz(mask);
+            retColors[currentCount] = mcolor;
+            currentCount++;
+            mask &= mask - 1;
         }
         return currentCount;
     }
 
+    /// <summary>
+    /// Same as above, but sets the color of the track's LEDs in outFaces, all at once
+    /// </summary>
+    void Track::evaluate(const DataSet::AnimationBits* bits, uint32_t color, int time, KeyframeCursor& cursor, AnimationFaces& outFaces) const {
+        if (keyFrameCount == 0)
+            return;
+
+        outFaces.fill(ledMask & ((1 << SettingsManager::getLayout()->ledCount) - 1), modulateColor(bits, color, time, cursor));
+    }
+
     /// <summary>
     /// Evaluate an animation track's for a given time, in milliseconds
     /// Values outside the track's range are clamped to first or last keyframe value.
     /// </summary>
     uint32_t Track::modulateColor(const DataSet::AnimationBits* bits, uint32_t color, int time) const
+    {
+        KeyframeCursor cursor = { 0 };
+        return modulateColor(bits, color, time, cursor);
+    }
+
+    /// <summary>
+    /// Same as above, but starts looking for the keyframes where the previous evaluation with this cursor stopped
+    /// </summary>
+    uint32_t Track::modulateColor(const DataSet::AnimationBits* bits, uint32_t color, int time, KeyframeCursor& cursor) const
     {
         // Find the first keyframe
-        int nextIndex = 0;
-        while (nextIndex < keyFrameCount && getKeyframe(bits, (uint16_t)nextIndex).time() < time) {
-            nextIndex++;
-        }
+        int nextIndex = findNextKeyframe(bits, time, cursor);
 
         uint8_t intensity = 0;
         if (nextIndex == 0) {
@@ -208,18 +333,34 @@ namespace Animations
         return Utils::modulateColor(color, intensity);
     }
 
+    /// <summary>
+    /// Returns the index of the first keyframe at or after the given time, starting from the cursor
+    /// when time moved forward, and from the first keyframe otherwise. Updates the cursor.
+    /// </summary>
+    int Track::findNextKeyframe(const DataSet::AnimationBits* bits, int time, KeyframeCursor& cursor) const {
+        int nextIndex = cursor.nextIndex;
+        if (nextIndex > keyFrameCount || (nextIndex > 0 && getKeyframe(bits, (uint16_t)(nextIndex - 1)).time() >= time)) {
+            // Time went backward, start over
+            nextIndex = 0;
+        }
+        while (nextIndex < keyFrameCount && getKeyframe(bits, (uint16_t)nextIndex).time() < time) {
+            nextIndex++;
+        }
+        cursor.nextIndex = (uint8_t)nextIndex;
+        return nextIndex;
+    }
+
     /// <summary>
     /// Extracts the LED indices from the led bit mask
     /// </summary>
     int Track::extractLEDIndices(int retIndices[]) const {
         // Fill the return arrays
         int currentCount = 0;
-        int ledCount = SettingsManager::getLayout()->ledCount;
-        for (int i = 0; i < ledCount; ++i) {
-            if (ledMask & (1 << i)) {
-                retIndices[currentCount] = i;
-                currentCount++;
-            }
+        uint32_t mask = ledMask & ((1 << SettingsManager::getLayout()->ledCount) - 1);
+        while (mask != 0) {
+            retIndices[currentCount] = __builtin_ctz(mask);
+            currentCount++;
+            mask &= mask - 1;
         }
         return currentCount;
     }
@@ -6,6 +6,19 @@
 
 namespace Animations
 {
+    /// <summary>
+    /// Remembers the keyframe a track evaluation stopped at, so that evaluating the same track
+    /// again at a later time only needs to look at the following keyframes instead of scanning
+    /// from the first one. Evaluating at an earlier time (i.e. time wrapped around) scans from the start again.
+    /// size: 1 byte
+    /// </summary>
+    struct KeyframeCursor
+    {
+        uint8_t nextIndex; // First keyframe at or after the last evaluated time
+
+        void reset() { nextIndex = 0; }
+    };
+
     /// <summary>
     /// Stores a single keyframe of a LED animation
     /// size: 2 bytes, split this way:
@@ -20,6 +33,7 @@ namespace Animations
         uint16_t timeAndColor;
 
         uint16_t time() const; // unpack the time in ms
+        uint16_t colorIndex() const; // unpack the palette index
         uint32_t color(const DataSet::AnimationBits* bits) const;// unpack the color using the lookup table from the animation set
 
         void setTimeAndColorIndex(uint16_t timeMs, uint16_t colorIndex);
@@ -41,8 +55,18 @@ namespace Animations
         uint16_t getDuration(const DataSet::AnimationBits* bits) const;
         const RGBKeyframe& getRGBKeyframe(const DataSet::AnimationBits* bits, uint16_t keyframeIndex) const;
         int evaluate(const DataSet::AnimationBits* bits, int time, int retIndices[], uint32_t retColors[]) const;
+        int evaluate(const DataSet::AnimationBits* bits, int time, KeyframeCursor& cursor, int retIndices[], uint32_t retColors[]) const;
+        void evaluate(const DataSet::AnimationBits* bits, int time, KeyframeCursor& cursor, AnimationFaces& outFaces) const;
         uint32_t evaluateColor(const DataSet::AnimationBits* bits, int time) const;
+        uint32_t evaluateColor(const DataSet::AnimationBits* bits, int time, KeyframeCursor& cursor) const;
+        int getHoldEndTime(const DataSet::AnimationBits* bits, int time) const;
+        bool hasRandomColors(const DataSet::AnimationBits* bits) const;
         int extractLEDIndices(int retIndices[]) const;
+
+    private:
+        int findNextKeyframe(const DataSet::AnimationBits* bits, int time, KeyframeCursor& cursor) const;
+        static bool hasConstantColor(const RGBKeyframe& keyframe);
+        static bool isSameColor(const RGBKeyframe& keyframe1, const RGBKeyframe& keyframe2);
     };
 
     /// <summary>
@@ -79,8 +103,14 @@ namespace Animations
         uint16_t getDuration(const DataSet::AnimationBits *bits) const;
         const Keyframe& getKeyframe(const DataSet::AnimationBits* bits, uint16_t keyframeIndex) const;
         int evaluate(const DataSet::AnimationBits* bits, uint32_t color, int time, int retIndices[], uint32_t retColors[]) const;
+        int evaluate(const DataSet::AnimationBits* bits, uint32_t color, int time, KeyframeCursor& cursor, int retIndices[], uint32_t retColors[]) const;
+        void evaluate(const DataSet::AnimationBits* bits, uint32_t color, int time, KeyframeCursor& cursor, AnimationFaces& outFaces) const;
         uint32_t modulateColor(const DataSet::AnimationBits* bits, uint32_t color, int time) const;
+        uint32_t modulateColor(const DataSet::AnimationBits* bits, uint32_t color, int time, KeyframeCursor& cursor) const;
         int extractLEDIndices(int retIndices[]) const;
+
+    private:
+        int findNextKeyframe(const DataSet::AnimationBits* bits, int time, KeyframeCursor& cursor) const;
     };
 
 
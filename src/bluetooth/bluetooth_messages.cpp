@@ -79,6 +79,10 @@ namespace Bluetooth
             return "TransferTestAck";
         case MessageType_TransferTestFinished:
             return "TransferTestFinished";
+        case MessageType_RequestAnimProfile:
+            return "RequestAnimProfile";
+        case MessageType_AnimProfile:
+            return "AnimProfile";
         default:
             return "<missing>";
     }
@@ -12,6 +12,7 @@
 #include "modules/user_mode_controller.h"
 #include "pixel.h"
 #include "die.h"
+#include "animations/Animation.h"
 
 // FW version of last settings struct change
 #define SETTINGS_VERSION 0x100
@@ -125,6 +126,9 @@ struct Message
         MessageType_LightUpFace,
         MessageType_SetLEDToColor,
         MessageType_PrintAnimControllerState,
+        MessageType_RequestAnimProfile,
+        MessageType_AnimProfile,
+        MessageType_SetLEDCurrentBudget,
 
         MessageType_Count,
     };
@@ -163,8 +167,8 @@ struct VersionInfo : Chunk<VersionInfo>
 
     // API compatibility versions
     uint16_t compatStandardApiVersion = 0x100; // WhoAreYou, IAmADie, RollState, BatteryLevel, RequestRssi, Rssi, Blink, BlinkAck
-    uint16_t compatExtendedApiVersion = 0x100; // Animations (including anim classes), profile
-    uint16_t compatManagementApiVersion = 0x100; // The rest
+    uint16_t compatExtendedApiVersion = 0x101; // Animations (including anim classes), profile. 0x101: sequence items moved to the animations buffer
+    uint16_t compatManagementApiVersion = 0x101; // The rest. 0x101: SetLEDCurrentBudget
 };
 
 struct DieInfo : Chunk<DieInfo>
@@ -676,6 +680,51 @@ struct MessageBlinkId
     MessageBlinkId() : Message(Message::MessageType_BlinkId) {}
 };
 
+struct MessageRequestAnimProfile
+    : Message
+{
+    uint8_t reset; // Non zero to clear the stats once they are sent
+
+    MessageRequestAnimProfile() : Message(Message::MessageType_RequestAnimProfile) {}
+};
+
+/// <summary>
+/// Cost of a kind of update, all values saturate at 0xFFFF
+/// </summary>
+struct AnimProfileStats
+{
+    uint16_t count;
+    uint16_t minUs;
+    uint16_t avgUs;
+    uint16_t maxUs;
+};
+
+/// <summary>
+/// How long the animation controller takes to update the LEDs, see AnimController
+/// </summary>
+struct MessageAnimProfile
+    : Message
+{
+    uint16_t overrunCount;      // Frames that took longer than ANIM_FRAME_DURATION_MS
+    AnimProfileStats frames;    // Whole frames, from the first render to the LEDs
+
+    // Renders of each animation type, indexed by Animations::AnimationType
+    AnimProfileStats anims[Animations::Animation_Count];
+
+    MessageAnimProfile() : Message(Message::MessageType_AnimProfile) {}
+};
+
+// Sent as a single notification, i.e. MTU minus the 3 bytes ATT header (115 bytes with 13 animation types)
+static_assert(sizeof(MessageAnimProfile) <= NRF_SDH_BLE_GATT_MAX_MTU_SIZE - 3, "MessageAnimProfile doesn't fit in a notification");
+
+struct MessageSetLEDCurrentBudget
+    : Message
+{
+    uint16_t budgetMA; // Most current the LEDs may draw, in mA, or 0 to go back to LED_CURRENT_BUDGET_MA
+
+    MessageSetLEDCurrentBudget() : Message(Message::MessageType_SetLEDCurrentBudget) {}
+};
+
 }
 
 #pragma pack(pop)
@@ -797,6 +797,33 @@ namespace DiceVariants
     }
 
 
+    // Tables for the layout currently in use, the die type doesn't change often so we only keep one set
+    static LayoutTables layoutTables;
+
+    const LayoutTables* Layout::getTables() const {
+        if (layoutTables.layout != this) {
+            memset(&layoutTables, 0, sizeof(LayoutTables));
+            layoutTables.layout = this;
+            for (int l = 0; l < ledCount; ++l) {
+                int faces[MAX_FACE_COUNT];
+                int ledFaceCount = faceIndicesFromLEDIndex(l, faces);
+                int daisyChainIndex = daisyChainIndexFromLEDIndex(l);
+                if (ledFaceCount == 1) {
+                    layoutTables.daisyChainMaskFromFace[faces[0]] |= 1 << daisyChainIndex;
+                } else if (ledFaceCount > 1 && layoutTables.blendedLEDCount < MAX_BLENDED_LED_COUNT) {
+                    auto& blendedLED = layoutTables.blendedLEDs[layoutTables.blendedLEDCount++];
+                    for (int i = 0; i < ledFaceCount; ++i) {
+                        blendedLED.faceMask |= 1 << faces[i];
+                    }
+                    blendedLED.faceCount = (uint8_t)ledFaceCount;
+                    blendedLED.daisyChainIndex = (uint8_t)daisyChainIndex;
+                }
+                // Else the LED doesn't show any face
+            }
+        }
+        return &layoutTables;
+    }
+
     uint32_t Layout::getTopFaceMask() const {
         switch (layoutType) {
             case LEDLayoutType::DieLayoutType_D4:
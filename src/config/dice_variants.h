@@ -3,6 +3,9 @@
 #include "core/int3.h"
 #include "stdint.h"
 
+#define MAX_FACE_COUNT 20           // Max face count so far is 20 (on D20 and M20)
+#define MAX_BLENDED_LED_COUNT 12    // Max number of LEDs showing the average of several faces (all 12 on the M20)
+
 namespace Config::DiceVariants
 {
     enum DieType : uint8_t
@@ -46,6 +49,8 @@ namespace Config::DiceVariants
         DieLayoutType_M20,
     };
 
+    struct LayoutTables;
+
     struct Layout
     {
         LEDLayoutType layoutType;
@@ -75,6 +80,29 @@ namespace Config::DiceVariants
         uint32_t getTopFaceMask() const;
         uint8_t getTopFace() const;
         uint8_t getAdjacentFaces(uint8_t face, uint8_t retFaces[]) const;
+
+        // Returns the lookup tables derived from this layout, building them the first time they are requested
+        const LayoutTables* getTables() const;
+    };
+
+    // An LED that shows the average color of several faces (i.e. the D4 top LEDs), each face weighing 1/faceCount
+    struct BlendedLED
+    {
+        uint32_t faceMask;
+        uint8_t faceCount;
+        uint8_t daisyChainIndex;
+    };
+
+    // Lookup tables flattened from the layout functions above, so animations can go from a face
+    // to the daisy chain LEDs it lights up with a single lookup instead of going through
+    // faceIndicesFromLEDIndex() and the index lookups for every LED on every frame.
+    // Faces are in the current orientation, use remapFaceIndexBasedOnUpFace() to get there from an animation face.
+    struct LayoutTables
+    {
+        const Layout* layout;                                   // The layout these tables were built from
+        uint32_t daisyChainMaskFromFace[MAX_FACE_COUNT];        // Daisy chain LEDs showing the color of that face only
+        BlendedLED blendedLEDs[MAX_BLENDED_LED_COUNT];          // Daisy chain LEDs showing the average color of several faces
+        uint8_t blendedLEDCount;
     };
 
     LEDLayoutType getLayoutType(DieType dieType);
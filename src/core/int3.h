@@ -65,6 +65,13 @@ namespace Core
         int3& normalize()
         {
             int magTimes1000 = magnitudeTimes1000();
+            if (magTimes1000 == 0) {
+                // Same as the Cortex-M4 division by 0, which returns 0 instead of faulting
+                xTimes1000 = 0;
+                yTimes1000 = 0;
+                zTimes1000 = 0;
+                return *this;
+            }
             xTimes1000 = (int16_t)((int32_t)xTimes1000 * 1000 / magTimes1000);
             yTimes1000 = (int16_t)((int32_t)yTimes1000 * 1000 / magTimes1000);
             zTimes1000 = (int16_t)((int32_t)zTimes1000 * 1000 / magTimes1000);
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace Core
+{
+    /// <summary>
+    /// Returns the largest sizeof() of the passed types, used to size pool slots at compile time
+    /// </summary>
+    template <typename T>
+    constexpr size_t maxSizeOf()
+    {
+        return sizeof(T);
+    }
+
+    template <typename T, typename U, typename... Others>
+    constexpr size_t maxSizeOf()
+    {
+        return sizeof(T) > maxSizeOf<U, Others...>() ? sizeof(T) : maxSizeOf<U, Others...>();
+    }
+
+    /// <summary>
+    /// Fixed size pool of memory slots, sized at compile time so it never touches the heap.
+    /// Allocation and release are O(1), free slots are kept in a singly linked list of indices.
+    /// The pool only hands out raw memory, callers are responsible for constructing / destroying objects.
+    /// </summary>
+    template <size_t SlotSize, int SlotCount>
+    class SlabPool
+    {
+        static_assert(SlotCount > 0 && SlotCount < 255, "SlabPool slot count must fit in a byte");
+
+        // Round slot size up so every slot stays 8-byte aligned
+        static constexpr size_t AlignedSlotSize = (SlotSize + 7) & ~(size_t)7;
+        static constexpr uint8_t EndOfList = 0xFF;
+        static constexpr uint8_t SlotInUse = 0xFE;
+
+    public:
+        struct Stats
+        {
+            uint32_t allocCount;    // Successful allocations since init
+            uint32_t failureCount;  // Allocations that failed because the pool was full
+            uint8_t inUseCount;     // Slots currently allocated
+            uint8_t peakInUseCount; // Highest number of slots allocated at the same time
+        };
+
+    private:
+        alignas(8) uint8_t slots[SlotCount][AlignedSlotSize];
+        uint8_t nextFree[SlotCount];
+        uint8_t firstFree;
+        Stats stats;
+
+    public:
+        /// <summary>
+        /// Constructor
+        /// </summary>
+        SlabPool()
+        {
+            clear();
+        }
+
+        /// <summary>
+        /// Marks all slots as free and resets the stats
+        /// </summary>
+        void clear()
+        {
+            for (int i = 0; i < SlotCount - 1; ++i)
+            {
+                nextFree[i] = (uint8_t)(i + 1);
+            }
+            nextFree[SlotCount - 1] = EndOfList;
+            firstFree = 0;
+            stats.allocCount = 0;
+            stats.failureCount = 0;
+            stats.inUseCount = 0;
+            stats.peakInUseCount = 0;
+        }
+
+        /// <summary>
+        /// Returns a free slot of at least size bytes, or nullptr if the pool is full (or size too big)
+        /// </summary>
+        void* alloc(size_t size)
+        {
+            if (size > SlotSize || firstFree == EndOfList)
+            {
+                stats.failureCount++;
+                return nullptr;
+            }
+
+            uint8_t index = firstFree;
+            firstFree = nextFree[index];
+            nextFree[index] = SlotInUse;
+
+            stats.allocCount++;
+            stats.inUseCount++;
+            if (stats.inUseCount > stats.peakInUseCount)
+            {
+                stats.peakInUseCount = stats.inUseCount;
+            }
+            return slots[index];
+        }
+
+        /// <summary>
+        /// Returns a slot to the pool.
+        /// Returns false if the pointer doesn't belong to the pool or the slot is already free
+        /// </summary>
+        bool release(void* ptr)
+        {
+            int index = indexOf(ptr);
+            if (index < 0 || nextFree[index] != SlotInUse)
+            {
+                return false;
+            }
+
+            nextFree[index] = firstFree;
+            firstFree = (uint8_t)index;
+            stats.inUseCount--;
+            return true;
+        }
+
+        /// <summary>
+        /// Returns true if the pointer is the start of a slot of this pool
+        /// </summary>
+        bool owns(const void* ptr) const
+        {
+            return indexOf(ptr) >= 0;
+        }
+
+        const Stats& getStats() const
+        {
+            return stats;
+        }
+
+        static constexpr size_t slotSize()
+        {
+            return SlotSize;
+        }
+
+        static constexpr int slotCount()
+        {
+            return SlotCount;
+        }
+
+    private:
+        int indexOf(const void* ptr) const
+        {
+            const uint8_t* bytes = (const uint8_t*)ptr;
+            if (bytes < slots[0] || bytes > slots[SlotCount - 1])
+            {
+                return -1;
+            }
+            size_t offset = (size_t)(bytes - slots[0]);
+            if (offset % AlignedSlotSize != 0)
+            {
+                return -1;
+            }
+            return (int)(offset / AlignedSlotSize);
+        }
+    };
+}
@@ -95,6 +95,13 @@ namespace DataSet
         return animationCount;
     }
 
+    const uint8_t* AnimationBits::getAnimationData(uint16_t offset, uint16_t size) const {
+        if (animations != nullptr && (uint32_t)offset + size <= animationsSize) {
+            return animations + offset;
+        }
+        return nullptr;
+    }
+
     void AnimationBits::Clear() {
         palette = nullptr;
         paletteSize = 0;
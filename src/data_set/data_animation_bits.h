@@ -66,6 +66,9 @@ namespace DataSet
         const Animation* getAnimation(int animationIndex) const;
         uint16_t getAnimationCount() const;
 
+        // Variable size data stored with the animations (i.e. baked frames), nullptr if out of the buffer
+        const uint8_t* getAnimationData(uint16_t offset, uint16_t size) const;
+
         void Clear();
     };
 }
\ No newline at end of file
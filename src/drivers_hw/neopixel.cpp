@@ -7,9 +7,11 @@
 #include "neopixel.h"
 #include "nrf_drv_pwm.h"
 #include "nrf_delay.h"
+#include "app_util_platform.h"
 #include "settings.h"
 #include "config/board_config.h"
 #include "../drivers_nrf/log.h"
+#include <string.h>
 
 using namespace Config;
 
@@ -22,36 +24,193 @@ using namespace Config;
 #define DUTY0 6
 #define DUTY1 13
 
+// Each PWM period sends out one bit, 1.25us
+#define PWM_PERIODS_PER_MS (16000 / TOP)
+
+// PWM duty word for one bit, the top bit sets the polarity
+#define BIT_WORD(value, bit) ((((value) & (1 << (bit))) == 0 ? DUTY0 : DUTY1) | 0x8000)
+#define NIBBLE_WORDS(value) { BIT_WORD(value, 3), BIT_WORD(value, 2), BIT_WORD(value, 1), BIT_WORD(value, 0) }
+
+// One sequence is played by the PWM while the next one is encoded
+#define SEQUENCE_BUFFER_COUNT 2
+#define NO_BUFFER -1
+
 namespace DriversHW
 {
     namespace NeoPixel
     {
         static nrf_drv_pwm_t m_pwm0;
-        static nrf_pwm_values_common_t pwm_sequence_values[MAX_LED_COUNT * NEOPIXEL_BYTES + 1];
+        static nrf_pwm_values_common_t pwm_sequence_values[SEQUENCE_BUFFER_COUNT][MAX_LED_COUNT * NEOPIXEL_BYTES + 1];
+        static uint16_t sequenceLengths[SEQUENCE_BUFFER_COUNT];
+
+        // Color each LED is encoded with in each sequence, so that unchanged LEDs can be skipped.
+        // Colors only use 24 bits, so the initial value forces the first encoding.
+        static uint32_t encodedColors[SEQUENCE_BUFFER_COUNT][MAX_LED_COUNT];
         static uint8_t numLEDs;
         static uint8_t dataPin;
 
-        struct component
-        {
-            uint32_t colorMask;
-            uint16_t colorShift;
-            uint16_t pwmSequenceOffset;
+        // Sequence being sent out by the PWM, and sequence waiting for it to be done.
+        // Both are changed from the PWM interrupt.
+        static volatile int8_t playingBuffer = NO_BUFFER;
+        static volatile int8_t pendingBuffer = NO_BUFFER;
+        static volatile uint32_t playedCount = 0;
+        static uint32_t replacedCount = 0;
+
+        // Whether the PWM is playing a loop from both sequences, see playLoop()
+        static bool looping = false;
+
+        // Set when playback was stopped before the PWM interrupt got to handle the stop event.
+        // Starting a playback clears the event, so it is cleared along.
+        static volatile bool ignoreStop = false;
+
+        // Whether the sequence still holds the colors passed to the last partial show(),
+        // cleared whenever something else writes into it (i.e. error indicator, LED return test)
+        static bool sequenceValid = false;
+
+        // LEDs passed as changed to the partial show() since each sequence was last encoded
+        static uint32_t staleMasks[SEQUENCE_BUFFER_COUNT];
+
+        // Duty words of the 4 bits of each nibble, most significant bit first
+        static const nrf_pwm_values_common_t nibbleWords[16][4] = {
+            NIBBLE_WORDS(0x0), NIBBLE_WORDS(0x1), NIBBLE_WORDS(0x2), NIBBLE_WORDS(0x3),
+            NIBBLE_WORDS(0x4), NIBBLE_WORDS(0x5), NIBBLE_WORDS(0x6), NIBBLE_WORDS(0x7),
+            NIBBLE_WORDS(0x8), NIBBLE_WORDS(0x9), NIBBLE_WORDS(0xA), NIBBLE_WORDS(0xB),
+            NIBBLE_WORDS(0xC), NIBBLE_WORDS(0xD), NIBBLE_WORDS(0xE), NIBBLE_WORDS(0xF),
         };
 
-        void writeColor(uint32_t color, uint32_t ledIndex) {
+        void writeByte(uint32_t value, nrf_pwm_values_common_t* words) {
+            memcpy(words, nibbleWords[(value >> 4) & 0xF], sizeof(nibbleWords[0]));
+            memcpy(words + 4, nibbleWords[value & 0xF], sizeof(nibbleWords[0]));
+        }
+
+        void writeColor(int buffer, uint32_t color, uint32_t ledIndex) {
+
+            // Reorder the color bytes to match the hardware, i.e. green, red, blue
+            nrf_pwm_values_common_t* words = &pwm_sequence_values[buffer][NEOPIXEL_BYTES * ledIndex];
+            writeByte(color >> 8, words);
+            writeByte(color >> 16, words + 8);
+            writeByte(color, words + 16);
+            encodedColors[buffer][ledIndex] = color;
+        }
+
+        /// <summary>
+        /// Encodes the LED if its color is different from what is in the sequence, returns whether it did
+        /// </summary>
+        bool updateColor(int buffer, uint32_t color, uint32_t ledIndex) {
+            if (encodedColors[buffer][ledIndex] == color) {
+                return false;
+            }
+            writeColor(buffer, color, ledIndex);
+            return true;
+        }
+
+        /// <summary>
+        /// Stops sending out whatever the PWM is playing, and drops any frame waiting to be sent
+        /// </summary>
+        void stopPlayback() {
+            looping = false;
+            CRITICAL_REGION_ENTER();
+            if (pendingBuffer != NO_BUFFER) {
+                pendingBuffer = NO_BUFFER;
+                replacedCount++;
+            }
+            CRITICAL_REGION_EXIT();
+
+            if (playingBuffer == NO_BUFFER) {
+                return;
+            }
+            nrf_drv_pwm_stop(&m_pwm0, true);
+
+            CRITICAL_REGION_ENTER();
+            if (playingBuffer != NO_BUFFER) {
+                // The PWM interrupt hasn't handled the stop yet
+                ignoreStop = true;
+                playingBuffer = NO_BUFFER;
+            }
+            CRITICAL_REGION_EXIT();
+        }
+
+        void startPlayback(int buffer) {
+            nrf_pwm_sequence_t const seq0 =
+                {
+                    .values = {
+                        .p_common = pwm_sequence_values[buffer],
+                    },
+                    .length = sequenceLengths[buffer],
+                    .repeats = 0,
+                    .end_delay = 0};
+
+            // The driver clears any stop event the interrupt hasn't handled yet, which then never comes
+            CRITICAL_REGION_ENTER();
+            ignoreStop = false;
+            (void)nrf_drv_pwm_simple_playback(&m_pwm0, &seq0, 1, NRF_DRV_PWM_FLAG_STOP);
+            CRITICAL_REGION_EXIT();
+        }
+
+        /// <summary>
+        /// Returns a sequence that isn't being sent out, so it can be written to.
+        /// If a frame is still waiting to be sent, its sequence is taken back and gets overwritten.
+        /// </summary>
+        int beginFrame() {
+            if (looping) {
+                // Both sequences are used by the loop
+                stopPlayback();
+            }
+
+            int buffer;
+            CRITICAL_REGION_ENTER();
+            if (pendingBuffer != NO_BUFFER) {
+                buffer = pendingBuffer;
+                pendingBuffer = NO_BUFFER;
+                replacedCount++;
+            } else {
+                buffer = playingBuffer == 0 ? 1 : 0;
+            }
+            CRITICAL_REGION_EXIT();
+            return buffer;
+        }
+
+        /// <summary>
+        /// Sends out a sequence returned by beginFrame(), now if the PWM is idle,
+        /// or as soon as it's done with the current one.
+        /// </summary>
+        void endFrame(int buffer, int ledCount) {
+            // write the termination word
+            pwm_sequence_values[buffer][ledCount * NEOPIXEL_BYTES] = 0x8000;
+            sequenceLengths[buffer] = (uint16_t)(NEOPIXEL_BYTES * ledCount + 1);
+
+            bool start;
+            CRITICAL_REGION_ENTER();
+            start = playingBuffer == NO_BUFFER;
+            if (start) {
+                playingBuffer = (int8_t)buffer;
+            } else {
+                pendingBuffer = (int8_t)buffer;
+            }
+            CRITICAL_REGION_EXIT();
 
-            // Reorder the color bytes to match the hardware
-            int pwm_baseIndex = 24 * ledIndex;
-            for (int i = 0; i < 8; ++i) {
-                pwm_sequence_values[pwm_baseIndex + 16 + i] = ((color & 0x000080) == 0 ? DUTY0 : DUTY1) | 0x8000;
-                pwm_sequence_values[pwm_baseIndex +  8 + i] = ((color & 0x800000) == 0 ? DUTY0 : DUTY1) | 0x8000;
-                pwm_sequence_values[pwm_baseIndex      + i] = ((color & 0x008000) == 0 ? DUTY0 : DUTY1) | 0x8000;
-                color <<= 1;
+            if (start) {
+                startPlayback(buffer);
             }
         }
 
         void pwm_handler(nrf_drv_pwm_evt_type_t event_type) {
-            // Nothing
+            if (event_type == NRF_DRV_PWM_EVT_STOPPED) {
+                if (ignoreStop) {
+                    // Already taken care of by stopPlayback()
+                    ignoreStop = false;
+                    return;
+                }
+
+                // The previous sequence has been fully sent out, move on to the next one if there is one
+                playedCount++;
+                int buffer = pendingBuffer;
+                pendingBuffer = NO_BUFFER;
+                playingBuffer = (int8_t)buffer;
+                if (buffer != NO_BUFFER) {
+                    startPlayback(buffer);
+                }
+            }
         }
 
         void init() {
@@ -63,7 +222,12 @@ namespace DriversHW
             const Board* board = Config::BoardManager::getBoard();
             dataPin = board->ledDataPin;
             numLEDs = board->ledCount;
-            
+            memset(encodedColors, 0xFF, sizeof(encodedColors));
+            playingBuffer = NO_BUFFER;
+            pendingBuffer = NO_BUFFER;
+            looping = false;
+            ignoreStop = false;
+
             nrf_drv_pwm_config_t const config0 =
                 {
                     .output_pins =
@@ -86,52 +250,123 @@ namespace DriversHW
 
         void uninit(void) {
             nrf_drv_pwm_uninit(&m_pwm0);
+            playingBuffer = NO_BUFFER;
+            pendingBuffer = NO_BUFFER;
+            looping = false;
         }
 
 
         void clear() {
+            int buffer = beginFrame();
             for (uint32_t led = 0; led < numLEDs; led++) {
-                writeColor(0, led);
+                updateColor(buffer, 0, led);
             }
+            sequenceValid = false;
+            endFrame(buffer, numLEDs);
         }
 
         void show(uint32_t* colors) {
+            int buffer = beginFrame();
             for (int i = 0; i < numLEDs; i++) {
-                writeColor(colors[i], i);
+                updateColor(buffer, colors[i], i);
             }
-            // write the termination word
-            pwm_sequence_values[numLEDs * NEOPIXEL_BYTES] = 0x8000;
+            sequenceValid = false;
+            endFrame(buffer, numLEDs);
+        }
 
-            nrf_pwm_sequence_t const seq0 =
-                {
-                    .values = {
-                        .p_common = pwm_sequence_values,
-                    },
-                    .length = (uint16_t)(NEOPIXEL_BYTES * numLEDs + 1),
-                    .repeats = 0,
-                    .end_delay = 0};
+        /// <summary>
+        /// Same as above, but only looks at the LEDs whose bit is set in changedMask, the others
+        /// must have the same colors as in the previous call. Returns the number of LEDs encoded.
+        /// </summary>
+        int show(uint32_t* colors, uint32_t changedMask) {
+            if (!sequenceValid) {
+                // The sequences were overwritten in between, check everything
+                changedMask = 0xFFFFFFFF;
+                sequenceValid = true;
+            }
 
-            (void)nrf_drv_pwm_simple_playback(&m_pwm0, &seq0, 1, NRF_DRV_PWM_FLAG_STOP);
+            // The sequence may hold an older frame than the last one, so look at everything that changed since
+            int buffer = beginFrame();
+            for (int b = 0; b < SEQUENCE_BUFFER_COUNT; ++b) {
+                staleMasks[b] |= changedMask;
+            }
+            changedMask = staleMasks[buffer] & ((1 << numLEDs) - 1);
+            staleMasks[buffer] = 0;
+            int encodedCount = 0;
+            while (changedMask != 0) {
+                int i = __builtin_ctz(changedMask);
+                if (updateColor(buffer, colors[i], i)) {
+                    encodedCount++;
+                }
+                changedMask &= changedMask - 1;
+            }
+            endFrame(buffer, numLEDs);
+            return encodedCount;
+        }
+
+        /// <summary>
+        /// Returns false if the LEDs were sent something else since the last partial show()
+        /// </summary>
+        bool isSequenceValid() {
+            return sequenceValid;
+        }
+
+        /// <summary>
+        /// Returns true while a frame is being sent out or waiting to be
+        /// </summary>
+        bool isBusy() {
+            return playingBuffer != NO_BUFFER;
+        }
+
+        void getPlaybackStats(PlaybackStats& outStats) {
+            outStats.playedCount = playedCount;
+            outStats.replacedCount = replacedCount;
+        }
+
+        /// <summary>
+        /// Encodes each frame in its own sequence, and has the PWM play them back to back count times.
+        /// The PWM holds the data line low after each sequence for the rest of the frame duration, which the
+        /// LEDs take as the end of the frame, so the CPU can sleep for the whole loop.
+        /// </summary>
+        void playLoop(const uint32_t* colorsA, int durationAMs, const uint32_t* colorsB, int durationBMs, int count) {
+            stopPlayback();
+
+            const uint32_t* frames[SEQUENCE_BUFFER_COUNT] = { colorsA, colorsB };
+            const int durations[SEQUENCE_BUFFER_COUNT] = { durationAMs, durationBMs };
+            nrf_pwm_sequence_t seqs[SEQUENCE_BUFFER_COUNT];
+            for (int b = 0; b < SEQUENCE_BUFFER_COUNT; ++b) {
+                for (int i = 0; i < numLEDs; ++i) {
+                    updateColor(b, frames[b][i], i);
+                }
+
+                // write the termination word
+                pwm_sequence_values[b][numLEDs * NEOPIXEL_BYTES] = 0x8000;
+                sequenceLengths[b] = (uint16_t)(NEOPIXEL_BYTES * numLEDs + 1);
+
+                seqs[b].values.p_common = pwm_sequence_values[b];
+                seqs[b].length = sequenceLengths[b];
+                seqs[b].repeats = 0;
+                seqs[b].end_delay = durations[b] * PWM_PERIODS_PER_MS - sequenceLengths[b];
+            }
+
+            // Which sequence is playing doesn't matter, beginFrame() stops the loop in any case
+            sequenceValid = false;
+            looping = true;
+            playingBuffer = 0;
+            CRITICAL_REGION_ENTER();
+            ignoreStop = false;
+            (void)nrf_drv_pwm_complex_playback(&m_pwm0, &seqs[0], &seqs[1], (uint16_t)count, NRF_DRV_PWM_FLAG_STOP);
+            CRITICAL_REGION_EXIT();
         }
 
         void testLEDReturn() {
             // Forces LEDs to forward color values past the last one so we can detect it
+            int buffer = beginFrame();
             for (int i = 0; i < numLEDs+1; i++) {
-                writeColor(0, i);
+                updateColor(buffer, 0, i);
             }
-            // write the termination word
-            pwm_sequence_values[(numLEDs+1) * NEOPIXEL_BYTES] = 0x8000;
-
-            nrf_pwm_sequence_t const seq0 =
-                {
-                    .values = {
-                        .p_common = pwm_sequence_values,
-                    },
-                    .length = (uint16_t)(NEOPIXEL_BYTES * (numLEDs + 1) + 1),
-                    .repeats = 0,
-                    .end_delay = 0};
-
-            (void)nrf_drv_pwm_simple_playback(&m_pwm0, &seq0, 1, NRF_DRV_PWM_FLAG_STOP);
+            sequenceValid = false;
+            endFrame(buffer, numLEDs + 1);
         }
     }
-}
\ No newline at end of file
+}
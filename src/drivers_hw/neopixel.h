@@ -7,6 +7,9 @@
 
 #include <stdint.h>
 
+// Longest time a frame of a loop can be shown, limited by the 24 bit end delay of the PWM sequences
+#define NEOPIXEL_MAX_LOOP_FRAME_MS 20000
+
 namespace DriversHW
 {
   namespace NeoPixel
@@ -15,6 +18,20 @@ namespace DriversHW
         void uninit(void);
         void clear();
         void show(uint32_t* colors);
+        int show(uint32_t* colors, uint32_t changedMask);
+        bool isSequenceValid();
+        bool isBusy();
         void testLEDReturn();
+
+        // Sends out two frames one after the other, each followed by a hold, count times, without the CPU.
+        // Anything shown afterwards stops the loop.
+        void playLoop(const uint32_t* colorsA, int durationAMs, const uint32_t* colorsB, int durationBMs, int count);
+
+        struct PlaybackStats
+        {
+            uint32_t playedCount;   // Number of frames fully sent out to the LEDs
+            uint32_t replacedCount; // Frames replaced by a newer one before they could be sent out
+        };
+        void getPlaybackStats(PlaybackStats& outStats);
     }
 }
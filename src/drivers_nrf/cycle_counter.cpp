@@ -0,0 +1,37 @@
+#include "cycle_counter.h"
+
+#if CYCLE_COUNTER_USE_DWT
+#include "nrf_log.h"
+#else
+#include <chrono>
+#endif
+
+namespace DriversNRF::CycleCounter
+{
+#if CYCLE_COUNTER_USE_DWT
+    void init() {
+        // The counter is part of the trace unit, which is off unless a debugger turned it on
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CYCCNT = 0;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+        NRF_LOG_DEBUG("Cycle counter init");
+    }
+
+    uint32_t getCyclesPerMs() {
+        return SystemCoreClock / 1000;
+    }
+#else
+    void init() {
+        // Steady clock is always running
+    }
+
+    uint32_t getCyclesPerMs() {
+        return 1000000;
+    }
+
+    uint32_t read() {
+        auto now = std::chrono::steady_clock::now().time_since_epoch();
+        return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+    }
+#endif
+}
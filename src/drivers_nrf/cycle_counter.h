@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+
+// The DWT cycle counter is only on Cortex-M targets, other builds (i.e. host tools) count nanoseconds instead
+#if defined(__arm__)
+#define CYCLE_COUNTER_USE_DWT 1
+#include "nrf.h"
+#else
+#define CYCLE_COUNTER_USE_DWT 0
+#endif
+
+namespace DriversNRF
+{
+    /// <summary>
+    /// Free running counter to measure short durations, wraps around every 2^32 cycles
+    /// (about 67 seconds at 64MHz), so subtract two reads to get the cycles in between.
+    /// </summary>
+    namespace CycleCounter
+    {
+        void init();
+
+        // Number of counts per millisecond
+        uint32_t getCyclesPerMs();
+
+#if CYCLE_COUNTER_USE_DWT
+        inline uint32_t read() {
+            return DWT->CYCCNT;
+        }
+#else
+        uint32_t read();
+#endif
+    }
+}
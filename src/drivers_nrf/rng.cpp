@@ -41,4 +41,22 @@ namespace DriversNRF::RNG
         return ret;
     }
 
+    uint32_t getStreamSeed() {
+#if RNG_DETERMINISTIC_SEED
+        return RNG_DETERMINISTIC_SEED;
+#else
+        return randomUInt32();
+#endif
+    }
+
+    void RandomStream::seed(uint32_t value) {
+        // Spread the seed over the whole state (splitmix32), which can't end up all zeros
+        for (int i = 0; i < 4; ++i) {
+            value += 0x9E3779B9;
+            uint32_t z = value;
+            z = (z ^ (z >> 16)) * 0x85EBCA6B;
+            z = (z ^ (z >> 13)) * 0xC2B2AE35;
+            state[i] = z ^ (z >> 16);
+        }
+    }
 }
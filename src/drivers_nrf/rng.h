@@ -3,6 +3,12 @@
 #include <stdint.h>
 #include <stddef.h>
 
+// Set to a non zero value to start every random stream from that seed instead of the hardware RNG,
+// so that animations play exactly the same each time (i.e. to compare them against a host replay)
+#ifndef RNG_DETERMINISTIC_SEED
+#define RNG_DETERMINISTIC_SEED 0
+#endif
+
 namespace DriversNRF
 {
     /// <summary>
@@ -15,6 +21,45 @@ namespace DriversNRF
         uint8_t randomUInt8();
         uint16_t randomUInt16();
         uint32_t randomUInt32();
+
+        // Seed for a new random stream, see RNG_DETERMINISTIC_SEED
+        uint32_t getStreamSeed();
+
+        /// <summary>
+        /// Fast pseudo random number generator (xoshiro128**), for code that needs random numbers
+        /// every frame. The hardware RNG is slow and may not have enough entropy available,
+        /// so it is only used to seed the stream.
+        /// size: 16 bytes
+        /// </summary>
+        struct RandomStream
+        {
+            uint32_t state[4];
+
+            void seed(uint32_t value);
+
+            uint32_t next() {
+                uint32_t ret = rotateLeft(state[1] * 5, 7) * 9;
+                uint32_t t = state[1] << 9;
+                state[2] ^= state[0];
+                state[3] ^= state[1];
+                state[1] ^= state[2];
+                state[0] ^= state[3];
+                state[2] ^= t;
+                state[3] = rotateLeft(state[3], 11);
+                return ret;
+            }
+
+            // Random number in the [0, bound) range, 0 if bound is 0.
+            // Uses a multiplication rather than a (slow) modulo.
+            uint32_t nextBelow(uint32_t bound) {
+                return (uint32_t)(((uint64_t)next() * bound) >> 32);
+            }
+
+        private:
+            static uint32_t rotateLeft(uint32_t x, int k) {
+                return (x << k) | (x >> (32 - k));
+            }
+        };
     }
 }
 
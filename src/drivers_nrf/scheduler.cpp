@@ -27,4 +27,8 @@ namespace DriversNRF::Scheduler
         }
         return ret == NRF_SUCCESS;
     }
+
+    uint16_t getQueueSpace() {
+        return app_sched_queue_space_get();
+    }
 }
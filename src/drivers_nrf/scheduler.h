@@ -8,5 +8,7 @@ namespace DriversNRF
         void init();
         void update();
         bool push(const void* eventData, uint16_t size, app_sched_event_handler_t handler);
+        // Number of events that can still be pushed before the queue is full
+        uint16_t getQueueSpace();
     }
 }
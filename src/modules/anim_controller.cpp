@@ -1,9 +1,11 @@
 #include "anim_controller.h"
 #include "animations/animation.h"
 #include "drivers_nrf/timers.h"
+#include "drivers_nrf/cycle_counter.h"
 #include "drivers_nrf/power_manager.h"
 #include "drivers_nrf/flash.h"
 #include "utils/utils.h"
+#include "utils/color_kernels.h"
 #include "utils/rainbow.h"
 #include "config/settings.h"
 #include "data_set/data_set.h"
@@ -13,6 +15,7 @@
 #include "bluetooth/bluetooth_messages.h"
 #include "bluetooth/bluetooth_message_service.h"
 #include "leds.h"
+#include "led_power.h"
 #include "drivers_nrf/scheduler.h"
 #include "core/delegate_array.h"
 
@@ -22,7 +25,6 @@ using namespace Config;
 using namespace DriversNRF;
 using namespace Bluetooth;
 
-#define MAX_ANIMS 20
 #define FORCE_FADE_OUT_DURATION_MS 500
 
 namespace Modules::AnimController
@@ -43,23 +45,123 @@ namespace Modules::AnimController
     State currentState = State_Unknown;
 
     // Some local functions
-    void update(int ms);
+    int update(int ms);
+    uint32_t getOccludedAnims(int ms, uint32_t skippedAnims);
+    uint32_t getGovernorSkippedAnims();
+    bool isLowPriority(Animations::AnimationTag tag);
+    void updateGovernor(uint32_t frameCycles);
+    int playLoop(int ms);
+    void scheduleUpdate(int ms);
+    void cancelUpdate();
     uint32_t getColorForAnim(void* token, uint32_t colorIndex);
     void onProgrammingEvent(void* context, Flash::ProgrammingEventType evt);
     void printAnimControllerStateHandler(const Message *msg);
     void playLEDAnimHandler(const Message* msg);
     void stopLEDAnimHandler(const Message* msg);
     void stopAllLEDAnimsHandler(const Message* msg);
+    void requestAnimProfileHandler(const Message* msg);
 
-    // Update timer
+    // Update timer, only running while there are animations, and only firing when their output may change
     APP_TIMER_DEF(animControllerTimer);
-    // To be passed to the timer
-    static int animControllerTicks = 0;
+    static bool updateScheduled = false;
+    static int scheduledUpdateTime = 0;
+
+    // Fade of each animation for the frame being rendered
+    static uint16_t animFades[MAX_ANIMS];
+
+#if ANIM_OCCLUSION_CULLING
+    // Coverage of each animation for the frame being rendered, see getOccludedAnims()
+    static Animations::AnimationCoverage animCoverages[MAX_ANIMS];
+#endif
+
+    // Number of animation renders, and renders skipped because the animation was hidden by others
+    static uint32_t renderCount = 0;
+    static uint32_t occludedCount = 0;
+
+    // Number of timer wakeups, and how many of those found no animation to update
+    static uint32_t wakeupCount = 0;
+    static uint32_t idleWakeupCount = 0;
+
+    // Number of loops handed over to the LEDs, and time they played without the CPU, in ms
+    static uint32_t hardwareLoopCount = 0;
+    static uint32_t hardwareLoopMs = 0;
+
+#if ANIM_PROFILER
+    // Time spent updating, in cycles of the cycle counter, see MessageAnimProfile
+    struct ProfileStats
+    {
+        uint32_t count;
+        uint32_t minCycles;
+        uint32_t maxCycles;
+        uint64_t totalCycles;
+    };
+    static ProfileStats frameProfile;
+    static ProfileStats animProfiles[Animation_Count];
+    static uint32_t overrunCount = 0;
+
+    void addProfileSample(ProfileStats& stats, uint32_t cycles);
+    void resetProfile();
+#endif
+
+#if ANIM_FRAME_GOVERNOR
+    // How much the governor degrades the animations to keep frames within ANIM_FRAME_BUDGET_MS,
+    // each level also applies the previous ones
+    enum GovernorLevel : uint8_t
+    {
+        GovernorLevel_Normal = 0,
+        GovernorLevel_SlowLowPriority,  // Low priority animations only need updating every ANIM_GOVERNOR_SLOW_FRAME_DURATION_MS
+        GovernorLevel_SkipFadingOut,    // Animations fading out aren't rendered anymore
+    };
+    static GovernorLevel governorLevel = GovernorLevel_Normal;
+    static int governorRecoveryFrames = 0;
+
+    // Number of times the governor degraded the animations, and renders it skipped
+    static uint32_t governorDegradeCount = 0;
+    static uint32_t governorSkipCount = 0;
+#endif
+
     void animationControllerUpdate(void* param)
     {
-        animControllerTicks++;
-        int timeMs = animControllerTicks * ANIM_FRAME_DURATION_MS;
-        update(timeMs);
+        updateScheduled = false;
+        wakeupCount++;
+        if (animationCount == 0) {
+            idleWakeupCount++;
+        }
+
+        int ms = Timers::millis();
+        int nextUpdateTime = update(ms);
+        if (animationCount > 0 && currentState == State_On) {
+            // Never update faster than the frame rate
+            scheduleUpdate(MAX(nextUpdateTime, ms + ANIM_FRAME_DURATION_MS));
+        }
+    }
+
+    /// <summary>
+    /// Makes sure the animations get updated at the given time (or earlier)
+    /// </summary>
+    void scheduleUpdate(int ms)
+    {
+        if (updateScheduled && scheduledUpdateTime <= ms) {
+            // Already updating soon enough
+            return;
+        }
+        if (updateScheduled) {
+            Timers::stopTimer(animControllerTimer);
+        }
+        updateScheduled = true;
+        scheduledUpdateTime = ms;
+        Timers::startTimer(animControllerTimer, MAX(ms - Timers::millis(), 1));
+    }
+
+    /// <summary>
+    /// Stops updating animations until the next call to scheduleUpdate()
+    /// </summary>
+    void cancelUpdate()
+    {
+        if (updateScheduled) {
+            Timers::stopTimer(animControllerTimer);
+            updateScheduled = false;
+        }
     }
 
     /// <summary>
@@ -73,7 +175,14 @@ namespace Modules::AnimController
         MessageService::RegisterMessageHandler(Message::MessageType_PlayAnim, playLEDAnimHandler);
         MessageService::RegisterMessageHandler(Message::MessageType_StopAnim, stopLEDAnimHandler);
         MessageService::RegisterMessageHandler(Message::MessageType_StopAllAnims, stopAllLEDAnimsHandler);
-        Timers::createTimer(&animControllerTimer, APP_TIMER_MODE_REPEATED, animationControllerUpdate);
+#if ANIM_PROFILER || ANIM_FRAME_GOVERNOR
+        CycleCounter::init();
+#endif
+#if ANIM_PROFILER
+        resetProfile();
+        MessageService::RegisterMessageHandler(Message::MessageType_RequestAnimProfile, requestAnimProfileHandler);
+#endif
+        Timers::createTimer(&animControllerTimer, APP_TIMER_MODE_SINGLE_SHOT, animationControllerUpdate);
 
         NRF_LOG_DEBUG("Anim Controller init");
 
@@ -81,18 +190,189 @@ namespace Modules::AnimController
         start();
     }
 
-#pragma GCC diagnostic push "-Wstack-usage="
-#pragma GCC diagnostic ignored "-Wstack-usage="
+    /// <summary>
+    /// Finds the animations that can't change the frame because other animations light the same LEDs
+    /// at least as bright, so they don't need to be rendered.
+    /// </summary>
+    /// <param name="skippedAnims">Animations that won't be rendered anyway, so can't hide others</param>
+    /// <returns>A bit mask of the animation indices</returns>
+    uint32_t getOccludedAnims(int ms, uint32_t skippedAnims)
+    {
+        uint32_t occludedAnims = 0;
+#if ANIM_OCCLUSION_CULLING
+        if (animationCount < 2) {
+            // Nothing to be hidden behind
+            return 0;
+        }
+
+        uint32_t coveredAnims = 0;
+        for (int i = 0; i < animationCount; ++i) {
+            if ((skippedAnims & (1 << i)) == 0 && animations[i]->getCoverage(ms, animFades[i], animCoverages[i])) {
+                coveredAnims |= 1 << i;
+            }
+        }
+
+        // Only animations that still get rendered can hide another one. Since rendered
+        // colors are max-blended, two identical animations won't hide each other.
+        for (int i = 0; i < animationCount; ++i) {
+            if ((coveredAnims & (1 << i)) != 0) {
+                auto& coverage = animCoverages[i];
+                uint32_t hiddenMask = 0;
+                for (int j = 0; j < animationCount; ++j) {
+                    if (j != i && (coveredAnims & (1 << j)) != 0 && (occludedAnims & (1 << j)) == 0) {
+                        auto& otherCoverage = animCoverages[j];
+                        if (Utils::ColorKernels::blendMax(otherCoverage.minColor, coverage.maxColor) == otherCoverage.minColor) {
+                            hiddenMask |= otherCoverage.opaqueMask;
+                        }
+                    }
+                }
+                if ((coverage.ledMask & ~hiddenMask) == 0) {
+                    occludedAnims |= 1 << i;
+                }
+            }
+        }
+#endif
+        return occludedAnims;
+    }
+
+    /// <summary>
+    /// Finds the animations the governor drops from the frame to keep up, see GovernorLevel
+    /// </summary>
+    /// <returns>A bit mask of the animation indices</returns>
+    uint32_t getGovernorSkippedAnims()
+    {
+        uint32_t skippedAnims = 0;
+#if ANIM_FRAME_GOVERNOR
+        if (governorLevel >= GovernorLevel_SkipFadingOut) {
+            for (int i = 0; i < animationCount; ++i) {
+                if (animations[i]->forceFadeTime != -1) {
+                    skippedAnims |= 1 << i;
+                }
+            }
+        }
+#endif
+        return skippedAnims;
+    }
+
+    /// <summary>
+    /// Whether animations from that source may be slowed down first when frames take too long
+    /// </summary>
+    bool isLowPriority(Animations::AnimationTag tag)
+    {
+        switch (tag) {
+            case AnimationTag_Status:
+            case AnimationTag_BluetoothNotification:
+            case AnimationTag_BatteryNotification:
+                // Feedback the user is waiting for
+                return false;
+            default:
+                return true;
+        }
+    }
+
+    /// <summary>
+    /// Degrades the animations by one level when a frame goes over budget,
+    /// and restores them one level at a time once frames are well within it
+    /// </summary>
+    /// <param name="frameCycles">How long the last frame took to update, in cycles of the cycle counter</param>
+    void updateGovernor(uint32_t frameCycles)
+    {
+#if ANIM_FRAME_GOVERNOR
+        uint32_t budgetCycles = ANIM_FRAME_BUDGET_MS * CycleCounter::getCyclesPerMs();
+        if (frameCycles > budgetCycles) {
+            governorRecoveryFrames = 0;
+            if (governorLevel < GovernorLevel_SkipFadingOut) {
+                governorLevel = (GovernorLevel)(governorLevel + 1);
+                governorDegradeCount++;
+                NRF_LOG_WARNING("Anim frame took %d us, degrading to level %d", frameCycles / (CycleCounter::getCyclesPerMs() / 1000), governorLevel);
+            }
+        } else if (governorLevel > GovernorLevel_Normal && frameCycles < budgetCycles / 2) {
+            governorRecoveryFrames++;
+            if (governorRecoveryFrames >= ANIM_GOVERNOR_RECOVERY_FRAMES) {
+                governorRecoveryFrames = 0;
+                governorLevel = (GovernorLevel)(governorLevel - 1);
+                NRF_LOG_INFO("Anim frames back within budget, restoring to level %d", governorLevel);
+            }
+        }
+#endif
+    }
+
+#if ANIM_PROFILER || ANIM_FRAME_GOVERNOR
+    /// <summary>
+    /// Accounts for a frame that was just handed over to the LEDs, for the profiler and the governor
+    /// </summary>
+    /// <param name="frameStartCycles">Cycle counter value at the start of the update</param>
+    void recordFrame(uint32_t frameStartCycles)
+    {
+        uint32_t frameCycles = CycleCounter::read() - frameStartCycles;
+#if ANIM_FRAME_GOVERNOR
+        updateGovernor(frameCycles);
+#endif
+#if ANIM_PROFILER
+        addProfileSample(frameProfile, frameCycles);
+        if (frameCycles > ANIM_FRAME_DURATION_MS * CycleCounter::getCyclesPerMs()) {
+            overrunCount++;
+        }
+#endif
+    }
+#endif
+
+    /// <summary>
+    /// Hands a lone animation blinking between two frames over to the LEDs, so that they play
+    /// it on their own instead of the controller waking up for each change.
+    /// </summary>
+    /// <returns>The time at which the LEDs are done playing, or 0 if the animation must be updated frame by frame</returns>
+    int playLoop(int ms)
+    {
+#if ANIM_HARDWARE_LOOPS
+        AnimationLoop loop;
+        if (animationCount != 1 || animations[0]->forceFadeTime != -1 || !animations[0]->getLoop(ms, loop)) {
+            return 0;
+        }
+
+        // Too big for the stack
+        static uint32_t loopFrames[2][MAX_LED_COUNT];
+        auto l = SettingsManager::getLayout();
+        for (int f = 0; f < 2; ++f) {
+            memset(loopFrames[f], 0, sizeof(uint32_t) * l->ledCount);
+#if ANIM_PROFILER
+            uint32_t renderStartCycles = CycleCounter::read();
+            animations[0]->render(loop.frameTimes[f], 1000, loopFrames[f]);
+            addProfileSample(animProfiles[animations[0]->animationPreset->type], CycleCounter::read() - renderStartCycles);
+#else
+            animations[0]->render(loop.frameTimes[f], 1000, loopFrames[f]);
+#endif
+            Utils::ColorKernels::applyBrightness(loopFrames[f], l->ledCount, DataSet::getBrightness());
+        }
+        if (!LEDs::playLoop(loopFrames[0], loop.frameDurations[0], loopFrames[1], loop.frameDurations[1], loop.count)) {
+            return 0;
+        }
+
+        int loopDuration = loop.count * (loop.frameDurations[0] + loop.frameDurations[1]);
+        renderCount += 2;
+        hardwareLoopCount++;
+        hardwareLoopMs += loopDuration;
+        return ms + loopDuration;
+#else
+        return 0;
+#endif
+    }
 
     /// <summary>
     /// Update all currently running animations, and performing housekeeping when necessary
     /// </summary>
     /// <param name="ms">Current global time in milliseconds</param>
-    void update(int ms)
+    /// <returns>The time at which the animations need to be updated next</returns>
+    int update(int ms)
     {
         auto l = SettingsManager::getLayout();
+        int nextUpdateTime = ANIM_TIME_NEVER;
 
         if (animationCount > 0) {
+#if ANIM_PROFILER || ANIM_FRAME_GOVERNOR
+            uint32_t frameStartCycles = CycleCounter::read();
+#endif
+
             // Notify clients for feeding or not feeding PowerManager
             Scheduler::push(nullptr, 0, [](void *p_event_data, uint16_t event_size) {
                 for (int i = 0; i < clients.Count(); ++i) {
@@ -100,7 +380,7 @@ namespace Modules::AnimController
                 }
             });
 
-            // Current animations will write their color into this array
+            // Current animations will blend their color into this array
             uint32_t allDaisyChainColors[MAX_LED_COUNT];
             memset(allDaisyChainColors, 0, sizeof(uint32_t) * l->ledCount);
 
@@ -140,35 +420,66 @@ namespace Modules::AnimController
                 }
                 else
                 {
-                    // Collect color values from the animations
-                    uint32_t daisyChainColors[MAX_LED_COUNT];
-                    memset(daisyChainColors, 0, sizeof(uint32_t) * l->ledCount);
-                    anim->updateDaisyChainLEDs(ms, daisyChainColors);
-
-                    // Blend with any other color already written to the led (and fade if necessary)
-                    for (int j = 0; j < l->ledCount; ++j) {
-                        auto color = daisyChainColors[j];
-                        if (fade) {
-                            color = Utils::scaleColor(color, fadePercentTimes1000);
-                        }
-                        allDaisyChainColors[j] = Utils::addColors(allDaisyChainColors[j], color);
+                    animFades[i] = (uint16_t)fadePercentTimes1000;
+
+                    // Fading out changes the colors every frame, otherwise ask the animation,
+                    // making sure to come back to loop or remove it once it's over
+                    int animUpdateTime = fade ? ms + ANIM_FRAME_DURATION_MS : MIN(anim->nextChangeTime(ms), endTime + 1);
+#if ANIM_FRAME_GOVERNOR
+                    if (governorLevel >= GovernorLevel_SlowLowPriority && isLowPriority(anim->tag)) {
+                        // Overloaded, let the other animations set the frame rate
+                        int slowUpdateTime = ms + ANIM_GOVERNOR_SLOW_FRAME_DURATION_MS;
+                        animUpdateTime = MAX(animUpdateTime, slowUpdateTime);
                     }
+#endif
+                    nextUpdateTime = MIN(nextUpdateTime, animUpdateTime);
                 }
             }
-            
-            // Apply global brightness (do it here, i.e. once per update)
-            uint8_t brightness = DataSet::getBrightness();
-            for (int j = 0; j < l->ledCount; ++j) {
-                allDaisyChainColors[j] = Utils::modulateColor(allDaisyChainColors[j], brightness);
+
+            int loopEndTime = playLoop(ms);
+            if (loopEndTime != 0) {
+                // Nothing to do until the LEDs are done
+#if ANIM_PROFILER || ANIM_FRAME_GOVERNOR
+                recordFrame(frameStartCycles);
+#endif
+                return loopEndTime;
             }
 
+            uint32_t skippedAnims = getGovernorSkippedAnims();
+            uint32_t occludedAnims = getOccludedAnims(ms, skippedAnims);
+            for (int i = 0; i < animationCount; ++i) {
+                if ((skippedAnims & (1 << i)) != 0) {
+#if ANIM_FRAME_GOVERNOR
+                    governorSkipCount++;
+#endif
+                } else if ((occludedAnims & (1 << i)) == 0) {
+                    // Blend the animation with any other color already written to the leds (and fade if necessary)
+#if ANIM_PROFILER
+                    uint32_t renderStartCycles = CycleCounter::read();
+                    animations[i]->render(ms, animFades[i], allDaisyChainColors);
+                    addProfileSample(animProfiles[animations[i]->animationPreset->type], CycleCounter::read() - renderStartCycles);
+#else
+                    animations[i]->render(ms, animFades[i], allDaisyChainColors);
+#endif
+                    renderCount++;
+                } else {
+                    occludedCount++;
+                }
+            }
+
+            // Apply global brightness (do it here, i.e. once per LED rather than once per blended color)
+            Utils::ColorKernels::applyBrightness(allDaisyChainColors, l->ledCount, DataSet::getBrightness());
+
             // Send the colors over!
             LEDs::setPixelColors(allDaisyChainColors);
+
+#if ANIM_PROFILER || ANIM_FRAME_GOVERNOR
+            recordFrame(frameStartCycles);
+#endif
         }
+        return nextUpdateTime;
     }
 
-#pragma GCC diagnostic pop "-Wstack-usage="
-
     /// <summary>
     /// Stop updating animations
     /// </summary>
@@ -176,7 +487,7 @@ namespace Modules::AnimController
     {
         switch (currentState) {
             case State_On:
-                Timers::stopTimer(animControllerTimer);
+                cancelUpdate();
                 // Clear all data
                 stopAll();
                 NRF_LOG_DEBUG("Stopped anim controller");
@@ -193,8 +504,10 @@ namespace Modules::AnimController
         switch (currentState) {
             case State_Off:
                 NRF_LOG_DEBUG("Starting anim controller");
-                Timers::startTimer(animControllerTimer, ANIM_FRAME_DURATION_MS);
                 currentState = State_On;
+                if (animationCount > 0) {
+                    scheduleUpdate(Timers::millis() + ANIM_FRAME_DURATION_MS);
+                }
                 break;
             default:
                 NRF_LOG_WARNING("Anim Controller in invalid state to start");
@@ -215,7 +528,7 @@ namespace Modules::AnimController
             }
         }
 
-        int ms = animControllerTicks * ANIM_FRAME_DURATION_MS;
+        int ms = Timers::millis();
         if (prevAnimIndex < animationCount)
         {
             // Fade out the previous animation pretty quickly
@@ -231,6 +544,13 @@ namespace Modules::AnimController
                 animations[animationCount]->setTag(tag);
                 animations[animationCount]->start(ms, remapFace, loopCount);
                 animationCount++;
+
+                // Render the first frame right away, or as soon as the LEDs are powered up
+                if (currentState == State_On) {
+                    bool powered = LEDPower::isPowerOn();
+                    LEDPower::prePower();
+                    scheduleUpdate(ms + (powered ? 0 : LED_POWER_UP_DELAY_MS));
+                }
             }
         }
         // Else there is no more room
@@ -257,6 +577,13 @@ namespace Modules::AnimController
 
             // Delete the instance
             Animations::destroyAnimationInstance(prevAnimInstance);
+
+            if (animationCount == 0) {
+                cancelUpdate();
+            } else if (currentState == State_On) {
+                // Redraw without the stopped animation
+                scheduleUpdate(Timers::millis() + ANIM_FRAME_DURATION_MS);
+            }
         }
         // Else the animation isn't playing
     }
@@ -264,7 +591,8 @@ namespace Modules::AnimController
     void fadeOutAnimsWithTag(Animations::AnimationTag tagToStop, int fadeOutTimeMs) {
 
         // Is there already an animation for this?
-        int ms = animControllerTicks * ANIM_FRAME_DURATION_MS;
+        int ms = Timers::millis();
+        bool fading = false;
         for (int prevAnimIndex = 0; prevAnimIndex < animationCount; ++prevAnimIndex)
         {
             auto prevAnim = animations[prevAnimIndex];
@@ -272,8 +600,14 @@ namespace Modules::AnimController
             {
                 // Fade out the previous animation pretty quickly
                 prevAnim->forceFadeOut(ms + fadeOutTimeMs);
+                fading = true;
             }
         }
+
+        // The fade needs to be rendered every frame
+        if (fading && currentState == State_On) {
+            scheduleUpdate(ms + ANIM_FRAME_DURATION_MS);
+        }
     }
 
     /// <summary>
@@ -287,9 +621,27 @@ namespace Modules::AnimController
             Animations::destroyAnimationInstance(animations[i]);
         }
         animationCount = 0;
+        cancelUpdate();
         LEDs::clear();
     }
 
+    void getUpdateStats(UpdateStats& outStats)
+    {
+        outStats.wakeupCount = wakeupCount;
+        outStats.idleWakeupCount = idleWakeupCount;
+        outStats.renderCount = renderCount;
+        outStats.occludedCount = occludedCount;
+        outStats.hardwareLoopCount = hardwareLoopCount;
+        outStats.hardwareLoopMs = hardwareLoopMs;
+#if ANIM_FRAME_GOVERNOR
+        outStats.governorDegradeCount = governorDegradeCount;
+        outStats.governorSkipCount = governorSkipCount;
+#else
+        outStats.governorDegradeCount = 0;
+        outStats.governorSkipCount = 0;
+#endif
+    }
+
     /// <summary>
     /// Helper function to clear anim LED turned on by a current animation
     /// </summary>
@@ -327,6 +679,30 @@ namespace Modules::AnimController
             NRF_LOG_DEBUG("Anim %d is of type %d, duration %d", i, anim->animationPreset->type, anim->animationPreset->duration);
             NRF_LOG_DEBUG("StartTime %d, remapFace %d, loopCount %d", anim->startTime, anim->remapFace, anim->loopCount);
         }
+        InstancePoolStats poolStats[2];
+        getInstancePoolStats(poolStats[0], poolStats[1]);
+        for (int i = 0; i < 2; ++i) {
+            NRF_LOG_DEBUG("Instance pool %d: %d/%d slots of %d bytes in use, peak %d", i, poolStats[i].inUseCount, poolStats[i].slotCount, poolStats[i].slotSize, poolStats[i].peakInUseCount);
+            NRF_LOG_DEBUG("Instance pool %d: %d allocs, %d failures", i, poolStats[i].allocCount, poolStats[i].failureCount);
+        }
+        LEDs::ShowStats showStats;
+        LEDs::getShowStats(showStats);
+        NRF_LOG_DEBUG("Wakeups: %d, %d with no animation", wakeupCount, idleWakeupCount);
+        NRF_LOG_DEBUG("Renders: %d, %d skipped because hidden", renderCount, occludedCount);
+        NRF_LOG_DEBUG("Loops played by the LEDs: %d, for %d ms", hardwareLoopCount, hardwareLoopMs);
+        NRF_LOG_DEBUG("LEDs: %d frames, %d skipped, %d partially encoded", showStats.frameCount, showStats.skippedCount, showStats.partialCount);
+        NRF_LOG_DEBUG("LEDs: %d frames sent out, %d replaced before being sent", showStats.playedCount, showStats.replacedCount);
+        NRF_LOG_DEBUG("LEDs: %d frames dimmed to the current budget, last one at %d/1000", showStats.limitedCount, showStats.limitTimes1000);
+        LEDPower::PowerStats powerStats;
+        LEDPower::getPowerStats(powerStats);
+        NRF_LOG_DEBUG("LED power: on %d times (%d ahead of a frame), off %d times", powerStats.onCount, powerStats.prePowerCount, powerStats.offCount);
+        NRF_LOG_DEBUG("LED power: frames waited for %d power ups, a total of %d ms", powerStats.delayedPowerUpCount, powerStats.delayMs);
+#if ANIM_FRAME_GOVERNOR
+        NRF_LOG_DEBUG("Governor: level %d, degraded %d times, %d renders skipped", governorLevel, governorDegradeCount, governorSkipCount);
+#endif
+#if ANIM_PROFILER
+        NRF_LOG_DEBUG("Profile: %d frames, %d to %d cycles, %d overruns", frameProfile.count, frameProfile.minCycles, frameProfile.maxCycles, overrunCount);
+#endif
     }
 
     void playLEDAnimHandler(const Message* msg) {
@@ -354,6 +730,59 @@ namespace Modules::AnimController
         stopAll();
     }
 
+#if ANIM_PROFILER
+    void addProfileSample(ProfileStats& stats, uint32_t cycles) {
+        stats.count++;
+        stats.minCycles = MIN(stats.minCycles, cycles);
+        stats.maxCycles = MAX(stats.maxCycles, cycles);
+        stats.totalCycles += cycles;
+    }
+
+    void resetProfile() {
+        frameProfile = { 0, UINT32_MAX, 0, 0 };
+        for (int i = 0; i < Animation_Count; ++i) {
+            animProfiles[i] = { 0, UINT32_MAX, 0, 0 };
+        }
+        overrunCount = 0;
+    }
+
+    uint16_t saturate16(uint64_t value) {
+        return value > 0xFFFF ? 0xFFFF : (uint16_t)value;
+    }
+
+    /// <summary>
+    /// Converts the stats to microseconds for the app
+    /// </summary>
+    void getProfileStats(const ProfileStats& stats, AnimProfileStats& outStats) {
+        uint32_t cyclesPerMs = CycleCounter::getCyclesPerMs();
+        outStats.count = saturate16(stats.count);
+        if (stats.count == 0) {
+            outStats.minUs = 0;
+            outStats.avgUs = 0;
+            outStats.maxUs = 0;
+        } else {
+            outStats.minUs = saturate16((uint64_t)stats.minCycles * 1000 / cyclesPerMs);
+            outStats.avgUs = saturate16(stats.totalCycles * 1000 / stats.count / cyclesPerMs);
+            outStats.maxUs = saturate16((uint64_t)stats.maxCycles * 1000 / cyclesPerMs);
+        }
+    }
+
+    void requestAnimProfileHandler(const Message* msg) {
+        auto request = (const MessageRequestAnimProfile*)msg;
+        MessageAnimProfile profile;
+        profile.overrunCount = saturate16(overrunCount);
+        getProfileStats(frameProfile, profile.frames);
+        for (int i = 0; i < Animation_Count; ++i) {
+            getProfileStats(animProfiles[i], profile.anims[i]);
+        }
+        MessageService::SendMessage(&profile);
+
+        if (request->reset) {
+            resetProfile();
+        }
+    }
+#endif
+
     /// <summary>
     /// Method used by clients to request timer callbacks
     /// </summary>
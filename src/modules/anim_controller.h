@@ -6,6 +6,54 @@
 // Frame duration = time between each animation update, in ms.
 #define ANIM_FRAME_DURATION_MS 33
 
+// Maximum number of animations playing at the same time
+#define MAX_ANIMS 20
+
+// Set to 0 to always render all the animations, even the ones hidden by brighter animations
+#ifndef ANIM_OCCLUSION_CULLING
+#define ANIM_OCCLUSION_CULLING 1
+#endif
+
+// Set to 0 to always update blinking animations frame by frame, instead of letting the LEDs play them on their own
+#ifndef ANIM_HARDWARE_LOOPS
+#define ANIM_HARDWARE_LOOPS 1
+#endif
+
+// Set to 1 to measure the time spent updating each frame and rendering each type of animation,
+// see MessageAnimProfile. On by default in debug builds.
+#ifndef ANIM_PROFILER
+#if defined(DEBUG)
+#define ANIM_PROFILER 1
+#else
+#define ANIM_PROFILER 0
+#endif
+#endif
+
+// Set to 1 to slow down or skip low priority animations when frames take too long to compute, instead of
+// always updating every animation at the full frame rate. On by default in debug builds, like the profiler,
+// since it times frames with the DWT cycle counter, which stays off in release builds.
+#ifndef ANIM_FRAME_GOVERNOR
+#if defined(DEBUG)
+#define ANIM_FRAME_GOVERNOR 1
+#else
+#define ANIM_FRAME_GOVERNOR 0
+#endif
+#endif
+
+// Time a frame may take to update before the governor degrades the animations, in ms
+#ifndef ANIM_FRAME_BUDGET_MS
+#define ANIM_FRAME_BUDGET_MS 20
+#endif
+
+// Number of frames taking less than half the budget before the governor restores one level
+#define ANIM_GOVERNOR_RECOVERY_FRAMES 30
+
+// Frame duration of low priority animations while the governor slows them down, in ms
+#define ANIM_GOVERNOR_SLOW_FRAME_DURATION_MS (ANIM_FRAME_DURATION_MS * 3)
+
+// Maximum number of animations with per-LED state (i.e. noise, normals, baked) playing at the same time
+#define MAX_LARGE_ANIMS 4
+
 namespace Animations
 {
     struct Animation;
@@ -29,6 +77,19 @@ namespace Modules::AnimController
     void fadeOutAnimsWithTag(Animations::AnimationTag tagToStop, int fadeOutTimeMs);
     void stopAll();
 
+    struct UpdateStats
+    {
+        uint32_t wakeupCount;       // Number of timer wakeups
+        uint32_t idleWakeupCount;   // Wakeups that found no animation to update
+        uint32_t renderCount;       // Number of animation renders
+        uint32_t occludedCount;     // Renders skipped because the animation was hidden by brighter ones
+        uint32_t hardwareLoopCount; // Number of loops handed over to the LEDs
+        uint32_t hardwareLoopMs;    // Time the LEDs played loops without the CPU, in ms
+        uint32_t governorDegradeCount;  // Number of times the frame governor degraded the animations
+        uint32_t governorSkipCount;     // Renders the frame governor skipped
+    };
+    void getUpdateStats(UpdateStats& outStats);
+
     // Notification management
     typedef void(*AnimControllerClientMethod)(void* param);
     void hook(AnimControllerClientMethod method, void* param);
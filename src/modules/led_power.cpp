@@ -0,0 +1,167 @@
+#include "led_power.h"
+#include "nrf_gpio.h"
+#include "core/delegate_array.h"
+#include "drivers_nrf/log.h"
+#include "battery_controller.h"
+#include "string.h" // for memset
+
+using namespace DriversNRF;
+
+#define MAX_POWER_CLIENTS 2
+
+namespace Modules::LEDPower
+{
+    static DelegateArray<PowerClientMethod, MAX_POWER_CLIENTS> powerClients;
+    static uint8_t powerPin;
+    static bool railOn = false;
+    static bool powerOffScheduled = false;
+    static int powerOnTime = 0;     // When the rail was last turned on, in ms
+    static PowerStats powerStats;
+
+    // Only the latest frame waits for the LEDs to power up, with a single delayed call per power up
+    static bool powerUpPending = false;
+    static Timers::DelayedCallback powerUpCallback = nullptr;
+    static void* powerUpParameter = nullptr;
+
+    void setPowerOn();
+    void cancelPowerOff();
+    void powerOffCallback(void* ignore);
+    void poweredUpCallback(void* ignore);
+
+    void init(uint8_t pin) {
+        powerPin = pin;
+
+        // Nothing to validate
+        nrf_gpio_cfg_output(powerPin);
+        nrf_gpio_pin_clear(powerPin);
+        railOn = false;
+        powerOffScheduled = false;
+        powerUpPending = false;
+        memset(&powerStats, 0, sizeof(PowerStats));
+    }
+
+    void powerOn(Timers::DelayedCallback callback, void* parameter) {
+        cancelPowerOff();
+        if (!railOn) {
+            setPowerOn();
+        }
+
+        // Give enough time for the LEDs to power up
+        int delay = powerOnTime + LED_POWER_UP_DELAY_MS - Timers::millis();
+        if (delay <= 0) {
+            // Power already stable, just proceed, an older frame still waiting is out of date
+            if (powerUpPending) {
+                Timers::cancelDelayedCallback(poweredUpCallback, nullptr);
+                powerUpPending = false;
+            }
+            callback(parameter);
+        } else {
+            // Replace the frame waiting for the power up, if any
+            powerUpCallback = callback;
+            powerUpParameter = parameter;
+            if (!powerUpPending) {
+                powerUpPending = Timers::setDelayedCallback(poweredUpCallback, nullptr, delay);
+                if (powerUpPending) {
+                    powerStats.delayedPowerUpCount++;
+                    powerStats.delayMs += delay;
+                }
+            }
+        }
+    }
+
+    void poweredUpCallback(void* ignore) {
+        powerUpPending = false;
+        powerUpCallback(powerUpParameter);
+    }
+
+    void prePower() {
+        if (railOn) {
+            // Already on, don't let a pending power off happen right before the frame
+            if (powerOffScheduled) {
+                cancelPowerOff();
+                releasePower();
+            }
+        } else if (BatteryController::getState() != BatteryController::State_Empty) {
+            powerStats.prePowerCount++;
+            setPowerOn();
+
+            // Don't stay on if the frame never comes
+            releasePower();
+        }
+    }
+
+    void releasePower() {
+        if (railOn && !powerOffScheduled) {
+            powerOffScheduled = Timers::setDelayedCallback(powerOffCallback, nullptr, LED_POWER_OFF_DELAY_MS);
+            if (!powerOffScheduled) {
+                // No room to delay it
+                powerOff();
+            }
+        }
+    }
+
+    void powerOff() {
+        cancelPowerOff();
+
+        // Already off?
+        if (!railOn)
+            return;
+
+        // Turn power off
+        NRF_LOG_DEBUG("LED Power Off");
+        nrf_gpio_pin_clear(powerPin);
+        railOn = false;
+        powerStats.offCount++;
+
+        // Notify clients we're turning led power off
+        for (int i = 0; i < powerClients.Count(); ++i) {
+            powerClients[i].handler(powerClients[i].token, false);
+        }
+    }
+
+    bool isPowerOn() {
+        return railOn;
+    }
+
+    void getPowerStats(PowerStats& outStats) {
+        outStats = powerStats;
+    }
+
+    void setPowerOn() {
+        // Notify clients we're turning led power on
+        for (int i = 0; i < powerClients.Count(); ++i) {
+            powerClients[i].handler(powerClients[i].token, true);
+        }
+
+        // Turn the power on
+        NRF_LOG_DEBUG("LED Power On");
+        nrf_gpio_pin_set(powerPin);
+        railOn = true;
+        powerOnTime = Timers::millis();
+        powerStats.onCount++;
+    }
+
+    void cancelPowerOff() {
+        if (powerOffScheduled) {
+            Timers::cancelDelayedCallback(powerOffCallback, nullptr);
+            powerOffScheduled = false;
+        }
+    }
+
+    void powerOffCallback(void* ignore) {
+        powerOffScheduled = false;
+        powerOff();
+    }
+
+    void hookPowerState(PowerClientMethod method, void* param) {
+        powerClients.Register(param, method);
+    }
+
+    void unHookPowerState(PowerClientMethod method) {
+        powerClients.UnregisterWithHandler(method);
+    }
+
+    void unHookPowerStateWithParam(void* param) {
+        powerClients.UnregisterWithToken(param);
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include "drivers_nrf/timers.h"
+
+// Time the LEDs need after their power rail is turned on before they accept data, in ms
+#define LED_POWER_UP_DELAY_MS 5
+
+// How long the rail stays on after the last lit frame, in ms. Keeps animations that blink
+// or fade through black from toggling the rail, at the cost of the LEDs' idle current.
+#ifndef LED_POWER_OFF_DELAY_MS
+#define LED_POWER_OFF_DELAY_MS 250
+#endif
+
+/// <summary>
+/// Controls the LED power rail, turning it on when there is something to display
+/// and off a little while after there isn't anymore.
+/// </summary>
+namespace Modules::LEDPower
+{
+    void init(uint8_t powerPin);
+
+    // Turns the rail on if needed, and calls back once the LEDs can be sent data.
+    // While the LEDs power up, only the last callback requested is called.
+    void powerOn(DriversNRF::Timers::DelayedCallback callback, void* parameter);
+
+    // Turns the rail on ahead of a frame that is about to be shown (i.e. an animation starting),
+    // so that the frame doesn't have to wait for the LEDs to power up.
+    void prePower();
+
+    // Turns the rail off after LED_POWER_OFF_DELAY_MS, unless power is requested again in between
+    void releasePower();
+
+    // Turns the rail off right away
+    void powerOff();
+
+    bool isPowerOn();
+
+    struct PowerStats
+    {
+        uint32_t onCount;           // Number of times the rail was turned on
+        uint32_t offCount;          // Number of times the rail was turned off
+        uint32_t prePowerCount;     // Rail turn ons that came from prePower()
+        uint32_t delayedPowerUpCount;   // Power ups that a frame had to wait for
+        uint32_t delayMs;               // Total time frames waited for the LEDs to power up
+    };
+    void getPowerStats(PowerStats& outStats);
+
+    typedef void(*PowerClientMethod)(void* param, bool powerOn);
+    void hookPowerState(PowerClientMethod method, void* param);
+    void unHookPowerState(PowerClientMethod client);
+    void unHookPowerStateWithParam(void* param);
+}
@@ -3,41 +3,64 @@
 #include "nrf_delay.h"
 #include "config/board_config.h"
 #include "config/settings.h"
-#include "core/delegate_array.h"
 #include "drivers_hw/neopixel.h"
 #include "drivers_hw/battery.h"
 #include "drivers_nrf/log.h"
 #include "drivers_nrf/timers.h"
 #include "drivers_nrf/scheduler.h"
 #include "drivers_nrf/gpiote.h"
+#include "bluetooth/bluetooth_messages.h"
+#include "bluetooth/bluetooth_message_service.h"
 #include "battery_controller.h"
+#include "temperature.h"
+#include "led_power.h"
 #include "utils/Utils.h"
+#include "utils/color_kernels.h"
 #include "string.h" // for memset
 
 using namespace Config;
 using namespace DriversHW;
 using namespace DriversNRF;
+using namespace Bluetooth;
 
 
 #define OFFSET_RED 2
 #define OFFSET_GREEN 1
 #define OFFSET_BLUE 0
 
-#define MAX_APA102_CLIENTS 2
-#define LOW_BATT_LED_INTENSITY_DIVISOR 32
+// Current drawn by each LED that is on, and by the LED drivers as soon as one LED is on, in nA
+#define LED_ON_NANO_AMPS (247000 * 3)
+#define LED_DRIVER_NANO_AMPS 7100000
+
+// Current drawn for each unit of each color channel, in nA
+#define LED_CHANNEL_NANO_AMPS 18200
 
 namespace Modules::LEDs
 {
-    static DelegateArray<LEDClientMethod, MAX_APA102_CLIENTS> ledPowerClients;
-    static uint8_t powerPin;
     static uint8_t numLed = 0;
-    static bool powerOn = false;
     static uint32_t pixels[MAX_LED_COUNT];
+    static uint32_t changedMask = 0;    // LEDs whose color changed since it was last sent out
+    static ShowStats showStats;
+
+    // Current limiter state, the pixels are dimmed into limitedPixels when over budget
+    static uint32_t currentBudget = LED_CURRENT_BUDGET_MA;  // Budget when the battery is fine, in mA
+    static uint32_t limitedPixels[MAX_LED_COUNT];
+    static uint32_t limitTimes1000 = 1000;  // Brightness of the last frame sent out
+    static int limitTime = 0;               // When the brightness was last updated, in ms
+    static int limitHoldTime = 0;           // When a frame last needed the current brightness or less, in ms
+    static bool limitReleasing = false;     // Whether the brightness is still coming back up
+    static bool limitReleaseScheduled = false;
+
+    // Loop waiting for the LEDs to power up, the second frame is the shown pixels
+    static uint32_t loopPixels[MAX_LED_COUNT];
+    static int loopDurations[2];
+    static int loopCount = 0;
+    static bool loopStartPending = false;
 
     void show();
-
-    void setPowerOn(Timers::DelayedCallback callback, void* parameter);
-    void setPowerOff();
+    void sendFrame();
+    void startLoopCallback(void* ignore);
+    void setCurrentBudgetHandler(const Message* msg);
 
     typedef void (*TestLEDCallback)(bool success);
     void testLEDReturn(TestLEDCallback callback);
@@ -49,12 +72,7 @@ namespace Modules::LEDs
         NeoPixel::init();
 
         // Initialize Power pin
-        powerPin = board->ledPowerPin;
-
-        // Nothing to validate
-        nrf_gpio_cfg_output(powerPin);
-        nrf_gpio_pin_clear(powerPin);
-        powerOn = false;
+        LEDPower::init(board->ledPowerPin);
 
         // Initialize out LED return pin
         nrf_gpio_cfg_default(board->ledReturnPin);
@@ -62,13 +80,19 @@ namespace Modules::LEDs
         // Initialize our color array
         memset(pixels, 0, MAX_LED_COUNT * sizeof(uint32_t));
         numLed = board->ledCount;
+        changedMask = 0;
+        memset(&showStats, 0, sizeof(ShowStats));
+        limitTimes1000 = 1000;
+        limitReleasing = false;
+
+        MessageService::RegisterMessageHandler(Message::MessageType_SetLEDCurrentBudget, setCurrentBudgetHandler);
 
         if (BatteryController::getState() != BatteryController::State_Empty &&
             BatteryController::getState() != BatteryController::State_Low &&
             BatteryController::getState() != BatteryController::State_ChargingLow) {
             testLEDReturn([](bool success) {
                 if (success) {
-                    NRF_LOG_DEBUG("LEDs init, powerPin=%d", (int)powerPin);
+                    NRF_LOG_DEBUG("LEDs init, powerPin=%d", (int)BoardManager::getBoard()->ledPowerPin);
                 } else {
                     NRF_LOG_ERROR("LED Return not detected");
                 }
@@ -86,7 +110,7 @@ namespace Modules::LEDs
         _callback = callback;
         
         // test LED return
-        setPowerOn([](void* ignore) {
+        LEDPower::powerOn([](void* ignore) {
 
             // Now that supposedly LEDs are powered on, set interrupt pin
             // to detect the output of the last LED toggling
@@ -112,7 +136,7 @@ namespace Modules::LEDs
                 nrf_gpio_cfg_default(BoardManager::getBoard()->ledReturnPin);
 
                 // Turn off LED power
-                setPowerOff();
+                LEDPower::powerOff();
 
                 // Trigger callback with the result
                 _callback(ledReturnDetected);
@@ -123,21 +147,30 @@ namespace Modules::LEDs
         }, nullptr);
     }
 
+    /// <summary>
+    /// Updates a pixel, keeping track of whether it actually changed
+    /// </summary>
+    void setPixel(int n, uint32_t c) {
+        if (pixels[n] != c) {
+            pixels[n] = c;
+            changedMask |= 1 << n;
+        }
+    }
+
     void clear() {
-        memset(pixels, 0, MAX_LED_COUNT * sizeof(uint32_t));
-        show();
+        setAll(0);
     }
 
     void setPixelColor(uint16_t n, uint32_t c) {
         if (n < numLed) {
-            pixels[n] = c;
+            setPixel(n, c);
             show();
         }
     }
 
     void setAll(uint32_t c) {
         for (int i = 0; i < numLed; ++i) {
-            pixels[i] = c;
+            setPixel(i, c);
         }
         show();
     }
@@ -146,28 +179,30 @@ namespace Modules::LEDs
         for (int i = 0; i < count; ++i) {
             int n = indices[i];
             if (n < numLed) {
-                pixels[n] = colors[i];
+                setPixel(n, colors[i]);
             }
         }
         show();
     }
 
     void setPixelColors(uint32_t* colors) {
-        memcpy(pixels, colors, numLed * sizeof(uint32_t));
+        for (int i = 0; i < numLed; ++i) {
+            setPixel(i, colors[i]);
+        }
         show();
     }
 
 
     void hookPowerState(LEDClientMethod method, void* param) {
-        ledPowerClients.Register(param, method);
+        LEDPower::hookPowerState(method, param);
     }
 
     void unHookPowerState(LEDClientMethod method) {
-        ledPowerClients.UnregisterWithHandler(method);
+        LEDPower::unHookPowerState(method);
     }
 
     void unHookPowerStateWithParam(void* param) {
-        ledPowerClients.UnregisterWithToken(param);
+        LEDPower::unHookPowerStateWithParam(param);
     }
 
     bool isPixelDataZero() {
@@ -179,101 +214,260 @@ namespace Modules::LEDs
         return true;
     }
 
-    void clampColors() {
+    /// <summary>
+    /// Estimates the current drawn to display the colors, split into the part that
+    /// goes down when the colors are dimmed and the part that doesn't, in nA
+    /// </summary>
+    void estimateCurrent(const uint32_t* colors, uint32_t& outFixedNanoAmps, uint32_t& outColorNanoAmps) {
+        uint32_t channelSum = 0;
+        int ledOnCount = 0;
         for (int i = 0; i < numLed; ++i) {
-            uint32_t color = pixels[i];
-            // Clamp intensity
-            uint8_t r = Utils::getRed(color);
-            uint8_t g = Utils::getGreen(color);
-            uint8_t b = Utils::getBlue(color);
-            r = (r + LOW_BATT_LED_INTENSITY_DIVISOR - 1) / LOW_BATT_LED_INTENSITY_DIVISOR;
-            g = (g + LOW_BATT_LED_INTENSITY_DIVISOR - 1) / LOW_BATT_LED_INTENSITY_DIVISOR;
-            b = (b + LOW_BATT_LED_INTENSITY_DIVISOR - 1) / LOW_BATT_LED_INTENSITY_DIVISOR;
-            pixels[i] = Utils::toColor(r,g,b);
+            uint32_t color = colors[i];
+            if (color != 0) {
+                ledOnCount++;
+                channelSum += Utils::getRed(color) + Utils::getGreen(color) + Utils::getBlue(color);
+            }
+        }
+        outFixedNanoAmps = ledOnCount > 0 ? ledOnCount * LED_ON_NANO_AMPS + LED_DRIVER_NANO_AMPS : 0;
+        outColorNanoAmps = channelSum * LED_CHANNEL_NANO_AMPS;
+    }
+
+    /// <summary>
+    /// Returns how much current the LEDs may draw, based on the battery state and temperature, in mA
+    /// </summary>
+    uint32_t getCurrentBudget() {
+        uint32_t budget = currentBudget;
+        uint32_t lowBudget = MIN(currentBudget, LED_CURRENT_BUDGET_LOW_MA);
+        switch (BatteryController::getState()) {
+            case BatteryController::State_Low:
+            case BatteryController::State_ChargingLow:
+            case BatteryController::State_HighTemp:
+                budget = lowBudget;
+                break;
+            default:
+                break;
+        }
+
+        // Go down linearly to the low budget as the battery heats up
+        int temp = Temperature::getNTCTemperatureTimes100();
+        if (temp >= LED_CURRENT_HOT_TEMP_TIMES100) {
+            budget = lowBudget;
+        } else if (temp > LED_CURRENT_DERATE_TEMP_TIMES100) {
+            uint32_t derated = currentBudget - (currentBudget - lowBudget) *
+                (temp - LED_CURRENT_DERATE_TEMP_TIMES100) / (LED_CURRENT_HOT_TEMP_TIMES100 - LED_CURRENT_DERATE_TEMP_TIMES100);
+            if (derated < budget) {
+                budget = derated;
+            }
+        }
+        return budget;
+    }
+
+    /// <summary>
+    /// Returns the brightness (times 1000) at which the colors fit the current budget
+    /// </summary>
+    uint32_t computeLimitTarget(const uint32_t* colors) {
+        uint32_t fixedNanoAmps, colorNanoAmps;
+        estimateCurrent(colors, fixedNanoAmps, colorNanoAmps);
+
+        // Work in uA so that the scale computation can't overflow
+        uint32_t budgetMicroAmps = getCurrentBudget() * 1000;
+        uint32_t fixedMicroAmps = fixedNanoAmps / 1000;
+        uint32_t colorMicroAmps = colorNanoAmps / 1000;
+        uint32_t target = 1000;
+        if (fixedMicroAmps + colorMicroAmps > budgetMicroAmps) {
+            target = budgetMicroAmps > fixedMicroAmps ? (budgetMicroAmps - fixedMicroAmps) * 1000 / colorMicroAmps : 0;
+        }
+        return target;
+    }
+
+    /// <summary>
+    /// Returns the brightness (times 1000) to show the pixels at so they fit the current budget.
+    /// Going down is immediate, coming back up is held then rate limited so that frames
+    /// alternating between over and under the budget don't make the LEDs pump.
+    /// </summary>
+    uint32_t computeLimit() {
+        uint32_t target = computeLimitTarget(pixels);
+        int time = Timers::millis();
+        uint32_t limit = target;
+        if (target > limitTimes1000) {
+            // Only count the time past the hold
+            int releaseStart = MAX(limitTime, limitHoldTime + LED_CURRENT_LIMIT_HOLD_MS);
+            uint32_t release = time > releaseStart ? (uint32_t)(time - releaseStart) * LED_CURRENT_LIMIT_RELEASE_PER_MS : 0;
+            if (limitTimes1000 + release < target) {
+                limit = limitTimes1000 + release;
+            }
+        } else {
+            limitHoldTime = time;
+        }
+        limitTime = time;
+        limitReleasing = limit < target;
+        return limit;
+    }
+
+    void limitReleaseCallback(void* ignore) {
+        limitReleaseScheduled = false;
+        if (limitReleasing) {
+            show();
+        }
+    }
+
+    /// <summary>
+    /// Sends the pixels out, dimmed if they would draw more than the current budget
+    /// </summary>
+    void sendFrame() {
+        uint32_t limit = computeLimit();
+        uint32_t mask = changedMask;
+        if (limit != limitTimes1000) {
+            // All the LEDs change brightness
+            limitTimes1000 = limit;
+            mask = 0xFFFFFFFF;
+        }
+
+        uint32_t* colors = pixels;
+        if (limit < 1000) {
+            showStats.limitedCount++;
+            memcpy(limitedPixels, pixels, numLed * sizeof(uint32_t));
+            Utils::ColorKernels::scaleColors(limitedPixels, numLed, limit);
+            colors = limitedPixels;
+        }
+        if (NeoPixel::show(colors, mask) < numLed) {
+            showStats.partialCount++;
+        }
+        changedMask = 0;
+
+        // Keep showing the frame while its brightness comes back up, even if it doesn't change
+        if (limitReleasing && !limitReleaseScheduled) {
+            int delay = MAX(limitHoldTime + LED_CURRENT_LIMIT_HOLD_MS - limitTime, LED_CURRENT_LIMIT_RELEASE_INTERVAL_MS);
+            limitReleaseScheduled = Timers::setDelayedCallback(limitReleaseCallback, nullptr, delay);
         }
     }
 
     void show() {
+        showStats.frameCount++;
+
+        // Newer than the loop, which may still be waiting for the LEDs to power up
+        loopStartPending = false;
+
+        // Are the LEDs already displaying these colors?
+        if (changedMask == 0 && !limitReleasing && NeoPixel::isSequenceValid()) {
+            showStats.skippedCount++;
+            return;
+        }
+
         // Do we want all the LEDs to be off?
         if (isPixelDataZero()) {
-            setPowerOff();
+            if (LEDPower::isPowerOn()) {
+                // Keep the power on for a little while in case something lights up again soon,
+                // the LEDs still need to be turned off in the meantime
+                if (NeoPixel::show(pixels, changedMask) < numLed) {
+                    showStats.partialCount++;
+                }
+                changedMask = 0;
+                limitReleasing = false;
+                LEDPower::releasePower();
+            } else {
+                showStats.skippedCount++;
+            }
         } else {
             // Only turn power on if Battery is strong enough
             if (BatteryController::getState() != BatteryController::State_Empty) {
                 // Turn power on so we display something!!!
-                setPowerOn([](void* ignore) {
-                    // Check battery and coil voltage to determine if we should turn leds on
-                    // if (BatteryController::getState() == BatteryController::State_Low ||
-                    //     BatteryController::getState() == BatteryController::State_ChargingLow) {
-                    //     clampColors();
-                    // }
-                    NeoPixel::show(pixels);
+                LEDPower::powerOn([](void* ignore) {
+                    // Dimmed to the current budget, which is lower when the battery is low
+                    sendFrame();
                 }, nullptr);
             }
         }
     }
 
-    // Convert separate R,G,B to packed value
-    uint32_t color(uint8_t r, uint8_t g, uint8_t b) {
-        return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
-    }
-
-    void setPowerOn(Timers::DelayedCallback callback, void* parameter) {
-        // Are we already on?
-        if (powerOn) {
-            // Power already on, just proceed.
-            callback(parameter);
-        } else {
-            // Notify clients we're turning led power on
-            for (int i = 0; i < ledPowerClients.Count(); ++i) {
-                ledPowerClients[i].handler(ledPowerClients[i].token, true);
-            }
-
-            // Turn the power on
-            NRF_LOG_DEBUG("LED Power On");
-            nrf_gpio_pin_set(powerPin);
-            powerOn = true;
+    /// <summary>
+    /// Has the LEDs alternate between two frames count times on their own, within the current budget,
+    /// once they are powered up. Returns false if the frames should be shown one by one instead,
+    /// i.e. the brightness is still coming back up.
+    /// </summary>
+    bool playLoop(const uint32_t* colorsA, int durationAMs, const uint32_t* colorsB, int durationBMs, int count) {
+        if (durationAMs < 1 || durationAMs > NEOPIXEL_MAX_LOOP_FRAME_MS ||
+            durationBMs < 1 || durationBMs > NEOPIXEL_MAX_LOOP_FRAME_MS ||
+            BatteryController::getState() == BatteryController::State_Empty) {
+            return false;
+        }
 
-            // Give enough time for the LEDs to power up (5ms)
-            Timers::setDelayedCallback(callback, parameter, 5);
+        // Both frames are shown at the same brightness, which can go down but not up
+        uint32_t limit = computeLimitTarget(colorsA);
+        uint32_t limitB = computeLimitTarget(colorsB);
+        limit = MIN(limit, limitB);
+        if (limit > limitTimes1000) {
+            return false;
         }
+        limitTimes1000 = limit;
+        limitTime = Timers::millis();
+        limitHoldTime = limitTime;
+        limitReleasing = false;
+
+        // The LEDs are left with the second frame
+        memcpy(pixels, colorsB, numLed * sizeof(uint32_t));
+        memcpy(loopPixels, colorsA, numLed * sizeof(uint32_t));
+        changedMask = 0;
+        if (limit < 1000) {
+            showStats.limitedCount += 2;
+            memcpy(limitedPixels, colorsB, numLed * sizeof(uint32_t));
+            Utils::ColorKernels::scaleColors(limitedPixels, numLed, limit);
+            Utils::ColorKernels::scaleColors(loopPixels, numLed, limit);
+        }
+        loopDurations[0] = durationAMs;
+        loopDurations[1] = durationBMs;
+        loopCount = count;
+
+        // Power may have been turned off during the second frame (i.e. black), in which case the loop
+        // starts a few ms late, and the anim controller comes back during its last second frame.
+        loopStartPending = true;
+        LEDPower::powerOn(startLoopCallback, nullptr);
+        return true;
     }
 
-    void setPowerOff() {
-        // Already off?
-        if (!powerOn)
+    void startLoopCallback(void* ignore) {
+        if (!loopStartPending) {
+            // A frame was shown since
             return;
+        }
+        loopStartPending = false;
+        NeoPixel::playLoop(loopPixels, loopDurations[0], limitTimes1000 < 1000 ? limitedPixels : pixels, loopDurations[1], loopCount);
+    }
 
-        // Turn power off
-        NRF_LOG_DEBUG("LED Power Off");
-        nrf_gpio_pin_clear(powerPin);
-        powerOn = false;
+    void getShowStats(ShowStats& outStats) {
+        outStats = showStats;
+        NeoPixel::PlaybackStats playbackStats;
+        NeoPixel::getPlaybackStats(playbackStats);
+        outStats.playedCount = playbackStats.playedCount;
+        outStats.replacedCount = playbackStats.replacedCount;
+        outStats.limitTimes1000 = limitTimes1000;
+    }
 
-        // Notify clients we're turning led power off
-        for (int i = 0; i < ledPowerClients.Count(); ++i) {
-            ledPowerClients[i].handler(ledPowerClients[i].token, false);
-        }
+    // Convert separate R,G,B to packed value
+    uint32_t color(uint8_t r, uint8_t g, uint8_t b) {
+        return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
     }
 
     uint8_t computeCurrentEstimate() {
-        uint32_t nanoAmps = 0; // We don't have anywhere near this precision, it just makes fixed-point computations easier
-        int ledOnCount = 0;
-        for (int i = 0; i < numLed; ++i) {
-            uint32_t color = pixels[i];
-            if (color != 0) {
-                ledOnCount++;
-                // Clamp intensity
-                uint8_t r = Utils::getRed(color);
-                uint8_t g = Utils::getGreen(color);
-                uint8_t b = Utils::getBlue(color);
-                nanoAmps += (uint32_t)247000 * 3 + 18200 * (r + g + b);
-            }
-        }
-        if (ledOnCount > 0) {
-            nanoAmps += 7100000;
-        }
+        // We don't have anywhere near nA precision, it just makes fixed-point computations easier.
+        // Estimate what is actually displayed, i.e. after the current limiter.
+        uint32_t fixedNanoAmps, colorNanoAmps;
+        estimateCurrent(pixels, fixedNanoAmps, colorNanoAmps);
+        return (uint8_t)((fixedNanoAmps + colorNanoAmps / 1000 * limitTimes1000) / 1000000);
+    }
+
+    /// <summary>
+    /// Sets the most current the LEDs may draw when the battery is fine, 0 for the default budget.
+    /// Applies from the next frame. Not stored in flash, the die goes back to LED_CURRENT_BUDGET_MA when it resets.
+    /// </summary>
+    void setCurrentBudget(uint16_t budgetMA) {
+        currentBudget = budgetMA != 0 ? budgetMA : LED_CURRENT_BUDGET_MA;
+        NRF_LOG_INFO("LED current budget set to %d mA", currentBudget);
+    }
 
-        return (uint8_t)(nanoAmps / 1000000);
+    void setCurrentBudgetHandler(const Message* msg) {
+        auto budgetMsg = (const MessageSetLEDCurrentBudget*)msg;
+        setCurrentBudget(budgetMsg->budgetMA);
     }
 
 }
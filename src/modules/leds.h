@@ -2,6 +2,29 @@
 
 #include <stdint.h>
 
+// Most current the LEDs may draw by default, in mA. Frames that would draw more are dimmed to fit.
+// Full white on MAX_LED_COUNT LEDs draws about 330 mA, so by default frames are only dimmed when the
+// battery is low or hot. The app may lower it at runtime, see MessageSetLEDCurrentBudget.
+#ifndef LED_CURRENT_BUDGET_MA
+#define LED_CURRENT_BUDGET_MA 330
+#endif
+
+// Current budget when the battery is low or too hot, in mA
+#define LED_CURRENT_BUDGET_LOW_MA 40
+
+// Battery temperatures over which the budget goes down, reaching the low budget at the upper one
+#define LED_CURRENT_DERATE_TEMP_TIMES100 4500
+#define LED_CURRENT_HOT_TEMP_TIMES100 6000
+
+// Dimming is immediate, so that the budget is never exceeded. The brightness only comes back once
+// frames have fit the budget for the hold time, so that periodic bright frames don't make the
+// frames in between pump, and then at the release rate, in 1/1000th per ms.
+#define LED_CURRENT_LIMIT_HOLD_MS 1000
+#define LED_CURRENT_LIMIT_RELEASE_PER_MS 2
+
+// Interval at which a static frame gets shown again while it is being brought back to full brightness, in ms
+#define LED_CURRENT_LIMIT_RELEASE_INTERVAL_MS 33
+
 /// <summary>
 /// The component in charge of controlling LEDs
 /// </summary>
@@ -14,7 +37,21 @@ namespace Modules::LEDs
     void setPixelColors(uint32_t* colors);
     void setAll(uint32_t c);
     void clear();
+    bool playLoop(const uint32_t* colorsA, int durationAMs, const uint32_t* colorsB, int durationBMs, int count);
     uint8_t computeCurrentEstimate();
+    void setCurrentBudget(uint16_t budgetMA);
+
+    struct ShowStats
+    {
+        uint32_t frameCount;    // Number of frames set
+        uint32_t skippedCount;  // Frames identical to what the LEDs already display, nothing sent out
+        uint32_t partialCount;  // Frames where only the LEDs that changed were re-encoded
+        uint32_t playedCount;   // Frames fully sent out to the LEDs
+        uint32_t replacedCount; // Frames replaced by a newer one while waiting for the previous one to be sent out
+        uint32_t limitedCount;  // Frames dimmed to fit the current budget
+        uint32_t limitTimes1000;// Brightness the last frame was shown at, 1000 when not limited
+    };
+    void getShowStats(ShowStats& outStats);
 
     typedef void(*LEDClientMethod)(void* param, bool powerOn);
     void hookPowerState(LEDClientMethod method, void* param);
@@ -4,30 +4,48 @@
 
 #include "rainbow.h"
 #include "utils.h"
+#include "color_kernels.h"
 #include "nrf_delay.h"
 
 #define NUMPIXELS 21
 
 namespace Rainbow
 {
+    /// <summary>
+    /// Full intensity wheel color, the channels going up and down by 3 per step
+    /// </summary>
+    constexpr uint32_t wheelColor(int wheelPos) {
+        return wheelPos < 85
+            ? ((uint32_t)(wheelPos * 3) << 16) | ((uint32_t)(255 - wheelPos * 3) << 8)
+            : wheelPos < 170
+                ? ((uint32_t)(255 - (wheelPos - 85) * 3) << 16) | (uint32_t)((wheelPos - 85) * 3)
+                : ((uint32_t)((wheelPos - 170) * 3) << 8) | (uint32_t)(255 - (wheelPos - 170) * 3);
+    }
+
+    /// <summary>
+    /// The 256 wheel colors, generated at compile time so that the table lives in flash
+    /// </summary>
+    struct WheelTable
+    {
+        uint32_t colors[256];
+        constexpr WheelTable() : colors() {
+            for (int i = 0; i < 256; ++i) {
+                colors[i] = wheelColor(i);
+            }
+        }
+    };
+    static constexpr WheelTable wheelTable;
+
     // Input a value 0 to 255 to get a color value.
     // The colours are a transition r - g - b - back to r.
     uint32_t wheel(uint8_t WheelPos, uint8_t intensity)
     {
-        if (WheelPos < 85)
-        {
-            return Utils::toColor(WheelPos * 3 * intensity / 255, (255 - WheelPos * 3) * intensity / 255, 0);
-        }
-        else if (WheelPos < 170)
-        {
-            WheelPos -= 85;
-            return Utils::toColor((255 - WheelPos * 3) * intensity / 255, 0, WheelPos * 3 * intensity / 255);
-        }
-        else
-        {
-            WheelPos -= 170;
-            return Utils::toColor(0, WheelPos * 3 * intensity / 255, (255 - WheelPos * 3) * intensity / 255);
+        uint32_t color = wheelTable.colors[WheelPos];
+        if (intensity == 255) {
+            return color;
         }
+        // Same as scaling each channel by intensity / 255
+        return Utils::ColorKernels::modulate(color, intensity);
     }
 
     uint32_t faceWheel(uint8_t face, uint8_t count) {
@@ -1,4 +1,5 @@
 #include "utils.h"
+#include "color_kernels.h"
 #include <nrf_delay.h>
 #include <app_timer.h>
 #include "config/settings.h"
@@ -18,29 +19,23 @@ namespace Utils
     }
 
     uint32_t addColors(uint32_t a, uint32_t b) {
-        uint8_t red = MAX(getRed(a), getRed(b));
-        uint8_t green = MAX(getGreen(a), getGreen(b));
-        uint8_t blue = MAX(getBlue(a), getBlue(b));
-        return toColor(red,green,blue);
+        return ColorKernels::blendMax(a, b);
     }
 
     uint32_t mulColors(uint32_t a, uint32_t b) {
-        uint8_t red = getRed(a) * getRed(b) / 255;
-        uint8_t green = getGreen(a) * getGreen(b) / 255;
-        uint8_t blue = getBlue(a) * getBlue(b) / 255;
-        return toColor(red,green,blue);
+        return ColorKernels::multiply(a, b);
     }
 
     uint32_t scaleColor(uint32_t color, uint32_t scaleTimes1000) {
-        uint8_t red = CLAMP(getRed(color) * scaleTimes1000 / 1000, 0, 255);
-        uint8_t green = CLAMP(getGreen(color) * scaleTimes1000 / 1000, 0, 255);
-        uint8_t blue = CLAMP(getBlue(color) * scaleTimes1000 / 1000, 0, 255);
-        return toColor(red, green, blue);
+        return ColorKernels::scale(color, scaleTimes1000);
     }
 
     uint32_t interpolateColors(uint32_t color1, uint32_t time1, uint32_t color2, uint32_t time2, uint32_t time) {
         // To stick to integer math, we'll scale the values
         int scaledPercent = (time - time1) * scaler / (time2 - time1);
+        if (scaledPercent >= 0 && scaledPercent <= scaler) {
+            return ColorKernels::lerp(color1, color2, scaledPercent);
+        }
         int scaledRed = getRed(color1)* (scaler - scaledPercent) + getRed(color2) * scaledPercent;
         int scaledGreen = getGreen(color1) * (scaler - scaledPercent) + getGreen(color2) * scaledPercent;
         int scaledBlue = getBlue(color1) * (scaler - scaledPercent) + getBlue(color2) * scaledPercent;
@@ -304,10 +299,7 @@ for x in range(256):
     }
 
     uint32_t modulateColor(uint32_t color, uint8_t intensity) {
-        int red = getRed(color) * intensity / 255;
-        int green = getGreen(color) * intensity / 255;
-        int blue = getBlue(color) * intensity / 255;
-        return toColor((uint8_t)red, (uint8_t)green, (uint8_t)blue);
+        return ColorKernels::modulate(color, intensity);
     }
 
 
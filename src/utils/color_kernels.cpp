@@ -0,0 +1,82 @@
+#include "color_kernels.h"
+
+namespace Utils::ColorKernels
+{
+    // modulate() results for every channel value, at the brightness they were computed for
+    static uint8_t brightnessLUT[256];
+    static int brightnessLUTLevel = -1;
+
+    /// <summary>
+    /// Blends otherColors into colors, keeping the max of each channel
+    /// </summary>
+    void blendMaxColors(uint32_t* colors, const uint32_t* otherColors, int count) {
+        for (int i = 0; i < count; ++i) {
+            colors[i] = blendMax(colors[i], otherColors[i]);
+        }
+    }
+
+    /// <summary>
+    /// Dims all colors by the same intensity (0 - 255)
+    /// </summary>
+    void modulateColors(uint32_t* colors, int count, uint8_t intensity) {
+        if (intensity == 255) {
+            // x * 255 / 255 == x, nothing to do
+            return;
+        }
+        for (int i = 0; i < count; ++i) {
+            colors[i] = modulate(colors[i], intensity);
+        }
+    }
+
+    /// <summary>
+    /// Applies the global brightness (0 - 255) to all colors, same as modulateColors() but with a
+    /// table lookup per channel, the table being rebuilt only when the brightness changes
+    /// </summary>
+    void applyBrightness(uint32_t* colors, int count, uint8_t brightness) {
+        if (brightness == 255) {
+            return;
+        }
+        if (brightnessLUTLevel != brightness) {
+            for (int i = 0; i < 256; ++i) {
+                brightnessLUT[i] = (uint8_t)modulate(i, brightness);
+            }
+            brightnessLUTLevel = brightness;
+        }
+        for (int i = 0; i < count; ++i) {
+            uint32_t color = colors[i];
+            colors[i] = ((uint32_t)brightnessLUT[(color >> 16) & 0xFF] << 16)
+                | ((uint32_t)brightnessLUT[(color >> 8) & 0xFF] << 8)
+                | brightnessLUT[color & 0xFF];
+        }
+    }
+
+    /// <summary>
+    /// Scales all colors by the same factor (times 1000)
+    /// </summary>
+    void scaleColors(uint32_t* colors, int count, uint32_t scaleTimes1000) {
+        if (scaleTimes1000 == 1000) {
+            return;
+        } else if (scaleTimes1000 > 1000) {
+            // Channels need clamping, use the generic version
+            for (int i = 0; i < count; ++i) {
+                colors[i] = scale(colors[i], scaleTimes1000);
+            }
+            return;
+        }
+
+        // Only divide once for the whole batch
+        uint32_t fadeMultiplier = getFadeMultiplier(scaleTimes1000);
+        for (int i = 0; i < count; ++i) {
+            colors[i] = fade(colors[i], fadeMultiplier);
+        }
+    }
+
+    /// <summary>
+    /// Interpolates all colors toward otherColors by the same weight, 0 (colors) - 65536 (otherColors)
+    /// </summary>
+    void lerpColors(uint32_t* colors, const uint32_t* otherColors, int count, int weightTimes65536) {
+        for (int i = 0; i < count; ++i) {
+            colors[i] = lerp(colors[i], otherColors[i], weightTimes65536);
+        }
+    }
+}
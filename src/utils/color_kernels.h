@@ -0,0 +1,154 @@
+#pragma once
+
+#include <stdint.h>
+
+// Cortex-M4 targets have per-byte SIMD instructions, other builds (i.e. host tools) use portable code.
+// Host tests also get the SIMD versions by defining COLOR_KERNELS_EMULATE_DSP and the intrinsics they use.
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+#define COLOR_KERNELS_USE_DSP 1
+#include "nrf.h"
+#else
+#define COLOR_KERNELS_USE_DSP 0
+#endif
+
+// Fade multiplier of an unfaded color, see getFadeMultiplier()
+#define COLOR_FADE_MULTIPLIER_NONE (1 << 18)
+
+// Largest fade factor getFadeMultiplier() converts, from there on any lit channel is brightened to 255
+#define COLOR_FADE_MAX_TIMES1000 255000
+
+/// <summary>
+/// Color math on packed 0x00RRGGBB colors, processing the channels together instead of
+/// unpacking, dividing and repacking each one. Every kernel is bit-exact with the matching
+/// Utils function (addColors, mulColors, modulateColor, scaleColor and interpolateColors),
+/// on target and on host.
+/// </summary>
+namespace Utils::ColorKernels
+{
+    /// <summary>
+    /// Divides the two 16 bit lanes of x by 255, each lane must be in the 0 - 65025 range (i.e. 255 * 255)
+    /// </summary>
+    inline uint32_t div255Lanes(uint32_t x) {
+        return ((x + 0x00010001 + ((x >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+    }
+
+    /// <summary>
+    /// Per channel max of two colors, portable version of blendMax()
+    /// </summary>
+    inline uint32_t blendMaxPortable(uint32_t a, uint32_t b) {
+        uint32_t red = ((a >> 16) & 0xFF) > ((b >> 16) & 0xFF) ? (a & 0xFF0000) : (b & 0xFF0000);
+        uint32_t green = ((a >> 8) & 0xFF) > ((b >> 8) & 0xFF) ? (a & 0x00FF00) : (b & 0x00FF00);
+        uint32_t blue = (a & 0xFF) > (b & 0xFF) ? (a & 0x0000FF) : (b & 0x0000FF);
+        return red | green | blue;
+    }
+
+#if COLOR_KERNELS_USE_DSP || defined(COLOR_KERNELS_EMULATE_DSP)
+    /// <summary>
+    /// Per channel max of two colors, SIMD version of blendMax()
+    /// </summary>
+    inline uint32_t blendMaxDSP(uint32_t a, uint32_t b) {
+        // USUB8 sets the GE flag of each byte where a >= b, and SEL then picks those bytes from a
+        __USUB8(a, b);
+        return __SEL(a, b) & 0x00FFFFFF;
+    }
+#endif
+
+    /// <summary>
+    /// Per channel max of two colors, same as Utils::addColors()
+    /// </summary>
+    inline uint32_t blendMax(uint32_t a, uint32_t b) {
+#if COLOR_KERNELS_USE_DSP
+        return blendMaxDSP(a, b);
+#else
+        return blendMaxPortable(a, b);
+#endif
+    }
+
+    /// <summary>
+    /// Dims a color by an intensity (0 - 255), same as Utils::modulateColor()
+    /// </summary>
+    inline uint32_t modulate(uint32_t color, uint8_t intensity) {
+        uint32_t redBlue = div255Lanes((color & 0x00FF00FF) * intensity);
+        uint32_t green = div255Lanes(((color >> 8) & 0xFF) * intensity);
+        return redBlue | (green << 8);
+    }
+
+    /// <summary>
+    /// Per channel product of two colors, same as Utils::mulColors()
+    /// </summary>
+    inline uint32_t multiply(uint32_t a, uint32_t b) {
+        uint32_t redBlue = (((a >> 16) & 0xFF) * ((b >> 16) & 0xFF) << 16) | ((a & 0xFF) * (b & 0xFF));
+        uint32_t green = ((a >> 8) & 0xFF) * ((b >> 8) & 0xFF);
+        return div255Lanes(redBlue) | (div255Lanes(green) << 8);
+    }
+
+    /// <summary>
+    /// Scales a color by a factor (times 1000), clamping each channel, same as Utils::scaleColor()
+    /// </summary>
+    inline uint32_t scale(uint32_t color, uint32_t scaleTimes1000) {
+        uint32_t red = ((color >> 16) & 0xFF) * scaleTimes1000 / 1000;
+        uint32_t green = ((color >> 8) & 0xFF) * scaleTimes1000 / 1000;
+        uint32_t blue = (color & 0xFF) * scaleTimes1000 / 1000;
+        if (scaleTimes1000 > 1000) {
+            red = red > 255 ? 255 : red;
+            green = green > 255 ? 255 : green;
+            blue = blue > 255 ? 255 : blue;
+        }
+        return (red << 16) | (green << 8) | blue;
+    }
+
+    /// <summary>
+    /// Converts a fade factor (times 1000) to a multiplier for fade(), so that the division
+    /// by 1000 is done once per animation rather than once per channel.
+    /// c * f / 1000 == (c * ceil(f * 2^18 / 1000)) >> 18 for any 8 bit c. Factors above 1000
+    /// brighten the colors, and are capped where every lit channel is clamped anyway.
+    /// </summary>
+    inline uint32_t getFadeMultiplier(uint32_t fadeTimes1000) {
+        if (fadeTimes1000 <= 1000) {
+            return (fadeTimes1000 * COLOR_FADE_MULTIPLIER_NONE + 999) / 1000;
+        }
+        uint64_t cappedTimes1000 = fadeTimes1000 < COLOR_FADE_MAX_TIMES1000 ? fadeTimes1000 : COLOR_FADE_MAX_TIMES1000;
+        return (uint32_t)((cappedTimes1000 * COLOR_FADE_MULTIPLIER_NONE + 999) / 1000);
+    }
+
+    /// <summary>
+    /// Fades a color by a multiplier from getFadeMultiplier(), same as scale() with the original factor
+    /// </summary>
+    inline uint32_t fade(uint32_t color, uint32_t fadeMultiplier) {
+        if (fadeMultiplier > COLOR_FADE_MULTIPLIER_NONE) {
+            // Brightening, the products don't fit 32 bits and the channels need clamping
+            uint64_t red = (((color >> 16) & 0xFF) * (uint64_t)fadeMultiplier) >> 18;
+            uint64_t green = (((color >> 8) & 0xFF) * (uint64_t)fadeMultiplier) >> 18;
+            uint64_t blue = ((color & 0xFF) * (uint64_t)fadeMultiplier) >> 18;
+            red = red > 255 ? 255 : red;
+            green = green > 255 ? 255 : green;
+            blue = blue > 255 ? 255 : blue;
+            return (uint32_t)((red << 16) | (green << 8) | blue);
+        }
+        uint32_t red = (((color >> 16) & 0xFF) * fadeMultiplier) >> 18;
+        uint32_t green = (((color >> 8) & 0xFF) * fadeMultiplier) >> 18;
+        uint32_t blue = ((color & 0xFF) * fadeMultiplier) >> 18;
+        return (red << 16) | (green << 8) | blue;
+    }
+
+    /// <summary>
+    /// Linear interpolation between two colors, weight is 0 (color1) - 65536 (color2).
+    /// Rounds down, same as Utils::interpolateColors() over that weight range.
+    /// </summary>
+    inline uint32_t lerp(uint32_t color1, uint32_t color2, int weightTimes65536) {
+        int red = (int)((color1 >> 16) & 0xFF);
+        int green = (int)((color1 >> 8) & 0xFF);
+        int blue = (int)(color1 & 0xFF);
+        red += (((int)((color2 >> 16) & 0xFF) - red) * weightTimes65536) >> 16;
+        green += (((int)((color2 >> 8) & 0xFF) - green) * weightTimes65536) >> 16;
+        blue += (((int)(color2 & 0xFF) - blue) * weightTimes65536) >> 16;
+        return ((uint32_t)red << 16) | ((uint32_t)green << 8) | (uint32_t)blue;
+    }
+
+    // Batch versions, working in place on arrays of colors
+    void blendMaxColors(uint32_t* colors, const uint32_t* otherColors, int count);
+    void modulateColors(uint32_t* colors, int count, uint8_t intensity);
+    void applyBrightness(uint32_t* colors, int count, uint8_t brightness);
+    void scaleColors(uint32_t* colors, int count, uint32_t scaleTimes1000);
+    void lerpColors(uint32_t* colors, const uint32_t* otherColors, int count, int weightTimes65536);
+}
@@ -0,0 +1,253 @@
+// Renders every animation type on every LED layout from a generated data set, and reports
+// the time and instructions per frame and the peak stack usage of each.
+// The frames rendered are summed up in a checksum per animation and layout, which are compared
+// against (or written to) a golden file to catch any change in what animations look like.
+//
+// Usage: bench_animations [--check <golden file> | --write <golden file>]
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <map>
+#include "sim/sim.h"
+#include "sim/data_set_builder.h"
+#include "sim/sample_animations.h"
+#include "sim/measure.h"
+#include "animations/Animation.h"
+#include "drivers_nrf/cycle_counter.h"
+#include "drivers_nrf/scheduler.h"
+#include "modules/anim_controller.h"
+
+using namespace Animations;
+using namespace Config;
+using namespace DriversNRF;
+
+// Minimum time spent rendering each animation, to average out the timer resolution and host noise
+#define BENCH_MIN_TIME_NS (20 * 1000 * 1000)
+#define BENCH_MIN_REPEAT_COUNT 3
+
+#define FNV_OFFSET_BASIS 0x811C9DC5
+#define FNV_PRIME 0x01000193
+
+static const DiceVariants::LEDLayoutType layoutTypes[] = {
+    DiceVariants::DieLayoutType_D4,
+    DiceVariants::DieLayoutType_D6_FD6,
+    DiceVariants::DieLayoutType_D8,
+    DiceVariants::DieLayoutType_D10_D00,
+    DiceVariants::DieLayoutType_D12,
+    DiceVariants::DieLayoutType_D20,
+    DiceVariants::DieLayoutType_PD6,
+    DiceVariants::DieLayoutType_M20,
+};
+
+struct BenchRun
+{
+    const Animation* preset;
+    const DataSet::AnimationBits* bits;
+    int ledCount;
+    uint8_t upFace;
+    int frameCount;
+    int outputCount;    // Lit LEDs and triggered animations over all the frames
+    uint32_t checksum;
+};
+
+static uint32_t hashWord(uint32_t hash, uint32_t word) {
+    for (int i = 0; i < 4; ++i) {
+        hash = (hash ^ ((word >> (i * 8)) & 0xFF)) * FNV_PRIME;
+    }
+    return hash;
+}
+
+static BenchRun* currentRun = nullptr;
+static int currentTime = 0;
+
+// Animations triggered by sequences are part of what they render
+static void onPlay(const Animation* preset, const DataSet::AnimationBits* bits, uint8_t remapFace, uint8_t loopCount) {
+    if (currentRun != nullptr) {
+        currentRun->checksum = hashWord(currentRun->checksum, currentTime);
+        currentRun->checksum = hashWord(currentRun->checksum, preset->type | (remapFace << 8) | (loopCount << 16));
+        currentRun->outputCount++;
+    }
+}
+
+// Renders all the frames of the animation, from a new instance, and returns the checksum of the frames
+static void renderAllFrames(void* param) {
+    auto run = (BenchRun*)param;
+    run->checksum = FNV_OFFSET_BASIS;
+    run->frameCount = 0;
+    run->outputCount = 0;
+    currentRun = run;
+
+    AnimationInstance* instance = createAnimationInstance(run->preset, run->bits);
+    instance->start(0, run->upFace, 1);
+    for (int ms = 0; ms <= run->preset->duration; ms += ANIM_FRAME_DURATION_MS) {
+        uint32_t frame[MAX_LED_COUNT];
+        memset(frame, 0, sizeof(frame));
+        currentTime = ms;
+        instance->render(ms, 1000, frame);
+        Scheduler::update();
+        for (int i = 0; i < run->ledCount; ++i) {
+            run->checksum = hashWord(run->checksum, frame[i]);
+            run->outputCount += frame[i] != 0 ? 1 : 0;
+        }
+        run->frameCount++;
+    }
+    destroyAnimationInstance(instance);
+    currentRun = nullptr;
+}
+
+// Renders all the frames of the animation and returns the time (in ns) and instructions it took, without the checksums
+static void timeAllFrames(const BenchRun& run, const Sim::InstructionCounter& counter, uint32_t& outNs, uint64_t& outInstructions) {
+    AnimationInstance* instance = createAnimationInstance(run.preset, run.bits);
+    instance->start(0, run.upFace, 1);
+    uint32_t frame[MAX_LED_COUNT];
+    uint64_t startInstructions = counter.read();
+    uint32_t startTime = CycleCounter::read();
+    for (int ms = 0; ms <= run.preset->duration; ms += ANIM_FRAME_DURATION_MS) {
+        memset(frame, 0, sizeof(frame));
+        instance->render(ms, 1000, frame);
+        Scheduler::update();
+    }
+    outNs = CycleCounter::read() - startTime;
+    outInstructions = counter.read() - startInstructions;
+    destroyAnimationInstance(instance);
+}
+
+static bool readGoldenFile(const char* path, std::map<std::string, uint32_t>& outChecksums) {
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        return false;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        char layout[32];
+        char animation[32];
+        unsigned checksum;
+        if (line[0] != '#' && sscanf(line, "%31s %31s %x", layout, animation, &checksum) == 3) {
+            outChecksums[std::string(layout) + " " + animation] = checksum;
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    const char* checkPath = nullptr;
+    const char* writePath = nullptr;
+    if (argc == 3 && strcmp(argv[1], "--check") == 0) {
+        checkPath = argv[2];
+    } else if (argc == 3 && strcmp(argv[1], "--write") == 0) {
+        writePath = argv[2];
+    } else if (argc != 1) {
+        fprintf(stderr, "Usage: %s [--check <golden file> | --write <golden file>]\n", argv[0]);
+        return 2;
+    }
+
+    std::map<std::string, uint32_t> goldenChecksums;
+    if (checkPath != nullptr && !readGoldenFile(checkPath, goldenChecksums)) {
+        fprintf(stderr, "Can't read %s\n", checkPath);
+        return 2;
+    }
+    FILE* writeFile = nullptr;
+    if (writePath != nullptr) {
+        writeFile = fopen(writePath, "w");
+        if (writeFile == nullptr) {
+            fprintf(stderr, "Can't write %s\n", writePath);
+            return 2;
+        }
+        fprintf(writeFile, "# Checksums of the frames rendered by bench_animations, regenerate with 'make golden'\n");
+        fprintf(writeFile, "# layout animation checksum\n");
+    }
+
+    CycleCounter::init();
+    Scheduler::init();
+    Sim::setPlayCallback(onPlay);
+    Sim::setCurrentFace(2);
+    Sim::InstructionCounter counter;
+
+    printf("%-6s %-16s %7s %10s %13s %8s %10s\n", "layout", "animation", "frames", "ns/frame", "instr/frame", "stack", "checksum");
+    int mismatchCount = 0;
+    int blankCount = 0;
+    for (auto layoutType : layoutTypes) {
+        Sim::setLayoutType(layoutType);
+        auto layout = DiceVariants::getLayout(layoutType);
+
+        Sim::DataSetBuilder builder;
+        int animationIndices[Animation_Count];
+        Sim::addSampleAnimations(builder, layout->faceCount, animationIndices);
+        auto bits = builder.getBits();
+
+        for (int type = Animation_Unknown + 1; type < Animation_Count; ++type) {
+            BenchRun run;
+            run.preset = bits->getAnimation(animationIndices[type]);
+            run.bits = bits;
+            run.ledCount = layout->ledCount;
+            // The highest face up leaves the faces where they are on most layouts, so that animations lighting
+            // the first faces only (i.e. tracks of the M20, whose LEDs only show its first five faces) show up
+            run.upFace = (uint8_t)(layout->faceCount - 1);
+            int stackUsage = Sim::measureStackUsage(renderAllFrames, &run);
+
+            // Keep the fastest run, the others were slowed down by something else
+            uint32_t bestNs = 0xFFFFFFFF;
+            uint64_t bestInstructions = 0;
+            uint64_t totalNs = 0;
+            for (int repeat = 0; repeat < BENCH_MIN_REPEAT_COUNT || totalNs < BENCH_MIN_TIME_NS; ++repeat) {
+                uint32_t ns;
+                uint64_t instructions;
+                timeAllFrames(run, counter, ns, instructions);
+                if (ns < bestNs) {
+                    bestNs = ns;
+                    bestInstructions = instructions;
+                }
+                totalNs += ns;
+            }
+
+            const char* layoutName = Sim::getLayoutTypeName(layoutType);
+            const char* animationName = Sim::getAnimationTypeName((AnimationType)type);
+            char instructionsText[32] = "n/a";
+            if (counter.isAvailable()) {
+                snprintf(instructionsText, sizeof(instructionsText), "%llu", (unsigned long long)(bestInstructions / run.frameCount));
+            }
+            printf("%-6s %-16s %7d %10u %13s %8d 0x%08x", layoutName, animationName, run.frameCount,
+                bestNs / run.frameCount, instructionsText, stackUsage, run.checksum);
+
+            // Checksums of blank frames don't catch anything
+            if (run.outputCount == 0) {
+                printf("  BLANK");
+                blankCount++;
+            }
+            std::string key = std::string(layoutName) + " " + animationName;
+            if (checkPath != nullptr) {
+                auto golden = goldenChecksums.find(key);
+                if (golden == goldenChecksums.end()) {
+                    printf("  MISSING");
+                    mismatchCount++;
+                } else if (golden->second != run.checksum) {
+                    printf("  MISMATCH (expected 0x%08x)", golden->second);
+                    mismatchCount++;
+                }
+            }
+            printf("\n");
+            if (writeFile != nullptr) {
+                fprintf(writeFile, "%s %s 0x%08x\n", layoutName, animationName, run.checksum);
+            }
+        }
+    }
+
+    if (!counter.isAvailable()) {
+        printf("Instruction counts need access to the perf events, see /proc/sys/kernel/perf_event_paranoid\n");
+    }
+    if (writeFile != nullptr) {
+        fclose(writeFile);
+    }
+    if (blankCount > 0) {
+        printf("%d animations don't light anything\n", blankCount);
+    }
+    if (mismatchCount > 0) {
+        printf("%d animations don't render the golden frames\n", mismatchCount);
+    }
+    if (blankCount > 0 || mismatchCount > 0) {
+        return 1;
+    }
+    return 0;
+}
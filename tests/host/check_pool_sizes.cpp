@@ -0,0 +1,3 @@
+// Compiled for a 32 bits target (see the Makefile), so that the static_assert of animation_pools.h
+// checks the RAM the animation instance pools take on the die, and not their (larger) host size
+#include "animations/animation_pools.h"
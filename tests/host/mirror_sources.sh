@@ -0,0 +1,27 @@
+#!/bin/sh
+# Mirrors the source tree (as symbolic links) into a folder, adding the aliases the firmware build gets for
+# free from the case insensitive Windows file system: lower case names (i.e. "utils/utils.h" for "utils/Utils.h")
+# and backslash separated paths (i.e. "utils\Utils.h").
+# Sources are compiled from the mirror, so that includes relative to the including file find the aliases too.
+# Usage: mirror_sources.sh <source folder> <output folder>
+
+set -e
+SRC_DIR=$(cd "$1" && pwd)
+rm -rf "$2"
+mkdir -p "$2"
+OUT_DIR=$(cd "$2" && pwd)
+
+cd "$SRC_DIR"
+find . -name '*.h' -o -name '*.c' -o -name '*.cpp' | sed 's|^\./||' | while read -r file; do
+    dir=$(dirname "$file")
+    name=$(basename "$file")
+    lowerName=$(echo "$name" | tr 'A-Z' 'a-z')
+    mkdir -p "$OUT_DIR/$dir"
+    ln -sf "$SRC_DIR/$file" "$OUT_DIR/$dir/$name"
+    if [ "$lowerName" != "$name" ]; then
+        ln -sf "$SRC_DIR/$file" "$OUT_DIR/$dir/$lowerName"
+    fi
+    if [ "$dir" != "." ]; then
+        ln -sf "$SRC_DIR/$file" "$OUT_DIR/$dir\\$name"
+    fi
+done
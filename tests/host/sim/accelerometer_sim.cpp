@@ -0,0 +1,18 @@
+#include "sim.h"
+#include "modules/accelerometer.h"
+
+namespace Sim
+{
+    static int currentFace = 0;
+
+    void setCurrentFace(int face) {
+        currentFace = face;
+    }
+}
+
+namespace Modules::Accelerometer
+{
+    int currentFace() {
+        return Sim::currentFace;
+    }
+}
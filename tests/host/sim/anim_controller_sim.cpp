@@ -0,0 +1,24 @@
+#include "sim.h"
+#include "modules/anim_controller.h"
+
+namespace Sim
+{
+    static PlayCallback playCallback = nullptr;
+
+    void setPlayCallback(PlayCallback callback) {
+        playCallback = callback;
+    }
+}
+
+// Stand-in for the anim controller, for programs rendering animations on their own (i.e. benchmarks)
+namespace Modules::AnimController
+{
+    void play(const Animations::Animation* animationPreset, const DataSet::AnimationBits* animationBits, uint8_t remapFace, uint8_t loopCount, Animations::AnimationTag tag) {
+        if (Sim::playCallback != nullptr) {
+            Sim::playCallback(animationPreset, animationBits, remapFace, loopCount);
+        }
+    }
+
+    void stop(const Animations::Animation* animationPreset, uint8_t remapFace) {
+    }
+}
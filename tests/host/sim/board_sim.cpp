@@ -0,0 +1,36 @@
+#include "config/board_config.h"
+
+namespace Sim
+{
+    // Pins don't matter on a host, the LED count follows the layout, see setLayoutType()
+    static Board board = {
+        .boardResistorValueInKOhms = 0,
+        .ledDataPin = 1,
+        .ledPowerPin = 0,
+        .ledReturnPin = 10,
+        .i2cDataPin = 14,
+        .i2cClockPin = 15,
+        .accInterruptPin = 12,
+        .chargingStatePin = 6,
+        .coilSensePin = 2,
+        .vbatSensePin = 3,
+        .ntcSensePin = 6,
+        .progPin = 9,
+        .ledCount = 20,
+        .debugLedIndex = 19,
+        .model = D20BoardV15,
+        .name = "Host",
+    };
+
+    void setBoardLEDCount(uint8_t ledCount) {
+        board.ledCount = ledCount;
+        board.debugLedIndex = ledCount - 1;
+    }
+}
+
+namespace Config::BoardManager
+{
+    const Board* getBoard() {
+        return &Sim::board;
+    }
+}
@@ -0,0 +1,30 @@
+#include "sim.h"
+#include "drivers_nrf/cycle_counter.h"
+
+// Clock of the die, so that cycle budgets come out the same as on target
+#define SIM_CYCLES_PER_MS 64000
+
+namespace Sim
+{
+    static uint32_t cycles = 0;
+
+    void advanceCycleCounter(uint32_t cycleCount) {
+        cycles += cycleCount;
+    }
+}
+
+// Stand-in for the cycle counter, for programs that simulate how long the code takes on the die instead of
+// timing it on the host. The counter only moves forward through Sim::advanceCycleCounter().
+namespace DriversNRF::CycleCounter
+{
+    void init() {
+    }
+
+    uint32_t getCyclesPerMs() {
+        return SIM_CYCLES_PER_MS;
+    }
+
+    uint32_t read() {
+        return Sim::cycles;
+    }
+}
@@ -0,0 +1,77 @@
+#include "data_set_builder.h"
+#include "utils/Utils.h"
+
+namespace Sim
+{
+    DataSetBuilder::DataSetBuilder()
+        : animationsSize(0) {
+        bits.Clear();
+        bits.animationOffsets = nullptr;
+        bits.animationCount = 0;
+        bits.animations = nullptr;
+        bits.animationsSize = 0;
+    }
+
+    uint16_t DataSetBuilder::addColor(uint32_t color) {
+        palette.push_back(Utils::getRed(color));
+        palette.push_back(Utils::getGreen(color));
+        palette.push_back(Utils::getBlue(color));
+        return (uint16_t)(palette.size() / 3 - 1);
+    }
+
+    uint16_t DataSetBuilder::addRGBTrack(uint32_t ledMask, const std::vector<KeyframeDesc>& keyframeDescs) {
+        Animations::RGBTrack track;
+        track.keyframesOffset = (uint16_t)rgbKeyframes.size();
+        track.keyFrameCount = (uint8_t)keyframeDescs.size();
+        track.padding = 0;
+        track.ledMask = ledMask;
+        for (auto& desc : keyframeDescs) {
+            Animations::RGBKeyframe keyframe;
+            keyframe.setTimeAndColorIndex((uint16_t)desc.first, (uint16_t)desc.second);
+            rgbKeyframes.push_back(keyframe);
+        }
+        rgbTracks.push_back(track);
+        return (uint16_t)(rgbTracks.size() - 1);
+    }
+
+    uint16_t DataSetBuilder::addTrack(uint32_t ledMask, const std::vector<KeyframeDesc>& keyframeDescs) {
+        Animations::Track track;
+        track.keyframesOffset = (uint16_t)keyframes.size();
+        track.keyFrameCount = (uint8_t)keyframeDescs.size();
+        track.padding = 0;
+        track.ledMask = ledMask;
+        for (auto& desc : keyframeDescs) {
+            Animations::Keyframe keyframe;
+            keyframe.setTimeAndIntensity((uint16_t)desc.first, (uint8_t)desc.second);
+            keyframes.push_back(keyframe);
+        }
+        tracks.push_back(track);
+        return (uint16_t)(tracks.size() - 1);
+    }
+
+    uint16_t DataSetBuilder::addAnimationData(const void* data, int size) {
+        uint16_t offset = (uint16_t)animationsSize;
+        animations.resize((animationsSize + size + 3) / 4);
+        memcpy((uint8_t*)animations.data() + animationsSize, data, size);
+        animationsSize = (uint32_t)animations.size() * 4;
+        return offset;
+    }
+
+    const DataSet::AnimationBits* DataSetBuilder::getBits() {
+        bits.palette = palette.data();
+        bits.paletteSize = (uint32_t)palette.size();
+        bits.rgbKeyframes = rgbKeyframes.data();
+        bits.rgbKeyFrameCount = (uint32_t)rgbKeyframes.size();
+        bits.rgbTracks = rgbTracks.data();
+        bits.rgbTrackCount = (uint32_t)rgbTracks.size();
+        bits.keyframes = keyframes.data();
+        bits.keyFrameCount = (uint32_t)keyframes.size();
+        bits.tracks = tracks.data();
+        bits.trackCount = (uint32_t)tracks.size();
+        bits.animationOffsets = animationOffsets.data();
+        bits.animationCount = (uint32_t)animationOffsets.size();
+        bits.animations = (const uint8_t*)animations.data();
+        bits.animationsSize = animationsSize;
+        return &bits;
+    }
+}
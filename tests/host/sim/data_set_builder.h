@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <utility>
+#include "data_set/data_animation_bits.h"
+
+namespace Sim
+{
+    /// <summary>
+    /// Builds the buffers of a DataSet::AnimationBits on the host, laid out the same way the app sends them.
+    /// The builder owns the buffers, so it must outlive the animation bits it returns.
+    /// </summary>
+    class DataSetBuilder
+    {
+    public:
+        // Time (in ms) and palette index (or intensity) of a keyframe
+        typedef std::pair<int, int> KeyframeDesc;
+
+        DataSetBuilder();
+
+        // Adds a color to the palette, returns its index
+        uint16_t addColor(uint32_t color);
+
+        // Adds a RGB track (color keyframes over ledMask), returns its index
+        uint16_t addRGBTrack(uint32_t ledMask, const std::vector<KeyframeDesc>& keyframes);
+
+        // Adds an intensity track, returns its index
+        uint16_t addTrack(uint32_t ledMask, const std::vector<KeyframeDesc>& keyframes);
+
+        // Adds variable size data to the animations buffer (i.e. sequence items or baked frames), returns its offset
+        uint16_t addAnimationData(const void* data, int size);
+
+        // Adds an animation preset, returns its index
+        template <typename PresetType>
+        int addAnimation(const PresetType& preset) {
+            animationOffsets.push_back(addAnimationData(&preset, sizeof(PresetType)));
+            return (int)animationOffsets.size() - 1;
+        }
+
+        // Points the animation bits at the buffers, call again after adding anything
+        const DataSet::AnimationBits* getBits();
+
+    private:
+        std::vector<uint8_t> palette;
+        std::vector<Animations::RGBKeyframe> rgbKeyframes;
+        std::vector<Animations::RGBTrack> rgbTracks;
+        std::vector<Animations::Keyframe> keyframes;
+        std::vector<Animations::Track> tracks;
+        std::vector<uint16_t> animationOffsets;
+        std::vector<uint32_t> animations; // 4-byte aligned, like the data set in flash
+        uint32_t animationsSize;
+        DataSet::AnimationBits bits;
+    };
+}
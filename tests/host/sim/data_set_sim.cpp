@@ -0,0 +1,28 @@
+#include "sim.h"
+#include "data_set/data_set.h"
+#include "data_set/data_animation_bits.h"
+
+namespace Sim
+{
+    static const DataSet::AnimationBits* dataSetBits = nullptr;
+
+    void setDataSet(const DataSet::AnimationBits* bits) {
+        dataSetBits = bits;
+    }
+}
+
+// Stand-in for the data set, for programs that link the real anim controller
+namespace DataSet
+{
+    const AnimationBits* getAnimationBits() {
+        return Sim::dataSetBits;
+    }
+
+    const Animations::Animation* getAnimation(int animationIndex) {
+        return Sim::dataSetBits->getAnimation(animationIndex);
+    }
+
+    uint8_t getBrightness() {
+        return 255;
+    }
+}
@@ -0,0 +1,68 @@
+#include <string.h>
+#include "sim.h"
+#include "config/board_config.h"
+#include "config/settings.h"
+#include "modules/leds.h"
+#include "modules/led_power.h"
+
+namespace Sim
+{
+    static LEDsCallback ledsCallback = nullptr;
+    static LEDsLoopCallback ledsLoopCallback = nullptr;
+
+    void setLEDsCallback(LEDsCallback callback) {
+        ledsCallback = callback;
+    }
+
+    void setLEDsLoopCallback(LEDsLoopCallback callback) {
+        ledsLoopCallback = callback;
+    }
+}
+
+// Stand-ins for the LEDs and their power rail, for programs that link the real anim controller.
+// The LEDs are always powered, hand every frame to the callback, and only play loops when given a loop callback.
+namespace Modules::LEDs
+{
+    static ShowStats showStats;
+
+    void setPixelColors(uint32_t* colors) {
+        showStats.frameCount++;
+        showStats.playedCount++;
+        if (Sim::ledsCallback != nullptr) {
+            Sim::ledsCallback(colors, Config::BoardManager::getBoard()->ledCount);
+        }
+    }
+
+    void clear() {
+        uint32_t colors[MAX_LED_COUNT];
+        memset(colors, 0, sizeof(colors));
+        setPixelColors(colors);
+    }
+
+    bool playLoop(const uint32_t* colorsA, int durationAMs, const uint32_t* colorsB, int durationBMs, int count) {
+        if (Sim::ledsLoopCallback == nullptr) {
+            return false;
+        }
+        Sim::ledsLoopCallback(colorsA, durationAMs, colorsB, durationBMs, count, Config::BoardManager::getBoard()->ledCount);
+        return true;
+    }
+
+    void getShowStats(ShowStats& outStats) {
+        outStats = showStats;
+        outStats.limitTimes1000 = 1000;
+    }
+}
+
+namespace Modules::LEDPower
+{
+    void prePower() {
+    }
+
+    bool isPowerOn() {
+        return true;
+    }
+
+    void getPowerStats(PowerStats& outStats) {
+        memset(&outStats, 0, sizeof(outStats));
+    }
+}
@@ -0,0 +1,68 @@
+#include "measure.h"
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string.h>
+#include <ucontext.h>
+
+#define MEASURED_STACK_SIZE (256 * 1024)
+#define STACK_PAINT 0xA5
+
+namespace Sim
+{
+    InstructionCounter::InstructionCounter() {
+        perf_event_attr attributes;
+        memset(&attributes, 0, sizeof(attributes));
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.size = sizeof(attributes);
+        attributes.config = PERF_COUNT_HW_INSTRUCTIONS;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        fd = (int)syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+    }
+
+    InstructionCounter::~InstructionCounter() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    uint64_t InstructionCounter::read() const {
+        uint64_t count = 0;
+        if (fd >= 0 && ::read(fd, &count, sizeof(count)) != sizeof(count)) {
+            count = 0;
+        }
+        return count;
+    }
+
+    static ucontext_t callerContext;
+    static ucontext_t measuredContext;
+    static StackMeasuredFunction measuredFunction;
+    static void* measuredParam;
+    static uint8_t measuredStack[MEASURED_STACK_SIZE];
+
+    static void runMeasuredFunction() {
+        measuredFunction(measuredParam);
+    }
+
+    int measureStackUsage(StackMeasuredFunction function, void* param) {
+        measuredFunction = function;
+        measuredParam = param;
+        memset(measuredStack, STACK_PAINT, sizeof(measuredStack));
+
+        getcontext(&measuredContext);
+        measuredContext.uc_stack.ss_sp = measuredStack;
+        measuredContext.uc_stack.ss_size = sizeof(measuredStack);
+        measuredContext.uc_link = &callerContext;
+        makecontext(&measuredContext, runMeasuredFunction, 0);
+        swapcontext(&callerContext, &measuredContext);
+
+        // The stack grows down, so the first byte that isn't painted anymore is the deepest the function went
+        int unused = 0;
+        while (unused < MEASURED_STACK_SIZE && measuredStack[unused] == STACK_PAINT) {
+            unused++;
+        }
+        return MEASURED_STACK_SIZE - unused;
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace Sim
+{
+    /// <summary>
+    /// Counts the instructions the host CPU retires, through the Linux perf events.
+    /// Instruction counts are a rough (architecture dependent) approximation of the cycles the same
+    /// code takes on the die, but unlike times they don't depend on the host load.
+    /// </summary>
+    class InstructionCounter
+    {
+    public:
+        InstructionCounter();
+        ~InstructionCounter();
+
+        // False when the kernel doesn't give access to the counter (i.e. in a VM), read() then returns 0
+        bool isAvailable() const { return fd >= 0; }
+        uint64_t read() const;
+
+    private:
+        int fd;
+    };
+
+    // Runs function(param) on a separate, painted, stack and returns how many bytes of that stack it used
+    typedef void (*StackMeasuredFunction)(void* param);
+    int measureStackUsage(StackMeasuredFunction function, void* param);
+}
@@ -0,0 +1,9 @@
+#include "pixel.h"
+
+namespace Pixel
+{
+    uint32_t getDeviceID() {
+        // Any fixed id, so that blink id animations are the same on every run
+        return 0x5EED1D5E;
+    }
+}
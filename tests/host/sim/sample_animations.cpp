@@ -0,0 +1,225 @@
+#include "sample_animations.h"
+#include "animations/animation_simple.h"
+#include "animations/animation_rainbow.h"
+#include "animations/animation_keyframed.h"
+#include "animations/animation_gradientpattern.h"
+#include "animations/animation_gradient.h"
+#include "animations/animation_noise.h"
+#include "animations/animation_cycle.h"
+#include "animations/animation_blinkid.h"
+#include "animations/animation_normals.h"
+#include "animations/animation_sequence.h"
+#include "animations/animation_worm.h"
+#include "animations/animation_baked.h"
+
+using namespace Animations;
+using namespace Config;
+
+#define SAMPLE_DURATION_MS 3000
+#define SAMPLE_BAKED_FRAME_COUNT 45
+
+namespace Sim
+{
+    void addSampleAnimations(DataSetBuilder& builder, int faceCount, int animationIndices[Animation_Count]) {
+        uint16_t red = builder.addColor(0xFF0000);
+        uint16_t green = builder.addColor(0x00FF00);
+        uint16_t blue = builder.addColor(0x0000FF);
+        uint16_t white = builder.addColor(0xFFFFFF);
+        uint16_t orange = builder.addColor(0xFF8000);
+        uint16_t black = builder.addColor(0x000000);
+
+        // Gradients go over the 0 - 1000 track time
+        uint16_t rainbowGradient = builder.addRGBTrack(0, { {0, red}, {334, green}, {666, blue}, {1000, red} });
+        uint16_t fireGradient = builder.addRGBTrack(0, { {0, black}, {200, red}, {500, orange}, {800, white}, {1000, black} });
+        uint16_t flashGradient = builder.addRGBTrack(0, { {0, white}, {100, blue}, {1000, black} });
+
+        // Keyframed tracks, with holds and faces taking their color from the up face
+        uint16_t keyframedTracks = builder.addRGBTrack(0x55555, { {0, black}, {250, red}, {500, red}, {750, black} });
+        builder.addRGBTrack(0xAAAAA, { {100, green}, {400, green}, {600, blue}, {900, blue} });
+        builder.addRGBTrack(0x00F0F, { {0, PALETTE_COLOR_FROM_FACE}, {500, white}, {1000, PALETTE_COLOR_FROM_FACE} });
+
+        // Intensity tracks of the gradient pattern
+        uint16_t patternTracks = builder.addTrack(0x33333, { {0, 0}, {300, 127}, {700, 127}, {1000, 0} });
+        builder.addTrack(0xCCCCC, { {0, 127}, {500, 0}, {1000, 127} });
+
+        for (int i = 0; i < Animation_Count; ++i) {
+            animationIndices[i] = -1;
+        }
+
+        AnimationSimple simple = {};
+        simple.type = Animation_Simple;
+        simple.duration = SAMPLE_DURATION_MS;
+        simple.faceMask = ANIM_FACEMASK_ALL_LEDS;
+        simple.colorIndex = orange;
+        simple.count = 3;
+        simple.fade = 128;
+        animationIndices[Animation_Simple] = builder.addAnimation(simple);
+
+        AnimationRainbow rainbow = {};
+        rainbow.type = Animation_Rainbow;
+        rainbow.animFlags = AnimationFlags_Traveling;
+        rainbow.duration = SAMPLE_DURATION_MS;
+        rainbow.faceMask = ANIM_FACEMASK_ALL_LEDS;
+        rainbow.count = 2;
+        rainbow.fade = 128;
+        rainbow.intensity = 200;
+        rainbow.cyclesTimes10 = 10;
+        animationIndices[Animation_Rainbow] = builder.addAnimation(rainbow);
+
+        AnimationKeyframed keyframed = {};
+        keyframed.type = Animation_Keyframed;
+        keyframed.duration = SAMPLE_DURATION_MS;
+        keyframed.tracksOffset = keyframedTracks;
+        keyframed.trackCount = 3;
+        animationIndices[Animation_Keyframed] = builder.addAnimation(keyframed);
+
+        AnimationGradientPattern gradientPattern = {};
+        gradientPattern.type = Animation_GradientPattern;
+        gradientPattern.duration = SAMPLE_DURATION_MS;
+        gradientPattern.tracksOffset = patternTracks;
+        gradientPattern.trackCount = 2;
+        gradientPattern.gradientTrackOffset = rainbowGradient;
+        animationIndices[Animation_GradientPattern] = builder.addAnimation(gradientPattern);
+
+        AnimationGradient gradient = {};
+        gradient.type = Animation_Gradient;
+        gradient.duration = SAMPLE_DURATION_MS;
+        gradient.faceMask = ANIM_FACEMASK_ALL_LEDS;
+        gradient.gradientTrackOffset = fireGradient;
+        animationIndices[Animation_Gradient] = builder.addAnimation(gradient);
+
+        AnimationNoise noise = {};
+        noise.type = Animation_Noise;
+        noise.duration = SAMPLE_DURATION_MS;
+        noise.overallGradientTrackOffset = rainbowGradient;
+        noise.individualGradientTrackOffset = flashGradient;
+        noise.blinkFrequencyTimes1000 = 15000;
+        noise.blinkFrequencyVarTimes1000 = 5000;
+        noise.blinkDurationMs = 400;
+        noise.fade = 128;
+        noise.overallGradientColorType = NoiseColorOverrideType_None;
+        animationIndices[Animation_Noise] = builder.addAnimation(noise);
+
+        AnimationCycle cycle = {};
+        cycle.type = Animation_Cycle;
+        cycle.duration = SAMPLE_DURATION_MS;
+        cycle.faceMask = ANIM_FACEMASK_ALL_LEDS;
+        cycle.count = 2;
+        cycle.fade = 128;
+        cycle.intensity = 255;
+        cycle.cyclesTimes10 = 20;
+        cycle.gradientTrackOffset = rainbowGradient;
+        animationIndices[Animation_Cycle] = builder.addAnimation(cycle);
+
+        AnimationBlinkId blinkId = {};
+        blinkId.type = Animation_BlinkId;
+        blinkId.framesPerBlink = 3;
+        blinkId.brightness = 128;
+        blinkId.setDuration(1000);
+        animationIndices[Animation_BlinkId] = builder.addAnimation(blinkId);
+
+        AnimationNormals normals = {};
+        normals.type = Animation_Normals;
+        normals.duration = SAMPLE_DURATION_MS;
+        normals.gradientOverTime = flashGradient;
+        normals.gradientAlongAxis = rainbowGradient;
+        normals.gradientAlongAngle = fireGradient;
+        normals.axisScaleTimes1000 = 1000;
+        normals.axisOffsetTimes1000 = 0;
+        normals.axisScrollSpeedTimes1000 = 1000;
+        normals.angleScrollSpeedTimes1000 = -500;
+        normals.fade = 128;
+        normals.mainGradientColorType = NormalsColorOverrideType_None;
+        animationIndices[Animation_Normals] = builder.addAnimation(normals);
+
+        AnimationWorm worm = {};
+        worm.type = Animation_Worm;
+        worm.duration = SAMPLE_DURATION_MS;
+        worm.faceMask = ANIM_FACEMASK_ALL_LEDS;
+        worm.count = 2;
+        worm.fade = 128;
+        worm.intensity = 255;
+        worm.cyclesTimes10 = 15;
+        worm.gradientTrackOffset = fireGradient;
+        animationIndices[Animation_Worm] = builder.addAnimation(worm);
+
+        // Baked frames: a lit face going around the die, leaving a dimmer trail behind
+        std::vector<uint8_t> frames;
+        int maskSize = (faceCount + 7) / 8;
+        for (int f = 0; f < SAMPLE_BAKED_FRAME_COUNT; ++f) {
+            int head = f % faceCount;
+            int tail = (f + faceCount - 1) % faceCount;
+            int off = (f + faceCount - 2) % faceCount;
+            uint32_t changedFaces = (1 << head) | (1 << tail);
+            if (f >= 2 && off != head) {
+                changedFaces |= 1 << off;
+            }
+            for (int i = 0; i < maskSize; ++i) {
+                frames.push_back((uint8_t)(changedFaces >> (i * 8)));
+            }
+            for (int face = 0; face < faceCount; ++face) {
+                if (face == head) {
+                    frames.push_back((uint8_t)white);
+                } else if (face == tail && (changedFaces & (1 << face)) != 0) {
+                    frames.push_back((uint8_t)blue);
+                } else if ((changedFaces & (1 << face)) != 0) {
+                    frames.push_back(BAKED_PALETTE_INDEX_OFF);
+                }
+            }
+        }
+        AnimationBaked baked = {};
+        baked.type = Animation_Baked;
+        baked.duration = SAMPLE_DURATION_MS;
+        baked.frameCount = SAMPLE_BAKED_FRAME_COUNT;
+        baked.framesOffset = builder.addAnimationData(frames.data(), (int)frames.size());
+        baked.framesSize = (uint16_t)frames.size();
+        baked.format = BakedFormat_Palette;
+        animationIndices[Animation_Baked] = builder.addAnimation(baked);
+
+        // Sequence triggering a few of the animations above, the items not in delay order
+        AnimationSequenceItem items[] = {
+            { (uint16_t)animationIndices[Animation_Gradient], 0 },
+            { (uint16_t)animationIndices[Animation_Rainbow], 1000 },
+            { (uint16_t)animationIndices[Animation_Simple], 500 },
+            { (uint16_t)animationIndices[Animation_Worm], 1000 },
+        };
+        AnimationSequence sequence = {};
+        sequence.type = Animation_Sequence;
+        sequence.duration = SAMPLE_DURATION_MS;
+        sequence.animationsOffset = builder.addAnimationData(items, sizeof(items));
+        sequence.animationCount = sizeof(items) / sizeof(items[0]);
+        animationIndices[Animation_Sequence] = builder.addAnimation(sequence);
+    }
+
+    const char* getAnimationTypeName(AnimationType type) {
+        switch (type) {
+            case Animation_Simple: return "Simple";
+            case Animation_Rainbow: return "Rainbow";
+            case Animation_Keyframed: return "Keyframed";
+            case Animation_GradientPattern: return "GradientPattern";
+            case Animation_Gradient: return "Gradient";
+            case Animation_Noise: return "Noise";
+            case Animation_Cycle: return "Cycle";
+            case Animation_BlinkId: return "BlinkId";
+            case Animation_Normals: return "Normals";
+            case Animation_Sequence: return "Sequence";
+            case Animation_Worm: return "Worm";
+            case Animation_Baked: return "Baked";
+            default: return "Unknown";
+        }
+    }
+
+    const char* getLayoutTypeName(DiceVariants::LEDLayoutType layoutType) {
+        switch (layoutType) {
+            case DiceVariants::DieLayoutType_D4: return "D4";
+            case DiceVariants::DieLayoutType_D6_FD6: return "D6";
+            case DiceVariants::DieLayoutType_D8: return "D8";
+            case DiceVariants::DieLayoutType_D10_D00: return "D10";
+            case DiceVariants::DieLayoutType_D12: return "D12";
+            case DiceVariants::DieLayoutType_D20: return "D20";
+            case DiceVariants::DieLayoutType_PD6: return "PD6";
+            case DiceVariants::DieLayoutType_M20: return "M20";
+            default: return "Unknown";
+        }
+    }
+}
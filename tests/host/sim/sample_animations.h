@@ -0,0 +1,20 @@
+#pragma once
+
+#include "animations/Animation.h"
+#include "data_set_builder.h"
+
+namespace Sim
+{
+    /// <summary>
+    /// Adds one representative preset of each animation type to the data set, with its palette and tracks.
+    /// Baked frames are encoded for faceCount faces. Fills animationIndices (indexed by AnimationType)
+    /// with the index of each preset, Animation_Unknown getting -1.
+    /// </summary>
+    void addSampleAnimations(DataSetBuilder& builder, int faceCount, int animationIndices[Animations::Animation_Count]);
+
+    // Returns a short name of the animation type, i.e. "Simple"
+    const char* getAnimationTypeName(Animations::AnimationType type);
+
+    // Returns a short name of the layout, i.e. "D20"
+    const char* getLayoutTypeName(Config::DiceVariants::LEDLayoutType layoutType);
+}
@@ -0,0 +1,20 @@
+#include "drivers_nrf/flash.h"
+#include "bluetooth/bluetooth_message_service.h"
+
+// Stand-ins for the services the anim controller registers with. Nothing is ever programmed
+// into flash or received over bluetooth on a host, so the handlers are never called.
+namespace DriversNRF::Flash
+{
+    void hookProgrammingEvent(ProgrammingEventMethod client, void* param) {
+    }
+}
+
+namespace Bluetooth::MessageService
+{
+    void RegisterMessageHandler(Message::MessageType msgType, MessageHandler handler) {
+    }
+
+    bool SendMessage(const Message* msg, int msgSize) {
+        return true;
+    }
+}
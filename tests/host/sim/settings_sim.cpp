@@ -0,0 +1,28 @@
+#include "sim.h"
+#include "config/settings.h"
+
+using namespace Config;
+
+namespace Sim
+{
+    static DiceVariants::LEDLayoutType currentLayoutType = DiceVariants::DieLayoutType_D20;
+
+    // Defined in board_sim.cpp
+    void setBoardLEDCount(uint8_t ledCount);
+
+    void setLayoutType(DiceVariants::LEDLayoutType layoutType) {
+        currentLayoutType = layoutType;
+        setBoardLEDCount(DiceVariants::getLayout(layoutType)->ledCount);
+    }
+}
+
+namespace Config::SettingsManager
+{
+    DiceVariants::LEDLayoutType getLayoutType() {
+        return Sim::currentLayoutType;
+    }
+
+    const DiceVariants::Layout* getLayout() {
+        return DiceVariants::getLayout(Sim::currentLayoutType);
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include "config/dice_variants.h"
+
+namespace Animations
+{
+    struct Animation;
+}
+
+namespace DataSet
+{
+    struct AnimationBits;
+}
+
+/// <summary>
+/// Controls of the host stand-ins for the firmware modules the animation code depends on
+/// (settings, accelerometer, board, anim controller, timers, LEDs, data set, cycle counter), see the *_sim.cpp files.
+/// </summary>
+namespace Sim
+{
+    // Sets the die SettingsManager::getLayout() returns, the board LED count follows
+    void setLayoutType(Config::DiceVariants::LEDLayoutType layoutType);
+
+    // Sets the face Accelerometer::currentFace() returns
+    void setCurrentFace(int face);
+
+    // Called by AnimController::play() when the real anim controller isn't linked in
+    typedef void (*PlayCallback)(const Animations::Animation* preset, const DataSet::AnimationBits* bits, uint8_t remapFace, uint8_t loopCount);
+    void setPlayCallback(PlayCallback callback);
+
+    // Moves Timers::millis() forward to untilMs, firing the timers that expire on the way, in order
+    void runTimers(int untilMs);
+
+    // Host time spent in the timer handlers so far, in nanoseconds, i.e. how long timers kept the CPU awake
+    uint64_t getTimerHandlersNs();
+
+    // Called with each frame the real anim controller sends to the LEDs, in daisy chain order
+    typedef void (*LEDsCallback)(const uint32_t* colors, int ledCount);
+    void setLEDsCallback(LEDsCallback callback);
+
+    // Called when the real anim controller hands a two frame loop over to the LEDs, which only play loops
+    // once this is set. The LEDs are left with the second frame.
+    typedef void (*LEDsLoopCallback)(const uint32_t* colorsA, int durationAMs, const uint32_t* colorsB, int durationBMs, int count, int ledCount);
+    void setLEDsLoopCallback(LEDsLoopCallback callback);
+
+    // Moves the simulated cycle counter forward, for programs linked with sim/cycle_counter_sim.cpp
+    // instead of the host cycle counter (which counts nanoseconds)
+    void advanceCycleCounter(uint32_t cycleCount);
+
+    // Sets the animations DataSet::getAnimation() and friends return
+    void setDataSet(const DataSet::AnimationBits* bits);
+}
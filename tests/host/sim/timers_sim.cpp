@@ -0,0 +1,85 @@
+#include "sim.h"
+#include "drivers_nrf/cycle_counter.h"
+#include "drivers_nrf/timers.h"
+#include "app_error.h"
+
+// Host stand-in for an app timer, see APP_TIMER_DEF
+struct app_timer_t
+{
+    app_timer_timeout_handler_t handler;
+    app_timer_mode_t mode;
+    bool running;
+    int expiryTime;
+    int period;
+    void* context;
+};
+
+#define SIM_TIMER_COUNT 8
+
+namespace Sim
+{
+    static app_timer_t timers[SIM_TIMER_COUNT];
+    static int timerCount = 0;
+    static int currentTime = 0;
+    static uint64_t handlersNs = 0;
+
+    void runTimers(int untilMs) {
+        for (;;) {
+            // Earliest timer due, timers started by the handlers included
+            app_timer_t* next = nullptr;
+            for (int i = 0; i < timerCount; ++i) {
+                auto& timer = timers[i];
+                if (timer.running && timer.expiryTime <= untilMs && (next == nullptr || timer.expiryTime < next->expiryTime)) {
+                    next = &timer;
+                }
+            }
+            if (next == nullptr) {
+                break;
+            }
+            if (next->expiryTime > currentTime) {
+                currentTime = next->expiryTime;
+            }
+            if (next->mode == APP_TIMER_MODE_REPEATED) {
+                next->expiryTime += next->period;
+            } else {
+                next->running = false;
+            }
+            uint32_t startTime = DriversNRF::CycleCounter::read();
+            next->handler(next->context);
+            handlersNs += DriversNRF::CycleCounter::read() - startTime;
+        }
+        if (untilMs > currentTime) {
+            currentTime = untilMs;
+        }
+    }
+
+    uint64_t getTimerHandlersNs() {
+        return handlersNs;
+    }
+}
+
+// Timers on a simulated clock, which only moves forward through Sim::runTimers()
+namespace DriversNRF::Timers
+{
+    void createTimer(app_timer_id_t const* p_timer_id, app_timer_mode_t mode, app_timer_timeout_handler_t timeout_handler) {
+        ASSERT(Sim::timerCount < SIM_TIMER_COUNT);
+        app_timer_t* timer = &Sim::timers[Sim::timerCount++];
+        *timer = { timeout_handler, mode, false, 0, 0, nullptr };
+        *const_cast<app_timer_id_t*>(p_timer_id) = timer;
+    }
+
+    void startTimer(app_timer_id_t timer_id, uint32_t timeout_ms, void* p_context) {
+        timer_id->running = true;
+        timer_id->expiryTime = Sim::currentTime + (int)timeout_ms;
+        timer_id->period = (int)timeout_ms;
+        timer_id->context = p_context;
+    }
+
+    void stopTimer(app_timer_id_t timer_id) {
+        timer_id->running = false;
+    }
+
+    int millis() {
+        return Sim::currentTime;
+    }
+}
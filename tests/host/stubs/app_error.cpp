@@ -0,0 +1,8 @@
+#include "app_error.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+void app_error_handler_host(ret_code_t error_code, const char* file, int line) {
+    fprintf(stderr, "%s:%d: error 0x%x\n", file, line, (unsigned)error_code);
+    abort();
+}
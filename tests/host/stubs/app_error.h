@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include "sdk_common.h"
+
+// Host stand-in for the nRF5 SDK error codes and checks, errors abort the program
+#define NRF_SUCCESS 0
+#define NRF_ERROR_NO_MEM 4
+
+typedef uint32_t ret_code_t;
+
+void app_error_handler_host(ret_code_t error_code, const char* file, int line);
+
+#define APP_ERROR_HANDLER(ERR_CODE) app_error_handler_host((ERR_CODE), __FILE__, __LINE__)
+
+#define APP_ERROR_CHECK(ERR_CODE)                                   \
+    do {                                                            \
+        const ret_code_t LOCAL_ERR_CODE = (ERR_CODE);               \
+        if (LOCAL_ERR_CODE != NRF_SUCCESS) {                        \
+            APP_ERROR_HANDLER(LOCAL_ERR_CODE);                      \
+        }                                                           \
+    } while (0)
+
+#define ASSERT(expr)                                                \
+    do {                                                            \
+        if (!(expr)) {                                              \
+            APP_ERROR_HANDLER(0xFFFFFFFF);                          \
+        }                                                           \
+    } while (0)
+
+#define NRF_LOG_ERROR_STRING_GET(code) ""
@@ -0,0 +1,3 @@
+#pragma once
+
+#include "app_error.h"
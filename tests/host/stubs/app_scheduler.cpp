@@ -0,0 +1,59 @@
+#include "app_scheduler.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Same limits as the SDK scheduler: events are copied into a queue of queue_size fixed size slots
+#define APP_SCHED_MAX_QUEUE_SIZE 64
+#define APP_SCHED_MAX_EVENT_SIZE 64
+
+struct EventSlot
+{
+    alignas(8) uint8_t data[APP_SCHED_MAX_EVENT_SIZE]; // Word aligned, like the SDK queue
+    app_sched_event_handler_t handler;
+    uint16_t size;
+};
+
+static EventSlot queue[APP_SCHED_MAX_QUEUE_SIZE];
+static uint16_t queueSize = 0;
+static uint16_t eventSize = 0;
+static uint16_t head = 0;
+static uint16_t count = 0;
+
+ret_code_t app_sched_init_host(uint16_t event_size, uint16_t queue_size) {
+    if (event_size > APP_SCHED_MAX_EVENT_SIZE || queue_size > APP_SCHED_MAX_QUEUE_SIZE) {
+        return NRF_ERROR_NO_MEM;
+    }
+    eventSize = event_size;
+    queueSize = queue_size;
+    head = 0;
+    count = 0;
+    return NRF_SUCCESS;
+}
+
+ret_code_t app_sched_event_put(void const* p_event_data, uint16_t event_size, app_sched_event_handler_t handler) {
+    if (event_size > eventSize || count >= queueSize) {
+        return NRF_ERROR_NO_MEM;
+    }
+    auto& slot = queue[(head + count) % queueSize];
+    slot.handler = handler;
+    slot.size = event_size;
+    if (p_event_data != nullptr) {
+        memcpy(slot.data, p_event_data, event_size);
+    }
+    count++;
+    return NRF_SUCCESS;
+}
+
+uint16_t app_sched_queue_space_get() {
+    return queueSize - count;
+}
+
+void app_sched_execute() {
+    // Events pushed by the handlers run in the same call, like on the die
+    while (count > 0) {
+        EventSlot slot = queue[head];
+        head = (head + 1) % queueSize;
+        count--;
+        slot.handler(slot.size != 0 ? slot.data : nullptr, slot.size);
+    }
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+#include "app_error.h"
+
+// Host stand-in for the nRF5 SDK scheduler, a queue of fixed size events executed in order, see app_scheduler.cpp
+typedef void (*app_sched_event_handler_t)(void* p_event_data, uint16_t event_size);
+
+ret_code_t app_sched_init_host(uint16_t event_size, uint16_t queue_size);
+ret_code_t app_sched_event_put(void const* p_event_data, uint16_t event_size, app_sched_event_handler_t handler);
+uint16_t app_sched_queue_space_get();
+void app_sched_execute();
+
+#define APP_SCHED_INIT(EVENT_SIZE, QUEUE_SIZE) APP_ERROR_CHECK(app_sched_init_host((EVENT_SIZE), (QUEUE_SIZE)))
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+
+// Host stand-in for the nRF5 SDK app timer types, see sim/timers_sim.cpp for the timers themselves
+#define APP_TIMER_TICKS(MS) ((uint32_t)(MS))
+
+typedef struct app_timer_t* app_timer_id_t;
+typedef void (*app_timer_timeout_handler_t)(void* p_context);
+
+typedef enum
+{
+    APP_TIMER_MODE_SINGLE_SHOT,
+    APP_TIMER_MODE_REPEATED
+} app_timer_mode_t;
+
+// Only the timer ids are defined, the host timers don't need any storage from the caller
+#define APP_TIMER_DEF(timer_id) static app_timer_id_t timer_id = nullptr
@@ -0,0 +1,4 @@
+#include "app_util_platform.h"
+
+int app_util_critical_region_depth = 0;
+void (*app_util_interrupts_enabled_hook)() = nullptr;
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+
+// Host stand-in for the nRF5 SDK critical regions. There are no interrupts on a host, tests that simulate
+// them (i.e. test_neopixel.cpp) set the hook, which is called whenever code leaves its outermost critical region,
+// i.e. where a pending interrupt would fire on the die.
+#define APP_IRQ_PRIORITY_LOWEST 7
+
+extern int app_util_critical_region_depth;
+extern void (*app_util_interrupts_enabled_hook)();
+
+#define CRITICAL_REGION_ENTER() { app_util_critical_region_depth++;
+#define CRITICAL_REGION_EXIT()                                                  \
+        app_util_critical_region_depth--;                                       \
+        if (app_util_critical_region_depth == 0 && app_util_interrupts_enabled_hook != nullptr) { \
+            app_util_interrupts_enabled_hook();                                 \
+        }                                                                       \
+    }
@@ -0,0 +1,10 @@
+#pragma once
+
+// Host stand-in for the nRF5 SDK common macros
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
+#ifndef MAX
+#define MAX(a, b) ((a) < (b) ? (b) : (a))
+#endif
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stdint.h>
+
+// Host stand-in for the nRF5 SDK busy wait delays, nothing waits on a host
+inline void nrf_delay_ms(uint32_t ms) {}
+inline void nrf_delay_us(uint32_t us) {}
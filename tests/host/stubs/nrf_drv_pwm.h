@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "app_error.h"
+
+// Host stand-in for the nRF5 SDK PWM driver, only the types and calls the NeoPixel driver uses.
+// There is no implementation, tests that link the NeoPixel driver provide a mocked PWM (see test_neopixel.cpp).
+#define NRFX_CONCAT_2(p1, p2) NRFX_CONCAT_2_(p1, p2)
+#define NRFX_CONCAT_2_(p1, p2) p1 ## p2
+#define NRFX_CONCAT_3(p1, p2, p3) NRFX_CONCAT_3_(p1, p2, p3)
+#define NRFX_CONCAT_3_(p1, p2, p3) p1 ## p2 ## p3
+
+typedef struct {
+    uint32_t unused;
+} NRF_PWM_Type;
+
+extern NRF_PWM_Type NRF_PWM0_host;
+#define NRF_PWM0 (&NRF_PWM0_host)
+
+enum {
+    NRFX_PWM0_INST_IDX,
+};
+
+#define NRF_DRV_PWM_PIN_NOT_USED 0xFF
+#define NRF_DRV_PWM_FLAG_STOP 0x01
+
+typedef uint16_t nrf_pwm_values_common_t;
+
+typedef enum {
+    NRF_PWM_CLK_16MHz,
+} nrf_pwm_clk_t;
+
+typedef enum {
+    NRF_PWM_MODE_UP,
+} nrf_pwm_mode_t;
+
+typedef enum {
+    NRF_PWM_LOAD_COMMON,
+} nrf_pwm_dec_load_t;
+
+typedef enum {
+    NRF_PWM_STEP_AUTO,
+} nrf_pwm_dec_step_t;
+
+typedef enum {
+    NRF_DRV_PWM_EVT_FINISHED,
+    NRF_DRV_PWM_EVT_END_SEQ0,
+    NRF_DRV_PWM_EVT_END_SEQ1,
+    NRF_DRV_PWM_EVT_STOPPED,
+} nrf_drv_pwm_evt_type_t;
+
+typedef void (*nrf_drv_pwm_handler_t)(nrf_drv_pwm_evt_type_t event_type);
+
+typedef struct {
+    NRF_PWM_Type* p_registers;
+    uint8_t drv_inst_idx;
+} nrf_drv_pwm_t;
+
+typedef union {
+    nrf_pwm_values_common_t const* p_common;
+} nrf_pwm_values_t;
+
+typedef struct {
+    nrf_pwm_values_t values;
+    uint16_t length;
+    uint32_t repeats;
+    uint32_t end_delay;
+} nrf_pwm_sequence_t;
+
+typedef struct {
+    uint8_t output_pins[4];
+    uint8_t irq_priority;
+    nrf_pwm_clk_t base_clock;
+    nrf_pwm_mode_t count_mode;
+    uint16_t top_value;
+    nrf_pwm_dec_load_t load_mode;
+    nrf_pwm_dec_step_t step_mode;
+} nrf_drv_pwm_config_t;
+
+ret_code_t nrf_drv_pwm_init(nrf_drv_pwm_t const* p_instance, nrf_drv_pwm_config_t const* p_config, nrf_drv_pwm_handler_t handler);
+void nrf_drv_pwm_uninit(nrf_drv_pwm_t const* p_instance);
+uint32_t nrf_drv_pwm_simple_playback(nrf_drv_pwm_t const* p_instance, nrf_pwm_sequence_t const* p_sequence, uint16_t playback_count, uint32_t flags);
+uint32_t nrf_drv_pwm_complex_playback(nrf_drv_pwm_t const* p_instance, nrf_pwm_sequence_t const* p_sequence_0, nrf_pwm_sequence_t const* p_sequence_1, uint16_t playback_count, uint32_t flags);
+bool nrf_drv_pwm_stop(nrf_drv_pwm_t const* p_instance, bool wait_until_stopped);
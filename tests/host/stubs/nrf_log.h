@@ -0,0 +1,13 @@
+#pragma once
+
+#include "sdk_common.h"
+
+// Host stand-in for the nRF5 SDK logger, log statements compile to nothing
+#define NRF_LOG_ERROR(...)
+#define NRF_LOG_WARNING(...)
+#define NRF_LOG_INFO(...)
+#define NRF_LOG_DEBUG(...)
+#define NRF_LOG_HEXDUMP_INFO(...)
+#define NRF_LOG_HEXDUMP_DEBUG(...)
+#define NRF_LOG_FLOAT_MARKER "%s%d.%02d"
+#define NRF_LOG_FLOAT(val) "", (int)(val), 0
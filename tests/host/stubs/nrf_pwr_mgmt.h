@@ -0,0 +1,3 @@
+#pragma once
+
+// Host stand-in for the nRF5 SDK power management, the power manager isn't built on a host
@@ -0,0 +1,21 @@
+#include "nrf_sdh_soc.h"
+#include "app_error.h"
+
+// Runs are reproducible, every program run gets the same "random" bytes
+static uint32_t randomState = 0x2545F491;
+
+uint32_t sd_rand_application_bytes_available_get(uint8_t* p_bytes_available) {
+    *p_bytes_available = 64;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_rand_application_vector_get(uint8_t* p_buff, uint8_t length) {
+    for (int i = 0; i < length; ++i) {
+        // xorshift32
+        randomState ^= randomState << 13;
+        randomState ^= randomState >> 17;
+        randomState ^= randomState << 5;
+        p_buff[i] = (uint8_t)randomState;
+    }
+    return NRF_SUCCESS;
+}
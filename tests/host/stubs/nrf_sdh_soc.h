@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stdint.h>
+
+// Host stand-in for the SoftDevice random number functions, a fixed pseudo random sequence, see nrf_sdh_soc.cpp
+uint32_t sd_rand_application_bytes_available_get(uint8_t* p_bytes_available);
+uint32_t sd_rand_application_vector_get(uint8_t* p_buff, uint8_t length);
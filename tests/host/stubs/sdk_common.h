@@ -0,0 +1,7 @@
+#pragma once
+
+// Host stand-in for the nRF5 SDK common header, which most SDK headers (i.e. the logger) pull in
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "nordic_common.h"
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+// Host stand-in for the board definitions shared with the bootloader
+enum BoardModel : uint8_t
+{
+    Unsupported = 0,
+    D20BoardV15,
+    D6BoardV4,
+    D6BoardV6,
+    D12BoardV2,
+    PD6BoardV3,
+    PD6BoardV5,
+    D10BoardV2,
+    D8BoardV2,
+};
+
+struct Board
+{
+    int boardResistorValueInKOhms;
+    uint32_t ledDataPin;
+    uint32_t ledPowerPin;
+    uint32_t ledReturnPin;
+    uint32_t i2cDataPin;
+    uint32_t i2cClockPin;
+    uint32_t accInterruptPin;
+    uint32_t chargingStatePin;
+    uint32_t coilSensePin;
+    uint32_t vbatSensePin;
+    uint32_t ntcSensePin;
+    uint32_t progPin;
+    uint8_t ledCount;
+    uint8_t debugLedIndex;
+    BoardModel model;
+    const char* name;
+};
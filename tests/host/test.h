@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdio.h>
+
+// Minimal checks for the host tests: a failed check is reported and counted, and the test
+// goes on so that one run lists the failures (the first TEST_MAX_REPORTED_FAILURES of them).
+// main() returns TEST_RESULT().
+
+#define TEST_MAX_REPORTED_FAILURES 20
+
+extern int testFailureCount;
+
+#define TEST_CHECK(condition, ...) \
+    do { \
+        if (!(condition)) { \
+            if (testFailureCount++ < TEST_MAX_REPORTED_FAILURES) { \
+                printf("%s:%d: check failed: %s: ", __FILE__, __LINE__, #condition); \
+                printf(__VA_ARGS__); \
+                printf("\n"); \
+            } \
+        } \
+    } while (0)
+
+#define TEST_DEFINE_FAILURE_COUNT() int testFailureCount = 0
+
+#define TEST_RESULT() \
+    (testFailureCount == 0 ? (printf("%s: passed\n", __FILE__), 0) : (printf("%s: %d checks failed\n", __FILE__, testFailureCount), 1))
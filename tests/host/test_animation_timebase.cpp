@@ -0,0 +1,112 @@
+// Checks the animation timebase against the formulas it replaces, for every duration (1 - 65535 ms):
+// - getPhase(ms, scale) against (ms - startTime) * scale / duration, computed on 64 bits, including
+//   the scales (a count times 1000 or 255) whose product overflows 32 bits late in long animations
+// - getFadeIntensity(ms, intensity) against the fade ramp computed with plain divisions
+// Results must be within 1 of the formulas (the divider is meant to be exact), the number of inexact
+// results is reported.
+
+#include <stdlib.h>
+#include "test.h"
+#include "sim/sim.h"
+#include "animations/Animation.h"
+
+using namespace Animations;
+using namespace Config;
+
+TEST_DEFINE_FAILURE_COUNT();
+
+// Started at a time that isn't 0, so that the times are relative to it
+#define TEST_START_TIME 123456
+
+// Number of times checked evenly spread over each duration, on top of the ones around its ends
+#define TEST_TIME_STEPS 32
+
+// Scales used by the animations: track times, rainbow wheel (count * 255), worm and cycle (count * 1000),
+// normals scroll speeds (signed 16 bits)
+static const int scales[] = { 1, 255, 1000, 255 * 255, 255 * 1000, 32767, -32768 };
+
+static const uint8_t intensities[] = { 1, 128, 255 };
+
+/// <summary>
+/// Exposes the timebase of the animation instances
+/// </summary>
+class TimebaseInstance
+    : public AnimationInstance
+{
+public:
+    TimebaseInstance(const Animation* preset)
+        : AnimationInstance(preset, nullptr) {
+    }
+    virtual int animationSize() const { return sizeof(Animation); }
+    virtual int stop(int retIndices[]) { return 0; }
+
+    using AnimationInstance::getPhase;
+    using AnimationInstance::setFadeTime;
+    using AnimationInstance::getFadeIntensity;
+};
+
+static int64_t inexactCount = 0;
+static int64_t checkCount = 0;
+
+static void checkResult(int64_t result, int64_t expected, const char* what, int duration, int time, int param) {
+    checkCount++;
+    if (result != expected) {
+        inexactCount++;
+        TEST_CHECK(llabs(result - expected) <= 1, "%s: duration %d, time %d, %d: %lld instead of %lld",
+            what, duration, time, param, (long long)result, (long long)expected);
+    }
+}
+
+static int getFadeReference(int duration, int fadeTime, int time, int intensity) {
+    int rampTime;
+    if (time <= fadeTime) {
+        rampTime = time;
+    } else if (time >= duration - fadeTime) {
+        rampTime = duration - time;
+    } else {
+        return intensity;
+    }
+    return rampTime > 0 && fadeTime > 0 ? rampTime * intensity / fadeTime : 0;
+}
+
+static void checkTime(TimebaseInstance& instance, int duration, int time) {
+    int ms = TEST_START_TIME + time;
+    for (int scale : scales) {
+        int64_t expected = (int64_t)time * scale / duration;
+        checkResult(instance.getPhase(ms, scale), expected, "getPhase", duration, time, scale);
+    }
+
+    int fadeTimes[] = { 0, 1, duration / 4, duration / 2 };
+    for (int fadeTime : fadeTimes) {
+        instance.setFadeTime(fadeTime);
+        for (int intensity : intensities) {
+            int expected = getFadeReference(duration, fadeTime, time, intensity);
+            checkResult(instance.getFadeIntensity(ms, intensity), expected, "getFadeIntensity", duration, time, fadeTime);
+        }
+    }
+}
+
+int main() {
+    Sim::setLayoutType(DiceVariants::DieLayoutType_D20);
+
+    Animation preset = {};
+    preset.type = Animation_Simple;
+    for (int duration = 1; duration <= 0xFFFF; ++duration) {
+        preset.duration = (uint16_t)duration;
+        TimebaseInstance instance(&preset);
+        instance.start(TEST_START_TIME, 0, 1);
+
+        // Around the start and the end (including past it, where looping animations go) and within
+        for (int time = -2; time <= 2; ++time) {
+            checkTime(instance, duration, time);
+            checkTime(instance, duration, duration + time);
+        }
+        checkTime(instance, duration, duration * 2);
+        for (int step = 1; step < TEST_TIME_STEPS; ++step) {
+            checkTime(instance, duration, (int)((int64_t)duration * step / TEST_TIME_STEPS));
+        }
+    }
+
+    printf("%lld results checked, %lld inexact\n", (long long)checkCount, (long long)inexactCount);
+    return TEST_RESULT();
+}
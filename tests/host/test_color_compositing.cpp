@@ -0,0 +1,182 @@
+// Compares the way frames are composited now, with the fade of each animation converted once to a multiplier
+// (ColorKernels::getFadeMultiplier() and fade()), max-blended, and the brightness applied through a table, with a
+// copy of the old path: Utils::scaleColor() and addColors() for each color, then modulateColor() for each LED.
+// Checks that:
+// - fade() matches the old scaleColor() for every channel value and every factor up to 4000 (fades out
+//   longer than FORCE_FADE_OUT_DURATION_MS brighten the colors at first), and for larger factors
+// - random stacks of faded animations give the same frames both ways, at random brightness levels
+// Reports the time per frame of both, by number of animations, faded or not.
+
+#include <string.h>
+#include "nordic_common.h"
+#include "test.h"
+#include "sim/sim.h"
+#include "drivers_nrf/cycle_counter.h"
+#include "utils/color_kernels.h"
+#include "utils/Utils.h"
+
+using namespace DriversNRF;
+using namespace Utils;
+
+TEST_DEFINE_FAILURE_COUNT();
+
+#define TEST_LED_COUNT 21
+#define TEST_MAX_LAYER_COUNT 4
+#define TEST_EXHAUSTIVE_MAX_FADE 4000
+#define TEST_LARGE_FADE_COUNT 10000
+#define TEST_STACK_COUNT 20000
+#define TEST_TIMED_FRAME_COUNT 20000
+
+static uint32_t randomState = 0x5EED;
+
+static uint32_t nextRandom() {
+    // xorshift32
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+// The color math of the old path, as Utils had it
+static uint32_t legacyScaleColor(uint32_t color, uint32_t scaleTimes1000) {
+    uint8_t red = CLAMP(getRed(color) * scaleTimes1000 / 1000, 0, 255);
+    uint8_t green = CLAMP(getGreen(color) * scaleTimes1000 / 1000, 0, 255);
+    uint8_t blue = CLAMP(getBlue(color) * scaleTimes1000 / 1000, 0, 255);
+    return toColor(red, green, blue);
+}
+
+static uint32_t legacyAddColors(uint32_t a, uint32_t b) {
+    return toColor(MAX(getRed(a), getRed(b)), MAX(getGreen(a), getGreen(b)), MAX(getBlue(a), getBlue(b)));
+}
+
+static uint32_t legacyModulateColor(uint32_t color, uint8_t intensity) {
+    int red = getRed(color) * intensity / 255;
+    int green = getGreen(color) * intensity / 255;
+    int blue = getBlue(color) * intensity / 255;
+    return toColor((uint8_t)red, (uint8_t)green, (uint8_t)blue);
+}
+
+// Animations rendered into the same frame, each with its own fade
+struct Stack
+{
+    int layerCount;
+    uint32_t layers[TEST_MAX_LAYER_COUNT][TEST_LED_COUNT];
+    uint32_t fadesTimes1000[TEST_MAX_LAYER_COUNT];
+    uint8_t brightness;
+};
+
+static void fillStack(Stack& stack, int layerCount, bool faded) {
+    stack.layerCount = layerCount;
+    for (int a = 0; a < layerCount; ++a) {
+        for (int l = 0; l < TEST_LED_COUNT; ++l) {
+            stack.layers[a][l] = nextRandom() % 4 == 0 ? 0 : nextRandom() & 0xFFFFFF;
+        }
+        // Up to twice as bright, from fades out of up to 1000 ms
+        stack.fadesTimes1000[a] = faded ? nextRandom() % 2001 : 1000;
+    }
+    stack.brightness = (uint8_t)nextRandom();
+}
+
+// The old anim controller update, after the renders
+static void legacyComposite(const Stack& stack, uint32_t* outFrame) {
+    memset(outFrame, 0, sizeof(uint32_t) * TEST_LED_COUNT);
+    for (int a = 0; a < stack.layerCount; ++a) {
+        for (int l = 0; l < TEST_LED_COUNT; ++l) {
+            uint32_t color = stack.layers[a][l];
+            if (stack.fadesTimes1000[a] != 1000) {
+                color = legacyScaleColor(color, stack.fadesTimes1000[a]);
+            }
+            outFrame[l] = legacyAddColors(outFrame[l], color);
+        }
+    }
+    for (int l = 0; l < TEST_LED_COUNT; ++l) {
+        outFrame[l] = legacyModulateColor(outFrame[l], stack.brightness);
+    }
+}
+
+// Same with the kernels, like AnimationInstance::blendColor() and the anim controller do now
+static void composite(const Stack& stack, uint32_t* outFrame) {
+    memset(outFrame, 0, sizeof(uint32_t) * TEST_LED_COUNT);
+    for (int a = 0; a < stack.layerCount; ++a) {
+        uint32_t fadeMultiplier = ColorKernels::getFadeMultiplier(stack.fadesTimes1000[a]);
+        for (int l = 0; l < TEST_LED_COUNT; ++l) {
+            uint32_t color = stack.layers[a][l];
+            if (fadeMultiplier != COLOR_FADE_MULTIPLIER_NONE) {
+                color = ColorKernels::fade(color, fadeMultiplier);
+            }
+            outFrame[l] = ColorKernels::blendMax(outFrame[l], color);
+        }
+    }
+    ColorKernels::applyBrightness(outFrame, TEST_LED_COUNT, stack.brightness);
+}
+
+static void checkFade(uint32_t fadeTimes1000) {
+    uint32_t fadeMultiplier = ColorKernels::getFadeMultiplier(fadeTimes1000);
+    for (int c = 0; c < 256; ++c) {
+        uint32_t color = toColor((uint8_t)c, (uint8_t)(255 - c), (uint8_t)(c / 3));
+        uint32_t faded = ColorKernels::fade(color, fadeMultiplier);
+        uint32_t expected = legacyScaleColor(color, fadeTimes1000);
+        TEST_CHECK(faded == expected, "fading 0x%06x by %u gives 0x%06x instead of 0x%06x", color, fadeTimes1000, faded, expected);
+    }
+}
+
+int main() {
+    CycleCounter::init();
+
+    // Every factor fades with a single multiplier
+    for (uint32_t f = 0; f <= TEST_EXHAUSTIVE_MAX_FADE; ++f) {
+        checkFade(f);
+    }
+    for (int i = 0; i < TEST_LARGE_FADE_COUNT; ++i) {
+        checkFade(TEST_EXHAUSTIVE_MAX_FADE + nextRandom() % (2 * COLOR_FADE_MAX_TIMES1000));
+    }
+    checkFade(COLOR_FADE_MAX_TIMES1000);
+    checkFade(COLOR_FADE_MAX_TIMES1000 + 1);
+
+    // Random stacks
+    int mismatchCount = 0;
+    for (int s = 0; s < TEST_STACK_COUNT; ++s) {
+        Stack stack;
+        fillStack(stack, 1 + (int)(nextRandom() % TEST_MAX_LAYER_COUNT), nextRandom() % 2 == 0);
+        uint32_t legacyFrame[TEST_LED_COUNT];
+        uint32_t frame[TEST_LED_COUNT];
+        legacyComposite(stack, legacyFrame);
+        composite(stack, frame);
+        for (int l = 0; l < TEST_LED_COUNT; ++l) {
+            if (mismatchCount < 10) {
+                TEST_CHECK(frame[l] == legacyFrame[l], "stack %d of %d animations at brightness %d: LED %d is 0x%06x instead of 0x%06x",
+                    s, stack.layerCount, stack.brightness, l, frame[l], legacyFrame[l]);
+            }
+            mismatchCount += frame[l] != legacyFrame[l] ? 1 : 0;
+        }
+    }
+    TEST_CHECK(mismatchCount == 0, "%d LEDs don't match the old path", mismatchCount);
+
+    // Timing, the frames are summed so that they can't be optimized out
+    uint32_t sum = 0;
+    static const int layerCounts[] = { 1, 2, 4 };
+    for (int faded = 0; faded < 2; ++faded) {
+        for (int layerCount : layerCounts) {
+            Stack stack;
+            fillStack(stack, layerCount, faded != 0);
+            uint32_t frame[TEST_LED_COUNT];
+            uint32_t startTime = CycleCounter::read();
+            for (int i = 0; i < TEST_TIMED_FRAME_COUNT; ++i) {
+                legacyComposite(stack, frame);
+                sum += frame[i % TEST_LED_COUNT];
+            }
+            uint32_t legacyNs = CycleCounter::read() - startTime;
+            startTime = CycleCounter::read();
+            for (int i = 0; i < TEST_TIMED_FRAME_COUNT; ++i) {
+                composite(stack, frame);
+                sum += frame[i % TEST_LED_COUNT];
+            }
+            uint32_t ns = CycleCounter::read() - startTime;
+            printf("Compositing %d %s animation%s on %d LEDs: %.1f ns per frame, %.1f ns for the old path (host times)\n",
+                layerCount, faded != 0 ? "fading" : "unfaded", layerCount > 1 ? "s" : "", TEST_LED_COUNT,
+                (double)ns / TEST_TIMED_FRAME_COUNT, (double)legacyNs / TEST_TIMED_FRAME_COUNT);
+        }
+    }
+    printf("Compositing: %d stacks compared (sum 0x%08x)\n", TEST_STACK_COUNT, sum);
+    return TEST_RESULT();
+}
@@ -0,0 +1,91 @@
+// Checks the Cortex-M4 SIMD path of the color kernels against their portable fallback, with the
+// intrinsics it uses emulated as the Armv7E-M architecture manual describes them:
+// - USUB8 subtracts each byte, and sets the GE flag of the bytes that didn't borrow (i.e. a >= b)
+// - SEL takes each byte from its first operand where the GE flag is set, from the second one elsewhere
+// Checks that:
+// - the emulation gives the results the manual lists for a few hand picked operands
+// - blendMaxDSP() matches blendMaxPortable() and Utils::addColors() for every pair of values in each channel,
+//   the other channels being random, and for random colors with garbage in the unused top byte
+
+#include <stdint.h>
+#include "test.h"
+#include "utils/Utils.h"
+
+// GE flags of the APSR, one bit per byte, as the last USUB8 left them
+static uint32_t emulatedGEFlags = 0;
+
+static uint32_t __USUB8(uint32_t a, uint32_t b) {
+    uint32_t result = 0;
+    emulatedGEFlags = 0;
+    for (int i = 0; i < 4; ++i) {
+        int difference = (int)((a >> (i * 8)) & 0xFF) - (int)((b >> (i * 8)) & 0xFF);
+        if (difference >= 0) {
+            emulatedGEFlags |= 1 << i;
+        }
+        result |= ((uint32_t)difference & 0xFF) << (i * 8);
+    }
+    return result;
+}
+
+static uint32_t __SEL(uint32_t a, uint32_t b) {
+    uint32_t result = 0;
+    for (int i = 0; i < 4; ++i) {
+        uint32_t byteMask = 0xFFu << (i * 8);
+        result |= (emulatedGEFlags & (1 << i)) ? (a & byteMask) : (b & byteMask);
+    }
+    return result;
+}
+
+#define COLOR_KERNELS_EMULATE_DSP
+#include "utils/color_kernels.h"
+
+using namespace Utils;
+
+TEST_DEFINE_FAILURE_COUNT();
+
+#define TEST_RANDOM_PAIR_COUNT 1000000
+
+static uint32_t randomState = 0x5EED;
+
+static uint32_t nextRandom() {
+    // xorshift32
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+static void checkBlendMax(uint32_t a, uint32_t b) {
+    uint32_t blended = ColorKernels::blendMaxDSP(a, b);
+    uint32_t expected = ColorKernels::blendMaxPortable(a, b);
+    TEST_CHECK(blended == expected, "blending 0x%08x and 0x%08x gives 0x%06x instead of 0x%06x", a, b, blended, expected);
+    uint32_t legacy = addColors(a & 0x00FFFFFF, b & 0x00FFFFFF);
+    TEST_CHECK(blended == legacy, "blending 0x%08x and 0x%08x gives 0x%06x, addColors() gives 0x%06x", a, b, blended, legacy);
+}
+
+int main() {
+    // The emulation itself, GE set on equal bytes too
+    uint32_t difference = __USUB8(0x10FF0080, 0x20FE0081);
+    TEST_CHECK(difference == 0xF00100FF, "USUB8 gives 0x%08x", difference);
+    TEST_CHECK(emulatedGEFlags == 0x6, "USUB8 sets GE to 0x%x", emulatedGEFlags);
+    uint32_t selected = __SEL(0x11223344, 0xAABBCCDD);
+    TEST_CHECK(selected == 0xAA2233DD, "SEL gives 0x%08x", selected);
+
+    // Every pair of values in each channel
+    for (int channel = 0; channel < 3; ++channel) {
+        int shift = channel * 8;
+        uint32_t otherMask = 0x00FFFFFF & ~(0xFFu << shift);
+        for (uint32_t x = 0; x < 256; ++x) {
+            for (uint32_t y = 0; y < 256; ++y) {
+                checkBlendMax((x << shift) | (nextRandom() & otherMask), (y << shift) | (nextRandom() & otherMask));
+            }
+        }
+    }
+
+    // Random colors, the top byte isn't part of the color and must not leak into the result
+    for (int i = 0; i < TEST_RANDOM_PAIR_COUNT; ++i) {
+        checkBlendMax(nextRandom(), nextRandom());
+    }
+
+    return TEST_RESULT();
+}
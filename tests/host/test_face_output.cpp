@@ -0,0 +1,328 @@
+// Compares the two ways animations hand their faces to render(): the old update() contract, filling parallel
+// lists of face indices and colors by testing every bit of the face or LED masks, and updateFaces(), setting a
+// face mask and a color per face, one masked fill per color. The old update() of the simple, keyframed,
+// gradient pattern and blink id animations are copied here as they were, colors computed the old way too.
+// Checks that both give the same colors for the faces a die has, on every LED layout and from every up face,
+// over the whole sample animations and a simple animation lighting some of the faces.
+// Reports the time per frame of both, on a D6, a D20 and a pixel D6 (21 LEDs, 6 faces).
+
+#include <string.h>
+#include "test.h"
+#include "sim/sim.h"
+#include "sim/data_set_builder.h"
+#include "sim/sample_animations.h"
+#include "animations/animation_blinkid.h"
+#include "animations/animation_gradientpattern.h"
+#include "animations/animation_keyframed.h"
+#include "animations/animation_simple.h"
+#include "data_set/data_animation_bits.h"
+#include "drivers_nrf/cycle_counter.h"
+#include "modules/anim_controller.h"
+#include "pixel.h"
+#include "utils/Utils.h"
+
+using namespace Animations;
+using namespace Config;
+using namespace DriversNRF;
+
+TEST_DEFINE_FAILURE_COUNT();
+
+#define TEST_PARTIAL_FACE_MASK 0x5A5A5
+#define TEST_TIMED_PASS_COUNT 200
+
+// The old lists hold an entry per LED of each track, the sample keyframed tracks overlap so they can list
+// more entries than MAX_LED_COUNT, which the old code assumed they wouldn't
+#define TEST_MAX_LIST_SIZE (3 * MAX_LED_COUNT)
+
+// Blink id message layout, as in animation_blinkid.cpp
+#define TEST_HEADER_BITS_COUNT 3
+#define TEST_DEVICE_BITS_COUNT (8 * sizeof(Pixel::getDeviceID()))
+#define TEST_CRC_BITS_COUNT 3
+#define TEST_CRC_DIVISOR 0xB
+#define TEST_CRC_MASK 0x7
+
+static const AnimationType animationTypes[] = {
+    Animation_Simple,
+    Animation_Keyframed,
+    Animation_GradientPattern,
+    Animation_BlinkId,
+};
+
+static const DiceVariants::LEDLayoutType timedLayoutTypes[] = {
+    DiceVariants::DieLayoutType_D6_FD6,
+    DiceVariants::DieLayoutType_D20,
+    DiceVariants::DieLayoutType_PD6,
+};
+
+// The old AnimationInstance::setColor()
+static int legacySetColor(uint32_t color, uint32_t faceMask, int retIndices[], uint32_t retColors[]) {
+    int c = SettingsManager::getLayout()->faceCount;
+    int retCount = 0;
+    for (int i = 0; i < c; ++i) {
+        if ((faceMask & (1 << i)) != 0) {
+            retIndices[retCount] = i;
+            retColors[retCount] = color;
+            retCount++;
+        }
+    }
+    return retCount;
+}
+
+// The loop filling the lists in the old RGBTrack::evaluate() and Track::evaluate()
+static int legacyFillTrack(uint32_t ledMask, uint32_t color, int retIndices[], uint32_t retColors[]) {
+    int currentCount = 0;
+    int ledCount = SettingsManager::getLayout()->ledCount;
+    for (int i = 0; i < ledCount; ++i) {
+        if (ledMask & (1 << i)) {
+            retIndices[currentCount] = i;
+            retColors[currentCount] = color;
+            currentCount++;
+        }
+    }
+    return currentCount;
+}
+
+static int legacySimpleUpdate(const AnimationSimple* preset, const DataSet::AnimationBits* bits, int startTime, int ms, int retIndices[], uint32_t retColors[]) {
+    uint32_t rgb = bits->getPaletteColor(preset->colorIndex);
+    uint32_t black = 0;
+    uint32_t color = 0;
+    int period = preset->duration / preset->count;
+    int fadeTime = period * preset->fade / (255 * 2);
+    int onOffTime = (period - fadeTime * 2) / 2;
+    int time = (ms - startTime) % period;
+
+    if (time <= fadeTime) {
+        color = Utils::interpolateColors(black, 0, rgb, fadeTime, time);
+    } else if (time <= fadeTime + onOffTime) {
+        color = rgb;
+    } else if (time <= fadeTime * 2 + onOffTime) {
+        color = Utils::interpolateColors(rgb, fadeTime + onOffTime, black, fadeTime * 2 + onOffTime, time);
+    } else {
+        color = black;
+    }
+    return legacySetColor(color, preset->faceMask, retIndices, retColors);
+}
+
+static int legacyKeyframedUpdate(const AnimationKeyframed* preset, const DataSet::AnimationBits* bits, int startTime, int ms, int retIndices[], uint32_t retColors[]) {
+    int time = ms - startTime;
+    const int trackTime = time * 1000 / preset->duration;
+    const RGBTrack* tracks = bits->getRGBTracks(preset->tracksOffset);
+    int totalCount = 0;
+    for (int i = 0; i < preset->trackCount; ++i) {
+        auto& track = tracks[i];
+        if (track.keyFrameCount != 0) {
+            totalCount += legacyFillTrack(track.ledMask, track.evaluateColor(bits, trackTime), retIndices + totalCount, retColors + totalCount);
+        }
+    }
+    return totalCount;
+}
+
+static int legacyGradientPatternUpdate(const AnimationGradientPattern* preset, const DataSet::AnimationBits* bits, int startTime, int ms, int retIndices[], uint32_t retColors[]) {
+    int time = ms - startTime;
+    const int trackTime = time * 1000 / preset->duration;
+    uint32_t gradientColor = preset->overrideWithFace
+        ? bits->getPaletteColor(PALETTE_COLOR_FROM_FACE)
+        : bits->getRGBTrack(preset->gradientTrackOffset).evaluateColor(bits, trackTime);
+
+    int totalCount = 0;
+    int indices[TEST_MAX_LIST_SIZE];
+    uint32_t colors[TEST_MAX_LIST_SIZE];
+    for (int i = 0; i < preset->trackCount; ++i) {
+        auto track = bits->getTrack((uint16_t)(preset->tracksOffset + i));
+        int count = 0;
+        if (track.keyFrameCount != 0) {
+            count = legacyFillTrack(track.ledMask, track.modulateColor(bits, gradientColor, trackTime), indices, colors);
+        }
+        for (int j = 0; j < count; ++j) {
+            retIndices[totalCount + j] = indices[j];
+            retColors[totalCount + j] = colors[j];
+        }
+        totalCount += count;
+    }
+    return totalCount;
+}
+
+static uint64_t legacyBlinkIdMessage() {
+    const uint64_t shiftedValue = (uint64_t)Pixel::getDeviceID() << TEST_CRC_BITS_COUNT;
+    const uint64_t mask = (uint64_t)(-1) ^ TEST_CRC_MASK;
+    uint64_t div = (uint64_t)TEST_CRC_DIVISOR << TEST_DEVICE_BITS_COUNT;
+    uint64_t crc = shiftedValue;
+    uint64_t firstBit = (uint64_t)1 << (TEST_DEVICE_BITS_COUNT + TEST_CRC_BITS_COUNT);
+    do {
+        while ((crc & firstBit) == 0) {
+            firstBit >>= 1;
+            div >>= 1;
+        }
+        crc ^= div;
+    } while ((crc & mask) != 0);
+    return (shiftedValue | crc) << TEST_HEADER_BITS_COUNT;
+}
+
+static int legacyBlinkIdUpdate(const AnimationBlinkId* preset, uint64_t message, int startTime, int ms, int retIndices[], uint32_t retColors[]) {
+    uint32_t color = 0;
+    const uint32_t brightness = (uint32_t)preset->brightness;
+    const uint32_t frameCounter = (ms - startTime) / ANIM_FRAME_DURATION_MS;
+    const uint32_t tick = frameCounter / preset->framesPerBlink;
+    const uint32_t totalTicks = preset->duration / preset->framesPerBlink / ANIM_FRAME_DURATION_MS;
+    const uint32_t preambleNumTicks = totalTicks - TEST_DEVICE_BITS_COUNT - TEST_HEADER_BITS_COUNT - TEST_CRC_BITS_COUNT;
+
+    if (tick < preambleNumTicks || tick >= totalTicks) {
+        auto whiteBrightness = brightness / 2;
+        color = (whiteBrightness << 16) | (whiteBrightness << 8) | whiteBrightness;
+    } else {
+        uint64_t msg = message;
+        uint32_t colorIndex = -1;
+        for (uint32_t i = preambleNumTicks; i <= tick; ++i) {
+            colorIndex += 1 + (msg & 1);
+            msg >>= 1;
+        }
+        colorIndex %= 3;
+        color = brightness << (16 - 8 * colorIndex);
+    }
+    return legacySetColor(color, ANIM_FACEMASK_ALL_LEDS, retIndices, retColors);
+}
+
+static uint64_t blinkIdMessage = 0;
+
+// The old update() of the animation type of the preset
+static int legacyUpdate(const Animation* preset, const DataSet::AnimationBits* bits, int startTime, int ms, int retIndices[], uint32_t retColors[]) {
+    switch (preset->type) {
+        case Animation_Simple:
+            return legacySimpleUpdate(static_cast<const AnimationSimple*>(preset), bits, startTime, ms, retIndices, retColors);
+        case Animation_Keyframed:
+            return legacyKeyframedUpdate(static_cast<const AnimationKeyframed*>(preset), bits, startTime, ms, retIndices, retColors);
+        case Animation_GradientPattern:
+            return legacyGradientPatternUpdate(static_cast<const AnimationGradientPattern*>(preset), bits, startTime, ms, retIndices, retColors);
+        case Animation_BlinkId:
+        default:
+            return legacyBlinkIdUpdate(static_cast<const AnimationBlinkId*>(preset), blinkIdMessage, startTime, ms, retIndices, retColors);
+    }
+}
+
+static void checkLayout(DiceVariants::LEDLayoutType layoutType, const DataSet::AnimationBits* bits, const int* presetIndices, int presetCount) {
+    const char* layoutName = Sim::getLayoutTypeName(layoutType);
+    Sim::setLayoutType(layoutType);
+    auto layout = SettingsManager::getLayout();
+    uint32_t dieFaceMask = (1 << layout->faceCount) - 1;
+
+    int mismatchCount = 0;
+    for (int p = 0; p < presetCount; ++p) {
+        auto preset = bits->getAnimation(presetIndices[p]);
+        const char* typeName = Sim::getAnimationTypeName(preset->type);
+        for (int upFace = 0; upFace < layout->faceCount; ++upFace) {
+            // Faces taking their color from the up face depend on it
+            Sim::setCurrentFace(upFace);
+            AnimationInstance* instance = createAnimationInstance(preset, bits);
+            instance->start(0, (uint8_t)upFace, 1);
+            for (int ms = 0; ms <= preset->duration; ms += ANIM_FRAME_DURATION_MS) {
+                // The lists, the way render() used to read them, later faces winning
+                int indices[TEST_MAX_LIST_SIZE];
+                uint32_t colors[TEST_MAX_LIST_SIZE];
+                int count = legacyUpdate(preset, bits, 0, ms, indices, colors);
+                uint32_t legacyMask = 0;
+                uint32_t legacyColors[MAX_LED_COUNT];
+                for (int i = 0; i < count; ++i) {
+                    legacyMask |= 1 << indices[i];
+                    legacyColors[indices[i]] = colors[i];
+                }
+
+                AnimationFaces faces;
+                faces.faceMask = 0;
+                instance->updateFaces(ms, faces);
+
+                // render() drops the faces the die doesn't have
+                uint32_t faceMask = faces.faceMask & dieFaceMask;
+                legacyMask &= dieFaceMask;
+                if (mismatchCount < 10) {
+                    TEST_CHECK(faceMask == legacyMask, "%s %s from face %d at %d ms: faces 0x%05x instead of 0x%05x",
+                        layoutName, typeName, upFace, ms, faceMask, legacyMask);
+                }
+                mismatchCount += faceMask != legacyMask ? 1 : 0;
+                for (uint32_t mask = faceMask & legacyMask; mask != 0; mask &= mask - 1) {
+                    int face = __builtin_ctz(mask);
+                    if (mismatchCount < 10) {
+                        TEST_CHECK(faces.colors[face] == legacyColors[face], "%s %s from face %d at %d ms: face %d is 0x%06x instead of 0x%06x",
+                            layoutName, typeName, upFace, ms, face, faces.colors[face], legacyColors[face]);
+                    }
+                    mismatchCount += faces.colors[face] != legacyColors[face] ? 1 : 0;
+                }
+            }
+            destroyAnimationInstance(instance);
+        }
+    }
+    TEST_CHECK(mismatchCount == 0, "%s: %d faces don't match the old update()", layoutName, mismatchCount);
+}
+
+int main() {
+    CycleCounter::init();
+    blinkIdMessage = legacyBlinkIdMessage();
+
+    // The sample animations, along with a simple animation on some faces only
+    Sim::DataSetBuilder builder;
+    int sampleIndices[Animation_Count];
+    Sim::addSampleAnimations(builder, MAX_LED_COUNT, sampleIndices);
+    AnimationSimple partialSimple = {};
+    partialSimple.type = Animation_Simple;
+    partialSimple.duration = 2000;
+    partialSimple.faceMask = TEST_PARTIAL_FACE_MASK;
+    partialSimple.colorIndex = builder.addColor(0x40C0FF);
+    partialSimple.count = 2;
+    partialSimple.fade = 200;
+    int partialSimpleIndex = builder.addAnimation(partialSimple);
+    auto bits = builder.getBits();
+    Sim::setDataSet(bits);
+
+    const int presetCount = sizeof(animationTypes) / sizeof(animationTypes[0]) + 1;
+    int presetIndices[presetCount];
+    for (int t = 0; t < presetCount - 1; ++t) {
+        presetIndices[t] = sampleIndices[animationTypes[t]];
+    }
+    presetIndices[presetCount - 1] = partialSimpleIndex;
+
+    for (int layoutType = DiceVariants::DieLayoutType_D4; layoutType <= DiceVariants::DieLayoutType_M20; ++layoutType) {
+        checkLayout((DiceVariants::LEDLayoutType)layoutType, bits, presetIndices, presetCount);
+    }
+
+    // Timing, over the whole animations from the same up face, the colors are summed so that they can't be optimized out
+    uint32_t sum = 0;
+    for (auto layoutType : timedLayoutTypes) {
+        Sim::setLayoutType(layoutType);
+        Sim::setCurrentFace(0);
+        for (int p = 0; p < presetCount; ++p) {
+            auto preset = bits->getAnimation(presetIndices[p]);
+            int frameCount = 0;
+            uint32_t startTime = CycleCounter::read();
+            for (int pass = 0; pass < TEST_TIMED_PASS_COUNT; ++pass) {
+                for (int ms = 0; ms <= preset->duration; ms += ANIM_FRAME_DURATION_MS) {
+                    int indices[TEST_MAX_LIST_SIZE];
+                    uint32_t colors[TEST_MAX_LIST_SIZE];
+                    int count = legacyUpdate(preset, bits, 0, ms, indices, colors);
+                    sum += count > 0 ? colors[count - 1] + indices[count - 1] : 0;
+                    frameCount++;
+                }
+            }
+            uint32_t legacyNs = CycleCounter::read() - startTime;
+
+            AnimationInstance* instance = createAnimationInstance(preset, bits);
+            startTime = CycleCounter::read();
+            for (int pass = 0; pass < TEST_TIMED_PASS_COUNT; ++pass) {
+                instance->start(0, 0, 1);
+                for (int ms = 0; ms <= preset->duration; ms += ANIM_FRAME_DURATION_MS) {
+                    AnimationFaces faces;
+                    faces.faceMask = 0;
+                    instance->updateFaces(ms, faces);
+                    sum += faces.faceMask != 0 ? faces.colors[31 - __builtin_clz(faces.faceMask)] + faces.faceMask : 0;
+                }
+            }
+            uint32_t ns = CycleCounter::read() - startTime;
+            destroyAnimationInstance(instance);
+
+            printf("%s %s%s: %.1f ns per frame with updateFaces(), %.1f ns with the old update() (host times)\n",
+                Sim::getLayoutTypeName(layoutType), Sim::getAnimationTypeName(preset->type),
+                presetIndices[p] == partialSimpleIndex ? " on some faces" : "",
+                (double)ns / frameCount, (double)legacyNs / frameCount);
+        }
+    }
+    printf("Face output: %d presets compared on every layout (sum 0x%08x)\n", presetCount, sum);
+    return TEST_RESULT();
+}
@@ -0,0 +1,155 @@
+// Overloads the real anim controller and checks that the frame governor keeps frames within ANIM_FRAME_BUDGET_MS.
+// The program is linked twice, with and without ANIM_FRAME_GOVERNOR (see the Makefile), and with the stand-in cycle
+// counter of sim/cycle_counter_sim.cpp: each frame costs a fixed time plus a fixed time per animation rendered,
+// charged when the frame reaches the LEDs, so that frame times are the same on any host.
+//
+// A status animation plays all along, at full rate. In bursts, low priority animations start, are replayed a
+// second later (the previous ones fade out, twice as many renders as before), and fade out a second after that.
+// Without the governor, frames stay over budget while the replayed animations fade out. With it, only the
+// frames that degrade it go over budget, and it recovers once the bursts are over.
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "test.h"
+#include "sim/sim.h"
+#include "sim/data_set_builder.h"
+#include "animations/animation_rainbow.h"
+#include "drivers_nrf/cycle_counter.h"
+#include "drivers_nrf/scheduler.h"
+#include "drivers_nrf/timers.h"
+#include "modules/anim_controller.h"
+
+using namespace Animations;
+using namespace Config;
+using namespace DriversNRF;
+using namespace Modules;
+
+TEST_DEFINE_FAILURE_COUNT();
+
+// Simulated cost of a frame: 17 renders take 26 ms, 9 renders 14 ms and the status animation alone 2 ms
+#define TEST_FRAME_COST_US 500
+#define TEST_RENDER_COST_US 1500
+
+#define TEST_LOW_PRIORITY_COUNT 8
+#define TEST_LOW_PRIORITY_DURATION_MS 5000
+#define TEST_STATUS_DURATION_MS 60000
+#define TEST_BURST_COUNT 6
+#define TEST_BURST_PERIOD_MS 5000
+#define TEST_REPLAY_TIME_MS 1000
+#define TEST_FADE_OUT_TIME_MS 2000
+#define TEST_FADE_OUT_DURATION_MS 500
+
+// Each burst may go over budget for the two frames degrading the governor, unlike the frames of a whole fade
+// out (FORCE_FADE_OUT_DURATION_MS at ANIM_FRAME_DURATION_MS)
+#define TEST_MAX_OVER_BUDGET_FRAMES_PER_BURST 2
+
+// Frame times, in simulated cycles
+static std::vector<uint32_t> frameCycles;
+static uint32_t lastRenderCount = 0;
+
+static void onLEDs(const uint32_t* colors, int ledCount) {
+    AnimController::UpdateStats stats;
+    AnimController::getUpdateStats(stats);
+    uint32_t renderCount = stats.renderCount - lastRenderCount;
+    lastRenderCount = stats.renderCount;
+
+    uint32_t cycles = (TEST_FRAME_COST_US + renderCount * TEST_RENDER_COST_US) * CycleCounter::getCyclesPerMs() / 1000;
+    Sim::advanceCycleCounter(cycles);
+    frameCycles.push_back(cycles);
+}
+
+// Moves time forward a millisecond at a time, running the scheduled events in between like the main loop does
+static void runUntil(int ms) {
+    for (int time = Timers::millis() + 1; time <= ms; ++time) {
+        Sim::runTimers(time);
+        Scheduler::update();
+    }
+}
+
+static void playLowPriorityAnimations(const DataSet::AnimationBits* bits, const int* indices) {
+    for (int i = 0; i < TEST_LOW_PRIORITY_COUNT; ++i) {
+        AnimController::play(bits->getAnimation(indices[i]), bits, 0, 1, AnimationTag_BluetoothMessage);
+    }
+}
+
+int main() {
+    CycleCounter::init();
+    Scheduler::init();
+    Sim::setLayoutType(DiceVariants::DieLayoutType_D20);
+    Sim::setCurrentFace(2);
+    Sim::setLEDsCallback(onLEDs);
+    AnimController::init();
+
+    // Rainbows don't report their coverage, so none of them is culled
+    Sim::DataSetBuilder builder;
+    int lowPriorityIndices[TEST_LOW_PRIORITY_COUNT];
+    for (int i = 0; i < TEST_LOW_PRIORITY_COUNT; ++i) {
+        AnimationRainbow rainbow = {};
+        rainbow.type = Animation_Rainbow;
+        rainbow.duration = TEST_LOW_PRIORITY_DURATION_MS;
+        rainbow.faceMask = ANIM_FACEMASK_ALL_LEDS;
+        rainbow.count = (uint8_t)(1 + i);
+        rainbow.intensity = 255;
+        rainbow.cyclesTimes10 = 10;
+        lowPriorityIndices[i] = builder.addAnimation(rainbow);
+    }
+    AnimationRainbow status = {};
+    status.type = Animation_Rainbow;
+    status.duration = TEST_STATUS_DURATION_MS;
+    status.faceMask = ANIM_FACEMASK_ALL_LEDS;
+    status.count = 1;
+    status.intensity = 128;
+    status.cyclesTimes10 = 10;
+    int statusIndex = builder.addAnimation(status);
+    auto bits = builder.getBits();
+    Sim::setDataSet(bits);
+
+    int startTime = Timers::millis();
+    AnimController::play(bits->getAnimation(statusIndex), bits, 0, 1, AnimationTag_Status);
+    for (int b = 0; b < TEST_BURST_COUNT; ++b) {
+        int burstTime = startTime + b * TEST_BURST_PERIOD_MS;
+        runUntil(burstTime);
+        playLowPriorityAnimations(bits, lowPriorityIndices);
+        runUntil(burstTime + TEST_REPLAY_TIME_MS);
+        playLowPriorityAnimations(bits, lowPriorityIndices);
+        runUntil(burstTime + TEST_FADE_OUT_TIME_MS);
+        AnimController::fadeOutAnimsWithTag(AnimationTag_BluetoothMessage, TEST_FADE_OUT_DURATION_MS);
+    }
+    int endTime = startTime + TEST_BURST_COUNT * TEST_BURST_PERIOD_MS;
+    runUntil(endTime);
+    AnimController::stopAll();
+
+    AnimController::UpdateStats stats;
+    AnimController::getUpdateStats(stats);
+    uint32_t budgetCycles = ANIM_FRAME_BUDGET_MS * CycleCounter::getCyclesPerMs();
+    int overBudgetCount = 0;
+    uint64_t busyCycles = 0;
+    for (uint32_t cycles : frameCycles) {
+        overBudgetCount += cycles > budgetCycles ? 1 : 0;
+        busyCycles += cycles;
+    }
+    std::vector<uint32_t> sortedCycles = frameCycles;
+    std::sort(sortedCycles.begin(), sortedCycles.end());
+    double cyclesPerMs = CycleCounter::getCyclesPerMs();
+    double maxMs = sortedCycles.back() / cyclesPerMs;
+    double p95Ms = sortedCycles[sortedCycles.size() * 95 / 100] / cyclesPerMs;
+
+#if ANIM_FRAME_GOVERNOR
+    TEST_CHECK(stats.governorDegradeCount > 0 && stats.governorSkipCount > 0, "the governor never kicked in");
+    TEST_CHECK(overBudgetCount <= TEST_MAX_OVER_BUDGET_FRAMES_PER_BURST * TEST_BURST_COUNT, "%d frames over budget, instead of at most %d",
+        overBudgetCount, TEST_MAX_OVER_BUDGET_FRAMES_PER_BURST * TEST_BURST_COUNT);
+    TEST_CHECK(p95Ms <= ANIM_FRAME_BUDGET_MS, "95th percentile frame of %.1f ms, over the %d ms budget", p95Ms, ANIM_FRAME_BUDGET_MS);
+#else
+    // Otherwise the overload doesn't test the governor
+    TEST_CHECK(overBudgetCount > TEST_MAX_OVER_BUDGET_FRAMES_PER_BURST * TEST_BURST_COUNT, "only %d frames over budget without the governor", overBudgetCount);
+#endif
+
+    printf("Frame governor %s: %d frames, %d over the %d ms budget, %.1f ms max, %.1f ms 95th percentile, CPU busy %.1f%% of the time\n",
+        ANIM_FRAME_GOVERNOR ? "on" : "off", (int)frameCycles.size(), overBudgetCount, ANIM_FRAME_BUDGET_MS, maxMs, p95Ms,
+        100.0 * busyCycles / ((endTime - startTime) * cyclesPerMs));
+    printf("Frame governor %s: %u renders, %u degradations, %u renders skipped (simulated frame times)\n",
+        ANIM_FRAME_GOVERNOR ? "on" : "off", stats.renderCount, stats.governorDegradeCount, stats.governorSkipCount);
+    return TEST_RESULT();
+}
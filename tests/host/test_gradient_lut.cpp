@@ -0,0 +1,134 @@
+// Bakes random gradient tracks (any keyframe count up to GRADIENT_LUT_MAX_KEYFRAMES, keyframes at any
+// time, including several at the same time) and compares the baked colors with the track's own colors
+// at every millisecond of the track range and around it. Reports the maximum error per color channel,
+// which must be 0, and the time per evaluation of both.
+
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include "test.h"
+#include "sim/sim.h"
+#include "sim/data_set_builder.h"
+#include "animations/gradient_lut.h"
+#include "animations/keyframes.h"
+#include "drivers_nrf/cycle_counter.h"
+#include "utils/Utils.h"
+
+using namespace Animations;
+using namespace Config;
+using namespace DriversNRF;
+
+TEST_DEFINE_FAILURE_COUNT();
+
+#define TEST_TRACK_COUNT 2000
+#define TEST_PALETTE_SIZE 32
+
+// Times checked, past both ends of the 0 - 1024ms track range
+#define TEST_FIRST_TIME -16
+#define TEST_LAST_TIME 1040
+
+static uint32_t randomState = 0x5EED;
+
+static uint32_t nextRandom() {
+    // xorshift32
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+static int getChannelError(uint32_t color1, uint32_t color2) {
+    int error = abs((int)Utils::getRed(color1) - (int)Utils::getRed(color2));
+    error = std::max(error, abs((int)Utils::getGreen(color1) - (int)Utils::getGreen(color2)));
+    return std::max(error, abs((int)Utils::getBlue(color1) - (int)Utils::getBlue(color2)));
+}
+
+int main() {
+#if !GRADIENT_LUT_ENABLED
+    printf("Gradient LUTs are disabled\n");
+    return 0;
+#endif
+    CycleCounter::init();
+    Sim::setLayoutType(DiceVariants::DieLayoutType_D20);
+
+    Sim::DataSetBuilder builder;
+    for (int i = 0; i < TEST_PALETTE_SIZE; ++i) {
+        builder.addColor(nextRandom() & 0xFFFFFF);
+    }
+    for (int i = 0; i < TEST_TRACK_COUNT; ++i) {
+        // Keyframe times are stored in 2ms units, pick them on a coarse grid every other track so that some are shared
+        int keyframeCount = 1 + nextRandom() % GRADIENT_LUT_MAX_KEYFRAMES;
+        int timeStep = (i & 1) != 0 ? 64 : 2;
+        std::vector<int> times;
+        for (int j = 0; j < keyframeCount; ++j) {
+            times.push_back((int)(nextRandom() % (1024 / timeStep)) * timeStep);
+        }
+        std::sort(times.begin(), times.end());
+        std::vector<Sim::DataSetBuilder::KeyframeDesc> keyframes;
+        for (int time : times) {
+            keyframes.push_back({ time, (int)(nextRandom() % TEST_PALETTE_SIZE) });
+        }
+        builder.addRGBTrack(0xFFFFF, keyframes);
+    }
+    auto bits = builder.getBits();
+
+    int maxError = 0;
+    int bakedCount = 0;
+    int64_t evaluationCount = 0;
+    int64_t lutNs = 0;
+    int64_t trackNs = 0;
+    uint32_t lutColors[TEST_LAST_TIME - TEST_FIRST_TIME + 1];
+    uint32_t trackColors[TEST_LAST_TIME - TEST_FIRST_TIME + 1];
+    for (int i = 0; i < TEST_TRACK_COUNT; ++i) {
+        auto& track = bits->getRGBTrack(i);
+        const GradientLUT* lut = GradientLUTs::acquire(bits, (uint16_t)i);
+        TEST_CHECK(lut != nullptr, "track %d (%d keyframes) not baked", i, track.keyFrameCount);
+        if (lut == nullptr) {
+            continue;
+        }
+        bakedCount++;
+
+        uint32_t startTime = CycleCounter::read();
+        for (int time = TEST_FIRST_TIME; time <= TEST_LAST_TIME; ++time) {
+            lutColors[time - TEST_FIRST_TIME] = lut->evaluateColor(time);
+        }
+        lutNs += CycleCounter::read() - startTime;
+
+        // Same as animations evaluating the track directly, with a cursor
+        KeyframeCursor cursor = { 0 };
+        startTime = CycleCounter::read();
+        for (int time = TEST_FIRST_TIME; time <= TEST_LAST_TIME; ++time) {
+            trackColors[time - TEST_FIRST_TIME] = track.evaluateColor(bits, time, cursor);
+        }
+        trackNs += CycleCounter::read() - startTime;
+
+        for (int time = TEST_FIRST_TIME; time <= TEST_LAST_TIME; ++time) {
+            int error = getChannelError(lutColors[time - TEST_FIRST_TIME], trackColors[time - TEST_FIRST_TIME]);
+            TEST_CHECK(error == 0, "track %d at %d ms: 0x%06x instead of 0x%06x", i, time,
+                lutColors[time - TEST_FIRST_TIME], trackColors[time - TEST_FIRST_TIME]);
+            maxError = std::max(maxError, error);
+            evaluationCount++;
+        }
+        GradientLUTs::release(lut);
+    }
+
+    printf("Gradient LUT: %d of %d tracks baked, %lld colors compared, max error per channel: %d\n",
+        bakedCount, TEST_TRACK_COUNT, (long long)evaluationCount, maxError);
+    printf("Gradient LUT: %.1f ns per evaluation, %.1f ns for the track (host times)\n",
+        (double)lutNs / evaluationCount, (double)trackNs / evaluationCount);
+    printf("Gradient LUT: %d bytes per baked gradient, %d bytes for the cache\n",
+        (int)sizeof(GradientLUT), (int)sizeof(GradientLUT) * MAX_BAKED_GRADIENTS);
+
+    // Tracks the tables can't hold are evaluated directly
+    Sim::DataSetBuilder largeBuilder;
+    largeBuilder.addColor(0xFF0000);
+    largeBuilder.addColor(0x0000FF);
+    std::vector<Sim::DataSetBuilder::KeyframeDesc> keyframes;
+    for (int i = 0; i <= GRADIENT_LUT_MAX_KEYFRAMES; ++i) {
+        keyframes.push_back({ i * 32, i & 1 });
+    }
+    largeBuilder.addRGBTrack(0xFFFFF, keyframes);
+    TEST_CHECK(GradientLUTs::acquire(largeBuilder.getBits(), 0) == nullptr, "track with too many keyframes baked");
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,252 @@
+// Plays blinking animations on the real anim controller and measures how often it wakes up for them, how many
+// frames it renders and how long its timer handlers keep the CPU awake. The program is linked twice, with and
+// without ANIM_HARDWARE_LOOPS (see the Makefile): the build without loops writes the color changes the LEDs show,
+// and the build with loops checks that the LEDs show the same changes, at the same times give or take the few
+// ms a loop may start late (SIMPLE_LOOP_START_MARGIN_MS), and that the 10 s blink costs a handful of wakeups.
+// Loops played by the LEDs are expanded into the frames they show. Changes from the end time of an animation on
+// aren't compared, only the colors the LEDs are left with: without loops, the controller still renders the
+// animation at its end time, which shows the start of one more period for a frame.
+//
+// Blink id animations aren't looped: their message blinks through three colors with one bit per blink, so
+// only the white preamble repeats, and it is a single hold the controller already sleeps through.
+//
+// Usage: test_hardware_loops [--check <changes file> | --write <changes file>]
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "test.h"
+#include "sim/sim.h"
+#include "sim/data_set_builder.h"
+#include "animations/animation_blinkid.h"
+#include "animations/blink.h"
+#include "drivers_nrf/cycle_counter.h"
+#include "drivers_nrf/scheduler.h"
+#include "drivers_nrf/timers.h"
+#include "modules/anim_controller.h"
+
+using namespace Animations;
+using namespace Config;
+using namespace DriversNRF;
+using namespace Modules;
+
+TEST_DEFINE_FAILURE_COUNT();
+
+#define TEST_BLINK_DURATION_MS 10000
+#define TEST_BLINK_COUNT 10
+#define TEST_BLINK_FADE 64
+#define TEST_BLINKID_PREAMBLE_MS 3000
+#define TEST_BLINKID_FRAMES_PER_BLINK 3
+#define TEST_SCENARIO_GAP_MS 500
+
+// How much later than without loops the LEDs may show a change, see SIMPLE_LOOP_START_MARGIN_MS
+#define TEST_TIME_TOLERANCE_MS 3
+
+// Most wakeups the 10 s blink may take with loops, starting it and coming back at its end
+#define TEST_MAX_LOOPED_BLINK_WAKEUPS 4
+
+enum Scenario
+{
+    Scenario_Blink,
+    Scenario_FadedBlink,
+    Scenario_BlinkId,
+    Scenario_Count,
+};
+
+static const char* scenarioNames[] = {
+    "Blink 10 s",
+    "Faded blink 10 s",
+    "Blink id",
+};
+
+// A change of the colors the LEDs show
+struct ColorChange
+{
+    int scenario;
+    int time;
+    uint32_t checksum;
+};
+
+static std::vector<ColorChange> changes;
+static int currentScenario = 0;
+static int scenarioEndTime = 0;
+static uint32_t lastChecksum = 0;
+
+static void addFrame(int time, const uint32_t* colors, int ledCount) {
+    // FNV-1a
+    uint32_t checksum = 2166136261;
+    for (int i = 0; i < ledCount; ++i) {
+        checksum = (checksum ^ colors[i]) * 16777619;
+    }
+    uint32_t previousChecksum = lastChecksum;
+    lastChecksum = checksum;
+    if (checksum != previousChecksum && time < scenarioEndTime) {
+        changes.push_back({ currentScenario, time, checksum });
+    }
+}
+
+static void onLEDs(const uint32_t* colors, int ledCount) {
+    addFrame(Timers::millis(), colors, ledCount);
+}
+
+static void onLEDsLoop(const uint32_t* colorsA, int durationAMs, const uint32_t* colorsB, int durationBMs, int count, int ledCount) {
+    int time = Timers::millis();
+    for (int i = 0; i < count; ++i) {
+        addFrame(time, colorsA, ledCount);
+        addFrame(time + durationAMs, colorsB, ledCount);
+        time += durationAMs + durationBMs;
+    }
+}
+
+// Moves time forward a millisecond at a time, running the scheduled events in between like the main loop does
+static void runUntil(int ms) {
+    for (int time = Timers::millis() + 1; time <= ms; ++time) {
+        Sim::runTimers(time);
+        Scheduler::update();
+    }
+}
+
+struct ScenarioResult
+{
+    uint32_t wakeupCount;
+    uint32_t renderCount;
+    uint32_t hardwareLoopCount;
+    uint32_t hardwareLoopMs;
+    uint64_t awakeNs;
+};
+
+static ScenarioResult playScenario(int scenario, Blink& blink, const AnimationBlinkId* blinkId, const DataSet::AnimationBits* bits) {
+    currentScenario = scenario;
+    AnimController::UpdateStats statsBefore;
+    AnimController::getUpdateStats(statsBefore);
+    uint64_t awakeNsBefore = Sim::getTimerHandlersNs();
+
+    int startTime = Timers::millis();
+    int duration;
+    scenarioEndTime = ANIM_TIME_NEVER;
+    switch (scenario) {
+        case Scenario_Blink:
+            blink.play(0xFF8000, TEST_BLINK_DURATION_MS, TEST_BLINK_COUNT);
+            duration = TEST_BLINK_DURATION_MS;
+            break;
+        case Scenario_FadedBlink:
+            blink.play(0x0080FF, TEST_BLINK_DURATION_MS, TEST_BLINK_COUNT, TEST_BLINK_FADE);
+            duration = TEST_BLINK_DURATION_MS;
+            break;
+        case Scenario_BlinkId:
+        default:
+            AnimController::play(blinkId, bits);
+            duration = blinkId->duration;
+            break;
+    }
+    scenarioEndTime = startTime + duration;
+    runUntil(scenarioEndTime + TEST_SCENARIO_GAP_MS);
+
+    // What the LEDs are left with
+    changes.push_back({ scenario, Timers::millis(), lastChecksum });
+
+    AnimController::UpdateStats stats;
+    AnimController::getUpdateStats(stats);
+    return {
+        stats.wakeupCount - statsBefore.wakeupCount,
+        stats.renderCount - statsBefore.renderCount,
+        stats.hardwareLoopCount - statsBefore.hardwareLoopCount,
+        stats.hardwareLoopMs - statsBefore.hardwareLoopMs,
+        Sim::getTimerHandlersNs() - awakeNsBefore,
+    };
+}
+
+int main(int argc, char** argv) {
+    const char* checkPath = nullptr;
+    const char* writePath = nullptr;
+    if (argc == 3 && strcmp(argv[1], "--check") == 0) {
+        checkPath = argv[2];
+    } else if (argc == 3 && strcmp(argv[1], "--write") == 0) {
+        writePath = argv[2];
+    } else if (argc != 1) {
+        fprintf(stderr, "Usage: %s [--check <changes file> | --write <changes file>]\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<ColorChange> expectedChanges;
+    if (checkPath != nullptr) {
+        FILE* file = fopen(checkPath, "r");
+        if (file == nullptr) {
+            fprintf(stderr, "Can't read %s\n", checkPath);
+            return 2;
+        }
+        ColorChange change;
+        while (fscanf(file, "%d %d %x", &change.scenario, &change.time, &change.checksum) == 3) {
+            expectedChanges.push_back(change);
+        }
+        fclose(file);
+    }
+
+    CycleCounter::init();
+    Scheduler::init();
+    Sim::setLayoutType(DiceVariants::DieLayoutType_D20);
+    Sim::setCurrentFace(2);
+    Sim::setLEDsCallback(onLEDs);
+    Sim::setLEDsLoopCallback(onLEDsLoop);
+    AnimController::init();
+
+    Sim::DataSetBuilder builder;
+    AnimationBlinkId blinkIdPreset = {};
+    blinkIdPreset.type = Animation_BlinkId;
+    blinkIdPreset.framesPerBlink = TEST_BLINKID_FRAMES_PER_BLINK;
+    blinkIdPreset.brightness = 255;
+    blinkIdPreset.setDuration(TEST_BLINKID_PREAMBLE_MS);
+    int blinkIdIndex = builder.addAnimation(blinkIdPreset);
+    auto bits = builder.getBits();
+    Sim::setDataSet(bits);
+    auto blinkId = static_cast<const AnimationBlinkId*>(bits->getAnimation(blinkIdIndex));
+
+    Blink blink;
+    ScenarioResult results[Scenario_Count];
+    for (int s = 0; s < Scenario_Count; ++s) {
+        results[s] = playScenario(s, blink, blinkId, bits);
+    }
+
+    if (writePath != nullptr) {
+        FILE* file = fopen(writePath, "w");
+        if (file == nullptr) {
+            fprintf(stderr, "Can't write %s\n", writePath);
+            return 2;
+        }
+        for (auto& change : changes) {
+            fprintf(file, "%d %d 0x%08x\n", change.scenario, change.time, change.checksum);
+        }
+        fclose(file);
+    }
+
+    if (checkPath != nullptr) {
+        // Same colors, in the same order, and no earlier than without loops
+        TEST_CHECK(changes.size() == expectedChanges.size(), "%d color changes instead of %d", (int)changes.size(), (int)expectedChanges.size());
+        for (int i = 0; i < (int)MIN(changes.size(), expectedChanges.size()); ++i) {
+            auto& change = changes[i];
+            auto& expected = expectedChanges[i];
+            int lateMs = change.time - expected.time;
+            TEST_CHECK(change.scenario == expected.scenario && change.checksum == expected.checksum && lateMs >= 0 && lateMs <= TEST_TIME_TOLERANCE_MS,
+                "%s: change %d to colors 0x%08x at %d ms instead of %s to colors 0x%08x at %d ms", scenarioNames[change.scenario],
+                i, change.checksum, change.time, scenarioNames[expected.scenario], expected.checksum, expected.time);
+        }
+    }
+
+#if ANIM_HARDWARE_LOOPS
+    TEST_CHECK(results[Scenario_Blink].hardwareLoopCount > 0, "the blink wasn't looped");
+    TEST_CHECK(results[Scenario_Blink].wakeupCount <= TEST_MAX_LOOPED_BLINK_WAKEUPS, "%u wakeups for the looped blink, instead of at most %d",
+        results[Scenario_Blink].wakeupCount, TEST_MAX_LOOPED_BLINK_WAKEUPS);
+#else
+    TEST_CHECK(results[Scenario_Blink].hardwareLoopCount == 0, "the blink was looped without hardware loops");
+#endif
+    TEST_CHECK(results[Scenario_FadedBlink].hardwareLoopCount == 0 && results[Scenario_BlinkId].hardwareLoopCount == 0,
+        "fading or multi-color animations were looped");
+
+    for (int s = 0; s < Scenario_Count; ++s) {
+        auto& result = results[s];
+        printf("Hardware loops %s, %s: %u wakeups, %u renders, %u loops over %u ms, %.1f us awake (host time)\n",
+            ANIM_HARDWARE_LOOPS ? "on" : "off", scenarioNames[s], result.wakeupCount, result.renderCount,
+            result.hardwareLoopCount, result.hardwareLoopMs, result.awakeNs / 1000.0);
+    }
+    return TEST_RESULT();
+}
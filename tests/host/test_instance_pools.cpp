@@ -0,0 +1,155 @@
+// Plays animations of every type in random order for a long while (as many at once as the pools
+// allow), and checks that:
+// - the heap is never used, malloc() and friends being wrapped to count calls (see the Makefile)
+// - creating an instance only fails when the pool of its size is full
+// - the pool stats match what was created and destroyed
+// The size the pools take on the die is checked at compile time, see animation_pools.h and check_pool_sizes.cpp.
+
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include "sim/sim.h"
+#include "sim/data_set_builder.h"
+#include "sim/sample_animations.h"
+#include "animations/animation_pools.h"
+#include "drivers_nrf/scheduler.h"
+
+using namespace Animations;
+using namespace Config;
+using namespace DriversNRF;
+
+TEST_DEFINE_FAILURE_COUNT();
+
+#define TEST_ITERATION_COUNT 200000
+
+// Heap calls, counted once the data set is built
+static bool countHeapCalls = false;
+static int heapCallCount = 0;
+
+extern "C" {
+    void* __real_malloc(size_t size);
+    void* __real_calloc(size_t count, size_t size);
+    void* __real_realloc(void* ptr, size_t size);
+    void __real_free(void* ptr);
+
+    void* __wrap_malloc(size_t size) {
+        heapCallCount += countHeapCalls ? 1 : 0;
+        return __real_malloc(size);
+    }
+    void* __wrap_calloc(size_t count, size_t size) {
+        heapCallCount += countHeapCalls ? 1 : 0;
+        return __real_calloc(count, size);
+    }
+    void* __wrap_realloc(void* ptr, size_t size) {
+        heapCallCount += countHeapCalls ? 1 : 0;
+        return __real_realloc(ptr, size);
+    }
+    void __wrap_free(void* ptr) {
+        heapCallCount += countHeapCalls ? 1 : 0;
+        __real_free(ptr);
+    }
+}
+
+static uint32_t randomState = 0x5EED;
+
+static uint32_t nextRandom() {
+    // xorshift32
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+static bool isLarge(AnimationType type) {
+    return type == Animation_Noise || type == Animation_Normals || type == Animation_Baked;
+}
+
+static void onPlay(const Animation* preset, const DataSet::AnimationBits* bits, uint8_t remapFace, uint8_t loopCount) {
+}
+
+int main() {
+    Scheduler::init();
+    Sim::setPlayCallback(onPlay);
+    Sim::setLayoutType(DiceVariants::DieLayoutType_D20);
+    Sim::setCurrentFace(2);
+
+    Sim::DataSetBuilder builder;
+    int animationIndices[Animation_Count];
+    Sim::addSampleAnimations(builder, 20, animationIndices);
+    auto bits = builder.getBits();
+
+    AnimationInstance* instances[MAX_ANIMS + MAX_LARGE_ANIMS];
+    AnimationType instanceTypes[MAX_ANIMS + MAX_LARGE_ANIMS];
+    int instanceCount = 0;
+    int smallCount = 0;
+    int largeCount = 0;
+    int createCount = 0;
+    int failureCount = 0;
+    int peakSmallCount = 0;
+    int peakLargeCount = 0;
+
+    InstancePoolStats smallStatsBefore, largeStatsBefore;
+    getInstancePoolStats(smallStatsBefore, largeStatsBefore);
+
+    countHeapCalls = true;
+    for (int i = 0; i < TEST_ITERATION_COUNT; ++i) {
+        // Create a bit more often than destroy, so that the pools are full most of the time
+        if (instanceCount == 0 || nextRandom() % 8 < 5) {
+            AnimationType type = (AnimationType)(Animation_Unknown + 1 + nextRandom() % (Animation_Count - Animation_Unknown - 1));
+            AnimationInstance* instance = createAnimationInstance(bits->getAnimation(animationIndices[type]), bits);
+            bool poolFull = isLarge(type) ? largeCount == MAX_LARGE_ANIMS : smallCount == MAX_ANIMS;
+            TEST_CHECK((instance == nullptr) == poolFull, "creating a %s instance with %d small and %d large ones %s",
+                Sim::getAnimationTypeName(type), smallCount, largeCount, instance == nullptr ? "failed" : "succeeded");
+            if (instance == nullptr) {
+                failureCount++;
+                continue;
+            }
+            createCount++;
+
+            // Play it a little, with any preparation it does on start
+            uint32_t frame[MAX_LED_COUNT];
+            memset(frame, 0, sizeof(frame));
+            instance->start(i, 0, 1);
+            instance->render(i + (int)(nextRandom() % 3000), 1000, frame);
+            Scheduler::update();
+
+            instances[instanceCount] = instance;
+            instanceTypes[instanceCount] = type;
+            instanceCount++;
+            smallCount += isLarge(type) ? 0 : 1;
+            largeCount += isLarge(type) ? 1 : 0;
+            peakSmallCount = std::max(peakSmallCount, smallCount);
+            peakLargeCount = std::max(peakLargeCount, largeCount);
+        } else {
+            int index = nextRandom() % instanceCount;
+            destroyAnimationInstance(instances[index]);
+            smallCount -= isLarge(instanceTypes[index]) ? 0 : 1;
+            largeCount -= isLarge(instanceTypes[index]) ? 1 : 0;
+            instanceCount--;
+            instances[index] = instances[instanceCount];
+            instanceTypes[index] = instanceTypes[instanceCount];
+        }
+    }
+    while (instanceCount > 0) {
+        instanceCount--;
+        destroyAnimationInstance(instances[instanceCount]);
+    }
+    countHeapCalls = false;
+
+    TEST_CHECK(heapCallCount == 0, "%d heap calls", heapCallCount);
+    TEST_CHECK(peakSmallCount == MAX_ANIMS && peakLargeCount == MAX_LARGE_ANIMS, "pools not filled up, the test doesn't stress them");
+
+    InstancePoolStats smallStats, largeStats;
+    getInstancePoolStats(smallStats, largeStats);
+    int allocCount = (int)(smallStats.allocCount - smallStatsBefore.allocCount + largeStats.allocCount - largeStatsBefore.allocCount);
+    int poolFailureCount = (int)(smallStats.failureCount - smallStatsBefore.failureCount + largeStats.failureCount - largeStatsBefore.failureCount);
+    TEST_CHECK(allocCount == createCount, "%d allocations in the stats, %d instances created", allocCount, createCount);
+    TEST_CHECK(poolFailureCount == failureCount, "%d failures in the stats, %d creations failed", poolFailureCount, failureCount);
+    TEST_CHECK(smallStats.inUseCount == 0 && largeStats.inUseCount == 0, "slots still in use");
+    TEST_CHECK(smallStats.peakInUseCount == MAX_ANIMS && largeStats.peakInUseCount == MAX_LARGE_ANIMS, "peak use doesn't match");
+
+    printf("%d instances created, %d creations failed on full pools, %d heap calls\n", createCount, failureCount, heapCallCount);
+    printf("Pools (host sizes): %d x %d bytes small slots, %d x %d bytes large slots\n",
+        smallStats.slotCount, smallStats.slotSize, largeStats.slotCount, largeStats.slotSize);
+    return TEST_RESULT();
+}
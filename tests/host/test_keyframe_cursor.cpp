@@ -0,0 +1,173 @@
+// Evaluates color and intensity tracks with the maximum number of keyframes, through cursors and through
+// a copy of the linear scan tracks used before cursors, and checks that both give the same colors:
+// - with time going forward frame after frame and wrapping around, one cursor per LED, like animations do
+// - at random times, where cursors mostly fall back to scanning from the start
+// Reports the time per evaluation of both on the forward times.
+
+#include <vector>
+#include "test.h"
+#include "sim/sim.h"
+#include "sim/data_set_builder.h"
+#include "animations/keyframes.h"
+#include "data_set/data_animation_bits.h"
+#include "drivers_nrf/cycle_counter.h"
+#include "utils/Utils.h"
+
+using namespace Animations;
+using namespace Config;
+using namespace DriversNRF;
+
+TEST_DEFINE_FAILURE_COUNT();
+
+// Keyframe counts are stored on 8 bits
+#define TEST_KEYFRAME_COUNT 255
+#define TEST_PALETTE_SIZE 64
+#define TEST_LED_COUNT 20
+#define TEST_FRAME_COUNT 20000
+#define TEST_RANDOM_TIME_COUNT 100000
+
+// Times evaluated, past both ends of the 0 - 1024ms track range
+#define TEST_FIRST_TIME -16
+#define TEST_TIME_RANGE 1056
+
+static uint32_t randomState = 0x5EED;
+
+static uint32_t nextRandom() {
+    // xorshift32
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+// The keyframe lookups tracks did before cursors, scanning from the first keyframe on every call
+static uint32_t legacyEvaluateColor(const RGBTrack& track, const DataSet::AnimationBits* bits, int time) {
+    int nextIndex = 0;
+    while (nextIndex < track.keyFrameCount && track.getRGBKeyframe(bits, nextIndex).time() < time) {
+        nextIndex++;
+    }
+    if (nextIndex == 0) {
+        return track.getRGBKeyframe(bits, 0).color(bits);
+    } else if (nextIndex == track.keyFrameCount) {
+        return track.getRGBKeyframe(bits, nextIndex - 1).color(bits);
+    }
+    auto& nextKeyframe = track.getRGBKeyframe(bits, nextIndex);
+    auto& prevKeyframe = track.getRGBKeyframe(bits, nextIndex - 1);
+    return Utils::interpolateColors(prevKeyframe.color(bits), prevKeyframe.time(), nextKeyframe.color(bits), nextKeyframe.time(), time);
+}
+
+static uint32_t legacyModulateColor(const Track& track, const DataSet::AnimationBits* bits, uint32_t color, int time) {
+    int nextIndex = 0;
+    while (nextIndex < track.keyFrameCount && track.getKeyframe(bits, (uint16_t)nextIndex).time() < time) {
+        nextIndex++;
+    }
+    uint8_t intensity;
+    if (nextIndex == 0) {
+        intensity = track.getKeyframe(bits, 0).intensity();
+    } else if (nextIndex == track.keyFrameCount) {
+        intensity = track.getKeyframe(bits, (uint16_t)(nextIndex - 1)).intensity();
+    } else {
+        auto& nextKeyframe = track.getKeyframe(bits, (uint16_t)nextIndex);
+        auto& prevKeyframe = track.getKeyframe(bits, (uint16_t)(nextIndex - 1));
+        intensity = Utils::interpolateIntensity(prevKeyframe.intensity(), prevKeyframe.time(), nextKeyframe.intensity(), nextKeyframe.time(), time);
+    }
+    return Utils::modulateColor(color, intensity);
+}
+
+// Track time of an LED on a frame, going forward by a frame duration and wrapping around, each LED a bit later
+static int getForwardTime(int frame, int led) {
+    return TEST_FIRST_TIME + (frame * 33 + led * 7) % TEST_TIME_RANGE;
+}
+
+int main() {
+    CycleCounter::init();
+    Sim::setLayoutType(DiceVariants::DieLayoutType_D20);
+
+    // Keyframes every 4ms (the time resolution is 2ms), over the whole track range
+    Sim::DataSetBuilder builder;
+    for (int i = 0; i < TEST_PALETTE_SIZE; ++i) {
+        builder.addColor(nextRandom() & 0xFFFFFF);
+    }
+    std::vector<Sim::DataSetBuilder::KeyframeDesc> rgbKeyframes;
+    std::vector<Sim::DataSetBuilder::KeyframeDesc> keyframes;
+    for (int i = 0; i < TEST_KEYFRAME_COUNT; ++i) {
+        rgbKeyframes.push_back({ i * 4, (int)(nextRandom() % TEST_PALETTE_SIZE) });
+        keyframes.push_back({ i * 4, (int)(nextRandom() % 256) });
+    }
+    builder.addRGBTrack(0xFFFFF, rgbKeyframes);
+    builder.addTrack(0xFFFFF, keyframes);
+    auto bits = builder.getBits();
+    auto& rgbTrack = bits->getRGBTrack(0);
+    auto& track = bits->getTrack(0);
+    TEST_CHECK(rgbTrack.keyFrameCount == TEST_KEYFRAME_COUNT && track.keyFrameCount == TEST_KEYFRAME_COUNT, "tracks don't have all the keyframes");
+
+    // Forward times, one cursor per LED
+    KeyframeCursor rgbCursors[TEST_LED_COUNT];
+    KeyframeCursor cursors[TEST_LED_COUNT];
+    for (int l = 0; l < TEST_LED_COUNT; ++l) {
+        rgbCursors[l].reset();
+        cursors[l].reset();
+    }
+    int mismatchCount = 0;
+    for (int frame = 0; frame < TEST_FRAME_COUNT; ++frame) {
+        for (int l = 0; l < TEST_LED_COUNT; ++l) {
+            int time = getForwardTime(frame, l);
+            uint32_t color = rgbTrack.evaluateColor(bits, time, rgbCursors[l]);
+            uint32_t expectedColor = legacyEvaluateColor(rgbTrack, bits, time);
+            uint32_t modulatedColor = track.modulateColor(bits, expectedColor, time, cursors[l]);
+            uint32_t expectedModulatedColor = legacyModulateColor(track, bits, expectedColor, time);
+            if (mismatchCount < 10) {
+                TEST_CHECK(color == expectedColor, "color at %d ms (frame %d, LED %d) is 0x%06x instead of 0x%06x", time, frame, l, color, expectedColor);
+                TEST_CHECK(modulatedColor == expectedModulatedColor, "intensity at %d ms (frame %d, LED %d) gives 0x%06x instead of 0x%06x",
+                    time, frame, l, modulatedColor, expectedModulatedColor);
+            }
+            mismatchCount += color != expectedColor || modulatedColor != expectedModulatedColor ? 1 : 0;
+        }
+    }
+
+    // Random times, going back most of the time
+    KeyframeCursor rgbCursor = { 0 };
+    KeyframeCursor cursor = { 0 };
+    for (int i = 0; i < TEST_RANDOM_TIME_COUNT; ++i) {
+        int time = TEST_FIRST_TIME + (int)(nextRandom() % TEST_TIME_RANGE);
+        uint32_t color = rgbTrack.evaluateColor(bits, time, rgbCursor);
+        uint32_t expectedColor = legacyEvaluateColor(rgbTrack, bits, time);
+        uint32_t modulatedColor = track.modulateColor(bits, expectedColor, time, cursor);
+        uint32_t expectedModulatedColor = legacyModulateColor(track, bits, expectedColor, time);
+        if (mismatchCount < 10) {
+            TEST_CHECK(color == expectedColor, "color at random time %d ms is 0x%06x instead of 0x%06x", time, color, expectedColor);
+            TEST_CHECK(modulatedColor == expectedModulatedColor, "intensity at random time %d ms gives 0x%06x instead of 0x%06x",
+                time, modulatedColor, expectedModulatedColor);
+        }
+        mismatchCount += color != expectedColor || modulatedColor != expectedModulatedColor ? 1 : 0;
+    }
+    TEST_CHECK(mismatchCount == 0, "%d evaluations don't match the linear scan", mismatchCount);
+
+    // Timing, on the forward times (the results are summed so that they can't be optimized out)
+    uint32_t sum = 0;
+    uint32_t startTime = CycleCounter::read();
+    for (int frame = 0; frame < TEST_FRAME_COUNT; ++frame) {
+        for (int l = 0; l < TEST_LED_COUNT; ++l) {
+            int time = getForwardTime(frame, l);
+            sum += rgbTrack.evaluateColor(bits, time, rgbCursors[l]);
+            sum += track.modulateColor(bits, 0xFFFFFF, time, cursors[l]);
+        }
+    }
+    uint32_t cursorNs = CycleCounter::read() - startTime;
+    startTime = CycleCounter::read();
+    for (int frame = 0; frame < TEST_FRAME_COUNT; ++frame) {
+        for (int l = 0; l < TEST_LED_COUNT; ++l) {
+            int time = getForwardTime(frame, l);
+            sum += legacyEvaluateColor(rgbTrack, bits, time);
+            sum += legacyModulateColor(track, bits, 0xFFFFFF, time);
+        }
+    }
+    uint32_t legacyNs = CycleCounter::read() - startTime;
+
+    int evaluationCount = TEST_FRAME_COUNT * TEST_LED_COUNT * 2;
+    printf("Keyframe cursor: %d keyframes, %d evaluations compared (sum 0x%08x)\n",
+        TEST_KEYFRAME_COUNT, TEST_FRAME_COUNT * TEST_LED_COUNT + TEST_RANDOM_TIME_COUNT, sum);
+    printf("Keyframe cursor: %.1f ns per forward evaluation, %.1f ns for the linear scan (host times)\n",
+        (double)cursorNs / evaluationCount, (double)legacyNs / evaluationCount);
+    return TEST_RESULT();
+}
@@ -0,0 +1,193 @@
+// Checks the lookup tables of every LED layout (see Layout::getTables()) against the layout functions they are
+// flattened from, and that:
+// - each daisy chain LED is either in the mask of the one face it shows, or a blended LED with all its faces
+// - LEDs and daisy chain indices map one to one, and each up face remaps the faces to a permutation of them
+// - random face colors give the same daisy chain frame through the tables as through the layout functions
+//   (the way animations computed their frames before the tables)
+// - the tables are rebuilt when the layout changes
+
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include "sim/sim.h"
+#include "sim/sample_animations.h"
+#include "config/dice_variants.h"
+#include "config/settings.h"
+#include "utils/Utils.h"
+
+using namespace Config;
+using namespace Utils;
+
+TEST_DEFINE_FAILURE_COUNT();
+
+#define TEST_FRAMES_PER_UP_FACE 100
+
+static uint32_t randomState = 0x5EED;
+
+static uint32_t nextRandom() {
+    // xorshift32
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+// Frame of the face colors (in animation faces), going through the layout functions for each LED
+static void computeFrameFromFunctions(const DiceVariants::Layout* layout, int upFace, const uint32_t* animFaceColors, uint32_t* outDaisyChainFrame) {
+    uint32_t faceColors[MAX_FACE_COUNT];
+    for (int f = 0; f < layout->faceCount; ++f) {
+        faceColors[layout->remapFaceIndexBasedOnUpFace(upFace, f)] = animFaceColors[f];
+    }
+    for (int d = 0; d < layout->ledCount; ++d) {
+        int faces[MAX_FACE_COUNT];
+        int faceCount = layout->faceIndicesFromLEDIndex(layout->LEDIndexFromDaisyChainIndex(d), faces);
+        uint32_t r = 0;
+        uint32_t g = 0;
+        uint32_t b = 0;
+        for (int i = 0; i < faceCount; ++i) {
+            r += getRed(faceColors[faces[i]]);
+            g += getGreen(faceColors[faces[i]]);
+            b += getBlue(faceColors[faces[i]]);
+        }
+        outDaisyChainFrame[d] = faceCount == 0 ? 0 : toColor(r / faceCount, g / faceCount, b / faceCount);
+    }
+}
+
+// Same frame, going through the tables like AnimationInstance::render() does
+static void computeFrameFromTables(const DiceVariants::Layout* layout, int upFace, const uint32_t* animFaceColors, uint32_t* outDaisyChainFrame) {
+    auto tables = layout->getTables();
+    uint32_t faceColors[MAX_FACE_COUNT];
+    memset(outDaisyChainFrame, 0, sizeof(uint32_t) * MAX_LED_COUNT);
+    for (int f = 0; f < layout->faceCount; ++f) {
+        int remappedFace = layout->remapFaceIndexBasedOnUpFace(upFace, f);
+        faceColors[remappedFace] = animFaceColors[f];
+        for (int d = 0; d < layout->ledCount; ++d) {
+            if ((tables->daisyChainMaskFromFace[remappedFace] & (1 << d)) != 0) {
+                outDaisyChainFrame[d] = animFaceColors[f];
+            }
+        }
+    }
+    for (int l = 0; l < tables->blendedLEDCount; ++l) {
+        auto& blendedLED = tables->blendedLEDs[l];
+        uint32_t r = 0;
+        uint32_t g = 0;
+        uint32_t b = 0;
+        for (int f = 0; f < layout->faceCount; ++f) {
+            if ((blendedLED.faceMask & (1 << f)) != 0) {
+                r += getRed(faceColors[f]);
+                g += getGreen(faceColors[f]);
+                b += getBlue(faceColors[f]);
+            }
+        }
+        outDaisyChainFrame[blendedLED.daisyChainIndex] = toColor(r / blendedLED.faceCount, g / blendedLED.faceCount, b / blendedLED.faceCount);
+    }
+}
+
+static void checkLayout(DiceVariants::LEDLayoutType layoutType) {
+    const char* name = Sim::getLayoutTypeName(layoutType);
+    Sim::setLayoutType(layoutType);
+    auto layout = SettingsManager::getLayout();
+    auto tables = layout->getTables();
+    TEST_CHECK(tables->layout == layout, "%s: tables built for another layout", name);
+    TEST_CHECK(layout->getTables() == tables, "%s: tables not kept", name);
+    TEST_CHECK(layout->faceCount <= MAX_FACE_COUNT && layout->ledCount <= MAX_LED_COUNT && layout->ledCount <= 32,
+        "%s: %d faces and %d LEDs don't fit the tables", name, layout->faceCount, layout->ledCount);
+
+    // Each LED against its daisy chain index and faces
+    uint32_t maskedLEDs = 0;
+    uint32_t blendedLEDs = 0;
+    int blendedLEDCount = 0;
+    for (int l = 0; l < layout->ledCount; ++l) {
+        int d = layout->daisyChainIndexFromLEDIndex(l);
+        TEST_CHECK(d >= 0 && d < layout->ledCount && layout->LEDIndexFromDaisyChainIndex(d) == l,
+            "%s: LED %d has daisy chain index %d, which maps back to LED %d", name, l, d, layout->LEDIndexFromDaisyChainIndex(d));
+
+        int faces[MAX_FACE_COUNT];
+        int faceCount = layout->faceIndicesFromLEDIndex(l, faces);
+        uint32_t faceMask = 0;
+        for (int i = 0; i < faceCount; ++i) {
+            faceMask |= 1 << faces[i];
+        }
+        for (int f = 0; f < layout->faceCount; ++f) {
+            bool inMask = (tables->daisyChainMaskFromFace[f] & (1 << d)) != 0;
+            TEST_CHECK(inMask == (faceCount == 1 && faces[0] == f), "%s: LED %d (daisy chain %d) %s the mask of face %d",
+                name, l, d, inMask ? "in" : "not in", f);
+        }
+        maskedLEDs |= faceCount == 1 ? 1 << d : 0;
+
+        int blendedIndex = -1;
+        for (int i = 0; i < tables->blendedLEDCount; ++i) {
+            if (tables->blendedLEDs[i].daisyChainIndex == d) {
+                TEST_CHECK(blendedIndex == -1, "%s: LED %d (daisy chain %d) blended twice", name, l, d);
+                blendedIndex = i;
+            }
+        }
+        if (faceCount > 1) {
+            TEST_CHECK(blendedIndex != -1, "%s: LED %d (daisy chain %d) shows %d faces but isn't blended", name, l, d, faceCount);
+            if (blendedIndex != -1) {
+                auto& blendedLED = tables->blendedLEDs[blendedIndex];
+                TEST_CHECK(blendedLED.faceMask == faceMask && blendedLED.faceCount == faceCount,
+                    "%s: LED %d (daisy chain %d) blends faces 0x%x (%d) instead of 0x%x (%d)",
+                    name, l, d, blendedLED.faceMask, blendedLED.faceCount, faceMask, faceCount);
+            }
+            blendedLEDs |= 1 << d;
+            blendedLEDCount++;
+        } else {
+            TEST_CHECK(blendedIndex == -1, "%s: LED %d (daisy chain %d) shows %d faces but is blended", name, l, d, faceCount);
+        }
+    }
+    TEST_CHECK(tables->blendedLEDCount == blendedLEDCount, "%s: %d blended LEDs instead of %d", name, tables->blendedLEDCount, blendedLEDCount);
+
+    // The masks of the faces don't overlap, and only have LEDs of the die
+    uint32_t allFaceMasks = 0;
+    for (int f = 0; f < MAX_FACE_COUNT; ++f) {
+        uint32_t mask = tables->daisyChainMaskFromFace[f];
+        TEST_CHECK((allFaceMasks & mask) == 0, "%s: mask of face %d overlaps other faces", name, f);
+        TEST_CHECK(f < layout->faceCount || mask == 0, "%s: mask set for face %d, past the %d faces", name, f, layout->faceCount);
+        allFaceMasks |= mask;
+    }
+    TEST_CHECK(allFaceMasks == maskedLEDs, "%s: faces masks have LEDs 0x%x instead of 0x%x", name, allFaceMasks, maskedLEDs);
+    TEST_CHECK((allFaceMasks & blendedLEDs) == 0, "%s: LEDs both masked and blended", name);
+
+    // Remapping from each up face, and the frames it gives
+    for (int upFace = 0; upFace < layout->faceCount; ++upFace) {
+        uint32_t remappedFaces = 0;
+        for (int f = 0; f < layout->faceCount; ++f) {
+            int remappedFace = layout->remapFaceIndexBasedOnUpFace(upFace, f);
+            TEST_CHECK(remappedFace >= 0 && remappedFace < layout->faceCount, "%s: up face %d remaps face %d to %d", name, upFace, f, remappedFace);
+            remappedFaces |= 1 << remappedFace;
+        }
+        TEST_CHECK(remappedFaces == (1u << layout->faceCount) - 1, "%s: up face %d doesn't remap to all the faces", name, upFace);
+
+        for (int i = 0; i < TEST_FRAMES_PER_UP_FACE; ++i) {
+            uint32_t animFaceColors[MAX_FACE_COUNT];
+            for (int f = 0; f < layout->faceCount; ++f) {
+                animFaceColors[f] = nextRandom() % 4 == 0 ? 0 : nextRandom() & 0xFFFFFF;
+            }
+            uint32_t expectedFrame[MAX_LED_COUNT];
+            uint32_t frame[MAX_LED_COUNT];
+            computeFrameFromFunctions(layout, upFace, animFaceColors, expectedFrame);
+            computeFrameFromTables(layout, upFace, animFaceColors, frame);
+            for (int d = 0; d < layout->ledCount; ++d) {
+                TEST_CHECK(frame[d] == expectedFrame[d], "%s: up face %d, daisy chain LED %d is 0x%06x instead of 0x%06x",
+                    name, upFace, d, frame[d], expectedFrame[d]);
+            }
+        }
+    }
+
+    printf("%s: %d faces, %d LEDs, %d blended\n", name, layout->faceCount, layout->ledCount, tables->blendedLEDCount);
+}
+
+int main() {
+    for (int layoutType = DiceVariants::DieLayoutType_D4; layoutType <= DiceVariants::DieLayoutType_M20; ++layoutType) {
+        checkLayout((DiceVariants::LEDLayoutType)layoutType);
+    }
+
+    // Going back to a layout rebuilds its tables
+    Sim::setLayoutType(DiceVariants::DieLayoutType_D4);
+    auto layout = SettingsManager::getLayout();
+    TEST_CHECK(layout->getTables()->layout == layout, "tables not rebuilt when the layout changes");
+    checkLayout(DiceVariants::DieLayoutType_D4);
+
+    return TEST_RESULT();
+}
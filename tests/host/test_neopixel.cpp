@@ -0,0 +1,468 @@
+// Runs the NeoPixel driver against a mocked PWM, which sends out sequences and raises its stop
+// interrupt at random times (the interrupt only fires outside of the driver's critical regions, as on the die).
+// Checks that:
+// - a sequence is never written to while the PWM sends it out
+// - frames are sent out in the order they were shown, and the last one always is
+// - frames shown back to back while the PWM is busy replace each other, and the playback stats count them
+// - stopping playback while a frame is waiting (i.e. to start a loop) drops it, and doesn't stall the next playback
+// - loops are sent out as two sequences with the expected holds, and showing a frame stops them
+// - full and partial frames are encoded to the exact same PWM words as the old encoder, which built each
+//   word bit by bit, and reports the time to encode a frame both ways
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "test.h"
+#include "sim/sim.h"
+#include "nrf_drv_pwm.h"
+#include "app_util_platform.h"
+#include "drivers_hw/neopixel.h"
+#include "config/board_config.h"
+#include "config/settings.h"
+#include "drivers_nrf/cycle_counter.h"
+
+using namespace DriversHW;
+using namespace Config;
+using namespace DriversNRF;
+
+TEST_DEFINE_FAILURE_COUNT();
+
+#define TEST_RANDOM_STEP_COUNT 50000
+#define TEST_ENCODED_FRAME_COUNT 5000
+#define TEST_TIMED_FRAME_COUNT 20000
+
+// Same timings as the driver, one PWM period per bit
+#define TEST_PWM_DUTY0 6
+#define TEST_PWM_DUTY1 13
+#define TEST_PWM_PERIODS_PER_MS 800
+
+NRF_PWM_Type NRF_PWM0_host;
+
+static uint32_t randomState = 0x5EED;
+
+static uint32_t nextRandom() {
+    // xorshift32
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+typedef std::vector<uint32_t> Frame;
+
+/// <summary>
+/// Mocked PWM: remembers what each started sequence held, so that writes while it is sent out can be caught,
+/// and decodes the sequences back to colors once they're sent out.
+/// </summary>
+namespace PWM
+{
+    static nrf_drv_pwm_handler_t handler = nullptr;
+
+    // Sequences of the current playback, and what they held when it started
+    static bool active = false;
+    static int sequenceCount = 0;
+    static nrf_pwm_sequence_t sequences[2];
+    static std::vector<nrf_pwm_values_common_t> startWords[2];
+    static uint16_t loopCount = 0;
+
+    // Stop event waiting for interrupts to be enabled
+    static bool stopEventPending = false;
+    static bool inInterrupt = false;
+
+    // Frames sent out to the end, loops are recorded separately
+    static std::vector<Frame> sentFrames;
+    static int finishedLoopCount = 0;
+    static int stoppedCount = 0;
+    static int startedWhileActiveCount = 0;
+
+    // Odds (in 1/256th) of the PWM being done / of the interrupt firing whenever interrupts get enabled
+    static uint32_t finishOdds = 0;
+    static uint32_t interruptOdds = 0;
+
+    Frame decode(const nrf_pwm_sequence_t& sequence) {
+        Frame frame;
+        int ledCount = (sequence.length - 1) / 24;
+        TEST_CHECK(sequence.length == ledCount * 24 + 1, "sequence of %d words", sequence.length);
+        TEST_CHECK(sequence.values.p_common[ledCount * 24] == 0x8000, "sequence not terminated");
+        for (int i = 0; i < ledCount; ++i) {
+            // Green, red, blue
+            uint32_t grb = 0;
+            for (int b = 0; b < 24; ++b) {
+                grb = (grb << 1) | ((sequence.values.p_common[i * 24 + b] & 0x7FFF) == TEST_PWM_DUTY1 ? 1 : 0);
+            }
+            frame.push_back(((grb & 0xFF00) << 8) | ((grb & 0xFF0000) >> 8) | (grb & 0xFF));
+        }
+        return frame;
+    }
+
+    void checkUnchanged(const char* when) {
+        for (int s = 0; s < sequenceCount; ++s) {
+            bool same = memcmp(sequences[s].values.p_common, startWords[s].data(), startWords[s].size() * sizeof(nrf_pwm_values_common_t)) == 0;
+            TEST_CHECK(same, "sequence %d written to while being sent out (%s)", s, when);
+        }
+    }
+
+    void start(const nrf_pwm_sequence_t* seqs, int count, uint16_t playbackCount) {
+        // The driver would restart the PWM in the middle of a sequence
+        TEST_CHECK(!active, "playback started while the PWM is busy");
+        startedWhileActiveCount += active ? 1 : 0;
+        active = true;
+        // Starting clears the stop event, whether the interrupt handled it or not
+        stopEventPending = false;
+        sequenceCount = count;
+        loopCount = playbackCount;
+        for (int s = 0; s < count; ++s) {
+            sequences[s] = seqs[s];
+            startWords[s].assign(seqs[s].values.p_common, seqs[s].values.p_common + seqs[s].length);
+        }
+    }
+
+    /// <summary>
+    /// The PWM is done with the playback, raises the stop event
+    /// </summary>
+    void finish() {
+        if (!active) {
+            return;
+        }
+        checkUnchanged("finished");
+        if (sequenceCount == 1) {
+            sentFrames.push_back(decode(sequences[0]));
+        } else {
+            finishedLoopCount++;
+        }
+        active = false;
+        stopEventPending = true;
+    }
+
+    /// <summary>
+    /// Calls the driver's handler for the pending stop event, if interrupts are enabled
+    /// </summary>
+    void fireInterrupt() {
+        if (!stopEventPending || inInterrupt || app_util_critical_region_depth > 0) {
+            return;
+        }
+        stopEventPending = false;
+        inInterrupt = true;
+        handler(NRF_DRV_PWM_EVT_STOPPED);
+        inInterrupt = false;
+    }
+
+    /// <summary>
+    /// Anything can happen when interrupts are enabled: the PWM can be done, and its interrupt can fire
+    /// </summary>
+    void onInterruptsEnabled() {
+        if (nextRandom() % 256 < finishOdds) {
+            finish();
+        }
+        if (nextRandom() % 256 < interruptOdds) {
+            fireInterrupt();
+        }
+    }
+
+    /// <summary>
+    /// Lets the PWM send out everything, until the driver is idle
+    /// </summary>
+    void runUntilIdle() {
+        for (int i = 0; i < 8 && (active || stopEventPending); ++i) {
+            finish();
+            fireInterrupt();
+        }
+        TEST_CHECK(!active && !stopEventPending, "PWM still busy");
+    }
+}
+
+ret_code_t nrf_drv_pwm_init(nrf_drv_pwm_t const* p_instance, nrf_drv_pwm_config_t const* p_config, nrf_drv_pwm_handler_t handler) {
+    PWM::handler = handler;
+    return NRF_SUCCESS;
+}
+
+void nrf_drv_pwm_uninit(nrf_drv_pwm_t const* p_instance) {
+    PWM::handler = nullptr;
+}
+
+uint32_t nrf_drv_pwm_simple_playback(nrf_drv_pwm_t const* p_instance, nrf_pwm_sequence_t const* p_sequence, uint16_t playback_count, uint32_t flags) {
+    PWM::start(p_sequence, 1, playback_count);
+    PWM::onInterruptsEnabled();
+    return NRF_SUCCESS;
+}
+
+uint32_t nrf_drv_pwm_complex_playback(nrf_drv_pwm_t const* p_instance, nrf_pwm_sequence_t const* p_sequence_0, nrf_pwm_sequence_t const* p_sequence_1, uint16_t playback_count, uint32_t flags) {
+    nrf_pwm_sequence_t seqs[2] = { *p_sequence_0, *p_sequence_1 };
+    PWM::start(seqs, 2, playback_count);
+    PWM::onInterruptsEnabled();
+    return NRF_SUCCESS;
+}
+
+bool nrf_drv_pwm_stop(nrf_drv_pwm_t const* p_instance, bool wait_until_stopped) {
+    if (PWM::active) {
+        PWM::checkUnchanged("stopped");
+        PWM::active = false;
+        PWM::stopEventPending = true;
+        PWM::stoppedCount++;
+    }
+    // The interrupt may fire while waiting for the PWM to stop
+    PWM::onInterruptsEnabled();
+    return true;
+}
+
+/// <summary>
+/// Frames shown to the driver, each with a unique color on its first LED
+/// </summary>
+static std::vector<Frame> shownFrames;
+
+static Frame makeFrame(const Frame& previous, uint32_t changedMask) {
+    Frame frame = previous;
+    for (int i = 0; i < (int)frame.size(); ++i) {
+        if ((changedMask & (1 << i)) != 0) {
+            frame[i] = nextRandom() & 0xFFFFFF;
+        }
+    }
+    frame[0] = (uint32_t)shownFrames.size() & 0xFFFFFF;
+    return frame;
+}
+
+static void show(const Frame& frame, bool partial, uint32_t changedMask) {
+    shownFrames.push_back(frame);
+    uint32_t colors[MAX_LED_COUNT];
+    memcpy(colors, frame.data(), frame.size() * sizeof(uint32_t));
+    if (partial) {
+        NeoPixel::show(colors, changedMask | 1);
+    } else {
+        NeoPixel::show(colors);
+    }
+}
+
+/// <summary>
+/// Checks that the frames sent out since the given index are shown frames, in order, starting after the given one
+/// </summary>
+static void checkSentFrames(size_t& sentIndex, size_t& shownIndex) {
+    for (; sentIndex < PWM::sentFrames.size(); ++sentIndex) {
+        size_t i = shownIndex;
+        while (i < shownFrames.size() && shownFrames[i] != PWM::sentFrames[sentIndex]) {
+            ++i;
+        }
+        TEST_CHECK(i < shownFrames.size(), "frame sent out %d isn't a frame shown after frame %d", (int)sentIndex, (int)shownIndex - 1);
+        if (i < shownFrames.size()) {
+            shownIndex = i + 1;
+        }
+    }
+}
+
+static void checkStats(uint32_t playedCount, uint32_t replacedCount, const char* step) {
+    NeoPixel::PlaybackStats stats;
+    NeoPixel::getPlaybackStats(stats);
+    TEST_CHECK(stats.playedCount == playedCount && stats.replacedCount == replacedCount, "%s: %d frames played, %d replaced, instead of %d and %d",
+        step, stats.playedCount, stats.replacedCount, playedCount, replacedCount);
+}
+
+static void testBackToBackFrames(int ledCount) {
+    // Frames shown while the PWM is busy wait, and replace each other
+    PWM::sentFrames.clear();
+    shownFrames.clear();
+    Frame frame(ledCount, 0);
+    for (int i = 0; i < 4; ++i) {
+        frame = makeFrame(frame, 0xFFFFFFFF);
+        show(frame, (i & 1) != 0, 0xFFFFFFFF);
+    }
+    TEST_CHECK(NeoPixel::isBusy(), "driver not busy with a frame being sent out");
+    checkStats(0, 2, "back to back frames");
+    PWM::runUntilIdle();
+    TEST_CHECK(PWM::sentFrames.size() == 2 && PWM::sentFrames[0] == shownFrames[0] && PWM::sentFrames[1] == shownFrames[3],
+        "back to back frames: %d frames sent out instead of the first and last ones", (int)PWM::sentFrames.size());
+    TEST_CHECK(!NeoPixel::isBusy(), "driver still busy once everything is sent out");
+    checkStats(2, 2, "back to back frames");
+
+    // Partial frames encode what changed since the frame their sequence holds, which is two frames back
+    frame = makeFrame(frame, 1 << 3);
+    show(frame, true, 1 << 3);
+    frame = makeFrame(frame, 1 << 5);
+    show(frame, true, 1 << 5);
+    PWM::runUntilIdle();
+    TEST_CHECK(PWM::sentFrames.size() == 4 && PWM::sentFrames[3] == shownFrames.back(), "partial frames not sent out as shown");
+    checkStats(4, 2, "partial frames");
+}
+
+static void testStopWhilePending(int ledCount) {
+    PWM::sentFrames.clear();
+    shownFrames.clear();
+    int finishedLoopCount = PWM::finishedLoopCount;
+
+    // One frame being sent out, one waiting, then a loop, with the stop interrupt firing after the loop started
+    Frame frame(ledCount, 0);
+    frame = makeFrame(frame, 0xFFFFFFFF);
+    show(frame, false, 0);
+    frame = makeFrame(frame, 0xFFFFFFFF);
+    show(frame, false, 0);
+
+    Frame loopA(ledCount, 0x102030);
+    Frame loopB(ledCount, 0x405060);
+    NeoPixel::playLoop(loopA.data(), 100, loopB.data(), 300, 5);
+    checkStats(4, 3, "stop while pending");
+    TEST_CHECK(PWM::active && PWM::sequenceCount == 2, "loop not started");
+    TEST_CHECK(PWM::decode(PWM::sequences[0]) == loopA && PWM::decode(PWM::sequences[1]) == loopB, "loop frames not encoded as given");
+    TEST_CHECK(PWM::loopCount == 5, "loop played %d times instead of 5", PWM::loopCount);
+    TEST_CHECK(PWM::sequences[0].length + PWM::sequences[0].end_delay == 100 * TEST_PWM_PERIODS_PER_MS
+        && PWM::sequences[1].length + PWM::sequences[1].end_delay == 300 * TEST_PWM_PERIODS_PER_MS, "loop frames not held as long as given");
+
+    // The stop of the first frame was cleared when the loop started, the loop is stopped by its own
+    PWM::fireInterrupt();
+    TEST_CHECK(PWM::active && NeoPixel::isBusy(), "loop stopped by the late stop interrupt");
+    PWM::runUntilIdle();
+    TEST_CHECK(PWM::sentFrames.empty(), "%d frames sent out, the loop should have stopped them", (int)PWM::sentFrames.size());
+    TEST_CHECK(PWM::finishedLoopCount == finishedLoopCount + 1, "loop not played to the end");
+    TEST_CHECK(!NeoPixel::isBusy(), "driver still busy once the loop is done");
+    checkStats(5, 3, "loop played to the end");
+
+    // A frame shown during a loop stops it, and is sent out with the loop's stop interrupt still pending
+    NeoPixel::playLoop(loopA.data(), 100, loopB.data(), 100, 100);
+    frame = makeFrame(frame, 0xFFFFFFFF);
+    show(frame, true, 0);
+    TEST_CHECK(PWM::active && PWM::sequenceCount == 1, "frame not sent out right away when stopping a loop");
+    PWM::runUntilIdle();
+    TEST_CHECK(PWM::sentFrames.size() == 1 && PWM::sentFrames[0] == frame, "frame shown during a loop not sent out");
+    checkStats(6, 3, "loop stopped by a frame");
+}
+
+static void testRandomTimings(int ledCount) {
+    // Shows frames while the PWM finishes and interrupts at random times
+    PWM::sentFrames.clear();
+    shownFrames.clear();
+    PWM::finishOdds = 32;
+    PWM::interruptOdds = 128;
+    size_t sentIndex = 0;
+    size_t shownIndex = 0;
+    int loopCount = 0;
+
+    // Partial frames carry on from this one
+    Frame frame(ledCount, 0);
+    frame = makeFrame(frame, 0xFFFFFFFF);
+    show(frame, false, 0);
+    for (int step = 0; step < TEST_RANDOM_STEP_COUNT; ++step) {
+        int action = nextRandom() % 100;
+        if (action < 40) {
+            uint32_t changedMask = nextRandom() & nextRandom();
+            frame = makeFrame(frame, changedMask);
+            show(frame, (action & 1) != 0, changedMask);
+        } else if (action < 42) {
+            // Frames shown before the loop must not be sent out after it
+            Frame loopA(ledCount, nextRandom() & 0xFFFFFF);
+            Frame loopB(ledCount, nextRandom() & 0xFFFFFF);
+            NeoPixel::playLoop(loopA.data(), 50, loopB.data(), 50, 1 + nextRandom() % 4);
+            checkSentFrames(sentIndex, shownIndex);
+            shownIndex = shownFrames.size();
+            loopCount++;
+        } else if (action < 43) {
+            NeoPixel::clear();
+            shownFrames.push_back(Frame(ledCount, 0));
+        } else {
+            // Time passes
+            PWM::onInterruptsEnabled();
+        }
+        checkSentFrames(sentIndex, shownIndex);
+    }
+    PWM::finishOdds = 0;
+    PWM::interruptOdds = 0;
+    PWM::runUntilIdle();
+    checkSentFrames(sentIndex, shownIndex);
+    TEST_CHECK(!PWM::sentFrames.empty() && PWM::sentFrames.back() == shownFrames.back(), "last frame shown not sent out");
+    TEST_CHECK(!NeoPixel::isBusy(), "driver still busy once everything is sent out");
+
+    NeoPixel::PlaybackStats stats;
+    NeoPixel::getPlaybackStats(stats);
+    printf("NeoPixel: %d frames shown, %d sent out, %d replaced while waiting, %d loops, %d stops\n",
+        (int)shownFrames.size(), (int)PWM::sentFrames.size(), stats.replacedCount, loopCount, PWM::stoppedCount);
+}
+
+// The encoder of the driver before the nibble table, with the termination word
+static void legacyEncode(const uint32_t* colors, int ledCount, nrf_pwm_values_common_t* words) {
+    for (int l = 0; l < ledCount; ++l) {
+        uint32_t color = colors[l];
+        int baseIndex = 24 * l;
+        for (int i = 0; i < 8; ++i) {
+            words[baseIndex + 16 + i] = ((color & 0x000080) == 0 ? TEST_PWM_DUTY0 : TEST_PWM_DUTY1) | 0x8000;
+            words[baseIndex +  8 + i] = ((color & 0x800000) == 0 ? TEST_PWM_DUTY0 : TEST_PWM_DUTY1) | 0x8000;
+            words[baseIndex      + i] = ((color & 0x008000) == 0 ? TEST_PWM_DUTY0 : TEST_PWM_DUTY1) | 0x8000;
+            color <<= 1;
+        }
+    }
+    words[ledCount * 24] = 0x8000;
+}
+
+static void testEncoding(int ledCount) {
+    // Each frame is sent out right away, from whichever sequence is free
+    PWM::sentFrames.clear();
+    shownFrames.clear();
+    Frame frame(ledCount, 0);
+    for (int i = 0; i < TEST_ENCODED_FRAME_COUNT; ++i) {
+        uint32_t changedMask = nextRandom() % 4 == 0 ? 0xFFFFFFFF : nextRandom() & nextRandom();
+        frame = makeFrame(frame, changedMask);
+        show(frame, (nextRandom() & 1) != 0, changedMask);
+        TEST_CHECK(PWM::active && PWM::sequenceCount == 1, "frame %d not sent out right away", i);
+
+        nrf_pwm_values_common_t words[MAX_LED_COUNT * 24 + 1];
+        legacyEncode(frame.data(), ledCount, words);
+        bool same = PWM::startWords[0].size() == (size_t)(ledCount * 24 + 1) &&
+            memcmp(PWM::startWords[0].data(), words, sizeof(nrf_pwm_values_common_t) * (ledCount * 24 + 1)) == 0;
+        TEST_CHECK(same, "frame %d not encoded the same as the old encoder", i);
+        PWM::runUntilIdle();
+    }
+}
+
+static void benchmarkEncoding(int ledCount) {
+    // The PWM stays busy, so each frame only gets encoded and replaces the previous one
+    std::vector<Frame> frames;
+    Frame frame(ledCount, 0);
+    for (int i = 0; i < TEST_TIMED_FRAME_COUNT; ++i) {
+        for (int l = 0; l < ledCount; ++l) {
+            frame[l] = nextRandom() & 0xFFFFFF;
+        }
+        frames.push_back(frame);
+    }
+    NeoPixel::show(frames[0].data());
+
+    uint32_t startTime = CycleCounter::read();
+    for (auto& f : frames) {
+        NeoPixel::show(f.data());
+    }
+    uint32_t fullNs = CycleCounter::read() - startTime;
+
+    // Partial frames with a single LED changing
+    NeoPixel::show(frame.data(), 0xFFFFFFFF);
+    startTime = CycleCounter::read();
+    for (int i = 0; i < TEST_TIMED_FRAME_COUNT; ++i) {
+        int l = i % ledCount;
+        frame[l] = frames[i][l];
+        NeoPixel::show(frame.data(), 1 << l);
+    }
+    uint32_t partialNs = CycleCounter::read() - startTime;
+
+    nrf_pwm_values_common_t words[MAX_LED_COUNT * 24 + 1];
+    uint32_t checksum = 0;
+    startTime = CycleCounter::read();
+    for (auto& f : frames) {
+        legacyEncode(f.data(), ledCount, words);
+        checksum += words[checksum % (ledCount * 24)];
+    }
+    uint32_t legacyNs = CycleCounter::read() - startTime;
+    PWM::runUntilIdle();
+
+    printf("NeoPixel: %d LEDs encoded in %u ns with the nibble table, %u ns bit by bit, one LED changed in %u ns (host times, checksum %u)\n",
+        ledCount, fullNs / TEST_TIMED_FRAME_COUNT, legacyNs / TEST_TIMED_FRAME_COUNT, partialNs / TEST_TIMED_FRAME_COUNT, checksum);
+}
+
+int main() {
+    Sim::setLayoutType(DiceVariants::DieLayoutType_PD6);
+    int ledCount = BoardManager::getBoard()->ledCount;
+    app_util_interrupts_enabled_hook = PWM::onInterruptsEnabled;
+    CycleCounter::init();
+    NeoPixel::init();
+
+    testBackToBackFrames(ledCount);
+    testStopWhilePending(ledCount);
+    testRandomTimings(ledCount);
+    testEncoding(ledCount);
+    benchmarkEncoding(ledCount);
+
+    TEST_CHECK(PWM::startedWhileActiveCount == 0, "%d playbacks started while the PWM was busy", PWM::startedWhileActiveCount);
+    return TEST_RESULT();
+}
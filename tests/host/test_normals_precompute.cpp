@@ -0,0 +1,230 @@
+// Plays normals animations on the 21 LED PD6, from every up face and with every color override, and checks
+// that they render the same frames as a copy of the old updateLEDs(), which worked out the angles of each
+// LED to the up face and back vector (dot products, acos8 lookups, a normalize and a cross product) on every
+// frame instead of once at start(). Reports the time and instructions per frame of both, and of the per
+// frame geometry on its own.
+
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include "sim/sim.h"
+#include "sim/data_set_builder.h"
+#include "sim/measure.h"
+#include "animations/animation_normals.h"
+#include "core/int3.h"
+#include "data_set/data_animation_bits.h"
+#include "drivers_nrf/cycle_counter.h"
+#include "utils/Rainbow.h"
+#include "utils/Utils.h"
+
+using namespace Animations;
+using namespace Config;
+using namespace DriversNRF;
+
+TEST_DEFINE_FAILURE_COUNT();
+
+#define TEST_DURATION_MS 3000
+#define TEST_FRAME_DURATION_MS 33
+
+static const NormalsColorOverrideType colorOverrideTypes[] = {
+    NormalsColorOverrideType_None,
+    NormalsColorOverrideType_FaceToGradient,
+    NormalsColorOverrideType_FaceToRainbowWheel,
+};
+
+// Base vectors of the old code, from start()
+struct LegacyNormalsState
+{
+    const Core::int3* faceNormal;
+    Core::int3 backVector;
+    int baseColorParam;
+};
+
+static void legacyStart(const AnimationNormals* preset, uint8_t remapFace, LegacyNormalsState& outState) {
+    auto layout = SettingsManager::getLayout();
+    const Core::int3* normals = layout->faceNormals;
+    outState.faceNormal = &normals[remapFace];
+    int backFaceOffset = 1;
+    Core::int3 backVectorNormal = normals[(remapFace + backFaceOffset) % layout->faceCount];
+    while (abs(Core::int3::dotTimes1000(*outState.faceNormal, backVectorNormal)) > 800 && backFaceOffset < layout->faceCount) {
+        backFaceOffset += 1;
+        backVectorNormal = normals[(remapFace + backFaceOffset) % layout->faceCount];
+    }
+    auto cross = Core::int3::cross(*outState.faceNormal, backVectorNormal);
+    cross.normalize();
+    outState.backVector = Core::int3::cross(cross, *outState.faceNormal);
+
+    outState.baseColorParam = 0;
+    if (preset->mainGradientColorType == NormalsColorOverrideType_FaceToGradient) {
+        outState.baseColorParam = (remapFace * 1000) / layout->faceCount;
+    } else if (preset->mainGradientColorType == NormalsColorOverrideType_FaceToRainbowWheel) {
+        outState.baseColorParam = (remapFace * 256) / layout->faceCount;
+    }
+}
+
+// The angles of an LED, as the old code computed them on every frame
+static void legacyGetAngles(const LegacyNormalsState& state, const Core::int3& normal, int& outAngleToAxis8, int& outAngleToBack8) {
+    int dotAxisTimes1000 = Core::int3::dotTimes1000(*state.faceNormal, normal);
+    uint8_t dotAxis8 = (dotAxisTimes1000 * 1275 + 1275000) / 10000;
+    outAngleToAxis8 = Utils::acos8(dotAxis8);
+
+    Core::int3 inPlaneNormal = normal - *state.faceNormal * dotAxisTimes1000;
+    inPlaneNormal.normalize();
+    int dotBackTimes1000 = Core::int3::dotTimes1000(state.backVector, inPlaneNormal);
+    int dotBack8 = (dotBackTimes1000 * 1275 + 1275000) / 10000;
+    outAngleToBack8 = Utils::acos8(dotBack8);
+    if (Core::int3::dotTimes1000(Core::int3::cross(state.backVector, normal), *state.faceNormal) < 0) {
+        outAngleToBack8 = 255 - outAngleToBack8;
+    }
+}
+
+// The old updateLEDs(), in LED order
+static void legacyUpdateLEDs(const AnimationNormals* preset, const DataSet::AnimationBits* bits, const LegacyNormalsState& state, int time, uint32_t* outLEDs) {
+    int fadeTime = preset->duration * preset->fade / (255 * 2);
+    uint8_t intensity = 255;
+    if (time <= fadeTime) {
+        intensity = (uint8_t)(time * 255 / fadeTime);
+    } else if (time >= (preset->duration - fadeTime)) {
+        intensity = (uint8_t)((preset->duration - time) * 255 / fadeTime);
+    }
+
+    int axisScrollTime = time * preset->axisScrollSpeedTimes1000 / preset->duration;
+    int angleScrollTime = time * preset->angleScrollSpeedTimes1000 / preset->duration;
+    int gradientTime = time * 1000 / preset->duration;
+
+    auto& gradient = bits->getRGBTrack(preset->gradientOverTime);
+    auto& axisGradient = bits->getRGBTrack(preset->gradientAlongAxis);
+    auto& angleGradient = bits->getRGBTrack(preset->gradientAlongAngle);
+    auto layout = SettingsManager::getLayout();
+    for (int i = 0; i < layout->ledCount; ++i) {
+        int angleToAxis8;
+        int angleToBack8;
+        legacyGetAngles(state, layout->ledNormals[i], angleToAxis8, angleToBack8);
+
+        int angleToAxisNormalized = (angleToAxis8 - 128) * 1000 / 128;
+        int axisGradientTime = angleToAxisNormalized * 1000 / preset->axisScaleTimes1000 + preset->axisOffsetTimes1000 + axisScrollTime;
+        uint32_t axisColor = axisGradient.evaluateColor(bits, axisGradientTime);
+
+        int angleToBackTimes1000 = (angleToBack8 - 128) * 1000 / 128;
+        int angleGradientTime = ((angleToBackTimes1000 + 1000) / 2 + angleScrollTime) % 1000;
+        uint32_t angleColor = angleGradient.evaluateColor(bits, angleGradientTime);
+
+        uint32_t gradientColor;
+        switch (preset->mainGradientColorType) {
+            case NormalsColorOverrideType_FaceToGradient:
+                gradientColor = gradient.evaluateColor(bits, state.baseColorParam + angleToAxisNormalized * preset->mainGradientColorVar / 1000);
+                break;
+            case NormalsColorOverrideType_FaceToRainbowWheel:
+                gradientColor = Rainbow::wheel((state.baseColorParam + angleToAxisNormalized * preset->mainGradientColorVar * 256 / 1000000) % 256);
+                break;
+            case NormalsColorOverrideType_None:
+            default:
+                gradientColor = gradient.evaluateColor(bits, gradientTime);
+                break;
+        }
+        outLEDs[i] = Utils::modulateColor(Utils::mulColors(gradientColor, Utils::mulColors(axisColor, angleColor)), intensity);
+    }
+}
+
+int main() {
+    CycleCounter::init();
+    Sim::setLayoutType(DiceVariants::DieLayoutType_PD6);
+    auto layout = SettingsManager::getLayout();
+    Sim::InstructionCounter counter;
+
+    Sim::DataSetBuilder builder;
+    uint16_t red = builder.addColor(0xFF0000);
+    uint16_t green = builder.addColor(0x00FF00);
+    uint16_t blue = builder.addColor(0x0000FF);
+    uint16_t white = builder.addColor(0xFFFFFF);
+    uint16_t orange = builder.addColor(0xFF8000);
+    uint16_t black = builder.addColor(0x000000);
+    uint16_t rainbowGradient = builder.addRGBTrack(0, { {0, red}, {334, green}, {666, blue}, {1000, red} });
+    uint16_t fireGradient = builder.addRGBTrack(0, { {0, black}, {200, red}, {500, orange}, {800, white}, {1000, black} });
+    uint16_t flashGradient = builder.addRGBTrack(0, { {0, white}, {100, blue}, {1000, black} });
+    int presetIndices[sizeof(colorOverrideTypes) / sizeof(colorOverrideTypes[0])];
+    for (int i = 0; i < (int)(sizeof(colorOverrideTypes) / sizeof(colorOverrideTypes[0])); ++i) {
+        AnimationNormals normals = {};
+        normals.type = Animation_Normals;
+        normals.duration = TEST_DURATION_MS;
+        normals.gradientOverTime = flashGradient;
+        normals.gradientAlongAxis = rainbowGradient;
+        normals.gradientAlongAngle = fireGradient;
+        normals.axisScaleTimes1000 = 1500;
+        normals.axisOffsetTimes1000 = 100;
+        normals.axisScrollSpeedTimes1000 = 1000;
+        normals.angleScrollSpeedTimes1000 = -500;
+        normals.fade = 128;
+        normals.mainGradientColorType = colorOverrideTypes[i];
+        normals.mainGradientColorVar = 400;
+        presetIndices[i] = builder.addAnimation(normals);
+    }
+    auto bits = builder.getBits();
+
+    int frameCount = 0;
+    uint64_t legacyNs = 0;
+    uint64_t ns = 0;
+    uint64_t geometryNs = 0;
+    uint64_t legacyInstructions = 0;
+    uint64_t instructions = 0;
+    uint64_t geometryInstructions = 0;
+    for (int presetIndex : presetIndices) {
+        auto preset = static_cast<const AnimationNormals*>(bits->getAnimation(presetIndex));
+        for (int upFace = 0; upFace < layout->faceCount; ++upFace) {
+            AnimationInstance* instance = createAnimationInstance(preset, bits);
+            instance->start(0, (uint8_t)upFace, 1);
+            LegacyNormalsState state;
+            legacyStart(preset, (uint8_t)upFace, state);
+
+            for (int ms = 0; ms <= preset->duration; ms += TEST_FRAME_DURATION_MS) {
+                uint32_t legacyLEDs[MAX_LED_COUNT];
+                uint64_t startInstructions = counter.read();
+                uint32_t startTime = CycleCounter::read();
+                legacyUpdateLEDs(preset, bits, state, ms, legacyLEDs);
+                legacyNs += CycleCounter::read() - startTime;
+                legacyInstructions += counter.read() - startInstructions;
+
+                uint32_t frame[MAX_LED_COUNT];
+                memset(frame, 0, sizeof(frame));
+                startInstructions = counter.read();
+                startTime = CycleCounter::read();
+                instance->render(ms, 1000, frame);
+                ns += CycleCounter::read() - startTime;
+                instructions += counter.read() - startInstructions;
+
+                // The part of the old frames that start() now does once
+                int angleSum = 0;
+                startInstructions = counter.read();
+                startTime = CycleCounter::read();
+                for (int i = 0; i < layout->ledCount; ++i) {
+                    int angleToAxis8;
+                    int angleToBack8;
+                    legacyGetAngles(state, layout->ledNormals[i], angleToAxis8, angleToBack8);
+                    angleSum += angleToAxis8 + angleToBack8;
+                }
+                geometryNs += CycleCounter::read() - startTime;
+                geometryInstructions += counter.read() - startInstructions;
+                TEST_CHECK(angleSum >= 0, "negative angles");
+
+                for (int i = 0; i < layout->ledCount; ++i) {
+                    uint32_t expected = legacyLEDs[i];
+                    uint32_t color = frame[layout->daisyChainIndexFromLEDIndex(i)];
+                    TEST_CHECK(color == expected, "color override %d, up face %d, at %d ms: LED %d is 0x%06x instead of 0x%06x",
+                        preset->mainGradientColorType, upFace, ms, i, color, expected);
+                }
+                frameCount++;
+            }
+            destroyAnimationInstance(instance);
+        }
+    }
+
+    printf("Normals on PD6: %d frames compared\n", frameCount);
+    printf("Normals on PD6: %llu ns per frame, %llu ns for the old code, of which %llu ns for its per frame geometry (host times)\n",
+        (unsigned long long)(ns / frameCount), (unsigned long long)(legacyNs / frameCount), (unsigned long long)(geometryNs / frameCount));
+    if (counter.isAvailable()) {
+        printf("Normals on PD6: %llu instructions per frame, %llu for the old code, of which %llu for its per frame geometry\n",
+            (unsigned long long)(instructions / frameCount), (unsigned long long)(legacyInstructions / frameCount),
+            (unsigned long long)(geometryInstructions / frameCount));
+    }
+    return TEST_RESULT();
+}
@@ -0,0 +1,259 @@
+// Plays random stacks of up to MAX_ANIMS animations on the real anim controller, and checksums the frames
+// it sends to the LEDs. The program is linked twice, with and without ANIM_OCCLUSION_CULLING (see the Makefile):
+// the build without culling writes its checksums, and the build with culling checks that it sends out
+// the exact same frames, and reports how many renders culling saved.
+// Stacks are mostly made of the animations that report their coverage (simple, gradient, blink id), with random
+// colors, faces and fades, mixed with the other types and with animations fading out.
+//
+// Usage: test_occlusion_culling [--check <frames file> | --write <frames file>]
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "test.h"
+#include "sim/sim.h"
+#include "sim/data_set_builder.h"
+#include "sim/sample_animations.h"
+#include "animations/Animation.h"
+#include "animations/animation_simple.h"
+#include "animations/animation_gradient.h"
+#include "animations/keyframes.h"
+#include "config/settings.h"
+#include "drivers_nrf/scheduler.h"
+#include "drivers_nrf/timers.h"
+#include "modules/anim_controller.h"
+
+using namespace Animations;
+using namespace Config;
+using namespace DriversNRF;
+using namespace Modules;
+
+TEST_DEFINE_FAILURE_COUNT();
+
+#define TEST_STACKS_PER_LAYOUT 400
+#define TEST_STACK_DURATION_MS 4000
+#define TEST_PALETTE_SIZE 16
+#define TEST_SIMPLE_COUNT 48
+#define TEST_GRADIENT_COUNT 16
+
+// Layouts without and with LEDs blending several faces, whose coverage is only partly opaque
+static const DiceVariants::LEDLayoutType layoutTypes[] = {
+    DiceVariants::DieLayoutType_D20,
+    DiceVariants::DieLayoutType_M20,
+    DiceVariants::DieLayoutType_D4,
+};
+#define TEST_STACK_COUNT (TEST_STACKS_PER_LAYOUT * sizeof(layoutTypes) / sizeof(layoutTypes[0]))
+
+static uint32_t randomState = 0x5EED;
+
+static uint32_t nextRandom() {
+    // xorshift32
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+// Checksum of the frames of the current stack, and when they were sent
+static uint32_t frameChecksum = 0;
+static int frameCount = 0;
+
+static void onLEDs(const uint32_t* colors, int ledCount) {
+    // FNV-1a
+    uint32_t time = (uint32_t)Timers::millis();
+    frameChecksum = (frameChecksum ^ time) * 16777619;
+    for (int i = 0; i < ledCount; ++i) {
+        frameChecksum = (frameChecksum ^ colors[i]) * 16777619;
+    }
+    frameCount++;
+}
+
+// Moves time forward a millisecond at a time, running the scheduled events in between like the main loop does
+static void runUntil(int ms) {
+    for (int time = Timers::millis() + 1; time <= ms; ++time) {
+        Sim::runTimers(time);
+        Scheduler::update();
+    }
+}
+
+// Adds random simple and gradient animations, some bright enough to hide others, returns their indices
+static std::vector<int> addRandomAnimations(Sim::DataSetBuilder& builder) {
+    uint16_t palette[TEST_PALETTE_SIZE];
+    palette[0] = builder.addColor(0xFFFFFF);
+    palette[1] = builder.addColor(0x000000);
+    for (int i = 2; i < TEST_PALETTE_SIZE; ++i) {
+        palette[i] = builder.addColor(nextRandom() & 0xFFFFFF);
+    }
+
+    std::vector<int> indices;
+    for (int i = 0; i < TEST_SIMPLE_COUNT; ++i) {
+        AnimationSimple simple = {};
+        simple.type = Animation_Simple;
+        simple.duration = (uint16_t)(500 + nextRandom() % 2500);
+        simple.faceMask = (nextRandom() & 1) != 0 ? ANIM_FACEMASK_ALL_LEDS : nextRandom() & 0xFFFFF;
+        simple.colorIndex = palette[nextRandom() % 4 == 0 ? 0 : nextRandom() % TEST_PALETTE_SIZE];
+        simple.count = (uint8_t)(1 + nextRandom() % 4);
+        simple.fade = (uint8_t)(nextRandom() % 256);
+        indices.push_back(builder.addAnimation(simple));
+    }
+    for (int i = 0; i < TEST_GRADIENT_COUNT; ++i) {
+        // Some gradients pick random colors, which they can't report the coverage of
+        std::vector<Sim::DataSetBuilder::KeyframeDesc> keyframes;
+        int keyframeCount = 2 + nextRandom() % 4;
+        for (int k = 0; k < keyframeCount; ++k) {
+            int colorIndex = i % 8 == 7 && k == 1 ? PALETTE_COLOR_FROM_RANDOM : palette[nextRandom() % TEST_PALETTE_SIZE];
+            keyframes.push_back({ k * 1000 / (keyframeCount - 1), colorIndex });
+        }
+        AnimationGradient gradient = {};
+        gradient.type = Animation_Gradient;
+        gradient.duration = (uint16_t)(500 + nextRandom() % 2500);
+        gradient.faceMask = (nextRandom() & 1) != 0 ? ANIM_FACEMASK_ALL_LEDS : nextRandom() & 0xFFFFF;
+        gradient.gradientTrackOffset = builder.addRGBTrack(0, keyframes);
+        indices.push_back(builder.addAnimation(gradient));
+    }
+    return indices;
+}
+
+struct StackResult
+{
+    uint32_t checksum;
+    int frameCount;
+    uint32_t renderCount;
+    uint32_t occludedCount;
+};
+
+static StackResult playStack(const DataSet::AnimationBits* bits, const std::vector<int>& randomIndices, const int sampleIndices[Animation_Count], int faceCount) {
+    AnimController::stopAll();
+    AnimController::UpdateStats statsBefore;
+    AnimController::getUpdateStats(statsBefore);
+    frameChecksum = 2166136261;
+    frameCount = 0;
+
+    int startTime = Timers::millis();
+    int animCount = 1 + nextRandom() % MAX_ANIMS;
+    for (int i = 0; i < animCount; ++i) {
+        runUntil(Timers::millis() + nextRandom() % 150);
+
+        // Mostly animations that report their coverage, with a sample of any type once in a while
+        int index;
+        if (nextRandom() % 5 == 0) {
+            index = sampleIndices[Animation_Unknown + 1 + nextRandom() % (Animation_Count - Animation_Unknown - 1)];
+        } else {
+            index = randomIndices[nextRandom() % randomIndices.size()];
+        }
+        AnimationTag tag = (AnimationTag)(1 + nextRandom() % 3);
+        AnimController::play(bits->getAnimation(index), bits, (uint8_t)(nextRandom() % faceCount), (uint8_t)(1 + nextRandom() % 3), tag);
+
+        // Fade some out, their fading colors are also checked against the others. Fades longer than
+        // FORCE_FADE_OUT_DURATION_MS brighten the animations at first, up to twice as bright here.
+        if (nextRandom() % 8 == 0) {
+            AnimController::fadeOutAnimsWithTag((AnimationTag)(1 + nextRandom() % 3), 100 + nextRandom() % 900);
+        }
+    }
+    runUntil(startTime + TEST_STACK_DURATION_MS);
+
+    AnimController::UpdateStats stats;
+    AnimController::getUpdateStats(stats);
+    return { frameChecksum, frameCount, stats.renderCount - statsBefore.renderCount, stats.occludedCount - statsBefore.occludedCount };
+}
+
+int main(int argc, char** argv) {
+    const char* checkPath = nullptr;
+    const char* writePath = nullptr;
+    if (argc == 3 && strcmp(argv[1], "--check") == 0) {
+        checkPath = argv[2];
+    } else if (argc == 3 && strcmp(argv[1], "--write") == 0) {
+        writePath = argv[2];
+    } else if (argc != 1) {
+        fprintf(stderr, "Usage: %s [--check <frames file> | --write <frames file>]\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<StackResult> expectedResults;
+    if (checkPath != nullptr) {
+        FILE* file = fopen(checkPath, "r");
+        if (file == nullptr) {
+            fprintf(stderr, "Can't read %s\n", checkPath);
+            return 2;
+        }
+        StackResult result;
+        while (fscanf(file, "%x %d %u %u", &result.checksum, &result.frameCount, &result.renderCount, &result.occludedCount) == 4) {
+            expectedResults.push_back(result);
+        }
+        fclose(file);
+        if (expectedResults.size() != TEST_STACK_COUNT) {
+            fprintf(stderr, "%s has %d stacks instead of %d\n", checkPath, (int)expectedResults.size(), (int)TEST_STACK_COUNT);
+            return 2;
+        }
+    }
+
+    Scheduler::init();
+    Sim::setCurrentFace(2);
+    Sim::setLEDsCallback(onLEDs);
+    AnimController::init();
+
+    std::vector<StackResult> results;
+    int totalFrameCount = 0;
+    uint32_t totalRenderCount = 0;
+    uint32_t totalOccludedCount = 0;
+    uint32_t expectedRenderCount = 0;
+    for (auto layoutType : layoutTypes) {
+        Sim::setLayoutType(layoutType);
+        auto layout = SettingsManager::getLayout();
+
+        Sim::DataSetBuilder builder;
+        int sampleIndices[Animation_Count];
+        Sim::addSampleAnimations(builder, layout->faceCount, sampleIndices);
+        std::vector<int> randomIndices = addRandomAnimations(builder);
+        auto bits = builder.getBits();
+        Sim::setDataSet(bits);
+
+        for (int i = 0; i < TEST_STACKS_PER_LAYOUT; ++i) {
+            int s = (int)results.size();
+            StackResult result = playStack(bits, randomIndices, sampleIndices, layout->faceCount);
+            results.push_back(result);
+            totalFrameCount += result.frameCount;
+            totalRenderCount += result.renderCount;
+            totalOccludedCount += result.occludedCount;
+            if (checkPath != nullptr) {
+                // Same frames, at the same times, and each render either done or skipped
+                auto& expected = expectedResults[s];
+                TEST_CHECK(result.checksum == expected.checksum && result.frameCount == expected.frameCount,
+                    "%s stack %d: %d frames with checksum 0x%08x instead of %d frames with checksum 0x%08x", Sim::getLayoutTypeName(layoutType),
+                    i, result.frameCount, result.checksum, expected.frameCount, expected.checksum);
+                TEST_CHECK(result.renderCount + result.occludedCount == expected.renderCount,
+                    "%s stack %d: %d renders and %d skipped instead of %d renders", Sim::getLayoutTypeName(layoutType),
+                    i, result.renderCount, result.occludedCount, expected.renderCount);
+                expectedRenderCount += expected.renderCount;
+            }
+        }
+
+        // The animations refer to the data set
+        AnimController::stopAll();
+    }
+
+    if (writePath != nullptr) {
+        FILE* file = fopen(writePath, "w");
+        if (file == nullptr) {
+            fprintf(stderr, "Can't write %s\n", writePath);
+            return 2;
+        }
+        for (auto& result : results) {
+            fprintf(file, "0x%08x %d %u %u\n", result.checksum, result.frameCount, result.renderCount, result.occludedCount);
+        }
+        fclose(file);
+    }
+
+#if ANIM_OCCLUSION_CULLING
+    TEST_CHECK(totalOccludedCount > 0, "no render skipped, the stacks don't test culling");
+#else
+    TEST_CHECK(totalOccludedCount == 0, "%d renders skipped without culling", totalOccludedCount);
+#endif
+    printf("Occlusion culling %s: %d stacks, %d frames, %u renders, %u skipped",
+        ANIM_OCCLUSION_CULLING ? "on" : "off", (int)TEST_STACK_COUNT, totalFrameCount, totalRenderCount, totalOccludedCount);
+    if (checkPath != nullptr) {
+        printf(" (%u renders without culling, %.1f%% saved)", expectedRenderCount, 100.0 * totalOccludedCount / expectedRenderCount);
+    }
+    printf("\n");
+    return TEST_RESULT();
+}
@@ -0,0 +1,226 @@
+// Checks the rainbow wheel table and the traveling phases rainbow animations compute in start() against copies
+// of the code they replaced:
+// - Rainbow::wheel() for every position and intensity, and faceWheel() for every face of up to 31 faces
+// - rainbow animations on every LED layout, traveling or not, with random counts, cycles, intensities, fades,
+//   face masks and up faces, over their whole duration, against the old updateDaisyChainLEDs()
+// Reports the time per call of both wheels, at full and scaled intensities, and per frame of both animations.
+
+#include <string.h>
+#include "test.h"
+#include "sim/sim.h"
+#include "sim/data_set_builder.h"
+#include "sim/sample_animations.h"
+#include "animations/animation_rainbow.h"
+#include "drivers_nrf/cycle_counter.h"
+#include "utils/Rainbow.h"
+#include "utils/Utils.h"
+
+using namespace Animations;
+using namespace Config;
+using namespace DriversNRF;
+
+TEST_DEFINE_FAILURE_COUNT();
+
+#define TEST_MAX_FACE_COUNT 31
+#define TEST_PRESETS_PER_LAYOUT 40
+#define TEST_FRAME_DURATION_MS 33
+#define TEST_TIMED_CALL_COUNT 1000000
+#define TEST_TIMED_FRAME_COUNT 20000
+
+static uint32_t randomState = 0x5EED;
+
+static uint32_t nextRandom() {
+    // xorshift32
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+// The old Rainbow::wheel(), computing the channels on every call
+static uint32_t legacyWheel(uint8_t WheelPos, uint8_t intensity = 255) {
+    if (WheelPos < 85) {
+        return Utils::toColor(WheelPos * 3 * intensity / 255, (255 - WheelPos * 3) * intensity / 255, 0);
+    } else if (WheelPos < 170) {
+        WheelPos -= 85;
+        return Utils::toColor((255 - WheelPos * 3) * intensity / 255, 0, WheelPos * 3 * intensity / 255);
+    } else {
+        WheelPos -= 170;
+        return Utils::toColor(0, WheelPos * 3 * intensity / 255, (255 - WheelPos * 3) * intensity / 255);
+    }
+}
+
+// The old AnimationInstanceRainbow::updateDaisyChainLEDs(), computing the offset of each LED on every frame
+static void legacyUpdateDaisyChainLEDs(const AnimationRainbow* preset, int startTime, uint8_t remapFace, int ms, uint32_t* outDaisyChainColors) {
+    auto layout = SettingsManager::getLayout();
+    int c = layout->ledCount;
+
+    uint32_t color = 0;
+    int fadeTime = preset->duration * preset->fade / (255 * 2);
+    int time = (ms - startTime);
+
+    int wheelPos = (time * preset->count * 255 / preset->duration) % 256;
+
+    uint8_t intensity = preset->intensity;
+    if (time <= fadeTime) {
+        intensity = (uint8_t)(time * preset->intensity / fadeTime);
+    } else if (time >= (preset->duration - fadeTime)) {
+        intensity = (uint8_t)((preset->duration - time) * preset->intensity / fadeTime);
+    }
+
+    int reverseMapping[MAX_LED_COUNT];
+    for (int f = 0; f < layout->faceCount; ++f) {
+        for (int ff = 0; ff < layout->faceCount; ++ff) {
+            if (f == layout->remapFaceIndexBasedOnUpFace(remapFace, ff)) {
+                reverseMapping[f] = ff;
+                break;
+            }
+        }
+    }
+
+    bool traveling = (preset->animFlags & AnimationFlags_Traveling) != 0;
+    if (!traveling) {
+        color = legacyWheel((uint8_t)wheelPos, intensity);
+    }
+    for (int l = 0; l < layout->ledCount; ++l) {
+        int faces[MAX_BLENDED_COLORS];
+        int faceCount = layout->faceIndicesFromLEDIndex(l, faces);
+        for (int f = 0; f < faceCount; ++f) {
+            int face = faces[f];
+            if ((preset->faceMask & (1 << reverseMapping[face])) != 0) {
+                int i = layout->daisyChainIndexFromLEDIndex(l);
+                outDaisyChainColors[i] = traveling
+                    ? legacyWheel((uint8_t)((wheelPos + i * 256 * preset->cyclesTimes10 / (c * 10)) % 256), intensity)
+                    : color;
+                break;
+            }
+        }
+    }
+}
+
+static void checkAnimations(DiceVariants::LEDLayoutType layoutType) {
+    const char* layoutName = Sim::getLayoutTypeName(layoutType);
+    Sim::setLayoutType(layoutType);
+    auto layout = SettingsManager::getLayout();
+
+    Sim::DataSetBuilder builder;
+    int indices[TEST_PRESETS_PER_LAYOUT];
+    for (int p = 0; p < TEST_PRESETS_PER_LAYOUT; ++p) {
+        // Fades of at least one frame, the old code divided by zero without
+        AnimationRainbow rainbow = {};
+        rainbow.type = Animation_Rainbow;
+        rainbow.animFlags = p % 4 == 3 ? AnimationFlags_None : AnimationFlags_Traveling;
+        rainbow.duration = (uint16_t)(500 + nextRandom() % 3000);
+        rainbow.faceMask = nextRandom() % 2 == 0 ? ANIM_FACEMASK_ALL_LEDS : nextRandom() & 0xFFFFF;
+        rainbow.count = (uint8_t)(1 + nextRandom() % 4);
+        rainbow.fade = (uint8_t)(8 + nextRandom() % 248);
+        rainbow.intensity = nextRandom() % 2 == 0 ? 255 : (uint8_t)nextRandom();
+        rainbow.cyclesTimes10 = (uint8_t)(1 + nextRandom() % 255);
+        indices[p] = builder.addAnimation(rainbow);
+    }
+    auto bits = builder.getBits();
+
+    int mismatchCount = 0;
+    for (int p = 0; p < TEST_PRESETS_PER_LAYOUT; ++p) {
+        auto preset = static_cast<const AnimationRainbow*>(bits->getAnimation(indices[p]));
+        uint8_t remapFace = (uint8_t)(nextRandom() % layout->faceCount);
+        AnimationInstance* instance = createAnimationInstance(preset, bits);
+        instance->start(0, remapFace, 1);
+        for (int ms = 0; ms <= preset->duration; ms += TEST_FRAME_DURATION_MS) {
+            uint32_t legacyFrame[MAX_LED_COUNT];
+            uint32_t frame[MAX_LED_COUNT];
+            memset(legacyFrame, 0, sizeof(legacyFrame));
+            memset(frame, 0, sizeof(frame));
+            legacyUpdateDaisyChainLEDs(preset, 0, remapFace, ms, legacyFrame);
+            instance->render(ms, 1000, frame);
+            for (int i = 0; i < layout->ledCount; ++i) {
+                if (mismatchCount < 10) {
+                    TEST_CHECK(frame[i] == legacyFrame[i], "%s rainbow %d (cycles %d) from face %d at %d ms: LED %d is 0x%06x instead of 0x%06x",
+                        layoutName, p, preset->cyclesTimes10, remapFace, ms, i, frame[i], legacyFrame[i]);
+                }
+                mismatchCount += frame[i] != legacyFrame[i] ? 1 : 0;
+            }
+        }
+        destroyAnimationInstance(instance);
+    }
+    TEST_CHECK(mismatchCount == 0, "%s: %d LEDs don't match the old rainbow", layoutName, mismatchCount);
+}
+
+int main() {
+    CycleCounter::init();
+
+    // The table and its scaling
+    for (int i = 0; i < 256; ++i) {
+        for (int p = 0; p < 256; ++p) {
+            uint32_t color = Rainbow::wheel((uint8_t)p, (uint8_t)i);
+            uint32_t expected = legacyWheel((uint8_t)p, (uint8_t)i);
+            TEST_CHECK(color == expected, "wheel at %d, intensity %d, is 0x%06x instead of 0x%06x", p, i, color, expected);
+        }
+    }
+    for (int count = 1; count <= TEST_MAX_FACE_COUNT; ++count) {
+        for (int face = 0; face < count; ++face) {
+            uint32_t color = Rainbow::faceWheel((uint8_t)face, (uint8_t)count);
+            uint32_t expected = legacyWheel((uint8_t)((face * 256) / count));
+            TEST_CHECK(color == expected, "wheel of face %d of %d is 0x%06x instead of 0x%06x", face, count, color, expected);
+        }
+    }
+
+    // The animations, traveling phases included
+    for (int layoutType = DiceVariants::DieLayoutType_D4; layoutType <= DiceVariants::DieLayoutType_M20; ++layoutType) {
+        checkAnimations((DiceVariants::LEDLayoutType)layoutType);
+    }
+
+    // Timing of the wheels, the colors are summed so that they can't be optimized out
+    uint32_t sum = 0;
+    static const uint8_t intensities[] = { 255, 200 };
+    for (uint8_t intensity : intensities) {
+        uint32_t startTime = CycleCounter::read();
+        for (int i = 0; i < TEST_TIMED_CALL_COUNT; ++i) {
+            sum += legacyWheel((uint8_t)i, intensity);
+        }
+        uint32_t legacyNs = CycleCounter::read() - startTime;
+        startTime = CycleCounter::read();
+        for (int i = 0; i < TEST_TIMED_CALL_COUNT; ++i) {
+            sum += Rainbow::wheel((uint8_t)i, intensity);
+        }
+        uint32_t ns = CycleCounter::read() - startTime;
+        printf("Rainbow wheel at intensity %d: %.2f ns per call, %.2f ns for the old wheel (host times)\n",
+            intensity, (double)ns / TEST_TIMED_CALL_COUNT, (double)legacyNs / TEST_TIMED_CALL_COUNT);
+    }
+
+    // And of a traveling rainbow on the 20 LEDs of a D20
+    Sim::setLayoutType(DiceVariants::DieLayoutType_D20);
+    Sim::DataSetBuilder builder;
+    AnimationRainbow rainbow = {};
+    rainbow.type = Animation_Rainbow;
+    rainbow.animFlags = AnimationFlags_Traveling;
+    rainbow.duration = 3000;
+    rainbow.faceMask = ANIM_FACEMASK_ALL_LEDS;
+    rainbow.count = 2;
+    rainbow.fade = 128;
+    rainbow.intensity = 200;
+    rainbow.cyclesTimes10 = 15;
+    int index = builder.addAnimation(rainbow);
+    auto bits = builder.getBits();
+    auto preset = static_cast<const AnimationRainbow*>(bits->getAnimation(index));
+    AnimationInstance* instance = createAnimationInstance(preset, bits);
+    instance->start(0, 0, 1);
+    uint32_t frame[MAX_LED_COUNT];
+    uint32_t startTime = CycleCounter::read();
+    for (int i = 0; i < TEST_TIMED_FRAME_COUNT; ++i) {
+        legacyUpdateDaisyChainLEDs(preset, 0, 0, i % preset->duration, frame);
+        sum += frame[i % 20];
+    }
+    uint32_t legacyNs = CycleCounter::read() - startTime;
+    startTime = CycleCounter::read();
+    for (int i = 0; i < TEST_TIMED_FRAME_COUNT; ++i) {
+        memset(frame, 0, sizeof(frame));
+        instance->render(i % preset->duration, 1000, frame);
+        sum += frame[i % 20];
+    }
+    uint32_t ns = CycleCounter::read() - startTime;
+    destroyAnimationInstance(instance);
+    printf("Traveling rainbow on D20: %.1f ns per frame, %.1f ns for the old code (host times, sum 0x%08x)\n",
+        (double)ns / TEST_TIMED_FRAME_COUNT, (double)legacyNs / TEST_TIMED_FRAME_COUNT, sum);
+    return TEST_RESULT();
+}
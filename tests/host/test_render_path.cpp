@@ -0,0 +1,216 @@
+// Compares AnimationInstance::render() with the path animations used to go through before it: update the
+// faces, remap them to a zeroed array of LEDs through the layout functions, copy the LEDs to a zeroed array
+// in daisy chain order, and let the anim controller fade and blend that array into its frame.
+// Every animation type is played on every LED layout, from random up faces, over random frames and fades
+// (up to twice as bright, like long fades out), and must render the exact same frames both ways. Reports
+// the time per frame and stack use of each path.
+// Noise, normals and rainbow render their LEDs directly, so their old path is rendering into a zeroed
+// array that the anim controller then fades and blends, which is the part render() removed for them.
+
+#include <string.h>
+#include "test.h"
+#include "sim/sim.h"
+#include "sim/data_set_builder.h"
+#include "sim/sample_animations.h"
+#include "sim/measure.h"
+#include "animations/Animation.h"
+#include "drivers_nrf/cycle_counter.h"
+#include "drivers_nrf/scheduler.h"
+#include "modules/anim_controller.h"
+#include "utils/Utils.h"
+
+using namespace Animations;
+using namespace Config;
+using namespace DriversNRF;
+using namespace Utils;
+
+TEST_DEFINE_FAILURE_COUNT();
+
+#define TEST_TIMING_REPEAT_COUNT 5
+
+static uint32_t randomState = 0x5EED;
+
+static uint32_t nextRandom() {
+    // xorshift32
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+static bool rendersDirectly(AnimationType type) {
+    return type == Animation_Rainbow || type == Animation_Noise || type == Animation_Normals;
+}
+
+// The color math of the old path, as Utils had it
+static uint32_t legacyScaleColor(uint32_t color, uint32_t scaleTimes1000) {
+    uint8_t red = CLAMP(getRed(color) * scaleTimes1000 / 1000, 0, 255);
+    uint8_t green = CLAMP(getGreen(color) * scaleTimes1000 / 1000, 0, 255);
+    uint8_t blue = CLAMP(getBlue(color) * scaleTimes1000 / 1000, 0, 255);
+    return toColor(red, green, blue);
+}
+
+static uint32_t legacyAddColors(uint32_t a, uint32_t b) {
+    return toColor(MAX(getRed(a), getRed(b)), MAX(getGreen(a), getGreen(b)), MAX(getBlue(a), getBlue(b)));
+}
+
+// The old updateLEDs(), from the faces of the animation
+static void legacyUpdateLEDs(AnimationInstance* instance, int ms, uint32_t* outLEDs) {
+    auto layout = SettingsManager::getLayout();
+
+    AnimationFaces animFaces;
+    animFaces.faceMask = 0;
+    instance->updateFaces(ms, animFaces);
+    uint32_t faceColors[MAX_LED_COUNT];
+    memset(faceColors, 0, sizeof(faceColors));
+    for (int f = 0; f < layout->faceCount; ++f) {
+        if ((animFaces.faceMask & (1 << f)) != 0) {
+            faceColors[layout->remapFaceIndexBasedOnUpFace(instance->remapFace, f)] = animFaces.colors[f];
+        }
+    }
+
+    for (int l = 0; l < layout->ledCount; ++l) {
+        int faces[MAX_BLENDED_COLORS];
+        int faceCount = layout->faceIndicesFromLEDIndex(l, faces);
+        if (faceCount == 0) {
+            outLEDs[l] = 0;
+        } else if (faceCount == 1) {
+            outLEDs[l] = faceColors[faces[0]];
+        } else {
+            uint32_t r = 0;
+            uint32_t g = 0;
+            uint32_t b = 0;
+            for (int i = 0; i < faceCount; ++i) {
+                r += getRed(faceColors[faces[i]]);
+                g += getGreen(faceColors[faces[i]]);
+                b += getBlue(faceColors[faces[i]]);
+            }
+            outLEDs[l] = toColor(r / faceCount, g / faceCount, b / faceCount);
+        }
+    }
+}
+
+// The old updateDaisyChainLEDs() and the blend of the anim controller
+static void legacyRender(AnimationInstance* instance, AnimationType type, int ms, uint32_t fadeTimes1000, uint32_t* daisyChainFrame) {
+    auto layout = SettingsManager::getLayout();
+
+    uint32_t daisyChainColors[MAX_LED_COUNT];
+    memset(daisyChainColors, 0, sizeof(uint32_t) * layout->ledCount);
+    if (rendersDirectly(type)) {
+        instance->render(ms, 1000, daisyChainColors);
+    } else {
+        uint32_t ledColors[MAX_LED_COUNT];
+        memset(ledColors, 0, sizeof(uint32_t) * MAX_LED_COUNT);
+        legacyUpdateLEDs(instance, ms, ledColors);
+        for (int l = 0; l < layout->ledCount; ++l) {
+            daisyChainColors[l] = ledColors[layout->LEDIndexFromDaisyChainIndex(l)];
+        }
+    }
+
+    for (int j = 0; j < layout->ledCount; ++j) {
+        uint32_t color = daisyChainColors[j];
+        if (fadeTimes1000 != 1000) {
+            color = legacyScaleColor(color, fadeTimes1000);
+        }
+        daisyChainFrame[j] = legacyAddColors(daisyChainFrame[j], color);
+    }
+}
+
+struct RenderRun
+{
+    const Animation* preset;
+    const DataSet::AnimationBits* bits;
+    uint8_t remapFace;
+    bool legacy;
+};
+
+// Plays the whole animation through one of the paths, over a blank frame
+static void renderAllFrames(void* param) {
+    auto run = (RenderRun*)param;
+    AnimationInstance* instance = createAnimationInstance(run->preset, run->bits);
+    instance->start(0, run->remapFace, 1);
+    uint32_t frame[MAX_LED_COUNT];
+    for (int ms = 0; ms <= run->preset->duration; ms += ANIM_FRAME_DURATION_MS) {
+        memset(frame, 0, sizeof(frame));
+        if (run->legacy) {
+            legacyRender(instance, run->preset->type, ms, 1000, frame);
+        } else {
+            instance->render(ms, 1000, frame);
+        }
+        Scheduler::update();
+    }
+    destroyAnimationInstance(instance);
+}
+
+static uint32_t timeAllFrames(RenderRun& run) {
+    uint32_t bestNs = 0xFFFFFFFF;
+    for (int i = 0; i < TEST_TIMING_REPEAT_COUNT; ++i) {
+        uint32_t startTime = CycleCounter::read();
+        renderAllFrames(&run);
+        bestNs = MIN(bestNs, CycleCounter::read() - startTime);
+    }
+    return bestNs;
+}
+
+int main() {
+    CycleCounter::init();
+    Scheduler::init();
+    Sim::setCurrentFace(2);
+
+    printf("%-6s %-16s %7s %12s %12s %12s %12s\n", "layout", "animation", "frames", "old ns/frame", "new ns/frame", "old stack", "new stack");
+    uint64_t totalLegacyNs = 0;
+    uint64_t totalNs = 0;
+    for (int layoutType = DiceVariants::DieLayoutType_D4; layoutType <= DiceVariants::DieLayoutType_M20; ++layoutType) {
+        Sim::setLayoutType((DiceVariants::LEDLayoutType)layoutType);
+        auto layout = SettingsManager::getLayout();
+        const char* layoutName = Sim::getLayoutTypeName((DiceVariants::LEDLayoutType)layoutType);
+
+        Sim::DataSetBuilder builder;
+        int animationIndices[Animation_Count];
+        Sim::addSampleAnimations(builder, layout->faceCount, animationIndices);
+        auto bits = builder.getBits();
+
+        for (int type = Animation_Unknown + 1; type < Animation_Count; ++type) {
+            const Animation* preset = bits->getAnimation(animationIndices[type]);
+            const char* animationName = Sim::getAnimationTypeName((AnimationType)type);
+            uint8_t remapFace = (uint8_t)(nextRandom() % layout->faceCount);
+
+            // Both instances draw the same random numbers, each from its own stream
+            AnimationInstance* legacyInstance = createAnimationInstance(preset, bits);
+            AnimationInstance* instance = createAnimationInstance(preset, bits);
+            legacyInstance->start(0, remapFace, 1);
+            instance->start(0, remapFace, 1);
+            int frameCount = 0;
+            for (int ms = 0; ms <= preset->duration; ms += ANIM_FRAME_DURATION_MS) {
+                // Over what other animations rendered, possibly fading
+                uint32_t legacyFrame[MAX_LED_COUNT];
+                uint32_t frame[MAX_LED_COUNT];
+                for (int l = 0; l < layout->ledCount; ++l) {
+                    legacyFrame[l] = frame[l] = nextRandom() % 2 == 0 ? 0 : nextRandom() & 0xFFFFFF;
+                }
+                uint32_t fadeTimes1000 = nextRandom() % 2 == 0 ? 1000 : nextRandom() % 2001;
+                legacyRender(legacyInstance, (AnimationType)type, ms, fadeTimes1000, legacyFrame);
+                instance->render(ms, fadeTimes1000, frame);
+                Scheduler::update();
+                for (int l = 0; l < layout->ledCount; ++l) {
+                    TEST_CHECK(frame[l] == legacyFrame[l], "%s %s from face %d at %d ms (fade %d): LED %d is 0x%06x instead of 0x%06x",
+                        layoutName, animationName, remapFace, ms, fadeTimes1000, l, frame[l], legacyFrame[l]);
+                }
+                frameCount++;
+            }
+            destroyAnimationInstance(legacyInstance);
+            destroyAnimationInstance(instance);
+
+            RenderRun legacyRun = { preset, bits, remapFace, true };
+            RenderRun run = { preset, bits, remapFace, false };
+            uint32_t legacyNs = timeAllFrames(legacyRun);
+            uint32_t ns = timeAllFrames(run);
+            totalLegacyNs += legacyNs;
+            totalNs += ns;
+            printf("%-6s %-16s %7d %12u %12u %12d %12d\n", layoutName, animationName, frameCount,
+                legacyNs / frameCount, ns / frameCount, Sim::measureStackUsage(renderAllFrames, &legacyRun), Sim::measureStackUsage(renderAllFrames, &run));
+        }
+    }
+    printf("Render path: %.1f%% of the time of the old path over all animations and layouts (host times)\n", 100.0 * totalNs / totalLegacyNs);
+    return TEST_RESULT();
+}
@@ -0,0 +1,220 @@
+// Drives a sequence the way the anim controller does (updating it at nextChangeTime(), but never faster
+// than the frame rate) and checks when its items get triggered:
+// - never before they are due, in delay order, each exactly once
+// - on the very update at which they are due, unless the scheduler queue is down to its headroom
+// - without ever leaving less than SEQUENCE_QUEUE_HEADROOM free entries in the scheduler queue
+// - nextChangeTime() returns the time the next item is due, or the next millisecond when the
+//   previous update couldn't trigger all the items that were due
+
+#include <vector>
+#include "test.h"
+#include "sim/sim.h"
+#include "sim/data_set_builder.h"
+#include "animations/Animation.h"
+#include "animations/animation_sequence.h"
+#include "animations/animation_simple.h"
+#include "drivers_nrf/scheduler.h"
+#include "modules/anim_controller.h"
+
+using namespace Animations;
+using namespace Config;
+using namespace DriversNRF;
+
+TEST_DEFINE_FAILURE_COUNT();
+
+// Same as in scheduler.cpp
+#define TEST_SCHED_QUEUE_SIZE 16
+
+// The sequence is started at a time that isn't a multiple of the frame duration
+#define TEST_START_TIME 1234
+
+// Item delays, some due at the same time (more than a frame can trigger), some within a frame of each other
+static const uint16_t itemDelays[] = {
+    1000, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    500, 500, 517, 500, 1000, 1000, 1000, 1000, 1000, 1000, 1000, 1000, 1000, 1000, 1000, 1000,
+    2345, 1999, 2000,
+};
+#define ITEM_COUNT (int)(sizeof(itemDelays) / sizeof(itemDelays[0]))
+
+struct Trigger
+{
+    int time;
+    uint16_t animationIndex;
+};
+
+static std::vector<Trigger> triggers;
+static int currentTime = 0;
+
+static void onPlay(const Animation* preset, const DataSet::AnimationBits* bits, uint8_t remapFace, uint8_t loopCount) {
+    for (int i = 0; i < bits->getAnimationCount(); ++i) {
+        if (bits->getAnimation(i) == preset) {
+            triggers.push_back({ currentTime, (uint16_t)i });
+            return;
+        }
+    }
+    TEST_CHECK(false, "triggered an animation that isn't in the data set");
+}
+
+static void doNothing(void* p_event_data, uint16_t event_size) {
+}
+
+// Fills the scheduler queue with events of other modules, until only freeCount entries are left
+static void fillQueue(int freeCount) {
+    while (Scheduler::getQueueSpace() > freeCount) {
+        Scheduler::push(nullptr, 0, doNothing);
+    }
+}
+
+// Returns the number of items due at time
+static int getDueCount(int time) {
+    int count = 0;
+    for (int i = 0; i < ITEM_COUNT; ++i) {
+        if (TEST_START_TIME + itemDelays[i] <= time) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// Plays the sequence, with busyFrames[i] != 0 when the queue is nearly full during the i-th update
+static void playSequence(const Animation* sequence, const DataSet::AnimationBits* bits, const std::vector<int>& busyFrames) {
+    triggers.clear();
+    AnimationInstance* instance = createAnimationInstance(sequence, bits);
+
+    uint32_t frame[MAX_LED_COUNT];
+    int ms = TEST_START_TIME;
+    bool wasBacklogged = false;
+    for (int update = 0; ms <= TEST_START_TIME + sequence->duration; ++update) {
+        currentTime = ms;
+        bool busy = update < (int)busyFrames.size() && busyFrames[update] != 0;
+
+        // The anim controller pushes its own event ahead of rendering, other modules may have filled the queue
+        Scheduler::push(nullptr, 0, doNothing);
+        if (busy) {
+            fillQueue(SEQUENCE_QUEUE_HEADROOM);
+        }
+        int spaceBefore = Scheduler::getQueueSpace();
+        int triggerCountBefore = (int)triggers.size();
+
+        // Starting the sequence triggers the items due right away, like an update
+        if (update == 0) {
+            instance->start(ms, 0, 1);
+        } else {
+            instance->render(ms, 1000, frame);
+        }
+
+        // The anim controller asks for the next update time right after rendering, before the queue is executed
+        int nextChangeTime = instance->nextChangeTime(ms);
+        int spaceAfter = Scheduler::getQueueSpace();
+        int launchCount = spaceBefore - spaceAfter;
+        int maxLaunchCount = spaceBefore > SEQUENCE_QUEUE_HEADROOM ? spaceBefore - SEQUENCE_QUEUE_HEADROOM : 0;
+        TEST_CHECK(launchCount <= maxLaunchCount, "at %d ms, %d items triggered with only %d free entries", ms, launchCount, spaceBefore);
+        TEST_CHECK(spaceAfter >= SEQUENCE_QUEUE_HEADROOM || spaceAfter == spaceBefore, "at %d ms, %d free entries left", ms, spaceAfter);
+
+        Scheduler::update();
+        int triggeredCount = (int)triggers.size() - triggerCountBefore;
+        TEST_CHECK(triggeredCount == launchCount, "at %d ms, %d items pushed but %d triggered", ms, launchCount, triggeredCount);
+
+        // Whatever is due and wasn't triggered must be retried on the next millisecond
+        int backlog = getDueCount(ms) - (int)triggers.size();
+        if (backlog > 0) {
+            TEST_CHECK(launchCount == maxLaunchCount, "at %d ms, %d items due left behind with room in the queue", ms, backlog);
+            TEST_CHECK(nextChangeTime == ms + 1, "at %d ms, %d items due left behind but next change at %d ms", ms, backlog, nextChangeTime);
+        } else {
+            // The next item due, if any
+            int nextDueTime = ANIM_TIME_NEVER;
+            for (int i = 0; i < ITEM_COUNT; ++i) {
+                int dueTime = TEST_START_TIME + itemDelays[i];
+                if (dueTime > ms && dueTime < nextDueTime) {
+                    nextDueTime = dueTime;
+                }
+            }
+            TEST_CHECK(nextChangeTime == nextDueTime, "at %d ms, next change at %d ms instead of %d ms", ms, nextChangeTime, nextDueTime);
+        }
+
+        // Items due since the last update are triggered right away, unless the queue is too full
+        if (!wasBacklogged && !busy) {
+            for (int i = triggerCountBefore; i < (int)triggers.size(); ++i) {
+                TEST_CHECK(triggers[i].time == ms, "item triggered late");
+            }
+        }
+        wasBacklogged = backlog > 0;
+
+        if (nextChangeTime == ANIM_TIME_NEVER) {
+            break;
+        }
+        ms = nextChangeTime > ms + ANIM_FRAME_DURATION_MS ? nextChangeTime : ms + ANIM_FRAME_DURATION_MS;
+    }
+    destroyAnimationInstance(instance);
+}
+
+// Checks that all the items were triggered once, in delay order, and not before they were due
+static void checkTriggers(const AnimationSequenceItem* items, const char* testName) {
+    TEST_CHECK((int)triggers.size() == ITEM_COUNT, "%s: %d items triggered out of %d", testName, (int)triggers.size(), ITEM_COUNT);
+    std::vector<bool> triggered(ITEM_COUNT, false);
+    int lastDelay = 0;
+    for (auto& trigger : triggers) {
+        // Items trigger an animation of their own, see main()
+        int item = -1;
+        for (int i = 0; i < ITEM_COUNT; ++i) {
+            if (items[i].animationIndex == trigger.animationIndex) {
+                item = i;
+            }
+        }
+        TEST_CHECK(item >= 0 && !triggered[item], "%s: animation %d triggered twice", testName, trigger.animationIndex);
+        if (item < 0 || triggered[item]) {
+            continue;
+        }
+        triggered[item] = true;
+        TEST_CHECK(trigger.time >= TEST_START_TIME + itemDelays[item], "%s: item %d triggered at %d ms, before it was due", testName, item, trigger.time);
+        TEST_CHECK(itemDelays[item] >= lastDelay, "%s: item %d triggered out of delay order", testName, item);
+        lastDelay = itemDelays[item];
+    }
+}
+
+int main() {
+    Scheduler::init();
+    Sim::setPlayCallback(onPlay);
+    Sim::setLayoutType(DiceVariants::DieLayoutType_D20);
+    TEST_CHECK(Scheduler::getQueueSpace() == TEST_SCHED_QUEUE_SIZE, "scheduler queue size changed, update the test");
+
+    // Each item triggers an animation of its own, so that triggers can be matched to items
+    Sim::DataSetBuilder builder;
+    AnimationSimple simple = {};
+    simple.type = Animation_Simple;
+    simple.duration = 100;
+    simple.faceMask = 1;
+    simple.count = 1;
+    std::vector<AnimationSequenceItem> items;
+    for (int i = 0; i < ITEM_COUNT; ++i) {
+        items.push_back({ (uint16_t)builder.addAnimation(simple), itemDelays[i] });
+    }
+    AnimationSequence sequence = {};
+    sequence.type = Animation_Sequence;
+    sequence.duration = 3000;
+    sequence.animationsOffset = builder.addAnimationData(items.data(), ITEM_COUNT * sizeof(AnimationSequenceItem));
+    sequence.animationCount = ITEM_COUNT;
+    int sequenceIndex = builder.addAnimation(sequence);
+    auto bits = builder.getBits();
+
+    // Queue free apart from the anim controller event
+    playSequence(bits->getAnimation(sequenceIndex), bits, {});
+    checkTriggers(items.data(), "free queue");
+
+    // The first 20 items take two frames, the 12 due at 1000 ms one frame and one more millisecond
+    int triggeredAtStart = 0;
+    int triggeredAt1000 = 0;
+    for (auto& trigger : triggers) {
+        triggeredAtStart += trigger.time == TEST_START_TIME ? 1 : 0;
+        triggeredAt1000 += trigger.time == TEST_START_TIME + 1000 ? 1 : 0;
+    }
+    int launchesPerFrame = TEST_SCHED_QUEUE_SIZE - 1 - SEQUENCE_QUEUE_HEADROOM;
+    TEST_CHECK(triggeredAtStart == launchesPerFrame, "%d items triggered on the first frame", triggeredAtStart);
+    TEST_CHECK(triggeredAt1000 == launchesPerFrame, "%d items triggered at 1000 ms", triggeredAt1000);
+
+    // Other modules fill the queue during some of the updates, including the ones items are due at
+    playSequence(bits->getAnimation(sequenceIndex), bits, { 1, 0, 1, 1, 0, 0, 1, 0, 1, 0, 0, 1 });
+    checkTriggers(items.data(), "busy queue");
+
+    return TEST_RESULT();
+}
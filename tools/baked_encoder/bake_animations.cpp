@@ -0,0 +1,316 @@
+// Bakes keyframed animations into the frame streams played back by baked animations, in both formats,
+// and reports for each die layout:
+// - the size of the keyframed animation (preset, tracks, keyframes and palette colors) and of the
+//   baked ones (preset, frame stream and palette colors), and their compression ratio, i.e. how much
+//   smaller they are than the raw frames (3 bytes per face per frame)
+// - the time and instructions per frame to render them
+// - the largest difference per color channel between the frames of both, which must be 0 for palette streams
+//
+// Usage: bake_animations
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "baked_encoder.h"
+#include "sim/sim.h"
+#include "sim/data_set_builder.h"
+#include "sim/sample_animations.h"
+#include "sim/measure.h"
+#include "animations/Animation.h"
+#include "animations/animation_keyframed.h"
+#include "drivers_nrf/cycle_counter.h"
+#include "modules/anim_controller.h"
+#include "utils/Utils.h"
+
+using namespace Animations;
+using namespace Config;
+using namespace DriversNRF;
+using namespace Tools;
+
+#define BAKE_DURATION_MS 3000
+
+// Minimum time spent rendering each animation, to average out the timer resolution and host noise
+#define BAKE_MIN_TIME_NS (20 * 1000 * 1000)
+#define BAKE_MIN_REPEAT_COUNT 3
+
+static const DiceVariants::LEDLayoutType layoutTypes[] = {
+    DiceVariants::DieLayoutType_D4,
+    DiceVariants::DieLayoutType_D6_FD6,
+    DiceVariants::DieLayoutType_D8,
+    DiceVariants::DieLayoutType_D10_D00,
+    DiceVariants::DieLayoutType_D12,
+    DiceVariants::DieLayoutType_D20,
+    DiceVariants::DieLayoutType_PD6,
+    DiceVariants::DieLayoutType_M20,
+};
+
+struct KeyframedSource
+{
+    const char* name;
+    int animationIndex;
+};
+
+static uint32_t randomState = 0x5EED;
+
+static uint32_t nextRandom() {
+    // xorshift32
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+// Adds the keyframed animations to bake on top of the sample one: a flash of all the faces,
+// a light spinning around the die (one track per face) and a flickering fire (random keyframes)
+static void addKeyframedAnimations(Sim::DataSetBuilder& builder, int faceCount, std::vector<KeyframedSource>& outSources) {
+    uint16_t black = builder.addColor(0x000000);
+    uint16_t white = builder.addColor(0xFFFFFF);
+    uint16_t red = builder.addColor(0xFF0000);
+    uint16_t fireColors[] = { builder.addColor(0xFF2000), builder.addColor(0xFF6000), builder.addColor(0xFFA010), builder.addColor(0x801000) };
+
+    AnimationKeyframed keyframed = {};
+    keyframed.type = Animation_Keyframed;
+    keyframed.duration = BAKE_DURATION_MS;
+
+    keyframed.tracksOffset = builder.addRGBTrack(ANIM_FACEMASK_ALL_LEDS, { {0, black}, {100, white}, {1000, black} });
+    keyframed.trackCount = 1;
+    outSources.push_back({ "Flash", builder.addAnimation(keyframed) });
+
+    for (int face = 0; face < faceCount; ++face) {
+        int time = face * 900 / faceCount;
+        uint16_t track = builder.addRGBTrack(1 << face, { {time, black}, {time + 40, red}, {time + 120, black} });
+        if (face == 0) {
+            keyframed.tracksOffset = track;
+        }
+    }
+    keyframed.trackCount = (uint16_t)faceCount;
+    outSources.push_back({ "Spin", builder.addAnimation(keyframed) });
+
+    for (int face = 0; face < faceCount; ++face) {
+        std::vector<Sim::DataSetBuilder::KeyframeDesc> keyframes;
+        for (int i = 0; i < 8; ++i) {
+            keyframes.push_back({ i * 1000 / 7, fireColors[nextRandom() % 4] });
+        }
+        uint16_t track = builder.addRGBTrack(1 << face, keyframes);
+        if (face == 0) {
+            keyframed.tracksOffset = track;
+        }
+    }
+    outSources.push_back({ "Fire", builder.addAnimation(keyframed) });
+}
+
+// Size of the keyframed animation in the data set, counting the palette colors it uses
+static int getKeyframedSize(const AnimationKeyframed* preset, const DataSet::AnimationBits* bits) {
+    int size = sizeof(AnimationKeyframed) + preset->trackCount * sizeof(RGBTrack);
+    std::vector<bool> usedColors(bits->getPaletteSize() / 3, false);
+    for (int i = 0; i < preset->trackCount; ++i) {
+        auto& track = bits->getRGBTrack(preset->tracksOffset + i);
+        size += track.keyFrameCount * sizeof(RGBKeyframe);
+        for (int j = 0; j < track.keyFrameCount; ++j) {
+            int colorIndex = track.getRGBKeyframe(bits, j).colorIndex();
+            if (colorIndex < (int)usedColors.size()) {
+                usedColors[colorIndex] = true;
+            }
+        }
+    }
+    for (bool used : usedColors) {
+        size += used ? 3 : 0;
+    }
+    return size;
+}
+
+// First time (relative to the start) at which a baked animation shows the given frame, see AnimationInstanceBaked
+static int getFrameTime(int frameIndex, int frameCount) {
+    return (frameIndex * BAKE_DURATION_MS + frameCount - 1) / frameCount;
+}
+
+// Renders the frames of the animation at the times the baked animation changes frames
+static void renderFrames(const Animation* preset, const DataSet::AnimationBits* bits, int frameCount, int ledCount, std::vector<std::vector<uint32_t>>& outFrames) {
+    AnimationInstance* instance = createAnimationInstance(preset, bits);
+    instance->start(0, 0, 1);
+    outFrames.clear();
+    for (int i = 0; i < frameCount; ++i) {
+        std::vector<uint32_t> frame(MAX_LED_COUNT, 0);
+        instance->render(getFrameTime(i, frameCount), 1000, frame.data());
+        frame.resize(ledCount);
+        outFrames.push_back(frame);
+    }
+    destroyAnimationInstance(instance);
+}
+
+// Returns the faces colors of the animation in canonical orientation, at the same times
+static void getFaceFrames(const Animation* preset, const DataSet::AnimationBits* bits, int frameCount, int faceCount, std::vector<BakedEncoder::Frame>& outFrames) {
+    AnimationInstance* instance = createAnimationInstance(preset, bits);
+    instance->start(0, 0, 1);
+    outFrames.clear();
+    for (int i = 0; i < frameCount; ++i) {
+        AnimationFaces faces;
+        faces.faceMask = 0;
+        instance->updateFaces(getFrameTime(i, frameCount), faces);
+        BakedEncoder::Frame frame(faceCount, 0);
+        for (int face = 0; face < faceCount; ++face) {
+            frame[face] = (faces.faceMask & (1 << face)) != 0 ? faces.colors[face] : 0;
+        }
+        outFrames.push_back(frame);
+    }
+    destroyAnimationInstance(instance);
+}
+
+// Returns the best time and instructions per frame to render the animation at the frame times
+static void timeFrames(const Animation* preset, const DataSet::AnimationBits* bits, int frameCount, const Sim::InstructionCounter& counter, uint32_t& outNs, uint64_t& outInstructions) {
+    outNs = 0xFFFFFFFF;
+    uint64_t totalNs = 0;
+    for (int repeat = 0; repeat < BAKE_MIN_REPEAT_COUNT || totalNs < BAKE_MIN_TIME_NS; ++repeat) {
+        AnimationInstance* instance = createAnimationInstance(preset, bits);
+        instance->start(0, 0, 1);
+        uint32_t frame[MAX_LED_COUNT];
+        uint64_t startInstructions = counter.read();
+        uint32_t startTime = CycleCounter::read();
+        for (int i = 0; i < frameCount; ++i) {
+            memset(frame, 0, sizeof(frame));
+            instance->render(getFrameTime(i, frameCount), 1000, frame);
+        }
+        uint32_t ns = CycleCounter::read() - startTime;
+        uint64_t instructions = counter.read() - startInstructions;
+        destroyAnimationInstance(instance);
+        if (ns < outNs) {
+            outNs = ns;
+            outInstructions = instructions;
+        }
+        totalNs += ns;
+    }
+    outNs /= frameCount;
+    outInstructions /= frameCount;
+}
+
+static int getMaxChannelError(const std::vector<std::vector<uint32_t>>& frames, const std::vector<std::vector<uint32_t>>& otherFrames) {
+    int maxError = 0;
+    for (size_t i = 0; i < frames.size(); ++i) {
+        for (size_t j = 0; j < frames[i].size(); ++j) {
+            uint32_t color = frames[i][j];
+            uint32_t otherColor = otherFrames[i][j];
+            maxError = std::max(maxError, abs((int)Utils::getRed(color) - (int)Utils::getRed(otherColor)));
+            maxError = std::max(maxError, abs((int)Utils::getGreen(color) - (int)Utils::getGreen(otherColor)));
+            maxError = std::max(maxError, abs((int)Utils::getBlue(color) - (int)Utils::getBlue(otherColor)));
+        }
+    }
+    return maxError;
+}
+
+static void formatInstructions(const Sim::InstructionCounter& counter, uint64_t instructions, char* text, int size) {
+    if (counter.isAvailable()) {
+        snprintf(text, size, "%llu", (unsigned long long)instructions);
+    } else {
+        snprintf(text, size, "n/a");
+    }
+}
+
+int main() {
+    CycleCounter::init();
+    Sim::setCurrentFace(2);
+    Sim::InstructionCounter counter;
+
+    int frameCount = BAKE_DURATION_MS / ANIM_FRAME_DURATION_MS;
+    printf("%d frames per animation, sizes in bytes, times per frame\n", frameCount);
+    printf("%-6s %-10s %6s %6s %8s %6s %7s %6s %9s %6s %9s %9s %8s %10s %10s\n", "layout", "animation", "raw", "keyfr",
+        "palette", "ratio", "rgb565", "ratio", "vs keyfr", "error", "keyfr ns", "baked ns", "speedup", "keyfr ins", "baked ins");
+
+    int errorCount = 0;
+    for (auto layoutType : layoutTypes) {
+        Sim::setLayoutType(layoutType);
+        auto layout = DiceVariants::getLayout(layoutType);
+
+        Sim::DataSetBuilder builder;
+        int animationIndices[Animation_Count];
+        Sim::addSampleAnimations(builder, layout->faceCount, animationIndices);
+        std::vector<KeyframedSource> sources = { { "Sample", animationIndices[Animation_Keyframed] } };
+        addKeyframedAnimations(builder, layout->faceCount, sources);
+        auto bits = builder.getBits();
+
+        for (auto& source : sources) {
+            auto preset = bits->getAnimation(source.animationIndex);
+            std::vector<BakedEncoder::Frame> faceFrames;
+            getFaceFrames(preset, bits, frameCount, layout->faceCount, faceFrames);
+            std::vector<std::vector<uint32_t>> keyframedFrames;
+            renderFrames(preset, bits, frameCount, layout->ledCount, keyframedFrames);
+
+            // Each baked animation goes into a data set of its own, with the palette of its frames
+            std::vector<uint32_t> palette;
+            bool hasPalette = BakedEncoder::buildPalette(faceFrames, palette);
+            int bakedSizes[2] = { 0, 0 };
+            int maxErrors[2] = { 0, 0 };
+            uint32_t bakedNs = 0;
+            uint64_t bakedInstructions = 0;
+            for (int format = BakedFormat_Palette; format <= BakedFormat_RGB565; ++format) {
+                if (format == BakedFormat_Palette && !hasPalette) {
+                    continue;
+                }
+                std::vector<uint8_t> stream = BakedEncoder::encode(faceFrames, layout->faceCount, (BakedFormat)format, palette);
+                Sim::DataSetBuilder bakedBuilder;
+                if (format == BakedFormat_Palette) {
+                    for (uint32_t color : palette) {
+                        bakedBuilder.addColor(color);
+                    }
+                }
+                AnimationBaked baked = {};
+                baked.type = Animation_Baked;
+                baked.duration = BAKE_DURATION_MS;
+                baked.frameCount = (uint16_t)frameCount;
+                baked.framesOffset = bakedBuilder.addAnimationData(stream.data(), (int)stream.size());
+                baked.framesSize = (uint16_t)stream.size();
+                baked.format = (BakedFormat)format;
+                int bakedIndex = bakedBuilder.addAnimation(baked);
+                auto bakedBits = bakedBuilder.getBits();
+                auto bakedPreset = bakedBits->getAnimation(bakedIndex);
+
+                bakedSizes[format] = sizeof(AnimationBaked) + (int)stream.size() + (format == BakedFormat_Palette ? (int)palette.size() * 3 : 0);
+                std::vector<std::vector<uint32_t>> bakedFrames;
+                renderFrames(bakedPreset, bakedBits, frameCount, layout->ledCount, bakedFrames);
+                maxErrors[format] = getMaxChannelError(keyframedFrames, bakedFrames);
+
+                // The palette stream is the one worth playing when there is one
+                if (format == BakedFormat_Palette || !hasPalette) {
+                    timeFrames(bakedPreset, bakedBits, frameCount, counter, bakedNs, bakedInstructions);
+                }
+            }
+            if (hasPalette && maxErrors[BakedFormat_Palette] != 0) {
+                errorCount++;
+            }
+
+            uint32_t keyframedNs;
+            uint64_t keyframedInstructions;
+            timeFrames(preset, bits, frameCount, counter, keyframedNs, keyframedInstructions);
+
+            int rawSize = frameCount * layout->faceCount * 3;
+            char paletteSizeText[16] = "n/a";
+            char paletteRatioText[16] = "n/a";
+            if (hasPalette) {
+                snprintf(paletteSizeText, sizeof(paletteSizeText), "%d", bakedSizes[BakedFormat_Palette]);
+                snprintf(paletteRatioText, sizeof(paletteRatioText), "%.1f", (double)rawSize / bakedSizes[BakedFormat_Palette]);
+            }
+            char keyframedInstructionsText[24];
+            char bakedInstructionsText[24];
+            formatInstructions(counter, keyframedInstructions, keyframedInstructionsText, sizeof(keyframedInstructionsText));
+            formatInstructions(counter, bakedInstructions, bakedInstructionsText, sizeof(bakedInstructionsText));
+            int keyframedSize = getKeyframedSize((const AnimationKeyframed*)preset, bits);
+            int bestBakedSize = hasPalette ? std::min(bakedSizes[BakedFormat_Palette], bakedSizes[BakedFormat_RGB565]) : bakedSizes[BakedFormat_RGB565];
+            printf("%-6s %-10s %6d %6d %8s %6s %7d %6.1f %8.1fx %3d/%-2d %9u %9u %7.1fx %10s %10s\n",
+                Sim::getLayoutTypeName(layoutType), source.name, rawSize, keyframedSize,
+                paletteSizeText, paletteRatioText, bakedSizes[BakedFormat_RGB565], (double)rawSize / bakedSizes[BakedFormat_RGB565],
+                (double)bestBakedSize / keyframedSize, maxErrors[BakedFormat_Palette], maxErrors[BakedFormat_RGB565],
+                keyframedNs, bakedNs, (double)keyframedNs / (bakedNs != 0 ? bakedNs : 1), keyframedInstructionsText, bakedInstructionsText);
+        }
+    }
+
+    printf("ratio: raw size / baked size, vs keyfr: smallest baked size / keyframed size,\n");
+    printf("error: largest channel difference with the keyframed frames (palette/rgb565), speedup: keyframed time / baked time\n");
+    if (!counter.isAvailable()) {
+        printf("Instruction counts need access to the perf events, see /proc/sys/kernel/perf_event_paranoid\n");
+    }
+    if (errorCount > 0) {
+        printf("%d palette streams don't play back the keyframed frames\n", errorCount);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include "baked_encoder.h"
+#include <algorithm>
+#include "utils/Utils.h"
+
+using namespace Animations;
+
+namespace Tools::BakedEncoder
+{
+    static uint32_t getFaceColor(const Frame& frame, int face) {
+        return face < (int)frame.size() ? frame[face] : 0;
+    }
+
+    bool buildPalette(const std::vector<Frame>& frames, std::vector<uint32_t>& outPalette) {
+        outPalette.clear();
+        for (auto& frame : frames) {
+            for (uint32_t color : frame) {
+                if (color != 0 && std::find(outPalette.begin(), outPalette.end(), color) == outPalette.end()) {
+                    if ((int)outPalette.size() > MaxPaletteIndex) {
+                        return false;
+                    }
+                    outPalette.push_back(color);
+                }
+            }
+        }
+        return true;
+    }
+
+    std::vector<uint8_t> encode(const std::vector<Frame>& frames, int faceCount, BakedFormat format, const std::vector<uint32_t>& palette) {
+        std::vector<uint8_t> stream;
+        int maskSize = (faceCount + 7) / 8;
+        Frame previousFrame(faceCount, 0);
+        for (auto& frame : frames) {
+            // Compare what the decoder shows, so that colors RGB565 can't tell apart don't count as changes
+            uint32_t changedFaces = 0;
+            for (int face = 0; face < faceCount; ++face) {
+                uint32_t color = getFaceColor(frame, face);
+                uint32_t previousColor = previousFrame[face];
+                if (format == BakedFormat_RGB565) {
+                    color = toRGB565Color(color);
+                    previousColor = toRGB565Color(previousColor);
+                }
+                if (color != previousColor) {
+                    changedFaces |= 1 << face;
+                }
+            }
+
+            for (int i = 0; i < maskSize; ++i) {
+                stream.push_back((uint8_t)(changedFaces >> (i * 8)));
+            }
+            for (int face = 0; face < faceCount; ++face) {
+                if ((changedFaces & (1 << face)) == 0) {
+                    continue;
+                }
+                uint32_t color = getFaceColor(frame, face);
+                if (format == BakedFormat_RGB565) {
+                    uint32_t rgb565 = ((Utils::getRed(color) >> 3) << 11) | ((Utils::getGreen(color) >> 2) << 5) | (Utils::getBlue(color) >> 3);
+                    stream.push_back((uint8_t)rgb565);
+                    stream.push_back((uint8_t)(rgb565 >> 8));
+                } else if (color == 0) {
+                    stream.push_back(BAKED_PALETTE_INDEX_OFF);
+                } else {
+                    stream.push_back((uint8_t)(std::find(palette.begin(), palette.end(), color) - palette.begin()));
+                }
+            }
+            for (int face = 0; face < faceCount; ++face) {
+                previousFrame[face] = getFaceColor(frame, face);
+            }
+        }
+        return stream;
+    }
+
+    uint32_t toRGB565Color(uint32_t color) {
+        // Same as AnimationInstanceBaked::decodeFrame()
+        uint32_t red = Utils::getRed(color) >> 3;
+        uint32_t green = Utils::getGreen(color) >> 2;
+        uint32_t blue = Utils::getBlue(color) >> 3;
+        return Utils::toColor((red << 3) | (red >> 2), (green << 2) | (green >> 4), (blue << 3) | (blue >> 2));
+    }
+}
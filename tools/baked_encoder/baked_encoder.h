@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "animations/animation_baked.h"
+#include "data_set/data_animation_bits.h"
+
+namespace Tools
+{
+    /// <summary>
+    /// Encodes frames of face colors (in canonical orientation) into the frame stream played back by
+    /// baked animations, see AnimationBaked for the format.
+    /// </summary>
+    namespace BakedEncoder
+    {
+        // Face colors of one frame, faces not in the vector are off
+        typedef std::vector<uint32_t> Frame;
+
+        // Highest palette index a palette encoded stream may use, the ones above are reserved
+        // (see PALETTE_COLOR_FROM_RANDOM and BAKED_PALETTE_INDEX_OFF)
+        const int MaxPaletteIndex = PALETTE_COLOR_FROM_RANDOM - 1;
+
+        // Fills the palette with the colors of the frames (but off), returns false if there are too many of them
+        bool buildPalette(const std::vector<Frame>& frames, std::vector<uint32_t>& outPalette);
+
+        // Encodes the frames as deltas from the previous frame, the first one from all faces off.
+        // The palette is only used with BakedFormat_Palette, and must hold all the colors of the frames.
+        std::vector<uint8_t> encode(const std::vector<Frame>& frames, int faceCount, Animations::BakedFormat format, const std::vector<uint32_t>& palette);
+
+        // Returns the color a BakedFormat_RGB565 stream decodes for the given color
+        uint32_t toRGB565Color(uint32_t color);
+    }
+}